@@ -7,26 +7,87 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 DISABLE_WARNINGS_POP()
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <vector>
+#include <memory>
+#include <optional>
+#include <span>
 
 
+// Storage type of a single channel
+enum class ImageFormat {
+    UInt8,
+    UInt16,
+    Float16, // IEEE half, as produced by the OpenEXR decoder
+    Float32
+};
+
+size_t getComponentSize(ImageFormat format);
+
+// Non-owning view of pixel rows. Rows may be padded or be part of a larger image, so always step by rowStride.
+struct ImageView {
+    const std::byte* data { nullptr };
+    int width { 0 }, height { 0 }, channels { 0 };
+    ImageFormat format { ImageFormat::UInt8 };
+    size_t rowStride { 0 }; // In bytes
+
+    size_t getPixelSize() const { return size_t(channels) * getComponentSize(format); }
+    bool isContiguous() const { return rowStride == size_t(width) * getPixelSize(); }
+    const std::byte* getRow(int y) const { return data + size_t(y) * rowStride; }
+    // Normalized to [0, 1] for integer formats
+    float getComponent(int x, int y, int channel) const;
+    // Rectangle of this view that shares its rows
+    ImageView subView(int x, int y, int subWidth, int subHeight) const;
+};
+
+struct ImageLoadSettings {
+    int channels { 0 }; // Expand or drop channels while decoding; 0 keeps the channels stored in the file
+    std::optional<ImageFormat> format; // Convert while decoding; by default 16-bit and HDR files keep their precision (EXR files decode to Float16)
+};
+
+// Properties of an image file, read from its header
+struct ImageInfo {
+    int width { 0 }, height { 0 }, channels { 0 };
+};
+
+// Decoded pixels, stored exactly as the decoder produced them (tightly packed rows, interleaved channels).
+// Move-only: the buffer returned by stb_image is adopted rather than copied.
 struct Image {
 public:
-    explicit Image(const std::filesystem::path& filePath);
+    explicit Image(const std::filesystem::path& filePath, const ImageLoadSettings& settings = {});
+    // Decode an image file that is already in memory; filePath is only recorded, not read
+    static Image fromMemory(std::span<const std::byte> encoded, const ImageLoadSettings& settings = {}, const std::filesystem::path& filePath = {});
+    // Zero-initialized image
+    Image(int width, int height, int channels, ImageFormat format = ImageFormat::UInt8);
+    // Size and channels of an image file without decoding it; empty if the file cannot be read
+    static std::optional<ImageInfo> readInfo(const std::filesystem::path& filePath);
 
+    Image(const Image&) = delete;
+    Image(Image&&) noexcept = default;
+    Image& operator=(const Image&) = delete;
+    Image& operator=(Image&&) noexcept = default;
 
-    void writeBitmapToFile(const std::filesystem::path& filePath);
+    // Only supported for 8-bit images
+    void writeBitmapToFile(const std::filesystem::path& filePath) const;
 
 public:
-    int width, height, channels;
+    int width { 0 }, height { 0 }, channels { 0 };
+    ImageFormat format { ImageFormat::UInt8 };
+    // File the image was loaded from
+    std::filesystem::path filePath;
+
+    ImageView view() const { return { pixels.get(), width, height, channels, format, size_t(width) * size_t(channels) * getComponentSize(format) }; }
+    size_t getSizeInBytes() const { return size_t(height) * size_t(width) * size_t(channels) * getComponentSize(format); }
+
     template<int image_channels = 3> glm::vec<image_channels, float>get_pixel(const int index) const {
         //Template argument should equal actual image channels
         assert(image_channels == channels);
-        
+
         glm::vec<image_channels, float> pixel;
         for (int channel = 0; channel < image_channels; channel++) {
-            pixel[channel] = pixels[index * image_channels + channel] / 255.0f;
+            pixel[channel] = getComponent(size_t(index) * image_channels + size_t(channel));
         }
 
         return pixel;
@@ -35,16 +96,36 @@ public:
     template<int image_channels = 3> void set_pixel(const int index, glm::vec<image_channels, float> value) {
         //Template argument should equal actual image channels
         assert(image_channels == channels);
-        
+
         for (int channel = 0; channel < image_channels; channel++) {
-            pixels[index * image_channels + channel] = (uint8_t) (value[channel] * 255.0f);
+            setComponent(size_t(index) * image_channels + size_t(channel), value[channel]);
         }
     }
 
+    std::byte* data() { return pixels.get(); }
+    const std::byte* data() const { return pixels.get(); }
+
     uint8_t* get_data() {
-        return pixels.data();
+        assert(format == ImageFormat::UInt8);
+        return reinterpret_cast<uint8_t*>(pixels.get());
     }
+    const uint8_t* get_data() const {
+        assert(format == ImageFormat::UInt8);
+        return reinterpret_cast<const uint8_t*>(pixels.get());
+    }
+
+private:
+    Image() = default;
+    void decode(std::span<const std::byte> encoded, const ImageLoadSettings& settings);
+    void decodeEXR(std::span<const std::byte> encoded);
+    // Change the channel count and format of the decoded pixels the way stb_image does while decoding
+    void convert(int newChannels, ImageFormat newFormat);
+
+    // Normalized to [0, 1] for integer formats
+    float getComponent(size_t index) const;
+    void setComponent(size_t index, float value);
 
 private:
-    std::vector<uint8_t> pixels;
+    // Freed with the allocator that produced it (stb_image or calloc)
+    std::unique_ptr<std::byte, void (*)(void*)> pixels { nullptr, nullptr };
 };
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+// Read-only memory mapping of a whole file. The contents stay valid for the lifetime of the object.
+struct MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& filePath);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    ~MappedFile();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) noexcept;
+
+    std::span<const std::byte> bytes() const { return { m_data, m_size }; }
+    size_t size() const { return m_size; }
+
+private:
+    void unmap();
+
+private:
+    const std::byte* m_data { nullptr };
+    size_t m_size { 0 };
+#ifdef _WIN32
+    void* m_fileHandle { nullptr };
+    void* m_mappingHandle { nullptr };
+#endif
+};
@@ -48,6 +48,8 @@ struct Mesh {
 struct LoadMeshSettings {
 	bool normalizeVertexPositions { false };
 	bool cacheVertices { true };
+	// Parse the file on all cores (falls back to tinyobjloader for polygons with more than four corners)
+	bool parallelLoading { true };
 };
 
 [[nodiscard]] std::vector<Mesh> loadMesh(const std::filesystem::path& file, const LoadMeshSettings& settings = {});
@@ -0,0 +1,782 @@
+#include "exr_decoder.h"
+#include "parallel_for.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/packing.hpp>
+#include <stb/stb_image.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EXR_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t EXR_MAGIC = 20000630;
+constexpr uint32_t EXR_VERSION = 2;
+constexpr uint32_t TILED_FLAG = 0x200;
+constexpr uint32_t DEEP_DATA_FLAG = 0x800;
+constexpr uint32_t MULTI_PART_FLAG = 0x1000;
+
+enum class PixelType : int32_t {
+    UInt = 0,
+    Half = 1,
+    Float = 2
+};
+
+enum class Compression : uint8_t {
+    None = 0,
+    RLE = 1,
+    ZIPS = 2,
+    ZIP = 3,
+    PIZ = 4
+};
+
+struct Channel {
+    PixelType type;
+    int outputIndex; // -1 if the channel is not decoded
+};
+
+struct Header {
+    std::vector<Channel> channels; // In file order, which is sorted by name
+    Compression compression { Compression::None };
+    int width { 0 }, height { 0 };
+    int yMin { 0 }; // First line of the data window, as recorded in scanline chunks
+    int outputChannels { 0 };
+    bool isTiled { false };
+    int tileWidth { 0 }, tileHeight { 0 };
+    size_t offsetTableStart { 0 };
+};
+
+// Bounds-checked little-endian reads; every violation is reported as a corrupt file
+class ByteReader {
+public:
+    explicit ByteReader(std::span<const std::byte> bytes, size_t offset = 0)
+        : m_bytes(bytes)
+        , m_offset(offset)
+    {
+    }
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view readString()
+    {
+        const std::byte* start = m_bytes.data() + m_offset;
+        const auto* end = static_cast<const std::byte*>(std::memchr(start, 0, m_bytes.size() - std::min(m_offset, m_bytes.size())));
+        if (!end)
+            throw std::runtime_error("unterminated header string");
+        m_offset += static_cast<size_t>(end - start) + 1;
+        return { reinterpret_cast<const char*>(start), static_cast<size_t>(end - start) };
+    }
+
+    std::span<const std::byte> take(size_t size)
+    {
+        if (size > m_bytes.size() || m_offset > m_bytes.size() - size)
+            throw std::runtime_error("unexpected end of file");
+        const std::span<const std::byte> result = m_bytes.subspan(m_offset, size);
+        m_offset += size;
+        return result;
+    }
+
+    size_t getOffset() const { return m_offset; }
+
+private:
+    std::span<const std::byte> m_bytes;
+    size_t m_offset;
+};
+
+size_t getSampleSize(PixelType type)
+{
+    return type == PixelType::Half ? 2 : 4;
+}
+
+int getLinesPerChunk(Compression compression)
+{
+    switch (compression) {
+    case Compression::None:
+    case Compression::RLE:
+    case Compression::ZIPS:
+        return 1;
+    case Compression::ZIP:
+        return 16;
+    case Compression::PIZ:
+        return 32;
+    }
+    return 1;
+}
+
+// Layers such as "diffuse.R" are matched on the part after the last dot
+std::string_view getBaseName(std::string_view name)
+{
+    const size_t dot = name.rfind('.');
+    return dot == std::string_view::npos ? name : name.substr(dot + 1);
+}
+
+Header parseHeader(std::span<const std::byte> encoded)
+{
+    ByteReader reader(encoded);
+    if (reader.read<uint32_t>() != EXR_MAGIC)
+        throw std::runtime_error("not an OpenEXR file");
+    const uint32_t version = reader.read<uint32_t>();
+    if ((version & 0xFF) != EXR_VERSION)
+        throw std::runtime_error("unsupported version");
+    if (version & (DEEP_DATA_FLAG | MULTI_PART_FLAG))
+        throw std::runtime_error("deep and multi-part files are not supported");
+
+    Header header;
+    header.isTiled = (version & TILED_FLAG) != 0;
+    std::vector<std::string_view> channelNames;
+    std::optional<std::array<int32_t, 4>> dataWindow;
+    bool hasTileDescription = false;
+
+    // Attributes: name, type name, size and value, until an empty name
+    for (std::string_view name = reader.readString(); !name.empty(); name = reader.readString()) {
+        const std::string_view type = reader.readString();
+        const int32_t size = reader.read<int32_t>();
+        if (size < 0)
+            throw std::runtime_error("invalid attribute size");
+        ByteReader value(reader.take(static_cast<size_t>(size)));
+
+        if (name == "channels" && type == "chlist") {
+            for (std::string_view channelName = value.readString(); !channelName.empty(); channelName = value.readString()) {
+                const auto pixelType = static_cast<PixelType>(value.read<int32_t>());
+                value.take(4); // pLinear and reserved bytes
+                const int32_t xSampling = value.read<int32_t>();
+                const int32_t ySampling = value.read<int32_t>();
+                if (pixelType != PixelType::UInt && pixelType != PixelType::Half && pixelType != PixelType::Float)
+                    throw std::runtime_error("unknown pixel type");
+                if (xSampling != 1 || ySampling != 1)
+                    throw std::runtime_error("subsampled channels are not supported");
+                header.channels.push_back({ pixelType, -1 });
+                channelNames.push_back(channelName);
+            }
+        } else if (name == "compression" && type == "compression") {
+            header.compression = static_cast<Compression>(value.read<uint8_t>());
+        } else if (name == "dataWindow" && type == "box2i") {
+            dataWindow = { value.read<int32_t>(), value.read<int32_t>(), value.read<int32_t>(), value.read<int32_t>() };
+        } else if (name == "tiles" && type == "tiledesc") {
+            header.tileWidth = static_cast<int>(value.read<uint32_t>());
+            header.tileHeight = static_cast<int>(value.read<uint32_t>());
+            hasTileDescription = true;
+        }
+    }
+    header.offsetTableStart = reader.getOffset();
+
+    if (header.channels.empty() || !dataWindow)
+        throw std::runtime_error("missing channels or data window");
+    const int64_t width = int64_t((*dataWindow)[2]) - (*dataWindow)[0] + 1;
+    const int64_t height = int64_t((*dataWindow)[3]) - (*dataWindow)[1] + 1;
+    if (width <= 0 || height <= 0 || width * height > std::numeric_limits<int32_t>::max())
+        throw std::runtime_error("invalid data window");
+    header.width = static_cast<int>(width);
+    header.height = static_cast<int>(height);
+    header.yMin = (*dataWindow)[1];
+    if (header.compression > Compression::PIZ)
+        throw std::runtime_error("unsupported compression (only none, RLE, ZIPS, ZIP and PIZ are supported)");
+    if (header.isTiled && (!hasTileDescription || header.tileWidth <= 0 || header.tileHeight <= 0))
+        throw std::runtime_error("invalid tile description");
+
+    // Map the channels onto RGB(A), or onto grey(A) for luminance and single-channel files
+    const auto findChannel = [&](std::string_view baseName) -> Channel* {
+        for (size_t i = 0; i < channelNames.size(); ++i) {
+            if (getBaseName(channelNames[i]) == baseName)
+                return &header.channels[i];
+        }
+        return nullptr;
+    };
+    Channel* red = findChannel("R");
+    Channel* green = findChannel("G");
+    Channel* blue = findChannel("B");
+    Channel* alpha = findChannel("A");
+    if (red || green || blue) {
+        for (Channel* channel : { red, green, blue }) {
+            if (channel)
+                channel->outputIndex = header.outputChannels;
+            ++header.outputChannels;
+        }
+    } else if (Channel* grey = findChannel("Y"); grey || header.channels.size() - (alpha ? 1 : 0) == 1) {
+        if (!grey)
+            grey = alpha == &header.channels[0] ? &header.channels[1] : &header.channels[0];
+        grey->outputIndex = header.outputChannels++;
+    } else {
+        throw std::runtime_error("no R, G, B or Y channels");
+    }
+    if (alpha)
+        alpha->outputIndex = header.outputChannels++;
+
+    return header;
+}
+
+// ZIP and RLE store the bytes delta-encoded, with the odd and even bytes of the chunk split into two halves
+void reconstructBytes(std::byte* scratch, size_t size, std::byte* output)
+{
+    auto* bytes = reinterpret_cast<uint8_t*>(scratch);
+    for (size_t i = 1; i < size; ++i)
+        bytes[i] = static_cast<uint8_t>(bytes[i - 1] + bytes[i] - 128);
+
+    const uint8_t* first = bytes;
+    const uint8_t* second = bytes + (size + 1) / 2;
+    auto* out = reinterpret_cast<uint8_t*>(output);
+    size_t i = 0;
+#ifdef EXR_DECODER_SSE2
+    for (; i + 32 <= size; i += 32, first += 16, second += 16) {
+        const __m128i evens = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const __m128i odds = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(evens, odds));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), _mm_unpackhi_epi8(evens, odds));
+    }
+#endif
+    for (; i < size; ++i)
+        out[i] = (i & 1) ? *second++ : *first++;
+}
+
+void decompressZIP(std::span<const std::byte> compressed, std::span<std::byte> output, std::vector<std::byte>& scratch)
+{
+    scratch.resize(output.size());
+    const int decodedSize = stbi_zlib_decode_buffer(reinterpret_cast<char*>(scratch.data()), static_cast<int>(scratch.size()),
+        reinterpret_cast<const char*>(compressed.data()), static_cast<int>(compressed.size()));
+    if (decodedSize != static_cast<int>(output.size()))
+        throw std::runtime_error("corrupt ZIP chunk");
+    reconstructBytes(scratch.data(), output.size(), output.data());
+}
+
+void decompressRLE(std::span<const std::byte> compressed, std::span<std::byte> output, std::vector<std::byte>& scratch)
+{
+    scratch.resize(output.size());
+    size_t in = 0, out = 0;
+    while (in < compressed.size()) {
+        const auto count = static_cast<int8_t>(compressed[in++]);
+        if (count < 0) {
+            // Literal run
+            const size_t length = static_cast<size_t>(-count);
+            if (length > compressed.size() - in || length > scratch.size() - out)
+                throw std::runtime_error("corrupt RLE chunk");
+            std::memcpy(&scratch[out], &compressed[in], length);
+            in += length;
+            out += length;
+        } else {
+            const size_t length = static_cast<size_t>(count) + 1;
+            if (in == compressed.size() || length > scratch.size() - out)
+                throw std::runtime_error("corrupt RLE chunk");
+            std::memset(&scratch[out], static_cast<int>(compressed[in++]), length);
+            out += length;
+        }
+    }
+    if (out != output.size())
+        throw std::runtime_error("corrupt RLE chunk");
+    reconstructBytes(scratch.data(), output.size(), output.data());
+}
+
+// PIZ: Huffman coding of 16-bit values, following the canonical code layout of OpenEXR's ImfHuf
+namespace huffman {
+
+    constexpr int ENCODING_SIZE = (1 << 16) + 1;
+    constexpr int DECODING_BITS = 14;
+    constexpr int DECODING_SIZE = 1 << DECODING_BITS;
+    constexpr uint64_t DECODING_MASK = DECODING_SIZE - 1;
+    constexpr int SHORT_ZERO_CODE_RUN = 59;
+    constexpr int LONG_ZERO_CODE_RUN = 63;
+    constexpr int SHORTEST_LONG_RUN = 2 + LONG_ZERO_CODE_RUN - SHORT_ZERO_CODE_RUN;
+
+    // Codes are stored as length in the low 6 bits and code value above
+    int getLength(uint64_t code) { return static_cast<int>(code & 63); }
+    uint64_t getCode(uint64_t code) { return code >> 6; }
+
+    struct DecodingEntry {
+        int length { 0 }; // Of a short code; 0 if the entry lists long codes
+        int symbol { 0 };
+        std::vector<int> longSymbols; // Symbols of the codes longer than DECODING_BITS that start with these bits
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t* data, const uint8_t* end)
+            : m_data(data)
+            , m_end(end)
+        {
+        }
+
+        uint64_t readBits(int count)
+        {
+            while (m_bitCount < count)
+                readByte();
+            m_bitCount -= count;
+            return (m_buffer >> m_bitCount) & ((uint64_t(1) << count) - 1);
+        }
+
+        void readByte()
+        {
+            if (m_data == m_end)
+                throw std::runtime_error("truncated Huffman data");
+            m_buffer = (m_buffer << 8) | *m_data++;
+            m_bitCount += 8;
+        }
+
+        bool hasMoreBytes() const { return m_data < m_end; }
+        const uint8_t* getPosition() const { return m_data; }
+
+        uint64_t m_buffer { 0 };
+        int m_bitCount { 0 };
+
+    private:
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+    };
+
+    // Code lengths are stored for the symbols minSymbol to maxSymbol with run-length coded zeros; the canonical
+    // code values are derived from the lengths
+    std::vector<uint64_t> unpackEncodingTable(BitReader& reader, int minSymbol, int maxSymbol)
+    {
+        std::vector<uint64_t> codes(ENCODING_SIZE, 0);
+        for (int symbol = minSymbol; symbol <= maxSymbol; ++symbol) {
+            const uint64_t length = reader.readBits(6);
+            codes[static_cast<size_t>(symbol)] = length;
+            if (length >= SHORT_ZERO_CODE_RUN) {
+                const int zeroRun = length == LONG_ZERO_CODE_RUN
+                    ? static_cast<int>(reader.readBits(8)) + SHORTEST_LONG_RUN
+                    : static_cast<int>(length) - SHORT_ZERO_CODE_RUN + 2;
+                if (symbol + zeroRun > maxSymbol + 1)
+                    throw std::runtime_error("invalid Huffman table");
+                std::fill_n(&codes[static_cast<size_t>(symbol)], zeroRun, 0);
+                symbol += zeroRun - 1;
+            }
+        }
+
+        std::array<uint64_t, 59> countPerLength {};
+        for (uint64_t length : codes)
+            ++countPerLength[length];
+        uint64_t code = 0;
+        for (int length = 58; length > 0; --length) {
+            const uint64_t nextCode = (code + countPerLength[length]) >> 1;
+            countPerLength[length] = code;
+            code = nextCode;
+        }
+        for (uint64_t& entry : codes) {
+            const uint64_t length = entry;
+            if (length > 0)
+                entry = length | (countPerLength[length]++ << 6);
+        }
+        return codes;
+    }
+
+    std::vector<DecodingEntry> buildDecodingTable(const std::vector<uint64_t>& codes, int minSymbol, int maxSymbol)
+    {
+        std::vector<DecodingEntry> table(DECODING_SIZE);
+        for (int symbol = minSymbol; symbol <= maxSymbol; ++symbol) {
+            const uint64_t code = getCode(codes[static_cast<size_t>(symbol)]);
+            const int length = getLength(codes[static_cast<size_t>(symbol)]);
+            if (code >> length)
+                throw std::runtime_error("invalid Huffman code");
+
+            if (length > DECODING_BITS) {
+                DecodingEntry& entry = table[code >> (length - DECODING_BITS)];
+                if (entry.length)
+                    throw std::runtime_error("invalid Huffman code");
+                entry.longSymbols.push_back(symbol);
+            } else if (length > 0) {
+                const uint64_t first = code << (DECODING_BITS - length);
+                for (uint64_t i = 0; i < (uint64_t(1) << (DECODING_BITS - length)); ++i) {
+                    DecodingEntry& entry = table[first + i];
+                    if (entry.length || !entry.longSymbols.empty())
+                        throw std::runtime_error("invalid Huffman code");
+                    entry.length = length;
+                    entry.symbol = symbol;
+                }
+            }
+        }
+        return table;
+    }
+
+    // The symbol runLengthSymbol is followed by 8 bits that repeat the previous value that many times
+    void emitSymbol(int symbol, int runLengthSymbol, BitReader& reader, std::span<uint16_t> output, size_t& written)
+    {
+        if (symbol == runLengthSymbol) {
+            if (reader.m_bitCount < 8)
+                reader.readByte();
+            reader.m_bitCount -= 8;
+            const size_t count = static_cast<uint8_t>(reader.m_buffer >> reader.m_bitCount);
+            if (written == 0 || count > output.size() - written)
+                throw std::runtime_error("invalid Huffman run");
+            std::fill_n(&output[written], count, output[written - 1]);
+            written += count;
+        } else {
+            if (written == output.size())
+                throw std::runtime_error("too much Huffman data");
+            output[written++] = static_cast<uint16_t>(symbol);
+        }
+    }
+
+    void decompress(std::span<const std::byte> compressed, std::span<uint16_t> output)
+    {
+        ByteReader header(compressed);
+        const uint32_t minSymbol = header.read<uint32_t>();
+        const uint32_t maxSymbol = header.read<uint32_t>();
+        header.read<uint32_t>(); // Table length
+        const uint32_t bitCount = header.read<uint32_t>();
+        header.read<uint32_t>();
+        if (minSymbol >= ENCODING_SIZE || maxSymbol >= ENCODING_SIZE || minSymbol > maxSymbol)
+            throw std::runtime_error("invalid Huffman table size");
+
+        const auto* begin = reinterpret_cast<const uint8_t*>(compressed.data());
+        const uint8_t* end = begin + compressed.size();
+        BitReader tableReader(begin + header.getOffset(), end);
+        const std::vector<uint64_t> codes = unpackEncodingTable(tableReader, static_cast<int>(minSymbol), static_cast<int>(maxSymbol));
+        const std::vector<DecodingEntry> table = buildDecodingTable(codes, static_cast<int>(minSymbol), static_cast<int>(maxSymbol));
+
+        const uint8_t* data = tableReader.getPosition();
+        if ((uint64_t(bitCount) + 7) / 8 > uint64_t(end - data))
+            throw std::runtime_error("truncated Huffman data");
+        BitReader reader(data, data + (bitCount + 7) / 8);
+        const int runLengthSymbol = static_cast<int>(maxSymbol);
+        size_t written = 0;
+
+        while (reader.hasMoreBytes()) {
+            reader.readByte();
+            while (reader.m_bitCount >= DECODING_BITS) {
+                const DecodingEntry& entry = table[(reader.m_buffer >> (reader.m_bitCount - DECODING_BITS)) & DECODING_MASK];
+                if (entry.length) {
+                    reader.m_bitCount -= entry.length;
+                    emitSymbol(entry.symbol, runLengthSymbol, reader, output, written);
+                    continue;
+                }
+
+                // Long code: try every code that shares the leading bits
+                bool isFound = false;
+                for (int symbol : entry.longSymbols) {
+                    const int length = getLength(codes[static_cast<size_t>(symbol)]);
+                    while (reader.m_bitCount < length && reader.hasMoreBytes())
+                        reader.readByte();
+                    if (reader.m_bitCount >= length
+                        && getCode(codes[static_cast<size_t>(symbol)]) == ((reader.m_buffer >> (reader.m_bitCount - length)) & ((uint64_t(1) << length) - 1))) {
+                        reader.m_bitCount -= length;
+                        emitSymbol(symbol, runLengthSymbol, reader, output, written);
+                        isFound = true;
+                        break;
+                    }
+                }
+                if (!isFound)
+                    throw std::runtime_error("invalid Huffman code");
+            }
+        }
+
+        // The remaining bits hold short codes only; drop the padding of the last byte
+        const int padding = static_cast<int>((8 - bitCount) & 7);
+        reader.m_buffer >>= padding;
+        reader.m_bitCount -= padding;
+        while (reader.m_bitCount > 0) {
+            const DecodingEntry& entry = table[(reader.m_buffer << (DECODING_BITS - reader.m_bitCount)) & DECODING_MASK];
+            if (!entry.length || entry.length > reader.m_bitCount)
+                throw std::runtime_error("invalid Huffman code");
+            reader.m_bitCount -= entry.length;
+            emitSymbol(entry.symbol, runLengthSymbol, reader, output, written);
+        }
+        if (written != output.size())
+            throw std::runtime_error("not enough Huffman data");
+    }
+
+} // namespace huffman
+
+// PIZ: inverse of the 2D Haar-like wavelet transform of OpenEXR's ImfWav, applied in place to one channel
+void decodeWavelet14(uint16_t low, uint16_t high, uint16_t& a, uint16_t& b)
+{
+    const int h = static_cast<int16_t>(high);
+    const int ai = static_cast<int16_t>(low) + (h & 1) + (h >> 1);
+    a = static_cast<uint16_t>(static_cast<int16_t>(ai));
+    b = static_cast<uint16_t>(static_cast<int16_t>(ai - h));
+}
+
+void decodeWavelet16(uint16_t low, uint16_t high, uint16_t& a, uint16_t& b)
+{
+    constexpr int OFFSET = 1 << 15;
+    constexpr int MASK = (1 << 16) - 1;
+    const int m = low;
+    const int d = high;
+    const int bb = (m - (d >> 1)) & MASK;
+    const int aa = (d + bb - OFFSET) & MASK;
+    a = static_cast<uint16_t>(aa);
+    b = static_cast<uint16_t>(bb);
+}
+
+void inverseWavelet(uint16_t* data, int nx, int ox, int ny, int oy, uint16_t maxValue)
+{
+    const auto decode = maxValue < (1 << 14) ? decodeWavelet14 : decodeWavelet16;
+    const int n = std::min(nx, ny);
+    int p = 1;
+    while (p <= n)
+        p <<= 1;
+    p >>= 1;
+    int p2 = p;
+    p >>= 1;
+
+    // From the coarsest level to the finest
+    while (p >= 1) {
+        uint16_t* py = data;
+        uint16_t* const ey = data + ptrdiff_t(oy) * (ny - p2);
+        const int oy1 = oy * p, oy2 = oy * p2, ox1 = ox * p, ox2 = ox * p2;
+        uint16_t i00, i01, i10, i11;
+
+        for (; py <= ey; py += oy2) {
+            uint16_t* px = py;
+            uint16_t* const ex = py + ptrdiff_t(ox) * (nx - p2);
+            for (; px <= ex; px += ox2) {
+                uint16_t* p01 = px + ox1;
+                uint16_t* p10 = px + oy1;
+                uint16_t* p11 = p10 + ox1;
+                decode(*px, *p10, i00, i10);
+                decode(*p01, *p11, i01, i11);
+                decode(i00, i01, *px, *p01);
+                decode(i10, i11, *p10, *p11);
+            }
+            // Odd column
+            if (nx & p) {
+                uint16_t* p10 = px + oy1;
+                decode(*px, *p10, i00, *p10);
+                *px = i00;
+            }
+        }
+        // Odd line
+        if (ny & p) {
+            uint16_t* px = py;
+            uint16_t* const ex = py + ptrdiff_t(ox) * (nx - p2);
+            for (; px <= ex; px += ox2) {
+                uint16_t* p01 = px + ox1;
+                decode(*px, *p01, i00, *p01);
+                *px = i00;
+            }
+        }
+
+        p2 = p;
+        p >>= 1;
+    }
+}
+
+void decompressPIZ(std::span<const std::byte> compressed, std::span<std::byte> output, const Header& header, int width, int lines, std::vector<std::byte>& scratch)
+{
+    constexpr size_t BITMAP_SIZE = 8192;
+    ByteReader reader(compressed);
+
+    // Bitmap of the 16-bit values that occur; the values were remapped to a dense range before the transform
+    std::array<uint8_t, BITMAP_SIZE> bitmap {};
+    const uint16_t minNonZero = reader.read<uint16_t>();
+    const uint16_t maxNonZero = reader.read<uint16_t>();
+    if (maxNonZero >= BITMAP_SIZE)
+        throw std::runtime_error("corrupt PIZ bitmap");
+    if (minNonZero <= maxNonZero) {
+        const std::span<const std::byte> bytes = reader.take(size_t(maxNonZero) - minNonZero + 1);
+        std::memcpy(&bitmap[minNonZero], bytes.data(), bytes.size());
+    }
+    std::vector<uint16_t> lut(1 << 16, 0);
+    size_t lutSize = 0;
+    for (size_t value = 0; value < lut.size(); ++value) {
+        if (value == 0 || (bitmap[value >> 3] & (1 << (value & 7))))
+            lut[lutSize++] = static_cast<uint16_t>(value);
+    }
+    const auto maxValue = static_cast<uint16_t>(lutSize - 1);
+
+    const int32_t length = reader.read<int32_t>();
+    if (length < 0)
+        throw std::runtime_error("corrupt PIZ chunk");
+    scratch.resize(output.size());
+    const std::span<uint16_t> values(reinterpret_cast<uint16_t*>(scratch.data()), output.size() / 2);
+    huffman::decompress(reader.take(static_cast<size_t>(length)), values);
+
+    // The channels are stored one after another, each as a 2D array of 16-bit words (two per float or uint sample)
+    uint16_t* channelData = values.data();
+    for (const Channel& channel : header.channels) {
+        const int words = static_cast<int>(getSampleSize(channel.type) / 2);
+        for (int word = 0; word < words; ++word)
+            inverseWavelet(channelData + word, width, words, lines, width * words, maxValue);
+        channelData += size_t(width) * lines * words;
+    }
+    for (uint16_t& value : values)
+        value = lut[value];
+
+    // Interleave back into the scanline layout: every line holds each channel's samples in turn
+    std::byte* out = output.data();
+    std::vector<const uint16_t*> channelRows;
+    const uint16_t* channelStart = values.data();
+    for (const Channel& channel : header.channels) {
+        channelRows.push_back(channelStart);
+        channelStart += size_t(width) * lines * (getSampleSize(channel.type) / 2);
+    }
+    for (int line = 0; line < lines; ++line) {
+        for (size_t c = 0; c < header.channels.size(); ++c) {
+            const size_t rowBytes = size_t(width) * getSampleSize(header.channels[c].type);
+            std::memcpy(out, channelRows[c], rowBytes);
+            channelRows[c] += rowBytes / 2;
+            out += rowBytes;
+        }
+    }
+}
+
+uint16_t toHalf(const std::byte* sample, PixelType type)
+{
+    switch (type) {
+    case PixelType::Half: {
+        uint16_t value;
+        std::memcpy(&value, sample, sizeof(value));
+        return value;
+    }
+    case PixelType::Float: {
+        float value;
+        std::memcpy(&value, sample, sizeof(value));
+        return glm::packHalf1x16(value);
+    }
+    case PixelType::UInt: {
+        uint32_t value;
+        std::memcpy(&value, sample, sizeof(value));
+        return glm::packHalf1x16(static_cast<float>(value));
+    }
+    }
+    return 0;
+}
+
+// Decompress one chunk (a block of scanlines or a tile) and scatter its channels into the output image
+void decodeChunk(std::span<const std::byte> encoded, const Header& header, uint64_t chunkOffset, std::span<uint16_t> halfs)
+{
+    if (chunkOffset >= encoded.size())
+        throw std::runtime_error("invalid chunk offset");
+    ByteReader reader(encoded, static_cast<size_t>(chunkOffset));
+    int x0 = 0, y0 = 0, width = header.width, lines = 0;
+    if (header.isTiled) {
+        const int32_t tileX = reader.read<int32_t>();
+        const int32_t tileY = reader.read<int32_t>();
+        const int32_t levelX = reader.read<int32_t>();
+        const int32_t levelY = reader.read<int32_t>();
+        if (levelX != 0 || levelY != 0 || tileX < 0 || tileY < 0
+            || int64_t(tileX) * header.tileWidth >= header.width || int64_t(tileY) * header.tileHeight >= header.height)
+            throw std::runtime_error("invalid tile coordinates");
+        x0 = tileX * header.tileWidth;
+        y0 = tileY * header.tileHeight;
+        width = std::min(header.tileWidth, header.width - x0);
+        lines = std::min(header.tileHeight, header.height - y0);
+    } else {
+        const int64_t firstLine = int64_t(reader.read<int32_t>()) - header.yMin;
+        if (firstLine < 0 || firstLine >= header.height)
+            throw std::runtime_error("invalid scanline coordinate");
+        y0 = static_cast<int>(firstLine);
+        lines = std::min(getLinesPerChunk(header.compression), header.height - y0);
+    }
+
+    size_t lineSize = 0;
+    for (const Channel& channel : header.channels)
+        lineSize += size_t(width) * getSampleSize(channel.type);
+    const size_t rawSize = lineSize * size_t(lines);
+
+    const int32_t dataSize = reader.read<int32_t>();
+    if (dataSize < 0)
+        throw std::runtime_error("invalid chunk size");
+    const std::span<const std::byte> data = reader.take(static_cast<size_t>(dataSize));
+
+    // Chunks that would not get smaller are stored uncompressed, whatever the file's compression
+    std::vector<std::byte> raw, scratch;
+    std::span<const std::byte> pixels = data;
+    if (data.size() != rawSize) {
+        raw.resize(rawSize);
+        switch (header.compression) {
+        case Compression::None:
+            throw std::runtime_error("invalid chunk size");
+        case Compression::RLE:
+            decompressRLE(data, raw, scratch);
+            break;
+        case Compression::ZIPS:
+        case Compression::ZIP:
+            decompressZIP(data, raw, scratch);
+            break;
+        case Compression::PIZ:
+            decompressPIZ(data, raw, header, width, lines, scratch);
+            break;
+        }
+        pixels = raw;
+    }
+
+    const size_t outputChannels = static_cast<size_t>(header.outputChannels);
+    const std::byte* sample = pixels.data();
+    for (int line = 0; line < lines; ++line) {
+        uint16_t* row = &halfs[(size_t(y0 + line) * header.width + x0) * outputChannels];
+        for (const Channel& channel : header.channels) {
+            const size_t sampleSize = getSampleSize(channel.type);
+            if (channel.outputIndex >= 0) {
+                uint16_t* out = row + channel.outputIndex;
+                for (int x = 0; x < width; ++x, out += outputChannels)
+                    *out = toHalf(sample + size_t(x) * sampleSize, channel.type);
+            }
+            sample += size_t(width) * sampleSize;
+        }
+    }
+}
+
+} // namespace
+
+bool isEXR(std::span<const std::byte> encoded)
+{
+    uint32_t magic = 0;
+    if (encoded.size() >= sizeof(magic))
+        std::memcpy(&magic, encoded.data(), sizeof(magic));
+    return magic == EXR_MAGIC;
+}
+
+bool readEXRInfo(std::span<const std::byte> encoded, EXRInfo& info, std::string& error)
+{
+    try {
+        const Header header = parseHeader(encoded);
+        info = { header.width, header.height, header.outputChannels };
+        return true;
+    } catch (const std::runtime_error& exception) {
+        error = exception.what();
+        return false;
+    }
+}
+
+bool decodeEXR(std::span<const std::byte> encoded, std::span<uint16_t> halfs, std::string& error)
+{
+    try {
+        const Header header = parseHeader(encoded);
+        if (halfs.size() != size_t(header.width) * header.height * header.outputChannels)
+            throw std::runtime_error("output size does not match the image");
+        std::fill(std::begin(halfs), std::end(halfs), uint16_t(0));
+
+        // Only the full-resolution level is decoded; its chunks come first in the offset table
+        size_t chunkCount;
+        if (header.isTiled) {
+            const size_t tilesX = (size_t(header.width) + header.tileWidth - 1) / header.tileWidth;
+            const size_t tilesY = (size_t(header.height) + header.tileHeight - 1) / header.tileHeight;
+            chunkCount = tilesX * tilesY;
+        } else {
+            const int linesPerChunk = getLinesPerChunk(header.compression);
+            chunkCount = (size_t(header.height) + linesPerChunk - 1) / linesPerChunk;
+        }
+        ByteReader offsetTable(encoded, header.offsetTableStart);
+        std::vector<uint64_t> chunkOffsets(chunkCount);
+        for (uint64_t& offset : chunkOffsets)
+            offset = offsetTable.read<uint64_t>();
+
+        // Chunks are independent and write disjoint parts of the output
+        parallelFor(chunkCount, [&](size_t chunk) {
+            decodeChunk(encoded, header, chunkOffsets[chunk], halfs);
+        });
+        return true;
+    } catch (const std::runtime_error& exception) {
+        error = exception.what();
+        return false;
+    } catch (const std::bad_alloc&) {
+        error = "out of memory";
+        return false;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Whether the data starts with the OpenEXR magic number
+bool isEXR(std::span<const std::byte> encoded);
+
+// Size of the data window and number of channels that decodeEXR produces: R, G, B (3) plus A if present, or a
+// luminance (Y) or single unnamed channel (1) plus A if present
+struct EXRInfo {
+    int width { 0 }, height { 0 }, channels { 0 };
+};
+
+// Parse the header of a single-part scanline or tiled file; returns false with a message if it cannot be decoded
+bool readEXRInfo(std::span<const std::byte> encoded, EXRInfo& info, std::string& error);
+
+// Decode the full-resolution level into interleaved half floats (width * height * channels, rows top to bottom).
+// Supports uncompressed, RLE, ZIPS, ZIP and PIZ chunks, which are decompressed on all cores; other channels are
+// ignored and float or uint channels are converted to half.
+bool decodeEXR(std::span<const std::byte> encoded, std::span<uint16_t> halfs, std::string& error);
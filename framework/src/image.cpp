@@ -1,4 +1,6 @@
 #include "image.h"
+#include "exr_decoder.h"
+#include "mapped_file.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -6,36 +8,275 @@ DISABLE_WARNINGS_PUSH()
 #include <stb/stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
+#include <glm/gtc/packing.hpp>
 DISABLE_WARNINGS_POP()
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <limits>
+#include <new>
 #include <string>
 
 
+size_t getComponentSize(ImageFormat format)
+{
+    switch (format) {
+    case ImageFormat::UInt8:
+        return sizeof(uint8_t);
+    case ImageFormat::UInt16:
+    case ImageFormat::Float16:
+        return sizeof(uint16_t);
+    case ImageFormat::Float32:
+        return sizeof(float);
+    }
+    return 0;
+}
+
+ImageView ImageView::subView(int x, int y, int subWidth, int subHeight) const
+{
+    assert(x >= 0 && y >= 0 && x + subWidth <= width && y + subHeight <= height);
+
+    ImageView result = *this;
+    result.data = getRow(y) + x * getPixelSize();
+    result.width = subWidth;
+    result.height = subHeight;
+    return result;
+}
+
+float ImageView::getComponent(int x, int y, int channel) const
+{
+    const std::byte* component = getRow(y) + x * getPixelSize() + channel * getComponentSize(format);
+    switch (format) {
+    case ImageFormat::UInt8:
+        return static_cast<uint8_t>(*component) / 255.0f;
+    case ImageFormat::UInt16: {
+        uint16_t value;
+        std::memcpy(&value, component, sizeof(value));
+        return value / 65535.0f;
+    }
+    case ImageFormat::Float16: {
+        uint16_t value;
+        std::memcpy(&value, component, sizeof(value));
+        return glm::unpackHalf1x16(value);
+    }
+    case ImageFormat::Float32: {
+        float value;
+        std::memcpy(&value, component, sizeof(value));
+        return value;
+    }
+    }
+    return 0.0f;
+}
+
 // write image to a file
-void Image::writeBitmapToFile(const std::filesystem::path& filePath) {
+void Image::writeBitmapToFile(const std::filesystem::path& filePath) const {
+    if (format != ImageFormat::UInt8) {
+        std::cerr << "Cannot write " << filePath << ": only 8-bit images can be written as bitmap" << std::endl;
+        return;
+    }
+
     std::string filePathString = filePath.string();
-    stbi_write_bmp(filePathString.c_str(), width, height, channels, pixels.data());
+    stbi_write_bmp(filePathString.c_str(), width, height, channels, pixels.get());
 }
 
 // Image constructor, create image from file
-Image::Image(const std::filesystem::path& filePath)
+Image::Image(const std::filesystem::path& filePath, const ImageLoadSettings& settings)
+    : filePath(filePath)
 {
 	if (!std::filesystem::exists(filePath)) {
 		std::cerr << "Texture file " << filePath << " does not exist!" << std::endl;
 		throw std::exception();
 	}
 
-	const auto filePathStr = filePath.string(); // Create l-value so c_str() is safe.
-	stbi_uc* stbPixels = stbi_load(filePathStr.c_str(), &width, &height, &channels, STBI_default);
+	// Decoding from a mapping reads the file exactly once, even though the format is probed before decoding
+	const MappedFile file { filePath };
+	decode(file.bytes(), settings);
+}
 
-	if (!stbPixels) {
-		std::cerr << "Failed to read texture " << filePath << " using stb_image.h" << std::endl;
-		throw std::exception();
-	}
+Image Image::fromMemory(std::span<const std::byte> encoded, const ImageLoadSettings& settings, const std::filesystem::path& filePath)
+{
+    Image image;
+    image.filePath = filePath;
+    image.decode(encoded, settings);
+    return image;
+}
+
+Image::Image(int width, int height, int channels, ImageFormat format)
+    : width(width)
+    , height(height)
+    , channels(channels)
+    , format(format)
+    , pixels(static_cast<std::byte*>(std::calloc(getSizeInBytes(), 1)), &std::free)
+{
+    if (!pixels && getSizeInBytes() > 0)
+        throw std::bad_alloc();
+}
+
+std::optional<ImageInfo> Image::readInfo(const std::filesystem::path& filePath)
+{
+    ImageInfo info;
+    const std::string filePathString = filePath.string();
+    if (stbi_info(filePathString.c_str(), &info.width, &info.height, &info.channels))
+        return info;
+
+    // stb_image cannot read OpenEXR headers
+    try {
+        const MappedFile file { filePath };
+        EXRInfo exrInfo;
+        std::string error;
+        if (!isEXR(file.bytes()) || !readEXRInfo(file.bytes(), exrInfo, error))
+            return std::nullopt;
+        return ImageInfo { exrInfo.width, exrInfo.height, exrInfo.channels };
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+void Image::decode(std::span<const std::byte> encoded, const ImageLoadSettings& settings)
+{
+    if (isEXR(encoded)) {
+        decodeEXR(encoded);
+        if ((settings.format && *settings.format != format) || (settings.channels > 0 && settings.channels != channels))
+            convert(settings.channels > 0 ? settings.channels : channels, settings.format.value_or(format));
+        return;
+    }
+
+    if (encoded.size() > size_t(std::numeric_limits<int>::max())) {
+        std::cerr << "Image " << filePath << " is too large to decode using stb_image.h" << std::endl;
+        throw std::exception();
+    }
+
+    const auto* buffer = reinterpret_cast<const stbi_uc*>(encoded.data());
+    const int length = static_cast<int>(encoded.size());
+    if (settings.format) {
+        format = *settings.format;
+    } else if (stbi_is_hdr_from_memory(buffer, length)) {
+        format = ImageFormat::Float32;
+    } else if (stbi_is_16_bit_from_memory(buffer, length)) {
+        format = ImageFormat::UInt16;
+    } else {
+        format = ImageFormat::UInt8;
+    }
+
+    // stb_image converts to the requested format and channel count itself, so its buffer can be kept as-is. It has
+    // no half-float output; those are converted from floats afterwards.
+    int fileChannels = 0;
+    void* decoded = nullptr;
+    switch (format) {
+    case ImageFormat::UInt8:
+        decoded = stbi_load_from_memory(buffer, length, &width, &height, &fileChannels, settings.channels);
+        break;
+    case ImageFormat::UInt16:
+        decoded = stbi_load_16_from_memory(buffer, length, &width, &height, &fileChannels, settings.channels);
+        break;
+    case ImageFormat::Float16:
+    case ImageFormat::Float32:
+        decoded = stbi_loadf_from_memory(buffer, length, &width, &height, &fileChannels, settings.channels);
+        break;
+    }
+
+    if (!decoded) {
+        std::cerr << "Failed to read texture " << filePath << " using stb_image.h: " << stbi_failure_reason() << std::endl;
+        throw std::exception();
+    }
+
+    channels = settings.channels > 0 ? settings.channels : fileChannels;
+    pixels = std::unique_ptr<std::byte, void (*)(void*)>(static_cast<std::byte*>(decoded), &stbi_image_free);
+    if (format == ImageFormat::Float16) {
+        format = ImageFormat::Float32;
+        convert(channels, ImageFormat::Float16);
+    }
+}
+
+void Image::decodeEXR(std::span<const std::byte> encoded)
+{
+    EXRInfo info;
+    std::string error;
+    if (!readEXRInfo(encoded, info, error)) {
+        std::cerr << "Failed to read OpenEXR image " << filePath << ": " << error << std::endl;
+        throw std::exception();
+    }
 
-	for (size_t i = 0UL; i < width * height * channels; i++) { pixels.emplace_back(stbPixels[i]); }
+    width = info.width;
+    height = info.height;
+    channels = info.channels;
+    format = ImageFormat::Float16;
+    pixels = std::unique_ptr<std::byte, void (*)(void*)>(static_cast<std::byte*>(std::malloc(getSizeInBytes())), &std::free);
+    if (!pixels)
+        throw std::bad_alloc();
 
-	stbi_image_free(stbPixels);
+    const std::span<uint16_t> halfs(reinterpret_cast<uint16_t*>(pixels.get()), size_t(width) * height * channels);
+    if (!::decodeEXR(encoded, halfs, error)) {
+        std::cerr << "Failed to decode OpenEXR image " << filePath << ": " << error << std::endl;
+        throw std::exception();
+    }
+}
+
+void Image::convert(int newChannels, ImageFormat newFormat)
+{
+    Image result(width, height, newChannels, newFormat);
+    const size_t pixelCount = size_t(width) * height;
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+        // Grey is replicated and missing alpha is opaque; dropping color keeps the luminance
+        float rgba[4] { 0.0f, 0.0f, 0.0f, 1.0f };
+        const size_t source = pixel * channels;
+        if (channels <= 2) {
+            rgba[0] = rgba[1] = rgba[2] = getComponent(source);
+            if (channels == 2)
+                rgba[3] = getComponent(source + 1);
+        } else {
+            for (int channel = 0; channel < std::min(channels, 4); ++channel)
+                rgba[channel] = getComponent(source + channel);
+        }
+
+        const size_t destination = pixel * newChannels;
+        if (newChannels <= 2) {
+            result.setComponent(destination, channels <= 2 ? rgba[0] : 0.299f * rgba[0] + 0.587f * rgba[1] + 0.114f * rgba[2]);
+            if (newChannels == 2)
+                result.setComponent(destination + 1, rgba[3]);
+        } else {
+            for (int channel = 0; channel < newChannels; ++channel)
+                result.setComponent(destination + channel, rgba[channel]);
+        }
+    }
+
+    channels = newChannels;
+    format = newFormat;
+    pixels = std::move(result.pixels);
+}
+
+float Image::getComponent(size_t index) const
+{
+    switch (format) {
+    case ImageFormat::UInt8:
+        return reinterpret_cast<const uint8_t*>(pixels.get())[index] / 255.0f;
+    case ImageFormat::UInt16:
+        return reinterpret_cast<const uint16_t*>(pixels.get())[index] / 65535.0f;
+    case ImageFormat::Float16:
+        return glm::unpackHalf1x16(reinterpret_cast<const uint16_t*>(pixels.get())[index]);
+    case ImageFormat::Float32:
+        return reinterpret_cast<const float*>(pixels.get())[index];
+    }
+    return 0.0f;
+}
+
+void Image::setComponent(size_t index, float value)
+{
+    switch (format) {
+    case ImageFormat::UInt8:
+        reinterpret_cast<uint8_t*>(pixels.get())[index] = (uint8_t) (std::clamp(value, 0.0f, 1.0f) * 255.0f);
+        break;
+    case ImageFormat::UInt16:
+        reinterpret_cast<uint16_t*>(pixels.get())[index] = (uint16_t) (std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+        break;
+    case ImageFormat::Float16:
+        reinterpret_cast<uint16_t*>(pixels.get())[index] = glm::packHalf1x16(value);
+        break;
+    case ImageFormat::Float32:
+        reinterpret_cast<float*>(pixels.get())[index] = value;
+        break;
+    }
 }
@@ -0,0 +1,108 @@
+#include "mapped_file.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <exception>
+#include <iostream>
+#include <utility>
+
+MappedFile::MappedFile(const std::filesystem::path& filePath)
+{
+#ifdef _WIN32
+    m_fileHandle = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) {
+        m_fileHandle = nullptr;
+        std::cerr << "Failed to open " << filePath << " for mapping" << std::endl;
+        throw std::exception();
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(m_fileHandle, &fileSize);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    if (m_size == 0)
+        return; // Empty files cannot be mapped
+
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle)
+        m_data = static_cast<const std::byte*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    const int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor == -1) {
+        std::cerr << "Failed to open " << filePath << " for mapping" << std::endl;
+        throw std::exception();
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == 0)
+        m_size = static_cast<size_t>(fileStatus.st_size);
+    if (m_size == 0) {
+        close(fileDescriptor);
+        return; // Empty files cannot be mapped
+    }
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    // The mapping keeps its own reference to the file
+    close(fileDescriptor);
+    if (mapping != MAP_FAILED) {
+        m_data = static_cast<const std::byte*>(mapping);
+        // The whole file is about to be read (possibly by several threads at once)
+        madvise(mapping, m_size, MADV_WILLNEED);
+    }
+#endif
+
+    if (!m_data) {
+        std::cerr << "Failed to map " << filePath << " into memory" << std::endl;
+        unmap();
+        throw std::exception();
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+        m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle)
+        CloseHandle(m_fileHandle);
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+#else
+    if (m_data)
+        munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
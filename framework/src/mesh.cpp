@@ -1,22 +1,27 @@
 #include "mesh.h"
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "parallel_for.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
-#include <tinyobjloader/tiny_obj_loader.h>
 DISABLE_WARNINGS_POP()
 #include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cstdint>
 #include <exception>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <numeric>
 #include <span>
 #include <stack>
 #include <string>
-#include <tuple>
-#include <map>
 
 static void centerAndScaleToUnitMesh(std::span<Mesh> meshes);
 
@@ -25,30 +30,153 @@ static glm::vec3 construct_vec3(const float* pFloats)
     return glm::vec3(pFloats[0], pFloats[1], pFloats[2]);
 }
 
-// https://stackoverflow.com/questions/2590677/how-do-i-combine-hash-values-in-c0x
-template <class T>
-static void hash_combine(std::size_t& seed, const T& v)
-{
-    std::hash<T> hasher;
-    seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
+// Open-addressing (linear probing) map from a tinyobj (position, normal, texcoord) index triple to a vertex index
+class VertexIndexTable {
+public:
+    explicit VertexIndexTable(size_t expectedKeys)
+        : m_slots(std::bit_ceil(std::max<size_t>(16, 2 * expectedKeys)))
+    {
+    }
+
+    // Returns the vertex index stored for the key, or stores and returns newIndex if the key was not present yet
+    uint32_t findOrInsert(const tinyobj::index_t& key, uint32_t newIndex)
+    {
+        Slot& slot = findSlot(key);
+        if (slot.vertexIndex != EMPTY)
+            return slot.value;
+
+        slot = { key.vertex_index, key.normal_index, key.texcoord_index, newIndex };
+        // Keep the load factor at or below one half
+        if (++m_size * 2 > m_slots.size())
+            grow();
+        return newIndex;
+    }
+
+private:
+    static constexpr int EMPTY = std::numeric_limits<int>::min();
+
+    struct Slot {
+        int vertexIndex { EMPTY };
+        int normalIndex;
+        int texCoordIndex;
+        uint32_t value;
+    };
+
+    Slot& findSlot(const tinyobj::index_t& key)
+    {
+        uint64_t hash = static_cast<uint32_t>(key.vertex_index) * 0x9E3779B97F4A7C15ull;
+        hash ^= static_cast<uint32_t>(key.normal_index) * 0xC2B2AE3D27D4EB4Full;
+        hash ^= static_cast<uint32_t>(key.texcoord_index) * 0x165667B19E3779F9ull;
+        hash ^= hash >> 29;
+
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slotIndex = hash & mask;; slotIndex = (slotIndex + 1) & mask) {
+            Slot& slot = m_slots[slotIndex];
+            if (slot.vertexIndex == EMPTY || (slot.vertexIndex == key.vertex_index && slot.normalIndex == key.normal_index && slot.texCoordIndex == key.texcoord_index))
+                return slot;
+        }
+    }
 
-struct VertexHash {
-    size_t operator()(const Vertex& v) const
+    void grow()
     {
-        size_t seed = 0;
-        hash_combine(seed, v.position.x);
-        hash_combine(seed, v.position.y);
-        hash_combine(seed, v.position.z);
-        hash_combine(seed, v.normal.x);
-        hash_combine(seed, v.normal.y);
-        hash_combine(seed, v.normal.z);
-        hash_combine(seed, v.texCoord.s);
-        hash_combine(seed, v.texCoord.t);
-        return seed;
+        std::vector<Slot> oldSlots(2 * m_slots.size());
+        std::swap(oldSlots, m_slots);
+        for (const Slot& slot : oldSlots) {
+            if (slot.vertexIndex != EMPTY)
+                findSlot({ slot.vertexIndex, slot.normalIndex, slot.texCoordIndex }) = slot;
+        }
     }
+
+    std::vector<Slot> m_slots;
+    size_t m_size { 0 };
 };
 
+// Range of triangles of a tinyobj shape that share a material and become one Mesh
+struct SubMeshRange {
+    const tinyobj::shape_t* shape;
+    size_t startTriangle;
+    size_t endTriangle;
+};
+
+// Decoded texture of every distinct path referenced by a model's materials
+using ImageMap = std::map<std::filesystem::path, std::shared_ptr<Image>>;
+
+static std::filesystem::path getTexturePath(const std::filesystem::path& baseDir, const std::string& textureName)
+{
+    return (baseDir / textureName).lexically_normal();
+}
+
+static Mesh buildSubMesh(const SubMeshRange& range, const ObjContents& contents, const ImageMap& images, const std::filesystem::path& baseDir, const LoadMeshSettings& settings)
+{
+    const tinyobj::attrib_t& inAttrib = contents.attrib;
+    const tinyobj::shape_t& shape = *range.shape;
+
+    Mesh mesh;
+    mesh.triangles.reserve(range.endTriangle - range.startTriangle);
+    // Map the index of a vertex as loaded by tinyobjloader to its index in the generated mesh
+    // Closed meshes share each vertex between several triangles, so start out with room for half a vertex per triangle
+    VertexIndexTable vertexCache(settings.cacheVertices ? (range.endTriangle - range.startTriangle) / 2 : 0);
+    for (size_t i = range.startTriangle * 3; i != range.endTriangle * 3; i += 3) {
+        const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 0].vertex_index]);
+        const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 1].vertex_index]);
+        const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 2].vertex_index]);
+        const auto geometricNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+
+        // Load the triangle indices and lazily create the vertices.
+        glm::uvec3 triangle;
+        for (unsigned j = 0; j < 3; j++) {
+            const auto& tinyObjIndex = shape.mesh.indices[i + j];
+            const uint32_t newIndex = static_cast<uint32_t>(mesh.vertices.size());
+            triangle[j] = settings.cacheVertices ? vertexCache.findOrInsert(tinyObjIndex, newIndex) : newIndex;
+            if (triangle[j] != newIndex)
+                continue; // Already visited this vertex? Reuse it!
+
+            // New vertex? Create it.
+            Vertex vertex {
+                .position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]),
+                .normal = glm::vec3(0),
+                .texCoord = glm::vec2(0)
+            };
+            if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty())
+                vertex.normal = glm::vec3(inAttrib.normals[3 * tinyObjIndex.normal_index + 0], inAttrib.normals[3 * tinyObjIndex.normal_index + 1], inAttrib.normals[3 * tinyObjIndex.normal_index + 2]);
+            else
+                vertex.normal = geometricNormal;
+            if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
+                vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
+            mesh.vertices.push_back(vertex);
+        }
+        mesh.triangles.push_back(triangle);
+    }
+
+    const auto materialID = shape.mesh.material_ids[range.startTriangle];
+    if (materialID == -1) {
+        mesh.material.kd = glm::vec3(1.0f);
+        mesh.material.ks = glm::vec3(0.0f);
+        mesh.material.shininess = 1.0f;
+    } else {
+        const auto& objMaterial = contents.materials[materialID];
+        mesh.material.kd = construct_vec3(objMaterial.diffuse);
+        if (!objMaterial.diffuse_texname.empty()) {
+            mesh.material.kdTexture = images.at(getTexturePath(baseDir, objMaterial.diffuse_texname));
+        }
+        if (!objMaterial.bump_texname.empty()) {
+            mesh.material.norTexture = images.at(getTexturePath(baseDir, objMaterial.bump_texname));
+        }
+        if (!objMaterial.metallic_texname.empty()) {
+            mesh.material.metTexture = images.at(getTexturePath(baseDir, objMaterial.metallic_texname));
+        }
+        if (!objMaterial.roughness_texname.empty()) {
+            mesh.material.roughTexture = images.at(getTexturePath(baseDir, objMaterial.roughness_texname));
+        }
+
+        mesh.material.ks = construct_vec3(objMaterial.specular);
+        mesh.material.shininess = objMaterial.shininess;
+        mesh.material.transparency = objMaterial.dissolve;
+    }
+
+    return mesh;
+}
+
 std::vector<Mesh> loadMesh(const std::filesystem::path& file, const LoadMeshSettings& settings)
 {
     if (!std::filesystem::exists(file)) {
@@ -58,20 +186,40 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, const LoadMeshSett
 
     const auto baseDir = file.parent_path();
 
-    tinyobj::attrib_t inAttrib;
-    std::vector<tinyobj::shape_t> inShapes;
-    std::vector<tinyobj::material_t> inMaterials;
+    ObjContents contents;
+    bool parsed = false;
+    if (settings.parallelLoading) {
+        const MappedFile mappedFile(file);
+        const std::span<const std::byte> bytes = mappedFile.bytes();
+        std::string error;
+        switch (parseObjParallel({ reinterpret_cast<const char*>(bytes.data()), bytes.size() }, baseDir, contents, error)) {
+        case ObjParseResult::Success:
+            parsed = true;
+            break;
+        case ObjParseResult::Unsupported:
+            std::cout << "Mesh " << file << " contains polygons with more than four corners, loading it with tinyobjloader" << std::endl;
+            contents = ObjContents();
+            break;
+        case ObjParseResult::Error:
+            std::cerr << "Failed to load mesh " << file << ": " << error << std::endl;
+            throw std::exception();
+        }
+    }
 
-    std::string warn, error;
-    bool ret = tinyobj::LoadObj(&inAttrib, &inShapes, &inMaterials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
-    if (!ret) {
-        std::cerr << "Failed to load mesh " << file << std::endl;
-        throw std::exception();
+    if (!parsed) {
+        std::string warn, error;
+        bool ret = tinyobj::LoadObj(&contents.attrib, &contents.shapes, &contents.materials, &warn, &error, file.string().c_str(), baseDir.string().c_str());
+        if (!ret) {
+            std::cerr << "Failed to load mesh " << file << std::endl;
+            throw std::exception();
+        }
     }
 
-    std::vector<Mesh> out;
-    for (const auto& shape : inShapes) {
+    std::vector<SubMeshRange> subMeshRanges;
+    for (const auto& shape : contents.shapes) {
         assert(shape.mesh.indices.size() % 3 == 0);
+        if (shape.mesh.indices.empty())
+            continue;
 
         size_t startTriangle = 0;
         auto prevMaterialID = shape.mesh.material_ids[0];
@@ -84,76 +232,32 @@ std::vector<Mesh> loadMesh(const std::filesystem::path& file, const LoadMeshSett
             else
                 prevMaterialID = shape.mesh.material_ids[endTriangle];
 
-            Mesh mesh;
-            using CacheKey = std::tuple<uint32_t, uint32_t, uint32_t>;
-            std::map<CacheKey, uint32_t> vertexCache; // Map the index of a vertex as loaded by tinyobjloader to its index in the generated mesh
-            for (size_t i = startTriangle * 3; i != endTriangle * 3; i += 3) {
-                const glm::vec3 v0 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 0].vertex_index]);
-                const glm::vec3 v1 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 1].vertex_index]);
-                const glm::vec3 v2 = construct_vec3(&inAttrib.vertices[3 * shape.mesh.indices[i + 2].vertex_index]);
-                const auto geometricNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
-
-                // Load the triangle indices and lazily create the vertices.
-                glm::uvec3 triangle;
-                for (unsigned j = 0; j < 3; j++) {
-                    const auto& tinyObjIndex = shape.mesh.indices[i + j];
-                    Vertex vertex {
-                        .position = construct_vec3(&inAttrib.vertices[3 * tinyObjIndex.vertex_index]),
-                        .normal = glm::vec3(0),
-                        .texCoord = glm::vec2(0)
-                    };
-                    if (tinyObjIndex.normal_index != -1 && !inAttrib.normals.empty())
-                        vertex.normal = glm::vec3(inAttrib.normals[3 * tinyObjIndex.normal_index + 0], inAttrib.normals[3 * tinyObjIndex.normal_index + 1], inAttrib.normals[3 * tinyObjIndex.normal_index + 2]);
-                    else
-                        vertex.normal = geometricNormal;
-                    if (tinyObjIndex.texcoord_index != -1 && !inAttrib.texcoords.empty())
-                        vertex.texCoord = glm::vec2(inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 0], inAttrib.texcoords[2 * tinyObjIndex.texcoord_index + 1]);
-
-                    const CacheKey cacheKey { tinyObjIndex.vertex_index, tinyObjIndex.normal_index, tinyObjIndex.texcoord_index };
-                    if (auto iter = vertexCache.find(cacheKey); settings.cacheVertices && iter != std::end(vertexCache)) {
-                        // Already visited this vertex? Reuse it!
-                        triangle[j] = iter->second;
-                    } else {
-                        // New vertex? Create it and store it in the vertex cache.
-                        vertexCache[cacheKey] = triangle[j] = (unsigned)mesh.vertices.size();
-                        mesh.vertices.push_back(vertex);
-                    }
-                }
-                mesh.triangles.push_back(triangle);
-            }
-
-            const auto materialID = shape.mesh.material_ids[startTriangle];
-            if (materialID == -1) {
-                mesh.material.kd = glm::vec3(1.0f);
-                mesh.material.ks = glm::vec3(0.0f);
-                mesh.material.shininess = 1.0f;
-            } else {
-                const auto& objMaterial = inMaterials[materialID];
-                mesh.material.kd = construct_vec3(objMaterial.diffuse);
-                if (!objMaterial.diffuse_texname.empty()) {
-                    mesh.material.kdTexture = std::make_shared<Image>(baseDir / objMaterial.diffuse_texname);
-                }
-                if (!objMaterial.bump_texname.empty()) {
-                    mesh.material.norTexture = std::make_shared<Image>(baseDir / objMaterial.bump_texname);
-                }
-                if (!objMaterial.metallic_texname.empty()) {
-                    mesh.material.metTexture = std::make_shared<Image>(baseDir / objMaterial.metallic_texname);
-                }
-                if (!objMaterial.roughness_texname.empty()) {
-                    mesh.material.roughTexture = std::make_shared<Image>(baseDir / objMaterial.roughness_texname);
-                }
-
-                mesh.material.ks = construct_vec3(objMaterial.specular);
-                mesh.material.shininess = objMaterial.shininess;
-                mesh.material.transparency = objMaterial.dissolve;
-            }
-
-            out.push_back(std::move(mesh));
-
+            subMeshRanges.push_back({ &shape, startTriangle, endTriangle });
             startTriangle = endTriangle;
         }
     }
 
+    // Decode every texture once, even if several materials or sub-meshes refer to it
+    ImageMap images;
+    for (const SubMeshRange& range : subMeshRanges) {
+        const auto materialID = range.shape->mesh.material_ids[range.startTriangle];
+        if (materialID == -1)
+            continue;
+        const auto& objMaterial = contents.materials[materialID];
+        for (const std::string* textureName : { &objMaterial.diffuse_texname, &objMaterial.bump_texname, &objMaterial.metallic_texname, &objMaterial.roughness_texname }) {
+            if (!textureName->empty())
+                images.try_emplace(getTexturePath(baseDir, *textureName));
+        }
+    }
+    std::vector<ImageMap::iterator> pendingImages;
+    for (auto iter = std::begin(images); iter != std::end(images); ++iter)
+        pendingImages.push_back(iter);
+    parallelFor(pendingImages.size(), [&](size_t i) { pendingImages[i]->second = std::make_shared<Image>(pendingImages[i]->first); });
+
+    // Sub-meshes are independent of each other
+    std::vector<Mesh> out(subMeshRanges.size());
+    parallelFor(subMeshRanges.size(), [&](size_t i) { out[i] = buildSubMesh(subMeshRanges[i], contents, images, baseDir, settings); });
+
     if (settings.normalizeVertexPositions)
         centerAndScaleToUnitMesh(out);
 
@@ -0,0 +1,477 @@
+#include "obj_parser.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string_view>
+
+namespace {
+
+// Chunks smaller than this are not worth the overhead of a separate task
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+enum class CommandType {
+    Faces, // A run of consecutive faces
+    UseMaterial,
+    MaterialLibrary,
+    NewShape // 'g' or 'o'
+};
+
+// Statements that depend on state from earlier in the file; replayed in file order once all chunks are parsed
+struct Command {
+    CommandType type;
+    size_t first { 0 }; // Faces: index of the first face, after triangulation the first triangle
+    size_t count { 0 };
+    std::string argument;
+};
+
+// Corner that used a negative (relative) index; the chunk's base offset is only known after all chunks are parsed
+struct IndexFixup {
+    uint32_t corner;
+    uint8_t attribute; // 0 = position, 1 = normal, 2 = texture coordinate
+};
+
+struct Chunk {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+
+    std::vector<tinyobj::index_t> corners;
+    std::vector<uint8_t> faceSizes; // 3 or 4
+    std::vector<IndexFixup> fixups;
+    std::vector<Command> commands;
+
+    std::vector<tinyobj::index_t> triangles;
+
+    bool unsupported { false };
+    std::string error;
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t'; }
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+bool isTokenEnd(const char* token, const char* lineEnd) { return token == lineEnd || isSpace(*token) || *token == '\r'; }
+
+const char* skipSpaces(const char* token, const char* lineEnd)
+{
+    while (token != lineEnd && isSpace(*token))
+        ++token;
+    return token;
+}
+
+// Same arithmetic as tinyobjloader's tryParseDouble, so both loaders produce bit-identical values
+bool tryParseDouble(const char* s, const char* end, double& result)
+{
+    if (s >= end)
+        return false;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool negative = false;
+    bool leadingDecimalDot = false;
+    const char* curr = s;
+
+    if (*curr == '+' || *curr == '-') {
+        negative = *curr == '-';
+        ++curr;
+        leadingDecimalDot = curr != end && *curr == '.';
+    } else if (*curr == '.') {
+        leadingDecimalDot = true;
+    } else if (!isDigit(*curr)) {
+        return false;
+    }
+
+    if (!leadingDecimalDot) {
+        int read = 0;
+        for (; curr != end && isDigit(*curr); ++curr, ++read)
+            mantissa = mantissa * 10 + static_cast<int>(*curr - '0');
+        if (read == 0)
+            return false;
+    }
+
+    if (curr != end && *curr == '.') {
+        static constexpr double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        ++curr;
+        for (int read = 1; curr != end && isDigit(*curr); ++curr, ++read)
+            mantissa += static_cast<int>(*curr - '0') * (read < 8 ? powLut[read] : std::pow(10.0, -read));
+    }
+
+    if (curr != end && (*curr == 'e' || *curr == 'E')) {
+        ++curr;
+        bool negativeExponent = false;
+        if (curr != end && (*curr == '+' || *curr == '-')) {
+            negativeExponent = *curr == '-';
+            ++curr;
+        } else if (curr == end || !isDigit(*curr)) {
+            return false; // Empty exponent
+        }
+
+        int read = 0;
+        for (; curr != end && isDigit(*curr); ++curr, ++read) {
+            if (exponent > 2147483647 / 10)
+                return false;
+            exponent = exponent * 10 + static_cast<int>(*curr - '0');
+        }
+        if (read == 0)
+            return false;
+        if (negativeExponent)
+            exponent = -exponent;
+    }
+
+    result = (negative ? -1 : 1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+// A missing or malformed value yields 0, like in tinyobjloader
+float parseReal(const char*& token, const char* lineEnd)
+{
+    token = skipSpaces(token, lineEnd);
+    const char* valueEnd = token;
+    while (!isTokenEnd(valueEnd, lineEnd))
+        ++valueEnd;
+
+    double value = 0.0;
+    tryParseDouble(token, valueEnd, value);
+    token = valueEnd;
+    return static_cast<float>(value);
+}
+
+// atoi() on a line that is not null-terminated
+int parseInt(const char* token, const char* lineEnd)
+{
+    bool negative = false;
+    if (token != lineEnd && (*token == '+' || *token == '-'))
+        negative = *token++ == '-';
+    int value = 0;
+    for (; token != lineEnd && isDigit(*token); ++token)
+        value = value * 10 + (*token - '0');
+    return negative ? -value : value;
+}
+
+std::string parseString(const char*& token, const char* lineEnd)
+{
+    token = skipSpaces(token, lineEnd);
+    const char* stringEnd = token;
+    while (!isTokenEnd(stringEnd, lineEnd))
+        ++stringEnd;
+    std::string result(token, stringEnd);
+    token = stringEnd;
+    return result;
+}
+
+// Parse one component of a face corner (v, vt or vn) and advance to the next '/' or whitespace.
+// Returns false for the invalid index 0.
+bool parseIndex(const char*& token, const char* lineEnd, size_t attributeCount, int& index, bool& isRelative)
+{
+    const int value = parseInt(token, lineEnd);
+    while (token != lineEnd && *token != '/' && !isSpace(*token) && *token != '\r')
+        ++token;
+
+    isRelative = value < 0;
+    index = value > 0 ? value - 1 : static_cast<int>(attributeCount) + value;
+    return value != 0;
+}
+
+// Parse a face corner of the form v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char*& token, const char* lineEnd, Chunk& chunk)
+{
+    const uint32_t cornerIndex = static_cast<uint32_t>(chunk.corners.size());
+    tinyobj::index_t corner { -1, -1, -1 };
+    bool isRelative;
+
+    const auto addFixup = [&](uint8_t attribute) {
+        if (isRelative)
+            chunk.fixups.push_back({ cornerIndex, attribute });
+    };
+
+    if (!parseIndex(token, lineEnd, chunk.positions.size() / 3, corner.vertex_index, isRelative))
+        return false;
+    addFixup(0);
+
+    if (token != lineEnd && *token == '/') {
+        ++token;
+        if (token != lineEnd && *token == '/') {
+            ++token;
+            if (!parseIndex(token, lineEnd, chunk.normals.size() / 3, corner.normal_index, isRelative))
+                return false;
+            addFixup(1);
+        } else {
+            if (!parseIndex(token, lineEnd, chunk.texCoords.size() / 2, corner.texcoord_index, isRelative))
+                return false;
+            addFixup(2);
+
+            if (token != lineEnd && *token == '/') {
+                ++token;
+                if (!parseIndex(token, lineEnd, chunk.normals.size() / 3, corner.normal_index, isRelative))
+                    return false;
+                addFixup(1);
+            }
+        }
+    }
+
+    chunk.corners.push_back(corner);
+    return true;
+}
+
+bool startsWith(const char* token, const char* lineEnd, std::string_view prefix)
+{
+    return static_cast<size_t>(lineEnd - token) >= prefix.size() && std::memcmp(token, prefix.data(), prefix.size()) == 0;
+}
+
+// Whether the keyword of the given length is followed by a space (as opposed to being a prefix of another keyword)
+bool isKeyword(const char* token, const char* lineEnd, std::string_view keyword)
+{
+    return startsWith(token, lineEnd, keyword) && lineEnd - token > static_cast<ptrdiff_t>(keyword.size()) && isSpace(token[keyword.size()]);
+}
+
+void parseChunk(const char* begin, const char* end, Chunk& chunk)
+{
+    size_t faceCount = 0;
+    for (const char* lineBegin = begin; lineBegin < end;) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(lineBegin, '\n', static_cast<size_t>(end - lineBegin)));
+        if (!lineEnd)
+            lineEnd = end;
+        const char* nextLine = lineEnd + (lineEnd != end ? 1 : 0);
+        if (lineEnd != lineBegin && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        const char* token = skipSpaces(lineBegin, lineEnd);
+        lineBegin = nextLine;
+        if (token == lineEnd || *token == '#')
+            continue;
+
+        if (isKeyword(token, lineEnd, "v")) {
+            token += 2;
+            for (int i = 0; i < 3; ++i)
+                chunk.positions.push_back(parseReal(token, lineEnd));
+        } else if (isKeyword(token, lineEnd, "vn")) {
+            token += 3;
+            for (int i = 0; i < 3; ++i)
+                chunk.normals.push_back(parseReal(token, lineEnd));
+        } else if (isKeyword(token, lineEnd, "vt")) {
+            token += 3;
+            for (int i = 0; i < 2; ++i)
+                chunk.texCoords.push_back(parseReal(token, lineEnd));
+        } else if (isKeyword(token, lineEnd, "f")) {
+            const char* statement = token;
+            token = skipSpaces(token + 2, lineEnd);
+
+            const size_t firstCorner = chunk.corners.size();
+            const size_t firstFixup = chunk.fixups.size();
+            while (token != lineEnd && *token != '\r') {
+                if (!parseCorner(token, lineEnd, chunk)) {
+                    chunk.error = "Failed to parse face (zero value for an index): " + std::string(statement, lineEnd);
+                    return;
+                }
+                while (token != lineEnd && (isSpace(*token) || *token == '\r'))
+                    ++token;
+            }
+
+            const size_t faceSize = chunk.corners.size() - firstCorner;
+            if (faceSize < 3) {
+                // Degenerate face; tinyobjloader skips these as well
+                chunk.corners.resize(firstCorner);
+                chunk.fixups.resize(firstFixup);
+                continue;
+            }
+            if (faceSize > 4) {
+                // Ear clipping would have to be reproduced exactly to match tinyobjloader
+                chunk.unsupported = true;
+                return;
+            }
+            chunk.faceSizes.push_back(static_cast<uint8_t>(faceSize));
+
+            if (chunk.commands.empty() || chunk.commands.back().type != CommandType::Faces)
+                chunk.commands.push_back({ CommandType::Faces, faceCount, 0, {} });
+            ++chunk.commands.back().count;
+            ++faceCount;
+        } else if (startsWith(token, lineEnd, "usemtl")) {
+            token += 6;
+            chunk.commands.push_back({ CommandType::UseMaterial, 0, 0, parseString(token, lineEnd) });
+        } else if (isKeyword(token, lineEnd, "mtllib")) {
+            chunk.commands.push_back({ CommandType::MaterialLibrary, 0, 0, std::string(token + 7, lineEnd) });
+        } else if (isKeyword(token, lineEnd, "g") || isKeyword(token, lineEnd, "o")) {
+            chunk.commands.push_back({ CommandType::NewShape, 0, 0, {} });
+        }
+        // Other statements (lines, points, smoothing groups, ...) do not contribute to triangle meshes
+    }
+}
+
+void appendTriangle(std::vector<tinyobj::index_t>& triangles, const tinyobj::index_t& a, const tinyobj::index_t& b, const tinyobj::index_t& c)
+{
+    triangles.push_back(a);
+    triangles.push_back(b);
+    triangles.push_back(c);
+}
+
+// Split the chunk's faces into triangles the same way tinyobjloader does. Quads are split along their shorter diagonal.
+// Command face ranges are converted into triangle ranges.
+void triangulateChunk(Chunk& chunk, const std::vector<float>& positions)
+{
+    const size_t quadCount = static_cast<size_t>(std::count(std::begin(chunk.faceSizes), std::end(chunk.faceSizes), uint8_t(4)));
+    chunk.triangles.reserve(3 * (chunk.faceSizes.size() + quadCount));
+
+    const tinyobj::index_t* corner = chunk.corners.data();
+    for (Command& command : chunk.commands) {
+        if (command.type != CommandType::Faces)
+            continue;
+
+        const size_t firstTriangle = chunk.triangles.size() / 3;
+        for (size_t face = command.first; face != command.first + command.count; ++face) {
+            const uint8_t faceSize = chunk.faceSizes[face];
+            if (faceSize == 3) {
+                appendTriangle(chunk.triangles, corner[0], corner[1], corner[2]);
+            } else {
+                const size_t vi[4] = { size_t(corner[0].vertex_index), size_t(corner[1].vertex_index), size_t(corner[2].vertex_index), size_t(corner[3].vertex_index) };
+                if (std::all_of(std::begin(vi), std::end(vi), [&](size_t index) { return 3 * index + 2 < positions.size(); })) {
+                    const float* v0 = &positions[3 * vi[0]];
+                    const float* v1 = &positions[3 * vi[1]];
+                    const float* v2 = &positions[3 * vi[2]];
+                    const float* v3 = &positions[3 * vi[3]];
+                    const float e02x = v2[0] - v0[0], e02y = v2[1] - v0[1], e02z = v2[2] - v0[2];
+                    const float e13x = v3[0] - v1[0], e13y = v3[1] - v1[1], e13z = v3[2] - v1[2];
+                    const float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+                    const float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+                    if (sqr02 < sqr13) {
+                        appendTriangle(chunk.triangles, corner[0], corner[1], corner[2]);
+                        appendTriangle(chunk.triangles, corner[0], corner[2], corner[3]);
+                    } else {
+                        appendTriangle(chunk.triangles, corner[0], corner[1], corner[3]);
+                        appendTriangle(chunk.triangles, corner[1], corner[2], corner[3]);
+                    }
+                }
+                // Quads with out of range indices are skipped, as in tinyobjloader
+            }
+            corner += faceSize;
+        }
+
+        command.first = firstTriangle;
+        command.count = chunk.triangles.size() / 3 - firstTriangle;
+    }
+}
+
+// Split an mtllib argument on spaces; a backslash escapes the next character
+std::vector<std::string> splitMaterialLibraries(const std::string& argument)
+{
+    std::vector<std::string> fileNames;
+    std::string fileName;
+    bool escaping = false;
+    for (char c : argument) {
+        if (!escaping && c == '\\') {
+            escaping = true;
+            continue;
+        }
+        if (!escaping && c == ' ') {
+            if (!fileName.empty())
+                fileNames.push_back(fileName);
+            fileName.clear();
+            continue;
+        }
+        escaping = false;
+        fileName += c;
+    }
+    fileNames.push_back(fileName);
+    return fileNames;
+}
+
+} // namespace
+
+ObjParseResult parseObjParallel(std::span<const char> text, const std::filesystem::path& baseDir, ObjContents& out, std::string& error)
+{
+    // Split into roughly equal chunks that each start at the beginning of a line
+    const size_t chunkCount = std::clamp<size_t>(text.size() / MIN_CHUNK_SIZE, 1, 4 * getParallelTaskCount());
+    std::vector<const char*> chunkBounds { text.data() };
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* bound = std::max(chunkBounds.back(), text.data() + i * text.size() / chunkCount);
+        const char* lineEnd = static_cast<const char*>(std::memchr(bound, '\n', static_cast<size_t>(text.data() + text.size() - bound)));
+        chunkBounds.push_back(lineEnd ? lineEnd + 1 : text.data() + text.size());
+    }
+    chunkBounds.push_back(text.data() + text.size());
+
+    std::vector<Chunk> chunks(chunkCount);
+    parallelFor(chunkCount, [&](size_t chunk) { parseChunk(chunkBounds[chunk], chunkBounds[chunk + 1], chunks[chunk]); });
+
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            error = chunk.error;
+            return ObjParseResult::Error;
+        }
+        if (chunk.unsupported)
+            return ObjParseResult::Unsupported;
+    }
+
+    // Offsets of every chunk's attributes in the concatenated arrays
+    std::vector<std::array<size_t, 3>> chunkOffsets(chunkCount);
+    std::array<size_t, 3> attributeSizes { 0, 0, 0 };
+    for (size_t i = 0; i < chunkCount; ++i) {
+        chunkOffsets[i] = attributeSizes;
+        attributeSizes[0] += chunks[i].positions.size();
+        attributeSizes[1] += chunks[i].normals.size();
+        attributeSizes[2] += chunks[i].texCoords.size();
+    }
+
+    tinyobj::attrib_t& attrib = out.attrib;
+    attrib.vertices.resize(attributeSizes[0]);
+    attrib.normals.resize(attributeSizes[1]);
+    attrib.texcoords.resize(attributeSizes[2]);
+    parallelFor(chunkCount, [&](size_t i) {
+        Chunk& chunk = chunks[i];
+        std::copy(std::begin(chunk.positions), std::end(chunk.positions), std::begin(attrib.vertices) + chunkOffsets[i][0]);
+        std::copy(std::begin(chunk.normals), std::end(chunk.normals), std::begin(attrib.normals) + chunkOffsets[i][1]);
+        std::copy(std::begin(chunk.texCoords), std::end(chunk.texCoords), std::begin(attrib.texcoords) + chunkOffsets[i][2]);
+
+        // Relative indices were stored relative to the start of the chunk
+        for (const IndexFixup& fixup : chunk.fixups) {
+            tinyobj::index_t& corner = chunk.corners[fixup.corner];
+            if (fixup.attribute == 0)
+                corner.vertex_index += static_cast<int>(chunkOffsets[i][0] / 3);
+            else if (fixup.attribute == 1)
+                corner.normal_index += static_cast<int>(chunkOffsets[i][1] / 3);
+            else
+                corner.texcoord_index += static_cast<int>(chunkOffsets[i][2] / 2);
+        }
+    });
+    parallelFor(chunkCount, [&](size_t i) { triangulateChunk(chunks[i], attrib.vertices); });
+
+    // Replay material and grouping statements in file order, like tinyobjloader's state machine
+    const std::string materialDir = baseDir.empty() ? std::string() : (baseDir / "").string();
+    tinyobj::MaterialFileReader materialReader(materialDir);
+    std::map<std::string, int> materialMap;
+    int materialId = -1;
+    tinyobj::shape_t shape;
+
+    for (const Chunk& chunk : chunks) {
+        for (const Command& command : chunk.commands) {
+            switch (command.type) {
+            case CommandType::Faces: {
+                const auto first = std::begin(chunk.triangles) + static_cast<ptrdiff_t>(3 * command.first);
+                shape.mesh.indices.insert(std::end(shape.mesh.indices), first, first + static_cast<ptrdiff_t>(3 * command.count));
+                shape.mesh.material_ids.insert(std::end(shape.mesh.material_ids), command.count, materialId);
+            } break;
+            case CommandType::UseMaterial: {
+                const auto iter = materialMap.find(command.argument);
+                materialId = iter != std::end(materialMap) ? iter->second : -1;
+            } break;
+            case CommandType::MaterialLibrary: {
+                for (const std::string& fileName : splitMaterialLibraries(command.argument)) {
+                    std::string warning, materialError;
+                    if (materialReader(fileName, &out.materials, &materialMap, &warning, &materialError))
+                        break;
+                }
+            } break;
+            case CommandType::NewShape: {
+                if (!shape.mesh.indices.empty())
+                    out.shapes.push_back(std::move(shape));
+                shape = tinyobj::shape_t();
+            } break;
+            }
+        }
+    }
+    if (!shape.mesh.indices.empty())
+        out.shapes.push_back(std::move(shape));
+
+    return ObjParseResult::Success;
+}
@@ -0,0 +1,27 @@
+#pragma once
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <tinyobjloader/tiny_obj_loader.h>
+DISABLE_WARNINGS_POP()
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// Contents of an OBJ file in the layout produced by tinyobj::LoadObj (with triangulation enabled)
+struct ObjContents {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+enum class ObjParseResult {
+    Success,
+    Unsupported, // The file uses polygons with more than four corners; parse it with tinyobjloader instead.
+    Error
+};
+
+// Parse OBJ text on all cores by splitting it into line-aligned chunks. Produces the same vertex attributes,
+// shape indices and per-face material ids as tinyobj::LoadObj. Material libraries are loaded from baseDir.
+ObjParseResult parseObjParallel(std::span<const char> text, const std::filesystem::path& baseDir, ObjContents& out, std::string& error);
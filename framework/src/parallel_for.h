@@ -0,0 +1,51 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Number of tasks worth splitting CPU-bound framework work into
+inline size_t getParallelTaskCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run body(taskIndex) for every taskIndex in [0, taskCount), spread over up to getParallelTaskCount() threads.
+// The calling thread participates. The first exception thrown by any task is rethrown after all tasks finished.
+inline void parallelFor(size_t taskCount, const std::function<void(size_t)>& body)
+{
+    const size_t threadCount = std::min(taskCount, getParallelTaskCount());
+    if (threadCount <= 1) {
+        for (size_t task = 0; task < taskCount; ++task)
+            body(task);
+        return;
+    }
+
+    std::atomic<size_t> nextTask { 0 };
+    std::vector<std::exception_ptr> errors(threadCount);
+    const auto runTasks = [&](size_t thread) {
+        try {
+            // Tasks are handed out one at a time because their sizes can differ a lot (e.g. sub-meshes)
+            for (size_t task = nextTask++; task < taskCount; task = nextTask++)
+                body(task);
+        } catch (...) {
+            errors[thread] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t thread = 1; thread < threadCount; ++thread)
+        threads.emplace_back(runTasks, thread);
+    runTasks(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (const std::exception_ptr& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
@@ -15,12 +15,17 @@ uniform vec3 cameraPosition;
 uniform samplerCube environmentMap;
 uniform float envBrightness;
 
+// Diffuse environment radiance projected onto order-2 spherical harmonics (see src/spherical_harmonics.h)
+uniform bool useSHDiffuse;
+uniform vec3 shCoefficients[9];
+
 uniform bool useMaterial;
 uniform bool hasTexCoords;
 uniform sampler2D colorMap;
 uniform sampler2D normalMap;
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
+uniform sampler2D ormMap; // Packed occlusion (R), roughness (G) and metallic (B)
 
 // Global texture toggles
 uniform bool enableColorTextures;
@@ -37,6 +42,9 @@ in mat3 TBN;
 
 layout(location = 0) out vec4 fragColor;
 
+// Defined in water_detail.glsl
+vec3 applyWaterDetail(vec3 N, vec3 worldPosition, vec3 viewerPosition);
+
 const float PI = 3.1415926;
 
 const float environmentIntensity = 0.3;
@@ -62,14 +70,30 @@ vec3 textureSample(samplerCube map, vec3 dir, float roughness, float spreadFacto
     return accumulatedColor / totalWeight;
 }
 
+vec3 evaluateSH(vec3 d)
+{
+    return shCoefficients[0] * 0.282095
+        + shCoefficients[1] * (0.488603 * d.y)
+        + shCoefficients[2] * (0.488603 * d.z)
+        + shCoefficients[3] * (0.488603 * d.x)
+        + shCoefficients[4] * (1.092548 * d.x * d.y)
+        + shCoefficients[5] * (1.092548 * d.y * d.z)
+        + shCoefficients[6] * (0.315392 * (3.0 * d.z * d.z - 1.0))
+        + shCoefficients[7] * (1.092548 * d.x * d.z)
+        + shCoefficients[8] * (0.546274 * (d.x * d.x - d.y * d.y));
+}
+
 void main()
 {
     vec3 N = normalize(fragNormal);
+    N = applyWaterDetail(N, fragPosition, cameraPosition);
     // Normal mapping
     if (useMaterial && hasTexCoords && textureFlags.y == 1 && enableNormalTextures)
     {
-        vec3 normalSample = texture(normalMap, fragTexCoord).rgb;
-        normalSample = normalSample * 2.0 - 1.0;// Transform from [0,1] to [-1,1]
+        // Z is reconstructed, so two-channel (BC5) normal maps work the same as RGB ones
+        vec3 normalSample = vec3(texture(normalMap, fragTexCoord).rg, 0.0);
+        normalSample.xy = normalSample.xy * 2.0 - 1.0;// Transform from [0,1] to [-1,1]
+        normalSample.z = sqrt(max(1.0 - dot(normalSample.xy, normalSample.xy), 0.0));
         normalSample.y = -normalSample.y;// Invert Y for OpenGL
         normalSample = normalize(normalSample);
         N = normalize(TBN * normalSample);
@@ -87,6 +111,7 @@ void main()
 
     float m_metallic = metallic;
     float m_roughness = roughness;
+    float occlusion = 1.0;
 
     if (useMaterial && hasTexCoords && textureFlags.z == 1 && enableMetallicTextures)
     {
@@ -94,10 +119,20 @@ void main()
         m_metallic = texture(metallicMap, fragTexCoord).r;
         m_roughness = texture(roughnessMap, fragTexCoord).r;
     }
+    else if (useMaterial && hasTexCoords && textureFlags.z == 2 && enableMetallicTextures)
+    {
+        // One fetch from the packed texture
+        vec3 orm = texture(ormMap, fragTexCoord).rgb;
+        m_roughness = orm.g;
+        m_metallic = orm.b;
+        occlusion = orm.r;
+    }
 
     m_roughness = clamp(m_roughness, 0.05, 1.0);// Avoid 0 roughness
 
-    vec3 diffuseEnv = textureSample(environmentMap, N, m_roughness, 5).rgb;
+    vec3 diffuseEnv = useSHDiffuse
+        ? max(evaluateSH(N), vec3(0.0))
+        : textureSample(environmentMap, N, m_roughness, 5).rgb;
 
     float NdotV = max(dot(N, V), 0.0);
     float ior = 1.5;
@@ -112,7 +147,7 @@ void main()
     vec3 envDiffuse  = diffuseEnv * albedo * kD * envBrightness * (1.0 / PI);
     vec3 envSpecular = specEnv * F * envBrightness;
 
-    vec3 color = envDiffuse + envSpecular;
+    vec3 color = (envDiffuse + envSpecular) * occlusion;
 
     // tone mapping (Reinhard) + gamma
     if (enableToneMapping)
@@ -13,16 +13,23 @@ out vec3 fragNormal;
 out vec2 fragTexCoord;
 out mat3 TBN;
 
+// Defined in water_noise.glsl
+void displaceWater(inout vec3 position, inout vec3 normal);
+
 void main()
 {
-    gl_Position = mvpMatrix * vec4(position, 1);
+    vec3 vertexPosition = position;
+    vec3 vertexNormal = normal;
+    displaceWater(vertexPosition, vertexNormal);
+
+    gl_Position = mvpMatrix * vec4(vertexPosition, 1);
 
-    fragPosition = (modelMatrix * vec4(position, 1)).xyz;
-    fragNormal = normalModelMatrix * normal;
+    fragPosition = (modelMatrix * vec4(vertexPosition, 1)).xyz;
+    fragNormal = normalModelMatrix * vertexNormal;
     fragTexCoord = texCoord;
 
     vec3 T = normalize(vec3(modelMatrix[0])); // Tangent
     vec3 B = normalize(vec3(modelMatrix[1])); // Bitangent
-    vec3 N = normalize(normalModelMatrix * normal); // Normal
+    vec3 N = normalize(normalModelMatrix * vertexNormal); // Normal
     TBN = mat3(T, B, N);
 }
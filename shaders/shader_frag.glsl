@@ -8,13 +8,14 @@ layout(std140) uniform Material// Must match RS_GPUMaterial in src/model.h
     float transmission;// offset 20
     vec3 emissive;// offset 32 (padding added by alignment)
     float _padding;// offset 44
-    ivec4 textureFlags;// offset 48: [hasBaseColor, hasNormal, hasMetallicRoughness, hasEmissive]
+    ivec4 textureFlags;// offset 48: [hasBaseColor, hasNormal, hasMetallicRoughness (2 = packed ORM), hasEmissive]
 };
 
 uniform sampler2D colorMap;
 uniform sampler2D normalMap;
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
+uniform sampler2D ormMap; // Packed occlusion (R), roughness (G) and metallic (B)
 uniform bool hasTexCoords;
 uniform bool useMaterial;
 
@@ -42,6 +43,9 @@ in mat3 TBN;
 
 layout(location = 0) out vec4 fragColor;
 
+// Defined in water_detail.glsl
+vec3 applyWaterDetail(vec3 N, vec3 worldPosition, vec3 viewerPosition);
+
 
 const float PI = 3.1415926;
 const int LIGHT_TYPE_POINT = 0;
@@ -201,11 +205,14 @@ void main()
     // f_r = kd * f_lambert + ks * f_cook_torrance
 
     vec3 N = normalize(fragNormal);
+    N = applyWaterDetail(N, fragPosition, cameraPosition);
     // Normal mapping
     if (useMaterial && hasTexCoords && textureFlags.y == 1 && enableNormalTextures)
     {
-        vec3 normalSample = texture(normalMap, fragTexCoord).rgb;
-        normalSample = normalSample * 2.0 - 1.0; // Transform from [0,1] to [-1,1]
+        // Z is reconstructed, so two-channel (BC5) normal maps work the same as RGB ones
+        vec3 normalSample = vec3(texture(normalMap, fragTexCoord).rg, 0.0);
+        normalSample.xy = normalSample.xy * 2.0 - 1.0; // Transform from [0,1] to [-1,1]
+        normalSample.z = sqrt(max(1.0 - dot(normalSample.xy, normalSample.xy), 0.0));
         normalSample = normalize(normalSample);
         N = normalize(TBN * normalSample);
     }
@@ -236,6 +243,13 @@ void main()
         m_metallic = texture(metallicMap, fragTexCoord).r;
         m_roughness = texture(roughnessMap, fragTexCoord).r;
     }
+    else if (useMaterial && hasTexCoords && textureFlags.z == 2 && enableMetallicTextures)
+    {
+        // One fetch from the packed texture
+        vec3 orm = texture(ormMap, fragTexCoord).rgb;
+        m_roughness = orm.g;
+        m_metallic = orm.b;
+    }
 
     m_roughness = clamp(m_roughness, 0.05, 1.0); // Avoid 0 roughness
 
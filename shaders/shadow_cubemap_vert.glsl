@@ -6,8 +6,15 @@ uniform mat4 modelMatrix;
 
 out vec3 worldPos;
 
+// Defined in water_noise.glsl
+void displaceWater(inout vec3 position, inout vec3 normal);
+
 void main()
 {
-    worldPos = (modelMatrix * vec4(position, 1.0)).xyz;
+    vec3 vertexPosition = position;
+    vec3 vertexNormal = vec3(0.0, 1.0, 0.0);
+    displaceWater(vertexPosition, vertexNormal);
+
+    worldPos = (modelMatrix * vec4(vertexPosition, 1.0)).xyz;
     gl_Position = vec4(worldPos, 1.0);
 }
@@ -4,7 +4,14 @@ uniform mat4 mvpMatrix;
 
 layout(location = 0) in vec3 position;
 
+// Defined in water_noise.glsl
+void displaceWater(inout vec3 position, inout vec3 normal);
+
 void main()
 {
-    gl_Position = mvpMatrix * vec4(position, 1);
+    vec3 vertexPosition = position;
+    vec3 vertexNormal = vec3(0, 1, 0);
+    displaceWater(vertexPosition, vertexNormal);
+
+    gl_Position = mvpMatrix * vec4(vertexPosition, 1);
 }
@@ -0,0 +1,39 @@
+#version 410
+
+// Fine ripples of the WaterSurface, shaded instead of modelled: tileable slope maps scrolled at several scales and
+// directions and added onto the slopes of the displaced grid. Linked as a second fragment shader object into the
+// lighting and environment programs.
+
+uniform bool waterDetail;
+uniform sampler2DArray waterDetailMaps; // x and z slopes of a tileable height field per layer, unit RMS
+uniform float waterDetailTime; // Elapsed seconds
+uniform float waterDetailStrength; // RMS slope that each layer adds near the viewer
+
+const int WATER_DETAIL_LAYERS = 3;
+// World size of a tile, direction and speed in tiles per second of every layer, from coarse to fine
+const float WATER_DETAIL_TILE_SIZE[WATER_DETAIL_LAYERS] = float[](7.0, 3.1, 1.3);
+const vec2 WATER_DETAIL_DIRECTION[WATER_DETAIL_LAYERS] = vec2[](vec2(0.96, 0.28), vec2(-0.37, 0.93), vec2(0.71, -0.71));
+const float WATER_DETAIL_SPEED[WATER_DETAIL_LAYERS] = float[](0.05, 0.08, 0.12);
+// A layer fades out between these many tiles away from the viewer, before its ripples only add shimmer
+const vec2 WATER_DETAIL_FADE_TILES = vec2(6.0, 24.0);
+
+// N with the detail slopes at worldPosition added, or unchanged for anything but the water
+vec3 applyWaterDetail(vec3 N, vec3 worldPosition, vec3 viewerPosition)
+{
+    if (!waterDetail || N.y <= 0.0)
+        return N;
+
+    float distanceToViewer = distance(worldPosition, viewerPosition);
+    vec2 slope = vec2(0.0);
+    for (int layer = 0; layer < WATER_DETAIL_LAYERS; ++layer) {
+        float tileSize = WATER_DETAIL_TILE_SIZE[layer];
+        float weight = 1.0 - smoothstep(WATER_DETAIL_FADE_TILES.x * tileSize, WATER_DETAIL_FADE_TILES.y * tileSize, distanceToViewer);
+        if (weight <= 0.0)
+            continue;
+        vec2 uv = worldPosition.xz / tileSize + WATER_DETAIL_DIRECTION[layer] * WATER_DETAIL_SPEED[layer] * waterDetailTime;
+        slope += weight * texture(waterDetailMaps, vec3(uv, float(layer))).rg;
+    }
+
+    // Combined with the surface normal as the wake is in displaceWater (water_noise.glsl)
+    return normalize(N / N.y - vec3(slope.x, 0.0, slope.y) * waterDetailStrength);
+}
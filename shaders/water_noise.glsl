@@ -0,0 +1,158 @@
+#version 410
+
+// Displaces the flat WaterSurface grid with the same Perlin noise as PerlinNoise::noise, or with the FFT ocean of
+// RS_OceanSpectrum, plus the ripples of RS_WaterWake. Linked as a second vertex shader object into every program
+// that draws water.
+
+uniform bool waterDisplacement;
+uniform usampler2D waterPermutation; // 256 x 1 permutation table of the PerlinNoise instance
+uniform vec2 waterOrigin; // World-space xz of the grid's local origin
+uniform float waterFrequency;
+uniform float waterTime; // Elapsed time multiplied by the wave speed
+uniform float waterAmplitude;
+uniform float waterHeightOffset;
+uniform bool waterUseNoiseVolume;
+uniform sampler3D waterNoiseVolume; // Baked NoiseVolume: value, d/dx and d/dz over x, z and time
+uniform vec3 waterNoiseVolumePeriod; // Lattice cells the volume spans along x, z and time
+uniform bool waterUseOcean;
+uniform sampler2D waterOceanDisplacement; // RS_OceanSpectrum patch: x displacement, height and z displacement
+uniform sampler2D waterOceanNormal;
+uniform float waterOceanPatchSize; // World units after which the ocean patch repeats
+uniform bool waterWake;
+uniform sampler2D waterWakeHeights; // RS_WaterWake heights around the focus point, added onto the waves
+uniform vec2 waterWakeCorner; // World xz of the wake grid's corner
+uniform float waterWakeExtent;
+
+int perm(int value)
+{
+    return int(texelFetch(waterPermutation, ivec2(value & 255, 0), 0).r);
+}
+
+float fade(float t)
+{
+    return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+}
+
+float fadeDerivative(float t)
+{
+    return 30.0 * t * t * (t * (t - 2.0) + 1.0);
+}
+
+// Gradient that the hash selects; the dot product with the offset is the grad() of the reference implementation
+vec3 gradient(int hash)
+{
+    int h = hash & 15;
+    float u = (h & 1) != 0 ? -1.0 : 1.0;
+    float v = (h & 2) != 0 ? -1.0 : 1.0;
+    vec3 g = h < 8 ? vec3(u, 0.0, 0.0) : vec3(0.0, u, 0.0);
+    if (h < 4)
+        g.y += v;
+    else if (h == 12 || h == 14)
+        g.x += v;
+    else
+        g.z += v;
+    return g;
+}
+
+// Noise value (x) and its partial derivatives (yzw)
+vec4 perlinNoise(vec3 p)
+{
+    vec3 cell = floor(p);
+    ivec3 i = ivec3(cell) & 255;
+    vec3 f = p - cell;
+
+    int a = perm(i.x) + i.y;
+    int b = perm(i.x + 1) + i.y;
+    vec3 ga = gradient(perm(perm(a) + i.z));
+    vec3 gb = gradient(perm(perm(b) + i.z));
+    vec3 gc = gradient(perm(perm(a + 1) + i.z));
+    vec3 gd = gradient(perm(perm(b + 1) + i.z));
+    vec3 ge = gradient(perm(perm(a) + i.z + 1));
+    vec3 gf = gradient(perm(perm(b) + i.z + 1));
+    vec3 gg = gradient(perm(perm(a + 1) + i.z + 1));
+    vec3 gh = gradient(perm(perm(b + 1) + i.z + 1));
+
+    float va = dot(ga, f);
+    float vb = dot(gb, f - vec3(1.0, 0.0, 0.0));
+    float vc = dot(gc, f - vec3(0.0, 1.0, 0.0));
+    float vd = dot(gd, f - vec3(1.0, 1.0, 0.0));
+    float ve = dot(ge, f - vec3(0.0, 0.0, 1.0));
+    float vf = dot(gf, f - vec3(1.0, 0.0, 1.0));
+    float vg = dot(gg, f - vec3(0.0, 1.0, 1.0));
+    float vh = dot(gh, f - vec3(1.0, 1.0, 1.0));
+
+    vec3 w = vec3(fade(f.x), fade(f.y), fade(f.z));
+    vec3 dw = vec3(fadeDerivative(f.x), fadeDerivative(f.y), fadeDerivative(f.z));
+
+    // Trilinear interpolation written as a polynomial in the fade weights
+    float k1 = vb - va;
+    float k2 = vc - va;
+    float k3 = ve - va;
+    float k4 = va - vb - vc + vd;
+    float k5 = va - vc - ve + vg;
+    float k6 = va - vb - ve + vf;
+    float k7 = -va + vb + vc - vd + ve - vf - vg + vh;
+
+    float value = va + k1 * w.x + k2 * w.y + k3 * w.z + k4 * w.x * w.y + k5 * w.y * w.z + k6 * w.z * w.x + k7 * w.x * w.y * w.z;
+
+    vec3 derivative = ga + w.x * (gb - ga) + w.y * (gc - ga) + w.z * (ge - ga)
+        + w.x * w.y * (ga - gb - gc + gd) + w.y * w.z * (ga - gc - ge + gg) + w.z * w.x * (ga - gb - ge + gf)
+        + w.x * w.y * w.z * (-ga + gb + gc - gd + ge - gf - gg + gh);
+    derivative += dw * vec3(
+        k1 + k4 * w.y + k6 * w.z + k7 * w.y * w.z,
+        k2 + k5 * w.z + k4 * w.x + k7 * w.z * w.x,
+        k3 + k6 * w.x + k5 * w.y + k7 * w.x * w.y);
+
+    return vec4(value, derivative);
+}
+
+// Value and x and z derivatives of the periodic noise at p = (x, time, z), filtered by the hardware. Texel i of an
+// axis holds lattice coordinate i / texelsPerCell, at the texel's center.
+vec3 sampleNoiseVolume(vec3 p)
+{
+    vec3 coord = p.xzy / waterNoiseVolumePeriod + 0.5 / vec3(textureSize(waterNoiseVolume, 0));
+    return texture(waterNoiseVolume, coord).rgb;
+}
+
+// Height of the wake and its x and z slopes at world position xz; the cells are centered on the texels
+vec3 sampleWake(vec2 world)
+{
+    vec2 uv = (world - waterWakeCorner) / waterWakeExtent;
+    vec2 texel = vec2(1.0 / float(textureSize(waterWakeHeights, 0).x), 0.0);
+    float height = textureLod(waterWakeHeights, uv, 0.0).r;
+    float slopeX = textureLod(waterWakeHeights, uv + texel.xy, 0.0).r - textureLod(waterWakeHeights, uv - texel.xy, 0.0).r;
+    float slopeZ = textureLod(waterWakeHeights, uv + texel.yx, 0.0).r - textureLod(waterWakeHeights, uv - texel.yx, 0.0).r;
+    return vec3(height, vec2(slopeX, slopeZ) / (2.0 * waterWakeExtent * texel.x));
+}
+
+// Leaves the vertex untouched unless a water surface is being drawn
+void displaceWater(inout vec3 position, inout vec3 normal)
+{
+    if (!waterDisplacement)
+        return;
+
+    vec2 world = waterOrigin + position.xz;
+    if (waterUseOcean) {
+        // Sample i of the patch lies at world coordinate i * waterOceanPatchSize / size, on the texel's center
+        vec2 uv = world / waterOceanPatchSize + 0.5 / vec2(textureSize(waterOceanDisplacement, 0));
+        vec3 displacement = textureLod(waterOceanDisplacement, uv, 0.0).xyz;
+        position += vec3(displacement.x, 0.0, displacement.z);
+        position.y = displacement.y + waterHeightOffset;
+        normal = normalize(textureLod(waterOceanNormal, uv, 0.0).xyz);
+    } else {
+        vec3 p = vec3(world.x * waterFrequency, waterTime, world.y * waterFrequency);
+        vec3 noise = waterUseNoiseVolume ? sampleNoiseVolume(p) : perlinNoise(p).xyw;
+        vec2 slope = noise.yz * waterFrequency * waterAmplitude;
+
+        position.y = noise.x * waterAmplitude + waterHeightOffset;
+        normal = normalize(vec3(-slope.x, 1.0, -slope.y));
+    }
+
+    // Slopes add up, so the normal is rebuilt from the sum of both: dividing by its y component turns it into
+    // (-slope.x, 1, -slope.y)
+    if (waterWake) {
+        vec3 wake = sampleWake(world);
+        position.y += wake.x;
+        normal = normalize(normal / normal.y - vec3(wake.y, 0.0, wake.z));
+    }
+}
@@ -0,0 +1,41 @@
+#version 410
+
+// Tessellation levels of the water patches from the projected size of each edge as seen by the main camera, so
+// the shadow passes tessellate the surface exactly like the lighting pass. A level only depends on its own edge,
+// which keeps neighbouring patches free of cracks.
+
+layout(vertices = 4) out;
+
+uniform vec2 waterOrigin; // World-space xz of the grid's local origin
+uniform float waterHeightOffset;
+uniform vec3 waterLodCamera; // World-space position of the main camera
+uniform float waterLodScale; // Level of an edge of unit length at unit distance
+
+in vec3 controlPosition[];
+in vec2 controlTexCoord[];
+
+out vec3 evaluationPosition[];
+out vec2 evaluationTexCoord[];
+
+float edgeLevel(vec3 a, vec3 b)
+{
+    vec3 center = vec3(waterOrigin.x, waterHeightOffset, waterOrigin.y) + 0.5 * (a + b);
+    float distance = max(length(center - waterLodCamera), 0.01);
+    return clamp(length(b - a) * waterLodScale / distance, 1.0, 64.0);
+}
+
+void main()
+{
+    evaluationPosition[gl_InvocationID] = controlPosition[gl_InvocationID];
+    evaluationTexCoord[gl_InvocationID] = controlTexCoord[gl_InvocationID];
+
+    if (gl_InvocationID == 0) {
+        // Quad edges in the order u = 0, v = 0, u = 1, v = 1
+        gl_TessLevelOuter[0] = edgeLevel(controlPosition[3], controlPosition[0]);
+        gl_TessLevelOuter[1] = edgeLevel(controlPosition[0], controlPosition[1]);
+        gl_TessLevelOuter[2] = edgeLevel(controlPosition[1], controlPosition[2]);
+        gl_TessLevelOuter[3] = edgeLevel(controlPosition[2], controlPosition[3]);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+    }
+}
@@ -0,0 +1,40 @@
+#version 410
+
+// u runs along +x and v along +z, so clockwise domain triangles face up
+layout(quads, fractional_even_spacing, cw) in;
+
+uniform mat4 mvpMatrix;
+uniform mat4 modelMatrix;
+uniform mat3 normalModelMatrix;
+
+in vec3 evaluationPosition[];
+in vec2 evaluationTexCoord[];
+
+out vec3 fragPosition;
+out vec3 fragNormal;
+out vec2 fragTexCoord;
+out mat3 TBN;
+out vec3 worldPos; // Input of the point shadow geometry shader
+
+// Defined in water_noise.glsl
+void displaceWater(inout vec3 position, inout vec3 normal);
+
+void main()
+{
+    vec2 uv = gl_TessCoord.xy;
+    vec3 position = mix(mix(evaluationPosition[0], evaluationPosition[1], uv.x), mix(evaluationPosition[3], evaluationPosition[2], uv.x), uv.y);
+    vec3 normal = vec3(0.0, 1.0, 0.0);
+    displaceWater(position, normal);
+
+    gl_Position = mvpMatrix * vec4(position, 1.0);
+
+    fragPosition = (modelMatrix * vec4(position, 1.0)).xyz;
+    fragNormal = normalModelMatrix * normal;
+    fragTexCoord = mix(mix(evaluationTexCoord[0], evaluationTexCoord[1], uv.x), mix(evaluationTexCoord[3], evaluationTexCoord[2], uv.x), uv.y);
+    worldPos = fragPosition;
+
+    vec3 T = normalize(vec3(modelMatrix[0])); // Tangent
+    vec3 B = normalize(vec3(modelMatrix[1])); // Bitangent
+    vec3 N = normalize(fragNormal); // Normal
+    TBN = mat3(T, B, N);
+}
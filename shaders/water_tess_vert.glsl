@@ -0,0 +1,13 @@
+#version 410
+
+layout(location = 0) in vec3 position;
+layout(location = 2) in vec2 texCoord;
+
+out vec3 controlPosition;
+out vec2 controlTexCoord;
+
+void main()
+{
+    controlPosition = position;
+    controlTexCoord = texCoord;
+}
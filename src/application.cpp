@@ -1,6 +1,8 @@
 //#include "Image.h"
 #include "constants.h"
 #include "scene.h"
+#include "texture_compression.h"
+#include "texture_streaming.h"
 // Always include window first (because it includes glfw, which includes GL which needs to be included AFTER glew).
 // Can't wait for modules to fix this stuff...
 #include <framework/disable_all_warnings.h>
@@ -47,16 +49,20 @@ public:
         try {
             ShaderBuilder defaultBuilder;
             defaultBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shader_vert.glsl");
+            defaultBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/water_noise.glsl");
             defaultBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shader_frag.glsl");
+            defaultBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/water_detail.glsl");
             m_defaultShader = defaultBuilder.build();
 
             ShaderBuilder shadowBuilder;
             shadowBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shadow_vert.glsl");
+            shadowBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/water_noise.glsl");
             shadowBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shadow_frag.glsl");
             m_shadowShader = shadowBuilder.build();
 
             ShaderBuilder shadowCubemapBuilder;
             shadowCubemapBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/shadow_cubemap_vert.glsl");
+            shadowCubemapBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/water_noise.glsl");
             shadowCubemapBuilder.addStage(GL_GEOMETRY_SHADER, RESOURCE_ROOT "shaders/shadow_cubemap_geom.glsl");
             shadowCubemapBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shadow_cubemap_frag.glsl");
             m_shadowCubemapShader = shadowCubemapBuilder.build();
@@ -68,7 +74,9 @@ public:
 
             ShaderBuilder envBuilder;
             envBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/env_vert.glsl");
+            envBuilder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/water_noise.glsl");
             envBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/env_frag.glsl");
+            envBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/water_detail.glsl");
             m_envShader = envBuilder.build();
 
             ShaderBuilder skyboxBuilder;
@@ -76,6 +84,17 @@ public:
             skyboxBuilder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/skybox_frag.glsl");
             m_skyboxShader = skyboxBuilder.build();
 
+            // The water samplers must not share unit 0 with the environment map, even before any water is drawn
+            for (const Shader* shader : { &m_defaultShader, &m_shadowShader, &m_shadowCubemapShader, &m_envShader }) {
+                shader->bind();
+                glUniform1i(shader->getUniformLocation("waterPermutation"), WATER_PERMUTATION_TEXTURE_UNIT);
+                glUniform1i(shader->getUniformLocation("waterNoiseVolume"), WATER_NOISE_VOLUME_TEXTURE_UNIT);
+                glUniform1i(shader->getUniformLocation("waterOceanDisplacement"), WATER_OCEAN_DISPLACEMENT_TEXTURE_UNIT);
+                glUniform1i(shader->getUniformLocation("waterOceanNormal"), WATER_OCEAN_NORMAL_TEXTURE_UNIT);
+                glUniform1i(shader->getUniformLocation("waterWakeHeights"), WATER_WAKE_TEXTURE_UNIT);
+                glUniform1i(shader->getUniformLocation("waterDetailMaps"), WATER_DETAIL_TEXTURE_UNIT);
+            }
+
         } catch (ShaderLoadingException e) {
             std::cerr << e.what() << std::endl;
         }
@@ -157,18 +176,11 @@ public:
         defaultScene.getCameras()[1]->setCamera({ 0.0, 0.0, 0.0 }, { 0.5 * 3.14159, 0.0, 0.0 }, 5.0f);
         defaultScene.getCameras()[1]->toggleMovement();
 
-        // Load ship model
+        // Ship model; a placeholder is shown until the real meshes have been loaded in the background
         RS_Model shipModel;
-        std::vector<GPUMesh> shipMeshes = GPUMesh::loadMeshGPU(RESOURCE_ROOT "resources/ship/ship.obj", true);
-
-        // Add all meshes to the model
-        for (GPUMesh& mesh : shipMeshes) {
-            // Create material from mesh data (automatically loads textures)
-            RS_Material material = RS_Material::createFromMesh(mesh);
-
-            shipModel.addMesh(std::move(mesh));
-            shipModel.addMaterial(std::move(material));
-        }
+        GPUMesh placeholderMesh = GPUMesh::createPlaceholder();
+        shipModel.addMaterial(RS_Material::createFromMesh(placeholderMesh));
+        shipModel.addMesh(std::move(placeholderMesh));
 
         std::vector<glm::vec3> curve = {
             glm::vec3(0.0f, 0.0f, 0.0f),
@@ -180,15 +192,28 @@ public:
 
         shipModel.setAnimationCurve(curve);
 
+        // Hull points at bow, midship and stern on both sides; the ship is normalized to the unit sphere, bow along +z
+        for (float along : { -0.7f, 0.0f, 0.7f }) {
+            for (float across : { -0.25f, 0.25f })
+                shipModel.getBuoyancy().hullPoints.emplace_back(across, 0.0f, along);
+        }
+
         // Add dragon to scene
         defaultScene.addModel(std::move(shipModel));
-
-        // Add environment map to scene
-        defaultScene.setEnvironmentMap(RESOURCE_ROOT "resources/envmap/pure_sky.hdr");
+        const size_t shipModelIndex = defaultScene.getModelCount() - 1;
 
         // Add the default scene to the scenes
         m_scenes.push_back(std::move(defaultScene));
 
+        // Workers pick block formats for imported textures, so this must be known before loading starts
+        if (RS_COMPRESS_MATERIAL_TEXTURES)
+            initBlockCompressionSupport();
+
+        // Load the heavy assets asynchronously; the scene must not move until they are done (no scenes are added later)
+        RS_Scene& loadingScene = m_scenes.back();
+        loadingScene.loadModelAsync(m_loader, shipModelIndex, RESOURCE_ROOT "resources/ship/ship.obj", true);
+        loadingScene.setEnvironmentMapAsync(m_loader, RESOURCE_ROOT "resources/envmap/pure_sky.hdr");
+
         Trackball::printHelp(); // Print camera controls to console
     }
 
@@ -200,6 +225,12 @@ public:
 
         ImGui::Begin(RS_WINDOW_TITLE);
 
+        if (m_loader.isLoading())
+            ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "Loading assets...");
+        if (RS_TextureStreamer::instance().getTextureCount() > 0)
+            ImGui::Text("Streamed textures: %zu (%.1f MiB resident)", RS_TextureStreamer::instance().getTextureCount(),
+                static_cast<double>(RS_TextureStreamer::instance().getResidentBytes()) / (1024.0 * 1024.0));
+
         // Scene controls
         ImGui::Separator();
         ImGui::Text("Scenes");
@@ -322,6 +353,8 @@ public:
         if (activeScene.getEnvironmentCubemap()) {
             float& envBrightness = activeScene.getEnvironmentBrightness();
             ImGui::SliderFloat("Brightness", &envBrightness, 0.0f, 2.0f);
+            if (activeScene.hasEnvironmentSH())
+                ImGui::Checkbox("SH diffuse lighting", &m_settings.enableSHDiffuse);
         } else {
             ImGui::TextDisabled("No environment map loaded");
         }
@@ -381,6 +414,8 @@ public:
 					model.enableAnimation(!model.getAnimationEnabled());
                 }
 				ImGui::InputFloat("Animation Time", &model.m_animateTime, 0.1f, 5.0f);
+                if (!model.getBuoyancy().hullPoints.empty())
+                    ImGui::SliderFloat("Buoyancy Response", &model.getBuoyancy().response, 0.5f, 10.0f);
 
                 ImGui::TreePop();
             }
@@ -395,6 +430,30 @@ public:
         if (ImGui::Checkbox("Enable Water", &waterEnabled)) {
             water.setEnabled(waterEnabled);
         }
+        bool waterOnGPU = water.isGPUDisplacement();
+        if (ImGui::Checkbox("Displace Water on GPU", &waterOnGPU)) {
+            water.setGPUDisplacement(waterOnGPU);
+        }
+        bool waterNoiseVolume = water.isNoiseVolume();
+        if (ImGui::Checkbox("Bake Water Noise Volume", &waterNoiseVolume)) {
+            water.setNoiseVolume(waterNoiseVolume);
+        }
+        bool waterOcean = water.isOcean();
+        if (ImGui::Checkbox("FFT Ocean", &waterOcean)) {
+            water.setOcean(waterOcean);
+        }
+        bool waterWake = water.isWake();
+        if (ImGui::Checkbox("Ship Wake", &waterWake)) {
+            water.setWake(waterWake);
+        }
+        bool waterDetail = water.isDetailNormals();
+        if (ImGui::Checkbox("Water Detail Normals", &waterDetail)) {
+            water.setDetailNormals(waterDetail);
+        }
+        bool waterTessellated = water.isTessellated();
+        if (ImGui::Checkbox("Tessellate Water", &waterTessellated)) {
+            water.setTessellated(waterTessellated);
+        }
         float waterExtent = water.getTileSize();
         if (ImGui::SliderFloat("Water Generation Range", &waterExtent, 20.0f, 250.0f)) {
             water.setTileSize(waterExtent);
@@ -411,6 +470,18 @@ public:
         if (ImGui::SliderFloat("Speed", &waterSpeed, 0.0f, 2.0f)) {
             water.setSpeed(waterSpeed);
         }
+        if (water.isOcean()) {
+            float windDirection = water.getWindDirection();
+            if (ImGui::SliderAngle("Wind Direction", &windDirection, -180.0f, 180.0f)) {
+                water.setWindDirection(windDirection);
+            }
+        }
+        if (water.isDetailNormals()) {
+            float detailStrength = water.getDetailStrength();
+            if (ImGui::SliderFloat("Detail Strength", &detailStrength, 0.0f, 0.3f)) {
+                water.setDetailStrength(detailStrength);
+            }
+        }
         float waterHeight = water.getHeightOffset();
         if (ImGui::SliderFloat("Height", &waterHeight, -5.0f, 2.0f)) {
             water.setHeightOffset(waterHeight);
@@ -473,6 +544,14 @@ public:
             float deltaTime = static_cast<float>(currentTime - m_lastFrameTime);
             m_lastFrameTime = currentTime;
 
+            // Finish asynchronous loads (GPU uploads) within a fixed slice of the frame
+            m_loader.processMainThreadQueue(RS_UPLOAD_BUDGET_PER_FRAME);
+
+            // Stream in the texture mips that the active scene needs on screen (uses the requests of this frame)
+            if (!m_scenes.empty())
+                m_scenes[m_activeSceneIndex].requestStreamedTextures(static_cast<float>(m_window.getFrameBufferSize().y));
+            RS_TextureStreamer::instance().update(RS_TEXTURE_UPLOAD_BYTES_PER_FRAME, RS_TEXTURE_MEMORY_BUDGET);
+
             render_imgui();
 
             // Clear the screen
@@ -486,7 +565,7 @@ public:
                 RS_Scene& activeScene = m_scenes[m_activeSceneIndex];
 
                 const glm::vec3 focusPoint = activeScene.getProceduralFocusPoint();
-                activeScene.updateWaterSurface(focusPoint, deltaTime);
+                activeScene.updateWaterSurface(focusPoint, deltaTime, static_cast<float>(m_window.getFrameBufferSize().y));
 
                 // Generate shadow maps before rendering the main passes
                 activeScene.renderShadowMaps(m_shadowShader, m_shadowCubemapShader, m_settings);
@@ -577,6 +656,8 @@ private:
     // Scene system
     std::vector<RS_Scene> m_scenes;
     size_t m_activeSceneIndex { 0 };
+    // Declared after the scenes so outstanding loads finish before the scenes they write to are destroyed
+    RS_AsyncLoader m_loader;
     double m_lastFrameTime = 0.0;
 };
 
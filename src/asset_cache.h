@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Helpers shared by the on-disk caches of baked assets. Cache entries live in a ".cache" directory next to
+// the source asset and are named after a hash of the source contents (or, for sources too large to hash on
+// every load, of the file's path, size and modification time), so editing a source file never picks up a
+// stale entry. Entries use native endianness; they are a local acceleration structure, not a distribution format.
+
+// Read an entire file into memory (empty optional if it cannot be opened)
+std::optional<std::vector<std::byte>> readFileBytes(const std::filesystem::path& filePath);
+
+// Fast non-cryptographic 64-bit hash, used to key cache entries on file contents
+uint64_t hashBytes(std::span<const std::byte> bytes, uint64_t seed = 0);
+
+// Hash of a file's canonical path, size and last modification time (empty optional if the file is missing)
+std::optional<uint64_t> hashFileStamp(const std::filesystem::path& filePath, uint64_t seed = 0);
+
+// ".cache/<stem>_<hash><suffix>" next to the source file
+std::filesystem::path getCacheEntryPath(const std::filesystem::path& sourceFile, uint64_t contentHash, std::string_view suffix);
+
+// Write to a temporary file and rename it into place, so readers never observe a half-written entry
+bool writeFileAtomically(const std::filesystem::path& filePath, std::span<const std::span<const std::byte>> chunks);
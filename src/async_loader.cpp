@@ -0,0 +1,81 @@
+#include "async_loader.h"
+#include "thread_pool.h"
+
+#include <exception>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+void RS_LoadTask::promise_type::unhandled_exception() noexcept
+{
+    try {
+        std::rethrow_exception(std::current_exception());
+    } catch (const std::exception& e) {
+        std::cerr << "Asynchronous load failed: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Asynchronous load failed with an unknown error" << std::endl;
+    }
+}
+
+RS_AsyncLoader::~RS_AsyncLoader()
+{
+    while (isLoading()) {
+        processMainThreadQueue(std::chrono::hours(1));
+        std::this_thread::yield();
+    }
+}
+
+void RS_AsyncLoader::WorkerAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+    RS_ThreadPool::instance().submit([handle]() { handle.resume(); });
+}
+
+void RS_AsyncLoader::MainThreadAwaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+{
+    handle = coroutine;
+    next = loader.m_queueHead.load(std::memory_order_relaxed);
+    while (!loader.m_queueHead.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+RS_AsyncLoader::TaskScope::TaskScope(RS_AsyncLoader& loader)
+    : m_loader(loader)
+{
+    m_loader.m_activeTasks.fetch_add(1, std::memory_order_relaxed);
+}
+
+RS_AsyncLoader::TaskScope::~TaskScope()
+{
+    m_loader.m_activeTasks.fetch_sub(1, std::memory_order_release);
+}
+
+void RS_AsyncLoader::collectQueued()
+{
+    MainThreadAwaiter* node = m_queueHead.exchange(nullptr, std::memory_order_acquire);
+
+    // The stack holds the newest continuation first; restore submission order. Handles are copied out
+    // before anything is resumed because resuming destroys the awaiter.
+    std::vector<std::coroutine_handle<>> newest;
+    for (; node != nullptr; node = node->next)
+        newest.push_back(node->handle);
+    m_pending.insert(m_pending.end(), newest.rbegin(), newest.rend());
+}
+
+void RS_AsyncLoader::processMainThreadQueue(std::chrono::microseconds budget)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    collectQueued();
+
+    while (!m_pending.empty()) {
+        const std::coroutine_handle<> handle = m_pending.front();
+        m_pending.pop_front();
+        handle.resume();
+
+        if (std::chrono::steady_clock::now() - startTime >= budget)
+            break;
+
+        // Pick up continuations queued by the work we just did (e.g. a task re-queueing itself)
+        if (m_pending.empty())
+            collectQueued();
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+
+class RS_AsyncLoader;
+
+// Fire-and-forget coroutine used for asset loading. It starts running on the calling thread and uses the
+// awaitables of RS_AsyncLoader to hop between worker threads (decoding, parsing) and the main thread (GL uploads).
+struct RS_LoadTask {
+    struct promise_type {
+        RS_LoadTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+    };
+};
+
+class RS_AsyncLoader {
+public:
+    RS_AsyncLoader() = default;
+    // Runs all outstanding loads to completion, so no coroutine outlives the loader (requires the GL context)
+    ~RS_AsyncLoader();
+
+    RS_AsyncLoader(const RS_AsyncLoader&) = delete;
+    RS_AsyncLoader& operator=(const RS_AsyncLoader&) = delete;
+
+    // co_await to continue on one of the shared pool's worker threads
+    struct WorkerAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const;
+        void await_resume() const noexcept {}
+    };
+    WorkerAwaiter resumeOnWorker() const { return {}; }
+
+    // co_await to continue on the main thread, during a later call to processMainThreadQueue. The awaiter
+    // lives in the suspended coroutine frame and doubles as the node of the lock-free queue.
+    struct MainThreadAwaiter {
+        RS_AsyncLoader& loader;
+        std::coroutine_handle<> handle {};
+        MainThreadAwaiter* next { nullptr };
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> coroutine) noexcept;
+        void await_resume() const noexcept {}
+    };
+    MainThreadAwaiter resumeOnMainThread() { return MainThreadAwaiter { *this }; }
+
+    // Keeps the loader's in-flight count up to date for the lifetime of a load coroutine
+    class TaskScope {
+    public:
+        explicit TaskScope(RS_AsyncLoader& loader);
+        ~TaskScope();
+        TaskScope(const TaskScope&) = delete;
+        TaskScope& operator=(const TaskScope&) = delete;
+
+    private:
+        RS_AsyncLoader& m_loader;
+    };
+    TaskScope trackTask() { return TaskScope(*this); }
+
+    // Called once per frame by the render loop: resumes queued main-thread continuations in FIFO order until
+    // the time budget is used up. At least one continuation runs per call, so progress is guaranteed.
+    void processMainThreadQueue(std::chrono::microseconds budget);
+
+    bool isLoading() const { return m_activeTasks.load(std::memory_order_acquire) > 0; }
+
+private:
+    void collectQueued();
+
+    // Multi-producer (workers) single-consumer (main thread) intrusive stack
+    std::atomic<MainThreadAwaiter*> m_queueHead { nullptr };
+    // Consumer-only FIFO of continuations that did not fit in the previous frame's budget
+    std::deque<std::coroutine_handle<>> m_pending;
+    std::atomic<int> m_activeTasks { 0 };
+};
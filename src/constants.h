@@ -5,9 +5,27 @@
 #ifndef COMPUTERGRAPHICS_CONSTANTS_H
 #define COMPUTERGRAPHICS_CONSTANTS_H
 #include "glm/vec2.hpp"
+#include "image_resample.h"
+#include <chrono>
+#include <cstddef>
 
 constexpr glm::ivec2 RS_WINDOW_SIZE = {1024, 1024};
 constexpr char RS_WINDOW_TITLE[] = "Tech Demo - Simon & Rafayel";
+// Main-thread time per frame spent on finishing asynchronous loads (GPU uploads)
+constexpr std::chrono::milliseconds RS_UPLOAD_BUDGET_PER_FRAME { 4 };
+// Block-compress material textures on import (cached next to the sources) when the GPU supports it
+constexpr bool RS_COMPRESS_MATERIAL_TEXTURES { true };
+// Pack metallic and roughness maps into one occlusion/roughness/metallic texture on import (cached next to the sources)
+constexpr bool RS_PACK_ORM_TEXTURES { true };
+// Deployment quality tier; caps the resolution of imported material textures (scaled down once and cached)
+constexpr RS_TextureQuality RS_TEXTURE_QUALITY { RS_TextureQuality::High };
+// Video memory the material textures of one model may occupy; their resolution is lowered until they fit (0 = no budget)
+constexpr size_t RS_TEXTURE_IMPORT_BUDGET { 0 };
+// Upload only the coarse mips of compressed material textures and stream in the finer ones as they are needed on screen
+constexpr bool RS_STREAM_MATERIAL_TEXTURES { true };
+// Texture mip data uploaded per frame, and the video memory that streamed textures may occupy together
+constexpr size_t RS_TEXTURE_UPLOAD_BYTES_PER_FRAME { 8u << 20 };
+constexpr size_t RS_TEXTURE_MEMORY_BUDGET { 256u << 20 };
 
 
 #endif //COMPUTERGRAPHICS_CONSTANTS_H
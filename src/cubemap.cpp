@@ -8,9 +8,105 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/gtc/type_ptr.hpp>
 DISABLE_WARNINGS_POP()
 #include <framework/shader.h>
+#include <algorithm>
 #include <iostream>
 #include "constants.h"
 
+namespace {
+
+// Shader and geometry used to render an equirectangular map into the cubemap faces. Built on first use and
+// reused by every later conversion; intentionally never freed because the GL context is already gone by
+// the time static destructors would run.
+struct ConversionResources {
+    Shader shader;
+    GLuint cubeVAO { 0 };
+    GLuint cubeVBO { 0 };
+    GLuint captureFBO { 0 };
+    GLuint captureRBO { 0 };
+    int captureResolution { 0 };
+};
+
+ConversionResources& getConversionResources()
+{
+    static ConversionResources* resources = []() {
+        auto* result = new ConversionResources();
+
+        ShaderBuilder builder;
+        builder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/equirect_to_cube_vert.glsl");
+        builder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/equirect_to_cube_frag.glsl");
+        result->shader = builder.build();
+
+        // Create a simple cube mesh for rendering
+        const float cubeVertices[] = {
+            // positions
+            -1.0f,  1.0f, -1.0f,
+            -1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,
+             1.0f,  1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,
+
+            -1.0f, -1.0f,  1.0f,
+            -1.0f, -1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,
+            -1.0f,  1.0f, -1.0f,
+            -1.0f,  1.0f,  1.0f,
+            -1.0f, -1.0f,  1.0f,
+
+             1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,
+
+            -1.0f, -1.0f,  1.0f,
+            -1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,
+             1.0f, -1.0f,  1.0f,
+            -1.0f, -1.0f,  1.0f,
+
+            -1.0f,  1.0f, -1.0f,
+             1.0f,  1.0f, -1.0f,
+             1.0f,  1.0f,  1.0f,
+             1.0f,  1.0f,  1.0f,
+            -1.0f,  1.0f,  1.0f,
+            -1.0f,  1.0f, -1.0f,
+
+            -1.0f, -1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,
+             1.0f, -1.0f, -1.0f,
+             1.0f, -1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,
+             1.0f, -1.0f,  1.0f
+        };
+
+        glGenVertexArrays(1, &result->cubeVAO);
+        glGenBuffers(1, &result->cubeVBO);
+        glBindVertexArray(result->cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, result->cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+
+        // Create framebuffer and renderbuffer for rendering to cubemap
+        glGenFramebuffers(1, &result->captureFBO);
+        glGenRenderbuffers(1, &result->captureRBO);
+        return result;
+    }();
+    return *resources;
+}
+
+size_t mipLevelTexelCount(int resolution, int mip)
+{
+    const size_t mipResolution = static_cast<size_t>(std::max(1, resolution >> mip));
+    return mipResolution * mipResolution;
+}
+
+} // namespace
+
 RS_Cubemap::RS_Cubemap(const RS_Texture& equirectTexture, int resolution)
     : m_resolution(resolution)
 {
@@ -18,9 +114,9 @@ RS_Cubemap::RS_Cubemap(const RS_Texture& equirectTexture, int resolution)
     glGenTextures(1, &m_cubemap);
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap);
 
-    // Allocate storage for all 6 faces
+    // Allocate storage for all 6 faces; R11F_G11F_B10F is the smallest color-renderable HDR format
     for (unsigned int i = 0; i < 6; i++) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F,
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R11F_G11F_B10F,
                      m_resolution, m_resolution, 0, GL_RGB, GL_FLOAT, nullptr);
     }
 
@@ -37,6 +133,54 @@ RS_Cubemap::RS_Cubemap(const RS_Texture& equirectTexture, int resolution)
     std::cout << "Created cubemap with resolution: " << m_resolution << "x" << m_resolution << std::endl;
 }
 
+RS_Cubemap::RS_Cubemap(int resolution, int mipCount, const uint32_t* sharedExponentFaces)
+    : m_resolution(resolution)
+    , m_mipCount(mipCount)
+{
+    glGenTextures(1, &m_cubemap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap);
+
+    // RGB9_E5 keeps more mantissa bits than the R11F_G11F_B10F the faces were rendered to, so the bake is lossless
+    const uint32_t* faceData = sharedExponentFaces;
+    for (int mip = 0; mip < m_mipCount; ++mip) {
+        const int mipResolution = std::max(1, m_resolution >> mip);
+        for (unsigned int i = 0; i < 6; i++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB9_E5,
+                         mipResolution, mipResolution, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, faceData);
+            faceData += mipLevelTexelCount(m_resolution, mip);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, m_mipCount - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, m_mipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    std::cout << "Loaded baked cubemap with resolution: " << m_resolution << "x" << m_resolution
+              << " (" << m_mipCount << " mips)" << std::endl;
+}
+
+std::vector<uint32_t> RS_Cubemap::readSharedExponentFaces() const
+{
+    size_t texelCount = 0;
+    for (int mip = 0; mip < m_mipCount; ++mip)
+        texelCount += 6 * mipLevelTexelCount(m_resolution, mip);
+    std::vector<uint32_t> faces(texelCount);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap);
+
+    uint32_t* faceData = faces.data();
+    for (int mip = 0; mip < m_mipCount; ++mip) {
+        for (unsigned int i = 0; i < 6; i++) {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, faceData);
+            faceData += mipLevelTexelCount(m_resolution, mip);
+        }
+    }
+    return faces;
+}
+
 // Private constructor for creating empty cubemaps
 RS_Cubemap::RS_Cubemap(int resolution, bool isDepth)
     : m_resolution(resolution)
@@ -71,10 +215,7 @@ void RS_Cubemap::convertEquirectToCubemap(const RS_Texture& equirectTexture)
     GLint viewport[4];
     glGetIntegerv(GL_VIEWPORT, viewport);
 
-    ShaderBuilder builder;
-    builder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/equirect_to_cube_vert.glsl");
-    builder.addStage(GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/equirect_to_cube_frag.glsl");
-    Shader conversionShader = builder.build();
+    ConversionResources& resources = getConversionResources();
 
     glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
 
@@ -88,76 +229,19 @@ void RS_Cubemap::convertEquirectToCubemap(const RS_Texture& equirectTexture)
         glm::lookAt(glm::vec3(0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))  // -Z
     };
 
-    // Create framebuffer and renderbuffer for rendering to cubemap
-    GLuint captureFBO, captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_resolution, m_resolution);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-    // Create a simple cube mesh for rendering
-    float cubeVertices[] = {
-        // positions
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f
-    };
-
-    GLuint cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindFramebuffer(GL_FRAMEBUFFER, resources.captureFBO);
+    if (resources.captureResolution != m_resolution) {
+        // Only reallocate the depth buffer when the cubemap resolution changes
+        glBindRenderbuffer(GL_RENDERBUFFER, resources.captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_resolution, m_resolution);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, resources.captureRBO);
+        resources.captureResolution = m_resolution;
+    }
 
     // Bind shader and set uniforms
-    conversionShader.bind();
-    glUniform1i(conversionShader.getUniformLocation("equirectangularMap"), 0);
-    glUniformMatrix4fv(conversionShader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
+    resources.shader.bind();
+    glUniform1i(resources.shader.getUniformLocation("equirectangularMap"), 0);
+    glUniformMatrix4fv(resources.shader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
 
     // Bind the equirectangular texture
     glActiveTexture(GL_TEXTURE0);
@@ -165,23 +249,19 @@ void RS_Cubemap::convertEquirectToCubemap(const RS_Texture& equirectTexture)
 
     // Render to each face of the cubemap
     glViewport(0, 0, m_resolution, m_resolution);
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindVertexArray(resources.cubeVAO);
 
     for (unsigned int i = 0; i < 6; i++) {
-        glUniformMatrix4fv(conversionShader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
+        glUniformMatrix4fv(resources.shader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_cubemap, 0);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindVertexArray(cubeVAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
 
     // Cleanup
+    glBindVertexArray(0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &captureFBO);
-    glDeleteRenderbuffers(1, &captureRBO);
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteBuffers(1, &cubeVBO);
 
     // Restore original viewport
     glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
@@ -190,6 +270,7 @@ void RS_Cubemap::convertEquirectToCubemap(const RS_Texture& equirectTexture)
 RS_Cubemap::RS_Cubemap(RS_Cubemap&& other)
     : m_cubemap(other.m_cubemap)
     , m_resolution(other.m_resolution)
+    , m_mipCount(other.m_mipCount)
 {
     other.m_cubemap = INVALID;
 }
@@ -203,6 +284,7 @@ RS_Cubemap& RS_Cubemap::operator=(RS_Cubemap&& other)
 
         m_cubemap = other.m_cubemap;
         m_resolution = other.m_resolution;
+        m_mipCount = other.m_mipCount;
 
         other.m_cubemap = INVALID;
     }
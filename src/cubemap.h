@@ -3,10 +3,12 @@
 DISABLE_WARNINGS_PUSH()
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
+#include <cstdint>
 #include <exception>
 #include <filesystem>
 #include <framework/opengl_includes.h>
 #include <memory>
+#include <vector>
 
 // Forward declaration
 class RS_Texture;
@@ -14,8 +16,10 @@ class Shader;
 
 class RS_Cubemap {
 public:
-    // Create a cubemap from an equirectangular HDR texture
+    // Create a cubemap from an equirectangular HDR texture, rendered into GL_R11F_G11F_B10F faces
     RS_Cubemap(const RS_Texture& equirectTexture, int resolution = 512);
+    // Create a GL_RGB9_E5 cubemap from previously baked shared-exponent faces (mip-major, +X, -X, +Y, -Y, +Z, -Z)
+    RS_Cubemap(int resolution, int mipCount, const uint32_t* sharedExponentFaces);
     // Create empty depth cubemap for shadow mapping
     static RS_Cubemap createDepthCubemap(int resolution);
 
@@ -28,7 +32,11 @@ public:
 
     void bind(GLint textureSlot) const;
 
+    // Read all faces and mips back as shared-exponent texels, in the layout accepted by the constructor above
+    std::vector<uint32_t> readSharedExponentFaces() const;
+
     int getResolution() const { return m_resolution; }
+    int getMipCount() const { return m_mipCount; }
     GLuint getCubemapID() const { return m_cubemap; }
 
 private:
@@ -38,6 +46,7 @@ private:
     static constexpr GLuint INVALID = 0xFFFFFFFF;
     GLuint m_cubemap { INVALID };
     int m_resolution { 512 };
+    int m_mipCount { 1 };
 
     void convertEquirectToCubemap(const RS_Texture& equirectTexture);
 };
@@ -0,0 +1,114 @@
+#include "environment_cache.h"
+#include "asset_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+constexpr std::array<char, 4> ENVIRONMENT_CACHE_MAGIC { 'R', 'S', 'E', 'C' };
+constexpr uint32_t ENVIRONMENT_CACHE_VERSION = 2;
+
+// Largest face resolution accepted from an entry; anything larger is corrupt or from another program
+constexpr uint32_t MAX_ENVIRONMENT_RESOLUTION = 16384;
+
+// Fixed-size file header, followed by dataSize bytes of RGB9_E5 face data
+struct EnvironmentCacheHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t resolution;
+    uint32_t mipCount;
+    uint32_t hasDiffuseSH;
+    float diffuseSH[27];
+    uint64_t dataSize;
+};
+
+// Levels of a full mip chain down to 1x1: floor(log2(resolution)) + 1
+uint32_t getFullMipCount(uint32_t resolution)
+{
+    uint32_t mipCount = 1;
+    while (resolution >>= 1)
+        ++mipCount;
+    return mipCount;
+}
+
+size_t expectedFaceDataSize(int resolution, int mipCount)
+{
+    size_t texels = 0;
+    for (int mip = 0; mip < mipCount; ++mip) {
+        const size_t mipResolution = static_cast<size_t>(std::max(1, resolution >> mip));
+        texels += 6 * mipResolution * mipResolution;
+    }
+    return texels;
+}
+
+} // namespace
+
+std::filesystem::path getEnvironmentCachePath(const std::filesystem::path& sourceFile, uint64_t contentHash, int resolution)
+{
+    return getCacheEntryPath(sourceFile, contentHash, "_" + std::to_string(resolution) + ".rsenv");
+}
+
+std::optional<RS_EnvironmentBake> readEnvironmentCache(const std::filesystem::path& cacheFile)
+{
+    std::ifstream file(cacheFile, std::ios::binary);
+    if (!file)
+        return std::nullopt;
+
+    EnvironmentCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != ENVIRONMENT_CACHE_MAGIC
+        || header.version != ENVIRONMENT_CACHE_VERSION
+        || header.resolution == 0 || header.resolution > MAX_ENVIRONMENT_RESOLUTION
+        || header.mipCount == 0 || header.mipCount > getFullMipCount(header.resolution)) {
+        std::cerr << "Ignoring invalid environment cache entry " << cacheFile << std::endl;
+        return std::nullopt;
+    }
+
+    RS_EnvironmentBake bake;
+    bake.resolution = static_cast<int>(header.resolution);
+    bake.mipCount = static_cast<int>(header.mipCount);
+    bake.hasDiffuseSH = header.hasDiffuseSH != 0;
+    std::memcpy(bake.diffuseSH.coefficients.data(), header.diffuseSH, sizeof(header.diffuseSH));
+
+    const size_t texelCount = expectedFaceDataSize(bake.resolution, bake.mipCount);
+    if (header.dataSize != texelCount * sizeof(uint32_t)) {
+        std::cerr << "Ignoring truncated environment cache entry " << cacheFile << std::endl;
+        return std::nullopt;
+    }
+
+    bake.faceData.resize(texelCount);
+    if (!file.read(reinterpret_cast<char*>(bake.faceData.data()), static_cast<std::streamsize>(header.dataSize))) {
+        std::cerr << "Ignoring truncated environment cache entry " << cacheFile << std::endl;
+        return std::nullopt;
+    }
+
+    return bake;
+}
+
+bool writeEnvironmentCache(const std::filesystem::path& cacheFile, const RS_EnvironmentBake& bake)
+{
+    static_assert(sizeof(RS_SHCoefficients::coefficients) == sizeof(EnvironmentCacheHeader::diffuseSH));
+
+    if (bake.faceData.size() != expectedFaceDataSize(bake.resolution, bake.mipCount))
+        return false;
+
+    EnvironmentCacheHeader header {};
+    header.magic = ENVIRONMENT_CACHE_MAGIC;
+    header.version = ENVIRONMENT_CACHE_VERSION;
+    header.resolution = static_cast<uint32_t>(bake.resolution);
+    header.mipCount = static_cast<uint32_t>(bake.mipCount);
+    header.hasDiffuseSH = bake.hasDiffuseSH ? 1 : 0;
+    std::memcpy(header.diffuseSH, bake.diffuseSH.coefficients.data(), sizeof(header.diffuseSH));
+    header.dataSize = bake.faceData.size() * sizeof(uint32_t);
+
+    const std::array<std::span<const std::byte>, 2> chunks {
+        std::as_bytes(std::span(&header, 1)),
+        std::as_bytes(std::span(bake.faceData))
+    };
+    return writeFileAtomically(cacheFile, chunks);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "spherical_harmonics.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// CPU-side copy of a baked environment map: the cubemap faces of every mip level as shared-exponent RGB9_E5 texels
+// (mip-major, faces ordered +X, -X, +Y, -Y, +Z, -Z) and the diffuse SH coefficients of the source.
+struct RS_EnvironmentBake {
+    int resolution { 0 };
+    int mipCount { 0 };
+    std::vector<uint32_t> faceData;
+
+    bool hasDiffuseSH { false };
+    RS_SHCoefficients diffuseSH {};
+};
+
+// Cache entry for an environment map with the given content hash, baked at the given cubemap resolution
+std::filesystem::path getEnvironmentCachePath(const std::filesystem::path& sourceFile, uint64_t contentHash, int resolution);
+
+// Load a baked environment; returns an empty optional if the entry is missing, outdated or corrupt
+std::optional<RS_EnvironmentBake> readEnvironmentCache(const std::filesystem::path& cacheFile);
+bool writeEnvironmentCache(const std::filesystem::path& cacheFile, const RS_EnvironmentBake& bake);
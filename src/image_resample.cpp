@@ -0,0 +1,325 @@
+#include "image_resample.h"
+#include "thread_pool.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/packing.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_IMAGE_RESAMPLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr float KAISER_WIDTH = 3.0f;
+constexpr float KAISER_ALPHA = 4.0f;
+// Budget fitting stops halving here; smaller textures save next to nothing
+constexpr int MIN_FITTED_SIZE_LIMIT = 64;
+
+float sinc(float x)
+{
+    if (std::abs(x) < 1e-6f)
+        return 1.0f;
+    x *= std::numbers::pi_v<float>;
+    return std::sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0 (power series)
+float besselI0(float x)
+{
+    const float quarterSquare = 0.25f * x * x;
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32 && term > 1e-8f * sum; ++k) {
+        term *= quarterSquare / float(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// Filter in units of destination texels
+struct FilterKernel {
+    float support; // Half width
+    float (*evaluate)(float);
+};
+
+FilterKernel getFilterKernel(RS_ResampleFilter filter)
+{
+    switch (filter) {
+    case RS_ResampleFilter::Box:
+        return { 0.5f, [](float x) { return x >= -0.5f && x < 0.5f ? 1.0f : 0.0f; } };
+    case RS_ResampleFilter::Kaiser:
+        return { KAISER_WIDTH, [](float x) {
+                    const float t = x / KAISER_WIDTH;
+                    if (std::abs(t) >= 1.0f)
+                        return 0.0f;
+                    return sinc(x) * besselI0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / besselI0(KAISER_ALPHA);
+                } };
+    case RS_ResampleFilter::Lanczos3:
+        return { 3.0f, [](float x) { return std::abs(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f; } };
+    }
+    return { 0.5f, nullptr };
+}
+
+// Source texels and normalized weights of every destination texel along one axis. Every destination texel has the
+// same number of taps; indices are clamped to the edge, so the inner loops need no bounds checks.
+struct Contributions {
+    int taps;
+    std::vector<int> indices;
+    std::vector<float> weights;
+};
+
+Contributions computeContributions(int sourceSize, int destinationSize, const FilterKernel& kernel)
+{
+    const float scale = float(sourceSize) / float(destinationSize);
+    // Widen the filter when shrinking so it covers every source texel; when enlarging it interpolates
+    const float filterScale = std::max(scale, 1.0f);
+    const float support = kernel.support * filterScale;
+
+    Contributions contributions;
+    contributions.taps = static_cast<int>(std::ceil(2.0f * support)) + 1;
+    contributions.indices.resize(size_t(destinationSize) * size_t(contributions.taps));
+    contributions.weights.resize(size_t(destinationSize) * size_t(contributions.taps));
+    for (int i = 0; i < destinationSize; ++i) {
+        const float center = (float(i) + 0.5f) * scale;
+        const int first = static_cast<int>(std::floor(center - support));
+        int* indices = &contributions.indices[size_t(i) * size_t(contributions.taps)];
+        float* weights = &contributions.weights[size_t(i) * size_t(contributions.taps)];
+
+        float weightSum = 0.0f;
+        for (int tap = 0; tap < contributions.taps; ++tap) {
+            const int source = first + tap;
+            indices[tap] = std::clamp(source, 0, sourceSize - 1);
+            weights[tap] = kernel.evaluate((float(source) + 0.5f - center) / filterScale);
+            weightSum += weights[tap];
+        }
+
+        if (weightSum > 0.0f) {
+            for (int tap = 0; tap < contributions.taps; ++tap)
+                weights[tap] /= weightSum;
+        } else {
+            // Can only happen for a degenerate kernel; fall back to the nearest texel
+            std::fill(weights, weights + contributions.taps, 0.0f);
+            indices[0] = std::clamp(static_cast<int>(center), 0, sourceSize - 1);
+            weights[0] = 1.0f;
+        }
+    }
+    return contributions;
+}
+
+// Rows are processed as RGBA floats whatever the source layout; missing channels are zero
+void loadRow(const ImageView& source, int y, float* rgba)
+{
+    const std::byte* row = source.getRow(y);
+    for (int x = 0; x < source.width; ++x, rgba += 4) {
+        for (int channel = 0; channel < 4; ++channel) {
+            if (channel >= source.channels) {
+                rgba[channel] = 0.0f;
+                continue;
+            }
+            const size_t index = size_t(x) * size_t(source.channels) + size_t(channel);
+            switch (source.format) {
+            case ImageFormat::UInt8:
+                rgba[channel] = static_cast<uint8_t>(row[index]) / 255.0f;
+                break;
+            case ImageFormat::UInt16: {
+                uint16_t value;
+                std::memcpy(&value, row + index * sizeof(value), sizeof(value));
+                rgba[channel] = value / 65535.0f;
+                break;
+            }
+            case ImageFormat::Float16: {
+                uint16_t value;
+                std::memcpy(&value, row + index * sizeof(value), sizeof(value));
+                rgba[channel] = glm::unpackHalf1x16(value);
+                break;
+            }
+            case ImageFormat::Float32:
+                std::memcpy(&rgba[channel], row + index * sizeof(float), sizeof(float));
+                break;
+            }
+        }
+    }
+}
+
+void storeRow(const float* rgba, int width, int channels, ImageFormat format, bool isNormalMap, std::byte* row)
+{
+    for (int x = 0; x < width; ++x, rgba += 4) {
+        float pixel[4] { rgba[0], rgba[1], rgba[2], rgba[3] };
+        if (isNormalMap && channels >= 3) {
+            // Averaging shortens the vectors; the shaders expect unit normals
+            const float nx = 2.0f * pixel[0] - 1.0f, ny = 2.0f * pixel[1] - 1.0f, nz = 2.0f * pixel[2] - 1.0f;
+            const float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+            if (length > 1e-6f) {
+                pixel[0] = 0.5f * nx / length + 0.5f;
+                pixel[1] = 0.5f * ny / length + 0.5f;
+                pixel[2] = 0.5f * nz / length + 0.5f;
+            }
+        }
+
+        for (int channel = 0; channel < channels; ++channel) {
+            const size_t index = size_t(x) * size_t(channels) + size_t(channel);
+            switch (format) {
+            case ImageFormat::UInt8:
+                row[index] = static_cast<std::byte>(std::clamp(pixel[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+                break;
+            case ImageFormat::UInt16: {
+                const uint16_t value = static_cast<uint16_t>(std::clamp(pixel[channel], 0.0f, 1.0f) * 65535.0f + 0.5f);
+                std::memcpy(row + index * sizeof(value), &value, sizeof(value));
+                break;
+            }
+            case ImageFormat::Float16: {
+                const uint16_t value = glm::packHalf1x16(std::max(pixel[channel], 0.0f));
+                std::memcpy(row + index * sizeof(value), &value, sizeof(value));
+                break;
+            }
+            case ImageFormat::Float32: {
+                // Negative lobes must not produce negative radiance
+                const float value = std::max(pixel[channel], 0.0f);
+                std::memcpy(row + index * sizeof(value), &value, sizeof(value));
+                break;
+            }
+            }
+        }
+    }
+}
+
+// output[i] = sum over taps of weight * input pixel, one RGBA pixel per SIMD register
+void filterRow(const float* input, const Contributions& contributions, int width, float* output)
+{
+    for (int x = 0; x < width; ++x) {
+        const int* indices = &contributions.indices[size_t(x) * size_t(contributions.taps)];
+        const float* weights = &contributions.weights[size_t(x) * size_t(contributions.taps)];
+#ifdef RS_IMAGE_RESAMPLE_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int tap = 0; tap < contributions.taps; ++tap)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(input + 4 * indices[tap])));
+        _mm_storeu_ps(output + 4 * x, sum);
+#else
+        float sum[4] {};
+        for (int tap = 0; tap < contributions.taps; ++tap) {
+            for (int channel = 0; channel < 4; ++channel)
+                sum[channel] += weights[tap] * input[4 * indices[tap] + channel];
+        }
+        std::copy(sum, sum + 4, output + 4 * x);
+#endif
+    }
+}
+
+// output += weight * input over a whole row of floats (a multiple of four)
+void accumulateRow(const float* input, float weight, size_t count, float* output)
+{
+#ifdef RS_IMAGE_RESAMPLE_SSE2
+    const __m128 scale = _mm_set1_ps(weight);
+    for (size_t i = 0; i < count; i += 4)
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(scale, _mm_loadu_ps(input + i))));
+#else
+    for (size_t i = 0; i < count; ++i)
+        output[i] += weight * input[i];
+#endif
+}
+
+} // namespace
+
+int getTextureSizeLimit(RS_TextureQuality quality)
+{
+    switch (quality) {
+    case RS_TextureQuality::Low:
+        return 512;
+    case RS_TextureQuality::Medium:
+        return 1024;
+    case RS_TextureQuality::High:
+        return 2048;
+    case RS_TextureQuality::Full:
+        return 0;
+    }
+    return 0;
+}
+
+int fitTextureSizeLimit(std::span<const RS_TextureSizeEstimate> textures, size_t memoryBudget, int sizeLimit)
+{
+    const auto getTotalBytes = [&](int limit) {
+        double totalBytes = 0.0;
+        for (const RS_TextureSizeEstimate& texture : textures) {
+            const glm::ivec2 size = getDownscaledSize(texture.width, texture.height, limit);
+            // The mip chain adds a third
+            totalBytes += double(size.x) * double(size.y) * double(texture.bytesPerTexel) * 4.0 / 3.0;
+        }
+        return totalBytes;
+    };
+    if (getTotalBytes(sizeLimit) <= double(memoryBudget))
+        return sizeLimit;
+
+    // Halve from the largest power of two below the current limit
+    int largestSize = 1;
+    for (const RS_TextureSizeEstimate& texture : textures)
+        largestSize = std::max({ largestSize, texture.width, texture.height });
+    const int startLimit = sizeLimit > 0 ? std::min(sizeLimit, largestSize) : largestSize;
+    int limit = 1;
+    while (limit * 2 < startLimit)
+        limit *= 2;
+
+    while (limit > MIN_FITTED_SIZE_LIMIT && getTotalBytes(limit) > double(memoryBudget))
+        limit /= 2;
+    return limit;
+}
+
+glm::ivec2 getDownscaledSize(int width, int height, int sizeLimit)
+{
+    const int largestSide = std::max(width, height);
+    if (sizeLimit <= 0 || largestSide <= sizeLimit)
+        return { width, height };
+
+    const double scale = double(sizeLimit) / largestSide;
+    return { std::max(1, static_cast<int>(std::lround(width * scale))), std::max(1, static_cast<int>(std::lround(height * scale))) };
+}
+
+Image resampleImage(const ImageView& source, int width, int height, RS_ResampleFilter filter, bool isNormalMap)
+{
+    const FilterKernel kernel = getFilterKernel(filter);
+    const Contributions horizontal = computeContributions(source.width, width, kernel);
+    const Contributions vertical = computeContributions(source.height, height, kernel);
+
+    // Every destination row needs the horizontally filtered source rows under its vertical taps. Those lie within
+    // vertical.taps consecutive source rows, so each range keeps a ring of that many filtered rows, with source row r
+    // in slot r % taps, and fills a slot when a row enters the window. Consecutive destination rows share most of
+    // their source rows; only the few at the edges of a range are filtered twice.
+    const size_t intermediateStride = size_t(width) * 4;
+    const size_t ringSize = size_t(vertical.taps);
+    Image result(width, height, source.channels, source.format);
+    const size_t resultStride = size_t(width) * source.getPixelSize();
+    RS_ThreadPool::instance().parallelFor(0, height, [&](int begin, int end, int) {
+        std::vector<float> sourceRow(size_t(source.width) * 4);
+        std::vector<float> ring(intermediateStride * ringSize);
+        std::vector<int> ringRows(ringSize, -1);
+        std::vector<float> row(intermediateStride);
+        for (int y = begin; y < end; ++y) {
+            std::fill(std::begin(row), std::end(row), 0.0f);
+            // Whole filtered rows are weighted and summed, so the SIMD lanes run along the row
+            for (int tap = 0; tap < vertical.taps; ++tap) {
+                const size_t index = size_t(y) * ringSize + size_t(tap);
+                if (vertical.weights[index] == 0.0f)
+                    continue;
+                const int sourceY = vertical.indices[index];
+                const size_t slot = size_t(sourceY) % ringSize;
+                float* filtered = &ring[slot * intermediateStride];
+                if (ringRows[slot] != sourceY) {
+                    loadRow(source, sourceY, sourceRow.data());
+                    filterRow(sourceRow.data(), horizontal, width, filtered);
+                    ringRows[slot] = sourceY;
+                }
+                accumulateRow(filtered, vertical.weights[index], intermediateStride, row.data());
+            }
+            storeRow(row.data(), width, source.channels, source.format, isNormalMap, result.data() + size_t(y) * resultStride);
+        }
+    });
+    return result;
+}
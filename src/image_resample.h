@@ -0,0 +1,40 @@
+#pragma once
+#include <framework/image.h>
+
+#include <cstddef>
+#include <span>
+
+enum class RS_ResampleFilter {
+    Box, // Average of the covered texels; never overshoots, so suited to data maps
+    Kaiser, // Kaiser-windowed sinc: sharp with little ringing
+    Lanczos3 // Sharpest; may ring slightly around hard edges
+};
+
+// Deployment quality tiers; each caps the resolution of imported textures
+enum class RS_TextureQuality {
+    Low, // 512
+    Medium, // 1024
+    High, // 2048
+    Full // Unlimited
+};
+
+// Largest width or height that textures are imported at, or 0 if unlimited
+int getTextureSizeLimit(RS_TextureQuality quality);
+
+// Size of a texture that is about to be imported, used to pick a size limit that fits a memory budget
+struct RS_TextureSizeEstimate {
+    int width;
+    int height;
+    float bytesPerTexel; // As stored on the GPU
+};
+
+// Size limit at which the textures, including their mips, fit in the memory budget: the given limit if they already
+// fit, otherwise a power of two found by halving
+int fitTextureSizeLimit(std::span<const RS_TextureSizeEstimate> textures, size_t memoryBudget, int sizeLimit);
+
+// Size of an image scaled down, keeping its aspect ratio, so that neither side exceeds the limit (0 = unlimited)
+glm::ivec2 getDownscaledSize(int width, int height, int sizeLimit);
+
+// Resample to the given size with a separable filter; the result has the format and channels of the source. Runs
+// on the thread pool. Normal maps (tangent-space vectors in the first three channels) are renormalized afterwards.
+Image resampleImage(const ImageView& source, int width, int height, RS_ResampleFilter filter, bool isNormalMap = false);
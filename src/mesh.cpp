@@ -1,16 +1,23 @@
 #include "mesh.h"
+#include "mesh_cache.h"
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <fmt/format.h>
+#include <glm/geometric.hpp>
 DISABLE_WARNINGS_POP()
 #include <iostream>
 #include <vector>
 
 GPUMesh::GPUMesh(const Mesh& cpuMesh)
-    : m_material(cpuMesh.material)
+    : GPUMesh(cpuMesh.vertices, cpuMesh.triangles, cpuMesh.material)
+{
+}
+
+GPUMesh::GPUMesh(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const Material& material)
+    : m_material(material)
 {
     // Figure out if this mesh has texture coordinates
-    m_hasTextureCoords = static_cast<bool>(cpuMesh.material.kdTexture);
+    m_hasTextureCoords = static_cast<bool>(material.kdTexture);
 
     // Create VAO and bind it so subsequent creations of VBO and IBO are bound to this VAO
     glGenVertexArrays(1, &m_vao);
@@ -19,12 +26,12 @@ GPUMesh::GPUMesh(const Mesh& cpuMesh)
     // Create vertex buffer object (VBO)
     glGenBuffers(1, &m_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(cpuMesh.vertices.size() * sizeof(decltype(cpuMesh.vertices)::value_type)), cpuMesh.vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data(), GL_STATIC_DRAW);
 
     // Create index buffer object (IBO)
     glGenBuffers(1, &m_ibo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(cpuMesh.triangles.size() * sizeof(decltype(cpuMesh.triangles)::value_type)), cpuMesh.triangles.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(triangles.size_bytes()), triangles.data(), GL_STATIC_DRAW);
 
     // Tell OpenGL that we will be using vertex attributes 0, 1 and 2.
     glEnableVertexAttribArray(0);
@@ -40,7 +47,7 @@ GPUMesh::GPUMesh(const Mesh& cpuMesh)
     glVertexAttribDivisor(2, 0);
 
     // Each triangle has 3 vertices.
-    m_numIndices = static_cast<GLsizei>(3 * cpuMesh.triangles.size());
+    m_numIndices = static_cast<GLsizei>(3 * triangles.size());
 }
 
 GPUMesh::GPUMesh(GPUMesh&& other)
@@ -64,13 +71,38 @@ std::vector<GPUMesh> GPUMesh::loadMeshGPU(std::filesystem::path filePath, bool n
         throw MeshLoadingException(fmt::format("File {} does not exist", filePath.string().c_str()));
 
     // Generate GPU-side meshes for all sub-meshes
-    std::vector<Mesh> subMeshes = loadMesh(filePath, { .normalizeVertexPositions = normalize });
+    const RS_MeshData meshData = RS_MeshData::load(filePath, normalize);
     std::vector<GPUMesh> gpuMeshes;
-    for (const Mesh& mesh : subMeshes) { gpuMeshes.emplace_back(mesh);}
-    
+    for (const RS_MeshData::SubMesh& subMesh : meshData.getSubMeshes()) { gpuMeshes.emplace_back(subMesh.vertices, subMesh.triangles, subMesh.material); }
+
     return gpuMeshes;
 }
 
+GPUMesh GPUMesh::createPlaceholder()
+{
+    Mesh cube;
+    cube.material.kd = glm::vec3(0.5f);
+
+    // Four vertices per face so every face gets a flat normal
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float sign : { -1.0f, 1.0f }) {
+            glm::vec3 normal(0.0f);
+            normal[axis] = sign;
+            glm::vec3 tangent(0.0f);
+            tangent[(axis + 1) % 3] = 0.5f;
+            const glm::vec3 bitangent = glm::cross(normal, tangent);
+
+            const glm::uint first = static_cast<glm::uint>(cube.vertices.size());
+            for (const glm::vec2& corner : { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) })
+                cube.vertices.push_back({ 0.5f * normal + corner.x * tangent + corner.y * bitangent, normal, 0.5f * corner + 0.5f });
+            cube.triangles.emplace_back(first, first + 1, first + 2);
+            cube.triangles.emplace_back(first, first + 2, first + 3);
+        }
+    }
+
+    return GPUMesh(cube);
+}
+
 bool GPUMesh::hasTextureCoords() const
 {
     return m_hasTextureCoords;
@@ -9,6 +9,7 @@ DISABLE_WARNINGS_POP()
 
 #include <exception>
 #include <filesystem>
+#include <span>
 #include <framework/opengl_includes.h>
 
 struct MeshLoadingException : public std::runtime_error {
@@ -19,14 +20,19 @@ struct MeshLoadingException : public std::runtime_error {
 class GPUMesh {
 public:
     GPUMesh(const Mesh& cpuMesh);
+    // Upload directly from externally owned arrays (e.g. a memory-mapped mesh cache)
+    GPUMesh(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles, const Material& material);
     // Cannot copy a GPU mesh because it would require reference counting of GPU resources.
     GPUMesh(const GPUMesh&) = delete;
     GPUMesh(GPUMesh&&);
     ~GPUMesh();
 
     // Generate a number of GPU meshes from a particular model file.
-    // Multiple meshes may be generated if there are multiple sub-meshes in the file
+    // Multiple meshes may be generated if there are multiple sub-meshes in the file.
+    // The first import writes a binary cache entry next to the file, which later loads map instead of parsing the OBJ.
     static std::vector<GPUMesh> loadMeshGPU(std::filesystem::path filePath, bool normalize = false);
+    // Grey unit cube, shown while the real model is still being loaded
+    static GPUMesh createPlaceholder();
 
     // Cannot copy a GPU mesh because it would require reference counting of GPU resources.
     GPUMesh& operator=(const GPUMesh&) = delete;
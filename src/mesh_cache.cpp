@@ -0,0 +1,601 @@
+#include "mesh_cache.h"
+#include "asset_cache.h"
+#include "image_resample.h"
+#include "orm_texture.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr std::array<char, 4> MESH_CACHE_MAGIC { 'R', 'S', 'M', 'C' };
+constexpr uint32_t MESH_CACHE_VERSION = 3;
+// Every section starts on a cache line, so the mapped arrays are suitably aligned for any vertex attribute access
+constexpr uint64_t MESH_CACHE_ALIGNMENT = 64;
+constexpr size_t TEXTURE_SLOT_COUNT = 4; // Diffuse, normal, metallic, roughness
+
+// File layout: header, sub-mesh table, vertices of all sub-meshes, triangles of all sub-meshes, texture path strings.
+// Triangle indices are relative to the first vertex of their sub-mesh.
+struct MeshCacheHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t subMeshCount;
+    uint32_t vertexSize;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t subMeshOffset;
+    uint64_t vertexOffset;
+    uint64_t triangleOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+};
+
+struct MeshCacheSubMesh {
+    uint64_t firstVertex;
+    uint64_t vertexCount;
+    uint64_t firstTriangle;
+    uint64_t triangleCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float uvDensity;
+
+    // Material record
+    float kd[3];
+    float ks[3];
+    float shininess;
+    float transparency;
+    uint32_t texturePathOffset[TEXTURE_SLOT_COUNT]; // Into the string section
+    uint32_t texturePathLength[TEXTURE_SLOT_COUNT]; // 0 if the slot has no texture
+};
+
+uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+// Whether count elements of elementSize bytes starting at offset lie within fileSize bytes; cannot overflow
+bool fitsInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+    return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+// Split an mtllib argument on spaces and tabs; a backslash escapes the next character, as in the OBJ parser
+std::vector<std::string> splitMaterialLibraries(std::string_view argument)
+{
+    std::vector<std::string> fileNames;
+    std::string fileName;
+    bool escaping = false;
+    for (const char c : argument) {
+        if (!escaping && c == '\\') {
+            escaping = true;
+            continue;
+        }
+        if (!escaping && (c == ' ' || c == '\t' || c == '\r')) {
+            if (!fileName.empty())
+                fileNames.push_back(std::move(fileName));
+            fileName.clear();
+            continue;
+        }
+        escaping = false;
+        fileName += c;
+    }
+    if (!fileName.empty())
+        fileNames.push_back(std::move(fileName));
+    return fileNames;
+}
+
+// Stamp of the OBJ file combined with the stamps of every material library it references, since the entry also
+// holds the materials. Finding the mtllib statements is one pass over the mapped file, far cheaper than parsing it.
+// A library that is missing contributes its name, so creating it later changes the stamp as well.
+std::optional<uint64_t> hashMeshStamp(const std::filesystem::path& filePath)
+{
+    std::optional<uint64_t> stamp = hashFileStamp(filePath, MESH_CACHE_VERSION);
+    if (!stamp)
+        return std::nullopt;
+
+    std::optional<MappedFile> mappedFile;
+    try {
+        mappedFile.emplace(filePath);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    const std::span<const std::byte> bytes = mappedFile->bytes();
+    const std::string_view text(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    for (size_t lineBegin = 0; lineBegin < text.size();) {
+        const size_t lineEnd = std::min(text.find('\n', lineBegin), text.size());
+        std::string_view line = text.substr(lineBegin, lineEnd - lineBegin);
+        lineBegin = lineEnd + 1;
+
+        line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+        if (line.size() <= 6 || !line.starts_with("mtllib") || (line[6] != ' ' && line[6] != '\t'))
+            continue;
+        for (const std::string& fileName : splitMaterialLibraries(line.substr(7))) {
+            const std::optional<uint64_t> libraryStamp = hashFileStamp(filePath.parent_path() / fileName, *stamp);
+            stamp = libraryStamp ? *libraryStamp : hashBytes(std::as_bytes(std::span(fileName)), *stamp);
+        }
+    }
+    return stamp;
+}
+
+std::array<std::shared_ptr<Image>*, TEXTURE_SLOT_COUNT> getTextureSlots(Material& material)
+{
+    return { &material.kdTexture, &material.norTexture, &material.metTexture, &material.roughTexture };
+}
+
+std::array<const std::shared_ptr<Image>*, TEXTURE_SLOT_COUNT> getTextureSlots(const Material& material)
+{
+    return { &material.kdTexture, &material.norTexture, &material.metTexture, &material.roughTexture };
+}
+
+constexpr std::array<RS_TextureUsage, TEXTURE_SLOT_COUNT> TEXTURE_SLOT_USAGES {
+    RS_TextureUsage::Color, RS_TextureUsage::Normal, RS_TextureUsage::Mask, RS_TextureUsage::Mask
+};
+constexpr size_t TEXTURE_USAGE_COUNT = 4;
+constexpr size_t METALLIC_SLOT = 2;
+constexpr size_t ROUGHNESS_SLOT = 3;
+
+using TexturePaths = std::array<std::string, TEXTURE_SLOT_COUNT>;
+
+// Everything the sub-meshes need from one texture file
+struct TextureSource {
+    std::shared_ptr<Image> image;
+    std::array<bool, TEXTURE_USAGE_COUNT> isUsedAs {};
+    std::array<std::shared_ptr<const RS_CompressedTexture>, TEXTURE_USAGE_COUNT> compressed;
+    bool isPackingInput { false }; // Source map of a packed texture that is not cached yet
+    bool needsPacking { false }; // Packed texture that is not cached yet; built instead of decoded
+
+    bool needsImage() const
+    {
+        if (isPackingInput)
+            return true;
+        for (size_t usage = 0; usage < TEXTURE_USAGE_COUNT; ++usage) {
+            if (isUsedAs[usage] && !compressed[usage])
+                return true;
+        }
+        return false;
+    }
+};
+
+struct PackedORMInputs {
+    std::string metallicPath;
+    std::string roughnessPath;
+};
+
+// GPU footprint of every texture file at full resolution, for fitting the textures into a memory budget
+std::vector<RS_TextureSizeEstimate> estimateTextureSizes(std::span<const TexturePaths> texturePaths, bool compressTextures)
+{
+    std::map<std::string, float> bytesPerTexel;
+    for (const TexturePaths& paths : texturePaths) {
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            if (paths[slot].empty())
+                continue;
+            const std::optional<RS_BlockFormat> format = compressTextures ? getBlockFormatForUsage(TEXTURE_SLOT_USAGES[slot]) : std::nullopt;
+            // Block formats are 4 or 8 bits per texel; uncompressed textures are assumed to be RGBA8
+            bytesPerTexel.try_emplace(paths[slot], !format ? 4.0f : format == RS_BlockFormat::BC1 || format == RS_BlockFormat::BC4 ? 0.5f : 1.0f);
+        }
+    }
+
+    std::vector<RS_TextureSizeEstimate> estimates;
+    for (const auto& [path, bytes] : bytesPerTexel) {
+        if (const std::optional<ImageInfo> info = Image::readInfo(path))
+            estimates.push_back({ info->width, info->height, bytes });
+    }
+    return estimates;
+}
+
+// Color keeps its detail best with Lanczos; normals use the softer Kaiser window to avoid ringing in the lighting,
+// and data maps are averaged so values never leave their range
+RS_ResampleFilter getDownscaleFilter(const TextureSource& source)
+{
+    if (source.isUsedAs[size_t(RS_TextureUsage::Color)])
+        return RS_ResampleFilter::Lanczos3;
+    if (source.isUsedAs[size_t(RS_TextureUsage::Normal)])
+        return RS_ResampleFilter::Kaiser;
+    return RS_ResampleFilter::Box;
+}
+
+// Fill the texture slots of the sub-meshes. Images already decoded by the OBJ loader are reused; the others are
+// decoded once per file, in parallel, unless every use of the file is covered by a cached compressed texture.
+void resolveTextures(std::vector<RS_MeshData::SubMesh>& subMeshes, std::span<const TexturePaths> texturePaths, const RS_MaterialImportSettings& settings)
+{
+    // Without BC7 a packed texture stays uncompressed while the separate maps still compress to BC4, so keep them apart
+    const bool packORM = settings.packORMTextures
+        && (!settings.compressTextures || !getBlockFormatForUsage(RS_TextureUsage::Mask) || getBlockFormatForUsage(RS_TextureUsage::Packed));
+
+    // Textures are imported at no more than the size limit; every limit has its own cache entries
+    int sizeLimit = settings.textureSizeLimit;
+    if (settings.textureMemoryBudget > 0)
+        sizeLimit = fitTextureSizeLimit(estimateTextureSizes(texturePaths, settings.compressTextures), settings.textureMemoryBudget, sizeLimit);
+    if (sizeLimit != settings.textureSizeLimit)
+        std::cout << "Importing textures at up to " << sizeLimit << " texels to fit the memory budget" << std::endl;
+
+    std::map<std::string, TextureSource> sources;
+    std::map<std::string, PackedORMInputs> packedInputs;
+    std::vector<std::string> ormPaths(subMeshes.size());
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        const TexturePaths& paths = texturePaths[i];
+        if (packORM && (!paths[METALLIC_SLOT].empty() || !paths[ROUGHNESS_SLOT].empty()))
+            ormPaths[i] = getPackedORMPath(paths[METALLIC_SLOT], paths[ROUGHNESS_SLOT], sizeLimit).string();
+
+        const auto slots = getTextureSlots(subMeshes[i].material);
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            if (paths[slot].empty())
+                continue;
+            TextureSource& source = sources[paths[slot]];
+            if (!source.image)
+                source.image = *slots[slot];
+            // Maps that end up in a packed texture are not uploaded on their own
+            if (ormPaths[i].empty() || (slot != METALLIC_SLOT && slot != ROUGHNESS_SLOT))
+                source.isUsedAs[size_t(TEXTURE_SLOT_USAGES[slot])] = true;
+        }
+
+        if (!ormPaths[i].empty()) {
+            sources[ormPaths[i]].isUsedAs[size_t(RS_TextureUsage::Packed)] = true;
+            packedInputs.try_emplace(ormPaths[i], PackedORMInputs { paths[METALLIC_SLOT], paths[ROUGHNESS_SLOT] });
+        }
+    }
+
+    size_t cacheHits = 0;
+    if (settings.compressTextures) {
+        for (auto& [path, source] : sources) {
+            for (size_t usage = 0; usage < TEXTURE_USAGE_COUNT; ++usage) {
+                const std::optional<RS_BlockFormat> format = getBlockFormatForUsage(RS_TextureUsage(usage));
+                if (!source.isUsedAs[usage] || !format)
+                    continue;
+                if (std::optional<RS_CompressedTexture> cached = RS_CompressedTexture::loadFromCache(path, RS_TextureUsage(usage), *format, sizeLimit)) {
+                    source.compressed[usage] = std::make_shared<const RS_CompressedTexture>(std::move(*cached));
+                    ++cacheHits;
+                }
+            }
+        }
+    }
+    if (cacheHits > 0)
+        std::cout << "Mapped " << cacheHits << " cached compressed textures" << std::endl;
+
+    // Packed textures missing from the cache are built from their source maps
+    for (const auto& [ormPath, inputs] : packedInputs) {
+        TextureSource& packed = sources.at(ormPath);
+        std::error_code error;
+        if (!packed.needsImage() || std::filesystem::exists(ormPath, error))
+            continue;
+        packed.needsPacking = true;
+        for (const std::string& inputPath : { inputs.metallicPath, inputs.roughnessPath }) {
+            if (!inputPath.empty())
+                sources.at(inputPath).isPackingInput = true;
+        }
+    }
+
+    std::vector<decltype(sources)::iterator> pendingImages;
+    for (auto iter = std::begin(sources); iter != std::end(sources); ++iter) {
+        if (!iter->second.image && !iter->second.needsPacking && iter->second.needsImage())
+            pendingImages.push_back(iter);
+    }
+
+    std::vector<std::exception_ptr> errors(pendingImages.size());
+    RS_ThreadPool::instance().parallelFor(0, static_cast<int>(pendingImages.size()), [&](int begin, int end, int) {
+        for (size_t i = static_cast<size_t>(begin); i < static_cast<size_t>(end); ++i) {
+            try {
+                pendingImages[i]->second.image = std::make_shared<Image>(std::filesystem::path(pendingImages[i]->first));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+    for (const std::exception_ptr& textureError : errors) {
+        if (textureError)
+            std::rethrow_exception(textureError);
+    }
+
+    // Each resample is parallel within the image
+    for (auto& [path, source] : sources) {
+        if (!source.image || !source.needsImage())
+            continue;
+        const glm::ivec2 size = getDownscaledSize(source.image->width, source.image->height, sizeLimit);
+        if (size == glm::ivec2(source.image->width, source.image->height))
+            continue;
+
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        const bool isNormalMap = source.isUsedAs[size_t(RS_TextureUsage::Normal)];
+        auto downscaled = std::make_shared<Image>(resampleImage(source.image->view(), size.x, size.y, getDownscaleFilter(source), isNormalMap));
+        downscaled->filePath = source.image->filePath;
+        std::cout << "Downscaled " << path << " from " << source.image->width << "x" << source.image->height << " to " << size.x << "x" << size.y << " in "
+                  << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count() << " ms" << std::endl;
+        source.image = std::move(downscaled);
+    }
+
+    const auto findImage = [&](const std::string& path) { return path.empty() ? nullptr : sources.at(path).image.get(); };
+    for (const auto& [ormPath, inputs] : packedInputs) {
+        TextureSource& packed = sources.at(ormPath);
+        if (packed.needsPacking)
+            packed.image = std::make_shared<Image>(packORMTexture(findImage(inputs.metallicPath), findImage(inputs.roughnessPath), ormPath));
+    }
+
+    // Encoding is parallel within each texture
+    if (settings.compressTextures) {
+        for (auto& [path, source] : sources) {
+            for (size_t usage = 0; usage < TEXTURE_USAGE_COUNT; ++usage) {
+                const std::optional<RS_BlockFormat> format = getBlockFormatForUsage(RS_TextureUsage(usage));
+                if (source.isUsedAs[usage] && format && !source.compressed[usage] && source.image)
+                    source.compressed[usage] = std::make_shared<const RS_CompressedTexture>(RS_CompressedTexture::encode(*source.image, RS_TextureUsage(usage), *format, sizeLimit));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        RS_ImportedTextures& importedTextures = subMeshes[i].importedTextures;
+        const auto slots = getTextureSlots(subMeshes[i].material);
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            if (texturePaths[i][slot].empty())
+                continue;
+            const TextureSource& source = sources.at(texturePaths[i][slot]);
+            *slots[slot] = source.image;
+            importedTextures.compressed[slot] = source.compressed[size_t(TEXTURE_SLOT_USAGES[slot])];
+        }
+
+        if (!ormPaths[i].empty()) {
+            const TextureSource& packed = sources.at(ormPaths[i]);
+            importedTextures.orm = packed.image;
+            importedTextures.compressed[RS_ORM_TEXTURE_SLOT] = packed.compressed[size_t(RS_TextureUsage::Packed)];
+        }
+    }
+}
+
+void computeBounds(std::span<const Vertex> vertices, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+}
+
+// UV units per model-space unit, averaged over the surface; 0 if the mesh has no usable texture coordinates
+float computeUVDensity(std::span<const Vertex> vertices, std::span<const glm::uvec3> triangles)
+{
+    // Both sums are of twice the triangle areas, which cancels in the ratio
+    double surfaceArea = 0.0;
+    double uvArea = 0.0;
+    for (const glm::uvec3& triangle : triangles) {
+        const Vertex& a = vertices[triangle.x];
+        const Vertex& b = vertices[triangle.y];
+        const Vertex& c = vertices[triangle.z];
+        surfaceArea += static_cast<double>(glm::length(glm::cross(b.position - a.position, c.position - a.position)));
+        const glm::vec2 uvB = b.texCoord - a.texCoord;
+        const glm::vec2 uvC = c.texCoord - a.texCoord;
+        uvArea += static_cast<double>(std::abs(uvB.x * uvC.y - uvB.y * uvC.x));
+    }
+    return surfaceArea > 0.0 && uvArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.0f;
+}
+
+} // namespace
+
+std::filesystem::path getMeshCachePath(const std::filesystem::path& sourceFile, uint64_t fileStamp, bool normalize)
+{
+    return getCacheEntryPath(sourceFile, fileStamp, normalize ? "_normalized.rsmesh" : ".rsmesh");
+}
+
+RS_MeshData RS_MeshData::load(const std::filesystem::path& filePath, bool normalize, const RS_MaterialImportSettings& settings)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Keyed on the file stamps instead of the contents: hashing a large OBJ would cost as much I/O as the cache saves
+    const std::optional<uint64_t> fileStamp = hashMeshStamp(filePath);
+    const std::filesystem::path cachePath = fileStamp ? getMeshCachePath(filePath, *fileStamp, normalize) : std::filesystem::path();
+
+    if (!cachePath.empty()) {
+        if (std::optional<RS_MeshData> cached = loadFromCache(cachePath, settings)) {
+            const auto endTime = std::chrono::high_resolution_clock::now();
+            std::cout << "Mapped mesh cache " << cachePath << " in "
+                      << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+            return std::move(*cached);
+        }
+    }
+
+    RS_MeshData data;
+    data.m_meshes = loadMesh(filePath, { .normalizeVertexPositions = normalize });
+    for (const Mesh& mesh : data.m_meshes) {
+        SubMesh& subMesh = data.m_subMeshes.emplace_back(SubMesh { mesh.vertices, mesh.triangles, mesh.material, {}, {}, 0.0f, {} });
+        computeBounds(mesh.vertices, subMesh.boundsMin, subMesh.boundsMax);
+        subMesh.uvDensity = computeUVDensity(mesh.vertices, mesh.triangles);
+    }
+
+    const auto parseTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Parsed mesh " << filePath << " in "
+              << std::chrono::duration<float, std::milli>(parseTime - startTime).count() << " ms" << std::endl;
+
+    if (!cachePath.empty() && writeMeshCache(cachePath, data.m_meshes))
+        std::cout << "Wrote mesh cache " << cachePath << std::endl;
+
+    if (settings.compressTextures || settings.packORMTextures || settings.textureSizeLimit > 0 || settings.textureMemoryBudget > 0) {
+        std::vector<TexturePaths> texturePaths(data.m_subMeshes.size());
+        for (size_t i = 0; i < data.m_subMeshes.size(); ++i) {
+            const auto slots = getTextureSlots(data.m_subMeshes[i].material);
+            for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+                if (*slots[slot])
+                    texturePaths[i][slot] = (*slots[slot])->filePath.string();
+            }
+        }
+        resolveTextures(data.m_subMeshes, texturePaths, settings);
+    }
+    return data;
+}
+
+std::optional<RS_MeshData> RS_MeshData::loadFromCache(const std::filesystem::path& cacheFile, const RS_MaterialImportSettings& settings)
+{
+    std::error_code error;
+    if (!std::filesystem::exists(cacheFile, error))
+        return std::nullopt;
+
+    RS_MeshData data;
+    try {
+        data.m_mappedFile.emplace(cacheFile);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+
+    const std::span<const std::byte> bytes = data.m_mappedFile->bytes();
+    const auto rejectEntry = [&]() {
+        std::cerr << "Ignoring invalid mesh cache entry " << cacheFile << std::endl;
+        return std::nullopt;
+    };
+
+    MeshCacheHeader header;
+    if (bytes.size() < sizeof(header))
+        return rejectEntry();
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    const uint64_t fileSize = bytes.size();
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexSize != sizeof(Vertex)
+        || header.subMeshOffset % alignof(MeshCacheSubMesh) != 0 || header.vertexOffset % alignof(Vertex) != 0 || header.triangleOffset % alignof(glm::uvec3) != 0
+        || !fitsInFile(header.subMeshOffset, header.subMeshCount, sizeof(MeshCacheSubMesh), fileSize)
+        || !fitsInFile(header.vertexOffset, header.vertexCount, sizeof(Vertex), fileSize)
+        || !fitsInFile(header.triangleOffset, header.triangleCount, sizeof(glm::uvec3), fileSize)
+        || !fitsInFile(header.stringOffset, header.stringSize, 1, fileSize))
+        return rejectEntry();
+
+    // The mapping is page aligned and all offsets were checked above, so the sections can be used in place
+    const std::byte* base = bytes.data();
+    const std::span<const MeshCacheSubMesh> records(reinterpret_cast<const MeshCacheSubMesh*>(base + header.subMeshOffset), header.subMeshCount);
+    const std::span<const Vertex> vertices(reinterpret_cast<const Vertex*>(base + header.vertexOffset), header.vertexCount);
+    const std::span<const glm::uvec3> triangles(reinterpret_cast<const glm::uvec3*>(base + header.triangleOffset), header.triangleCount);
+    const char* strings = reinterpret_cast<const char*>(base + header.stringOffset);
+
+    for (const MeshCacheSubMesh& record : records) {
+        if (record.vertexCount > vertices.size() || record.firstVertex > vertices.size() - record.vertexCount
+            || record.triangleCount > triangles.size() || record.firstTriangle > triangles.size() - record.triangleCount)
+            return rejectEntry();
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            if (uint64_t(record.texturePathOffset[slot]) + record.texturePathLength[slot] > header.stringSize)
+                return rejectEntry();
+        }
+
+        // The indices go straight to the GPU, so one out of range would read past the vertex buffer
+        const std::span<const glm::uvec3> subMeshTriangles = triangles.subspan(record.firstTriangle, record.triangleCount);
+        const bool indicesInRange = std::all_of(std::begin(subMeshTriangles), std::end(subMeshTriangles), [&](const glm::uvec3& triangle) {
+            return std::max({ triangle.x, triangle.y, triangle.z }) < record.vertexCount;
+        });
+        if (!indicesInRange)
+            return rejectEntry();
+
+        SubMesh& subMesh = data.m_subMeshes.emplace_back();
+        subMesh.vertices = vertices.subspan(record.firstVertex, record.vertexCount);
+        subMesh.triangles = subMeshTriangles;
+        subMesh.boundsMin = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+        subMesh.boundsMax = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+        subMesh.uvDensity = record.uvDensity;
+        subMesh.material.kd = glm::vec3(record.kd[0], record.kd[1], record.kd[2]);
+        subMesh.material.ks = glm::vec3(record.ks[0], record.ks[1], record.ks[2]);
+        subMesh.material.shininess = record.shininess;
+        subMesh.material.transparency = record.transparency;
+    }
+
+    // Texture decoding dominates a cached load
+    std::vector<TexturePaths> texturePaths(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            if (records[i].texturePathLength[slot] > 0)
+                texturePaths[i][slot].assign(strings + records[i].texturePathOffset[slot], records[i].texturePathLength[slot]);
+        }
+    }
+    resolveTextures(data.m_subMeshes, texturePaths, settings);
+
+    return data;
+}
+
+bool writeMeshCache(const std::filesystem::path& cacheFile, std::span<const Mesh> meshes)
+{
+    std::vector<MeshCacheSubMesh> records(meshes.size());
+    std::string strings;
+
+    MeshCacheHeader header {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.subMeshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexSize = sizeof(Vertex);
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const Mesh& mesh = meshes[i];
+        MeshCacheSubMesh& record = records[i];
+        record.firstVertex = header.vertexCount;
+        record.vertexCount = mesh.vertices.size();
+        record.firstTriangle = header.triangleCount;
+        record.triangleCount = mesh.triangles.size();
+        header.vertexCount += mesh.vertices.size();
+        header.triangleCount += mesh.triangles.size();
+
+        glm::vec3 meshMin, meshMax;
+        computeBounds(mesh.vertices, meshMin, meshMax);
+        boundsMin = glm::min(boundsMin, meshMin);
+        boundsMax = glm::max(boundsMax, meshMax);
+        std::memcpy(record.boundsMin, &meshMin, sizeof(record.boundsMin));
+        std::memcpy(record.boundsMax, &meshMax, sizeof(record.boundsMax));
+        record.uvDensity = computeUVDensity(mesh.vertices, mesh.triangles);
+
+        std::memcpy(record.kd, &mesh.material.kd, sizeof(record.kd));
+        std::memcpy(record.ks, &mesh.material.ks, sizeof(record.ks));
+        record.shininess = mesh.material.shininess;
+        record.transparency = mesh.material.transparency;
+
+        const auto slots = getTextureSlots(mesh.material);
+        for (size_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+            const std::shared_ptr<Image>& image = *slots[slot];
+            if (!image)
+                continue;
+            const std::string path = image->filePath.string();
+            record.texturePathOffset[slot] = static_cast<uint32_t>(strings.size());
+            record.texturePathLength[slot] = static_cast<uint32_t>(path.size());
+            strings += path;
+        }
+    }
+    std::memcpy(header.boundsMin, &boundsMin, sizeof(header.boundsMin));
+    std::memcpy(header.boundsMax, &boundsMax, sizeof(header.boundsMax));
+
+    header.subMeshOffset = alignOffset(sizeof(header));
+    header.vertexOffset = alignOffset(header.subMeshOffset + records.size() * sizeof(MeshCacheSubMesh));
+    header.triangleOffset = alignOffset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+    header.stringOffset = alignOffset(header.triangleOffset + header.triangleCount * sizeof(glm::uvec3));
+    header.stringSize = strings.size();
+
+    // Written straight from the meshes' own arrays; only the padding between sections is extra
+    static constexpr std::array<std::byte, MESH_CACHE_ALIGNMENT> padding {};
+    std::vector<std::span<const std::byte>> chunks;
+    uint64_t writtenSize = 0;
+    const auto addChunk = [&](std::span<const std::byte> chunk) {
+        chunks.push_back(chunk);
+        writtenSize += chunk.size();
+    };
+    const auto padTo = [&](uint64_t offset) {
+        addChunk(std::span(padding).first(offset - writtenSize));
+    };
+
+    addChunk(std::as_bytes(std::span(&header, 1)));
+    padTo(header.subMeshOffset);
+    addChunk(std::as_bytes(std::span(records)));
+    padTo(header.vertexOffset);
+    for (const Mesh& mesh : meshes)
+        addChunk(std::as_bytes(std::span(mesh.vertices)));
+    padTo(header.triangleOffset);
+    for (const Mesh& mesh : meshes)
+        addChunk(std::as_bytes(std::span(mesh.triangles)));
+    padTo(header.stringOffset);
+    addChunk(std::as_bytes(std::span(strings)));
+
+    return writeFileAtomically(cacheFile, chunks);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "texture_compression.h"
+#include <framework/disable_all_warnings.h>
+#include <framework/mapped_file.h>
+#include <framework/mesh.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// How material textures are prepared when a model is imported
+struct RS_MaterialImportSettings {
+    // Block-compress textures (or map their cached compressed versions, which skips image decoding)
+    bool compressTextures { false };
+    // Pack metallic and roughness maps into one occlusion/roughness/metallic texture
+    bool packORMTextures { false };
+    // Largest width or height of imported textures; larger ones are scaled down once and cached (0 = unlimited)
+    int textureSizeLimit { 0 };
+    // Video memory the model's textures may occupy; lowers the size limit until they fit (0 = no budget)
+    size_t textureMemoryBudget { 0 };
+};
+
+// Textures prepared while importing a model, in addition to the images referenced by the framework material
+struct RS_ImportedTextures {
+    // Packed occlusion/roughness/metallic texture; replaces the separate metallic and roughness maps if present
+    std::shared_ptr<Image> orm;
+    // A slot with a compressed texture may have no decoded image in the material
+    RS_CompressedMaterialTextures compressed;
+};
+
+// CPU-side sub-meshes of a model file. On the first import the OBJ is parsed and a binary cache entry is
+// written; later loads memory-map that entry, so vertex and index data is handed to OpenGL straight from the
+// mapped pages. Loading does not touch OpenGL and may happen on a worker thread.
+class RS_MeshData {
+public:
+    struct SubMesh {
+        std::span<const Vertex> vertices;
+        std::span<const glm::uvec3> triangles;
+        Material material;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        float uvDensity; // UV units per model-space unit; decides how sharp streamed textures need to be
+        RS_ImportedTextures importedTextures;
+    };
+
+    // Throws like loadMesh if the source cannot be parsed
+    static RS_MeshData load(const std::filesystem::path& filePath, bool normalize, const RS_MaterialImportSettings& settings = {});
+
+    const std::vector<SubMesh>& getSubMeshes() const { return m_subMeshes; }
+    bool isFromCache() const { return m_mappedFile.has_value(); }
+
+private:
+    static std::optional<RS_MeshData> loadFromCache(const std::filesystem::path& cacheFile, const RS_MaterialImportSettings& settings);
+
+    std::optional<MappedFile> m_mappedFile; // Cache hit: the spans point into the mapping
+    std::vector<Mesh> m_meshes; // Cache miss: the spans point into the parsed meshes
+    std::vector<SubMesh> m_subMeshes;
+};
+
+// Cache entry for the model file with the given stamp, imported with or without normalization
+std::filesystem::path getMeshCachePath(const std::filesystem::path& sourceFile, uint64_t fileStamp, bool normalize);
+
+bool writeMeshCache(const std::filesystem::path& cacheFile, std::span<const Mesh> meshes);
@@ -3,6 +3,7 @@
 //
 
 #include "model.h"
+#include "texture_cache.h"
 #include <framework/mesh.h>
 #include <iostream>
 #include <framework/disable_all_warnings.h>
@@ -12,14 +13,29 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 DISABLE_WARNINGS_POP()
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 
-RS_Material RS_Material::createFromMesh(const GPUMesh& mesh)
+RS_Material RS_Material::createFromMesh(const GPUMesh& mesh, const RS_ImportedTextures& importedTextures, bool streamTextures)
 {
     RS_Material material;
     const Material& cpuMaterial = mesh.getMaterial();
 
+    // Prefer the block-compressed version of a texture; the material then need not hold a decoded image at all
+    const RS_CompressedMaterialTextures& compressedTextures = importedTextures.compressed;
+    const auto getTexture = [&](size_t slot, const std::shared_ptr<Image>& image) {
+        if (compressedTextures[slot] && streamTextures) {
+            std::shared_ptr<RS_StreamingTexture> streamed = RS_TextureCache::instance().getOrCreateStreaming(compressedTextures[slot]);
+            material.streamingTextures.push_back(streamed);
+            // Shares ownership with the streaming texture, which updates its GL texture in place
+            return std::shared_ptr<RS_Texture>(streamed, &streamed->getTexture());
+        }
+        if (compressedTextures[slot])
+            return RS_TextureCache::instance().getOrCreate(*compressedTextures[slot]);
+        return RS_TextureCache::instance().getOrCreate(*image);
+    };
+
     material.gpuData.baseColor = cpuMaterial.kd;
     material.gpuData.metallic = 0.0f;
     material.gpuData.roughness = 0.5f;
@@ -27,9 +43,9 @@ RS_Material RS_Material::createFromMesh(const GPUMesh& mesh)
     material.gpuData.emissive = glm::vec3(0.0f);
     material.gpuData.textureFlags = glm::ivec4(0);
 
-    if (cpuMaterial.kdTexture) {
+    if (cpuMaterial.kdTexture || compressedTextures[0]) {
         try {
-            material.baseColorTex = std::make_unique<RS_Texture>(*cpuMaterial.kdTexture);
+            material.baseColorTex = getTexture(0, cpuMaterial.kdTexture);
             material.gpuData.textureFlags += RS_HAS_COLOR_TEX;
             std::cout << "Loaded base color texture from mesh material" << std::endl;
         } catch (const std::exception& e) {
@@ -37,11 +53,11 @@ RS_Material RS_Material::createFromMesh(const GPUMesh& mesh)
         }
     }
 
-    if (cpuMaterial.norTexture)
+    if (cpuMaterial.norTexture || compressedTextures[1])
     {
         try
         {
-            material.normalTex = std::make_unique<RS_Texture>(*cpuMaterial.norTexture);
+            material.normalTex = getTexture(1, cpuMaterial.norTexture);
             material.gpuData.textureFlags += RS_HAS_NORMAL_TEX;
             std::cout << "Loaded normal texture from mesh material" << std::endl;
         } catch (const std::exception& e)
@@ -50,30 +66,46 @@ RS_Material RS_Material::createFromMesh(const GPUMesh& mesh)
         }
     }
 
-    // Load metallic texture
-    if (cpuMaterial.metTexture)
+    // A packed occlusion/roughness/metallic texture replaces the separate maps: one texture fetch instead of two
+    if (importedTextures.orm || compressedTextures[RS_ORM_TEXTURE_SLOT])
     {
         try
         {
-            material.metallicTex = std::make_unique<RS_Texture>(*cpuMaterial.metTexture);
-            material.gpuData.textureFlags += RS_HAS_METALLIC_ROUGHNESS_TEX;
-            std::cout << "Loaded metallic texture from mesh material" << std::endl;
+            material.ormTex = getTexture(RS_ORM_TEXTURE_SLOT, importedTextures.orm);
+            material.gpuData.textureFlags += RS_HAS_ORM_TEX;
+            std::cout << "Loaded packed ORM texture from mesh material" << std::endl;
         } catch (const std::exception& e)
         {
-            std::cerr << "Failed to load metallic texture: " << e.what() << std::endl;
+            std::cerr << "Failed to load packed ORM texture: " << e.what() << std::endl;
         }
     }
-
-    // Load roughness texture
-    if (cpuMaterial.roughTexture)
+    else
     {
-        try
+        // Load metallic texture
+        if (cpuMaterial.metTexture || compressedTextures[2])
         {
-            material.roughnessTex = std::make_unique<RS_Texture>(*cpuMaterial.roughTexture);
-            std::cout << "Loaded roughness texture from mesh material" << std::endl;
-        } catch (const std::exception& e)
+            try
+            {
+                material.metallicTex = getTexture(2, cpuMaterial.metTexture);
+                material.gpuData.textureFlags += RS_HAS_METALLIC_ROUGHNESS_TEX;
+                std::cout << "Loaded metallic texture from mesh material" << std::endl;
+            } catch (const std::exception& e)
+            {
+                std::cerr << "Failed to load metallic texture: " << e.what() << std::endl;
+            }
+        }
+
+        // Load roughness texture
+        if (cpuMaterial.roughTexture || compressedTextures[3])
         {
-            std::cerr << "Failed to load roughness texture: " << e.what() << std::endl;
+            try
+            {
+                material.roughnessTex = getTexture(3, cpuMaterial.roughTexture);
+                std::cout << "Loaded roughness texture from mesh material" << std::endl;
+            } catch (const std::exception& e)
+            {
+                std::cerr << "Failed to load roughness texture: " << e.what() << std::endl;
+            }
         }
     }
 
@@ -137,6 +169,35 @@ glm::mat4 animate(glm::mat4 matrix, std::vector<glm::vec3> curve, float t, const
     return matrix * rot;
 }
 
+void RS_Model::requestStreamedTextures(const glm::mat4& viewProjectionMatrix, float viewportHeight) const
+{
+    // The view matrix is a rigid transform, so the second row of the view-projection matrix has the length of the
+    // projection's vertical scale (1 / tan(fovY / 2))
+    const float projectionScale = glm::length(glm::vec3(viewProjectionMatrix[0][1], viewProjectionMatrix[1][1], viewProjectionMatrix[2][1]));
+    const float pixelsPerUnitAtUnitDepth = 0.5f * projectionScale * viewportHeight;
+    const glm::mat4 baseModelMatrix = evaluateModelMatrix();
+
+    for (size_t i = 0; i < m_meshes.size() && i < m_materials.size(); i++)
+    {
+        const RS_Material& material = m_materials[i];
+        if (material.streamingTextures.empty() || material.footprint.uvDensity <= 0.0f)
+            continue;
+
+        const glm::mat4 meshModelMatrix = evaluateMeshSpecificMatrix(i, baseModelMatrix);
+        const float scale = std::max({ glm::length(glm::vec3(meshModelMatrix[0])), glm::length(glm::vec3(meshModelMatrix[1])), glm::length(glm::vec3(meshModelMatrix[2])) });
+        const float depth = (viewProjectionMatrix * meshModelMatrix * glm::vec4(material.footprint.center, 1.0f)).w;
+        const float radius = material.footprint.radius * scale;
+        if (depth + radius <= 0.0f)
+            continue; // Behind the camera
+
+        // The nearest point of the bounding sphere decides; from inside the sphere the full resolution is needed
+        const float distance = std::max(depth - radius, 1e-4f);
+        const float pixelsPerUV = pixelsPerUnitAtUnitDepth / distance * scale / material.footprint.uvDensity;
+        for (const std::shared_ptr<RS_StreamingTexture>& texture : material.streamingTextures)
+            texture->request(pixelsPerUV);
+    }
+}
+
 void RS_Model::draw(const Shader& drawShader, const glm::mat4& viewProjectionMatrix)
 {
     const glm::mat4 baseModelMatrix = evaluateModelMatrix();
@@ -201,6 +262,16 @@ void RS_Model::draw(const Shader& drawShader, const glm::mat4& viewProjectionMat
             }
         }
 
+        if (material.ormTex)
+        {
+            material.ormTex->bind(GL_TEXTURE3);
+            GLint texLoc = drawShader.getUniformLocation("ormMap");
+            if (texLoc != -1)
+            {
+                glUniform1i(texLoc, 3);
+            }
+        }
+
 
         glUniform1i(drawShader.getUniformLocation("hasTexCoords"), m_meshes[i].hasTextureCoords() ? 1 : 0);
         glUniform1i(drawShader.getUniformLocation("useMaterial"), 1);
@@ -249,7 +320,34 @@ void RS_Model::addMaterial(RS_Material&& material)
     m_materials.push_back(std::move(material));
 }
 
+void RS_Model::clearMeshes()
+{
+    m_meshes.clear();
+    m_materials.clear();
+}
+
 glm::mat4 RS_Model::evaluateModelMatrix() const
+{
+    const glm::mat4 pathMatrix = evaluatePathMatrix();
+    if (m_buoyancy.hullPoints.empty())
+        return pathMatrix;
+
+    // Rise, then pitch about the horizontal axis across the model and roll about the one along it, around its origin
+    const glm::vec3 origin(pathMatrix[3]);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    const glm::vec3 forward(pathMatrix[2]);
+    const glm::vec3 right(pathMatrix[0]);
+
+    glm::mat4 floating = glm::translate(glm::mat4(1.0f), origin + up * m_buoyancy.heave);
+    if (glm::length(glm::cross(forward, up)) > 1e-6f)
+        floating = glm::rotate(floating, m_buoyancy.pitch, glm::cross(forward, up));
+    if (glm::length(glm::cross(right, up)) > 1e-6f)
+        floating = glm::rotate(floating, m_buoyancy.roll, glm::cross(right, up));
+    floating = glm::translate(floating, -origin);
+    return floating * pathMatrix;
+}
+
+glm::mat4 RS_Model::evaluatePathMatrix() const
 {
     glm::mat4 modelMatrix = m_model_matrix;
 
@@ -287,6 +385,11 @@ glm::mat4 RS_Model::getModelMatrix() const
     return evaluateModelMatrix();
 }
 
+glm::mat4 RS_Model::getPathMatrix() const
+{
+    return evaluatePathMatrix();
+}
+
 glm::vec3 RS_Model::getWorldPosition() const
 {
     const glm::mat4 modelMatrix = evaluateModelMatrix();
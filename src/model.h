@@ -5,12 +5,18 @@
 #ifndef COMPUTERGRAPHICS_RSMODEL_H
 #define COMPUTERGRAPHICS_RSMODEL_H
 #include "mesh.h"
+#include "mesh_cache.h"
 #include "texture.h"
+#include "texture_compression.h"
+#include "texture_streaming.h"
 #include <memory>
+#include <optional>
+#include <vector>
 
 inline glm::ivec4 RS_HAS_COLOR_TEX = {1, 0, 0, 0};
 inline glm::ivec4 RS_HAS_NORMAL_TEX = {0, 1, 0, 0};
 inline glm::ivec4 RS_HAS_METALLIC_ROUGHNESS_TEX = {0, 0, 1, 0};
+inline glm::ivec4 RS_HAS_ORM_TEX = {0, 0, 2, 0}; // Packed occlusion/roughness/metallic instead of separate maps
 inline glm::ivec4 RS_HAS_EMISSIVE_TEX = {0, 0, 0, 1};
 
 // GPU-compatible material struct (std140 layout)
@@ -25,7 +31,15 @@ struct RS_GPUMaterial
     float _padding;                      // offset 44
 
     // Texture flags (use these to know which textures are bound in shader)
-    alignas(16) glm::ivec4 textureFlags; // offset 48: [hasBaseColor, hasNormal, hasMetallicRoughness, hasEmissive]
+    alignas(16) glm::ivec4 textureFlags; // offset 48: [hasBaseColor, hasNormal, hasMetallicRoughness (2 = packed ORM), hasEmissive]
+};
+
+// Where a mesh is and how densely its UVs are laid out; decides the mips its streamed textures need
+struct RS_TextureFootprint
+{
+    glm::vec3 center { 0.0f }; // Bounding sphere in model space
+    float radius { 0.0f };
+    float uvDensity { 0.0f }; // UV units per model-space unit; 0 if the mesh has no texture coordinates
 };
 
 // CPU-side material that holds both GPU data and texture references
@@ -33,13 +47,36 @@ struct RS_Material
 {
     RS_GPUMaterial gpuData;
 
-    std::unique_ptr<RS_Texture> baseColorTex = nullptr;
-    std::unique_ptr<RS_Texture> normalTex = nullptr;
-    std::unique_ptr<RS_Texture> metallicTex = nullptr;
-    std::unique_ptr<RS_Texture> roughnessTex = nullptr;
+    // Shared through RS_TextureCache, so materials that use the same texture files share the GPU textures
+    std::shared_ptr<RS_Texture> baseColorTex = nullptr;
+    std::shared_ptr<RS_Texture> normalTex = nullptr;
+    std::shared_ptr<RS_Texture> metallicTex = nullptr;
+    std::shared_ptr<RS_Texture> roughnessTex = nullptr;
+    std::shared_ptr<RS_Texture> ormTex = nullptr; // Replaces metallicTex and roughnessTex if present
 
-    // Helper function to create material from framework mesh material
-    static RS_Material createFromMesh(const GPUMesh& mesh);
+    // The streamed ones among the textures above, which are asked every frame for the mips the mesh needs
+    std::vector<std::shared_ptr<RS_StreamingTexture>> streamingTextures;
+    RS_TextureFootprint footprint;
+
+    // Helper function to create material from framework mesh material. Compressed textures are streamed if requested.
+    static RS_Material createFromMesh(const GPUMesh& mesh, const RS_ImportedTextures& importedTextures = {}, bool streamTextures = false);
+};
+
+// Floats a model on the water. The water heights at the hull points, given in model space, decide how far the
+// model rises (heave) and tilts (pitch and roll); the animated pose is its rest pose on calm water. While it moves,
+// the footprint spanned by the hull points stirs up a wake.
+struct RS_Buoyancy
+{
+    std::vector<glm::vec3> hullPoints; // Empty if the model does not float
+    float response { 3.0f }; // Rate (1/s) at which the pose follows the water
+    float draft { 0.2f }; // Depth the hull pushes the water down by, which sets the strength of its wake
+
+    // Current offsets from the rest pose, in world units and radians
+    float heave { 0.0f };
+    float pitch { 0.0f };
+    float roll { 0.0f };
+    // Horizontal position of the rest pose at the previous update, which gives its velocity
+    std::optional<glm::vec2> lastPosition;
 };
 
 class RS_Model
@@ -49,10 +86,14 @@ public:
     RS_Model();
 
     void draw(const Shader& drawShader, const glm::mat4& viewProjectionMatrix);
+    // Ask the streamed textures for the mips needed at each mesh's size on screen
+    void requestStreamedTextures(const glm::mat4& viewProjectionMatrix, float viewportHeight) const;
     void drawDepth(const Shader& depthShader, const glm::mat4& viewProjectionMatrix);
     void drawDepthCubemap(const Shader& depthCubemapShader);
     void addMesh(GPUMesh&& mesh);
     void addMaterial(RS_Material&& material);
+    // Remove all meshes and materials, e.g. to replace a placeholder once the real asset arrives
+    void clearMeshes();
     void setAnimationCurve(const std::vector<glm::vec3>& curvePoints) { m_animateCurvePoints = curvePoints; }
     float m_animateTime{ 5.0f };
 
@@ -64,6 +105,11 @@ public:
 	void enableAnimation(bool enable) { m_animationEnabled = enable; }
     glm::mat4 getModelMatrix() const;
     glm::vec3 getWorldPosition() const;
+    // Pose along the animation curve, before the model floats on the water
+    glm::mat4 getPathMatrix() const;
+
+    RS_Buoyancy& getBuoyancy() { return m_buoyancy; }
+    const RS_Buoyancy& getBuoyancy() const { return m_buoyancy; }
 
 private:
     std::vector<GPUMesh> m_meshes;
@@ -72,8 +118,10 @@ private:
     GLuint m_material_UBO { 0 };
 	bool m_animationEnabled{ false };
 	std::vector<glm::vec3> m_animateCurvePoints;
+    RS_Buoyancy m_buoyancy;
 
     glm::mat4 evaluateModelMatrix() const;
+    glm::mat4 evaluatePathMatrix() const;
     glm::mat4 evaluateMeshSpecificMatrix(size_t meshIndex, const glm::mat4& baseMatrix) const;
 };
 
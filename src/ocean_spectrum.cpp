@@ -0,0 +1,349 @@
+#include "ocean_spectrum.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <numbers>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_OCEAN_SPECTRUM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr float GRAVITY = 9.81f;
+
+using Complex = std::complex<float>;
+
+// Plain complex product; the operator of std::complex also handles infinities and NaNs, which makes it far slower
+Complex multiply(Complex a, Complex b)
+{
+    return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+}
+
+Complex timesI(Complex a)
+{
+    return { -a.imag(), a.real() };
+}
+
+// The transforms below are unnormalized inverse DFTs of n values, sum over k of data[k] * exp(2 pi i j k / n), as
+// iterative radix-2 decimations in time. twiddles[j] = exp(2 pi i j / n) for j < n / 2. Two sequences are always
+// transformed together, which on SSE2 fills a register with one complex value of each.
+
+#ifdef RS_OCEAN_SPECTRUM_SSE2
+// data holds n registers in bit-reversed order
+void inverseFFTPair(float* data, int n, const Complex* twiddles)
+{
+    const __m128 negateReal = _mm_castsi128_ps(_mm_setr_epi32(INT_MIN, 0, INT_MIN, 0));
+    const auto timesI4 = [negateReal](__m128 v) { return _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), negateReal); };
+
+    // The first two stages only have the twiddles 1 and i
+    for (int start = 0; start + 4 <= n; start += 4) {
+        float* quad = data + 4 * start;
+        const __m128 a0 = _mm_loadu_ps(quad), a1 = _mm_loadu_ps(quad + 4), a2 = _mm_loadu_ps(quad + 8), a3 = _mm_loadu_ps(quad + 12);
+        const __m128 b0 = _mm_add_ps(a0, a1), b1 = _mm_sub_ps(a0, a1), b2 = _mm_add_ps(a2, a3), b3 = timesI4(_mm_sub_ps(a2, a3));
+        _mm_storeu_ps(quad, _mm_add_ps(b0, b2));
+        _mm_storeu_ps(quad + 4, _mm_add_ps(b1, b3));
+        _mm_storeu_ps(quad + 8, _mm_sub_ps(b0, b2));
+        _mm_storeu_ps(quad + 12, _mm_sub_ps(b1, b3));
+    }
+
+    for (int size = 8; size <= n; size *= 2) {
+        const int half = size / 2;
+        const int twiddleStep = n / size;
+        for (int j = 0; j < half; ++j) {
+            const Complex w = twiddles[j * twiddleStep];
+            const __m128 wRe = _mm_set1_ps(w.real());
+            const __m128 wIm = _mm_set1_ps(w.imag());
+            for (int start = j; start < n; start += size) {
+                float* lower = data + 4 * start;
+                float* upper = data + 4 * (start + half);
+                const __m128 v = _mm_loadu_ps(upper);
+                const __m128 swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+                const __m128 t = _mm_add_ps(_mm_mul_ps(wRe, v), _mm_xor_ps(_mm_mul_ps(wIm, swapped), negateReal));
+                const __m128 u = _mm_loadu_ps(lower);
+                _mm_storeu_ps(lower, _mm_add_ps(u, t));
+                _mm_storeu_ps(upper, _mm_sub_ps(u, t));
+            }
+        }
+    }
+}
+#else
+void inverseFFT(Complex* data, int n, const Complex* twiddles, const int* bitReverse)
+{
+    for (int i = 0; i < n; ++i) {
+        const int j = bitReverse[i];
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (int size = 2; size <= n; size *= 2) {
+        const int half = size / 2;
+        const int twiddleStep = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int j = 0; j < half; ++j) {
+                const Complex t = multiply(twiddles[j * twiddleStep], data[start + j + half]);
+                const Complex u = data[start + j];
+                data[start + j] = u + t;
+                data[start + j + half] = u - t;
+            }
+        }
+    }
+}
+#endif
+
+// Transform rows a and b in place; scratch holds 2 n complex values
+void inverseFFTRows(Complex* a, Complex* b, int n, const Complex* twiddles, const int* bitReverse, Complex* scratch)
+{
+#ifdef RS_OCEAN_SPECTRUM_SSE2
+    float* pairs = reinterpret_cast<float*>(scratch);
+    for (int i = 0; i < n; ++i) {
+        const __m128 lowerHalf = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(&a[i]));
+        _mm_storeu_ps(pairs + 4 * bitReverse[i], _mm_loadh_pi(lowerHalf, reinterpret_cast<const __m64*>(&b[i])));
+    }
+    inverseFFTPair(pairs, n, twiddles);
+    for (int i = 0; i < n; ++i) {
+        const __m128 pair = _mm_loadu_ps(pairs + 4 * i);
+        _mm_storel_pi(reinterpret_cast<__m64*>(&a[i]), pair);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(&b[i]), pair);
+    }
+#else
+    (void)scratch;
+    inverseFFT(a, n, twiddles, bitReverse);
+    inverseFFT(b, n, twiddles, bitReverse);
+#endif
+}
+
+// Transform columns x and x + 1 of an n x n field into columnA and columnB; scratch holds 2 n complex values
+void inverseFFTColumns(const Complex* field, int x, int n, const Complex* twiddles, const int* bitReverse,
+    Complex* columnA, Complex* columnB, Complex* scratch)
+{
+    const size_t rowLength = static_cast<size_t>(n);
+#ifdef RS_OCEAN_SPECTRUM_SSE2
+    // The two columns are next to each other in every row
+    float* pairs = reinterpret_cast<float*>(scratch);
+    for (int z = 0; z < n; ++z)
+        _mm_storeu_ps(pairs + 4 * bitReverse[z], _mm_loadu_ps(reinterpret_cast<const float*>(&field[static_cast<size_t>(z) * rowLength + static_cast<size_t>(x)])));
+    inverseFFTPair(pairs, n, twiddles);
+    for (int z = 0; z < n; ++z) {
+        const __m128 pair = _mm_loadu_ps(pairs + 4 * z);
+        _mm_storel_pi(reinterpret_cast<__m64*>(&columnA[z]), pair);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(&columnB[z]), pair);
+    }
+#else
+    (void)scratch;
+    for (size_t z = 0; z < rowLength; ++z) {
+        columnA[z] = field[z * rowLength + static_cast<size_t>(x)];
+        columnB[z] = field[z * rowLength + static_cast<size_t>(x) + 1];
+    }
+    inverseFFT(columnA, n, twiddles, bitReverse);
+    inverseFFT(columnB, n, twiddles, bitReverse);
+#endif
+}
+
+} // namespace
+
+RS_OceanSpectrum::RS_OceanSpectrum(int resolution, uint32_t seed)
+    : m_resolution(resolution)
+    , m_seed(seed)
+{
+    assert(resolution >= 4 && (resolution & (resolution - 1)) == 0);
+    const size_t count = static_cast<size_t>(resolution) * static_cast<size_t>(resolution);
+
+    m_twiddles.resize(static_cast<size_t>(resolution / 2));
+    for (size_t j = 0; j < m_twiddles.size(); ++j)
+        m_twiddles[j] = std::polar(1.0f, 2.0f * std::numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(resolution));
+
+    int bits = 0;
+    while ((1 << bits) < resolution)
+        ++bits;
+    m_bitReverse.resize(static_cast<size_t>(resolution));
+    for (int i = 0; i < resolution; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        m_bitReverse[static_cast<size_t>(i)] = reversed;
+    }
+
+    for (std::vector<Complex>& field : m_fields)
+        field.resize(count);
+    m_displacements.resize(count);
+    m_normals.resize(count, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+
+    generateAmplitudes();
+}
+
+void RS_OceanSpectrum::setSettings(const Settings& settings)
+{
+    const bool wavesChanged = settings.patchSize != m_settings.patchSize || settings.windSpeed != m_settings.windSpeed
+        || settings.windDirection != m_settings.windDirection;
+    m_settings = settings;
+    if (wavesChanged)
+        generateAmplitudes();
+}
+
+// Phillips spectrum: waves up to about windSpeed^2 / g long, travelling along the wind
+void RS_OceanSpectrum::generateAmplitudes()
+{
+    const int n = m_resolution;
+    const size_t count = static_cast<size_t>(n) * static_cast<size_t>(n);
+    m_amplitudes.assign(count, Complex());
+    m_oppositeAmplitudes.assign(count, Complex());
+    m_dispersion.assign(count, 0.0f);
+
+    const float windSpeed = std::max(m_settings.windSpeed, 0.1f);
+    const float largestWave = windSpeed * windSpeed / GRAVITY;
+    const glm::vec2 wind(std::cos(m_settings.windDirection), std::sin(m_settings.windDirection));
+    // Waves shorter than a few samples would only alias
+    const float smallestWave = m_settings.patchSize / static_cast<float>(n);
+    const float frequencyScale = 2.0f * std::numbers::pi_v<float> / m_settings.patchSize;
+
+    std::mt19937 rng(m_seed);
+    std::normal_distribution<float> gaussian;
+
+    double variance = 0.0;
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            // Draw for every wave vector, so that the waves only depend on the seed and not on the wind
+            const Complex random(gaussian(rng), gaussian(rng));
+
+            // The Nyquist row and column have no opposite wave vector and stay empty, which keeps every field real
+            if (x == n / 2 || z == n / 2)
+                continue;
+
+            const glm::vec2 k = frequencyScale * glm::vec2(x < n / 2 ? x : x - n, z < n / 2 ? z : z - n);
+            const float k2 = glm::dot(k, k);
+            if (k2 == 0.0f)
+                continue;
+
+            const float alignment = glm::dot(k, wind) * glm::dot(k, wind) / k2;
+            const float phillips = std::exp(-1.0f / (k2 * largestWave * largestWave)) / (k2 * k2) * alignment
+                * std::exp(-k2 * smallestWave * smallestWave);
+
+            const size_t i = static_cast<size_t>(z) * static_cast<size_t>(n) + static_cast<size_t>(x);
+            m_amplitudes[i] = random * std::sqrt(0.5f * phillips);
+            // Deep water dispersion
+            m_dispersion[i] = std::sqrt(GRAVITY * std::sqrt(k2));
+            variance += static_cast<double>(std::norm(m_amplitudes[i]));
+        }
+    }
+
+    // Each height is the sum of the waves along k and -k, whose amplitudes are independent
+    variance *= 2.0;
+    const float normalization = variance > 0.0 ? static_cast<float>(1.0 / std::sqrt(variance)) : 0.0f;
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            const size_t i = static_cast<size_t>(z) * static_cast<size_t>(n) + static_cast<size_t>(x);
+            const size_t opposite = static_cast<size_t>((n - z) % n) * static_cast<size_t>(n) + static_cast<size_t>((n - x) % n);
+            m_amplitudes[i] *= normalization;
+            m_oppositeAmplitudes[opposite] = std::conj(m_amplitudes[i]);
+        }
+    }
+}
+
+void RS_OceanSpectrum::simulate(float time)
+{
+    const int n = m_resolution;
+    const size_t rowLength = static_cast<size_t>(n);
+    const float frequencyScale = 2.0f * std::numbers::pi_v<float> / m_settings.patchSize;
+    RS_ThreadPool& pool = RS_ThreadPool::instance();
+
+    // Spectra of the fields at this time. Every field is real, so the spectrum at -k is the conjugate of the one at
+    // k: rows z and n - z are filled together, and transformed along x together right away. Row 0 is its own
+    // mirror and the Nyquist row n / 2 is empty.
+    pool.parallelFor(0, n / 2, [&](int begin, int end, int) {
+        std::vector<Complex> scratch(2 * rowLength);
+        for (int pair = begin; pair < end; ++pair) {
+            const int z = pair;
+            const int mirrorZ = (n - z) % n;
+            const int pairedZ = pair == 0 ? n / 2 : mirrorZ;
+            const size_t rowStart = static_cast<size_t>(z) * rowLength;
+            const size_t mirrorRowStart = static_cast<size_t>(mirrorZ) * rowLength;
+            const size_t pairedRowStart = static_cast<size_t>(pairedZ) * rowLength;
+            if (pair == 0) {
+                for (std::vector<Complex>& field : m_fields)
+                    std::fill_n(&field[pairedRowStart], rowLength, Complex());
+            }
+
+            for (int x = 0; x < (pair == 0 ? n / 2 + 1 : n); ++x) {
+                const size_t i = rowStart + static_cast<size_t>(x);
+                const size_t mirror = mirrorRowStart + static_cast<size_t>((n - x) % n);
+                const glm::vec2 k = frequencyScale * glm::vec2(x < n / 2 ? x : x - n, z < n / 2 ? z : z - n);
+                const float omegaTime = m_dispersion[i] * time;
+                const Complex phase(std::cos(omegaTime), std::sin(omegaTime));
+                const Complex height = m_settings.rmsHeight
+                    * (multiply(m_amplitudes[i], phase) + multiply(m_oppositeAmplitudes[i], std::conj(phase)));
+
+                // Slopes are i k h and the choppy displacement is -i k / |k| h
+                const Complex iHeight = timesI(height);
+                const float k2 = glm::dot(k, k);
+                const glm::vec2 direction = k2 > 0.0f ? (-m_settings.choppiness / std::sqrt(k2)) * k : glm::vec2(0.0f);
+                const Complex displacementX = direction.x * iHeight;
+                const Complex displacementZ = direction.y * iHeight;
+                const Complex slopeX = k.x * iHeight;
+                const Complex slopeZ = k.y * iHeight;
+
+                m_fields[0][i] = height + timesI(displacementX);
+                m_fields[1][i] = displacementZ + timesI(slopeX);
+                m_fields[2][i] = slopeZ;
+                m_fields[0][mirror] = std::conj(height) + timesI(std::conj(displacementX));
+                m_fields[1][mirror] = std::conj(displacementZ) + timesI(std::conj(slopeX));
+                m_fields[2][mirror] = std::conj(slopeZ);
+            }
+
+            for (std::vector<Complex>& field : m_fields)
+                inverseFFTRows(&field[rowStart], &field[pairedRowStart], n, m_twiddles.data(), m_bitReverse.data(), scratch.data());
+        }
+    });
+
+    // Then along z, two columns at a time, writing the samples straight from the transformed columns
+    pool.parallelFor(0, n / 2, [&](int begin, int end, int) {
+        std::vector<Complex> scratch(2 * rowLength);
+        std::vector<Complex> columns(6 * rowLength);
+        for (int pair = begin; pair < end; ++pair) {
+            const int x = 2 * pair;
+            for (size_t f = 0; f < 3; ++f) {
+                inverseFFTColumns(m_fields[f].data(), x, n, m_twiddles.data(), m_bitReverse.data(),
+                    &columns[2 * f * rowLength], &columns[(2 * f + 1) * rowLength], scratch.data());
+            }
+
+            for (size_t c = 0; c < 2; ++c) {
+                const Complex* heightAndX = &columns[c * rowLength];
+                const Complex* zAndSlopeX = &columns[(2 + c) * rowLength];
+                const Complex* slopeZ = &columns[(4 + c) * rowLength];
+                for (size_t z = 0; z < rowLength; ++z) {
+                    const size_t i = z * rowLength + static_cast<size_t>(x) + c;
+                    m_displacements[i] = glm::vec4(heightAndX[z].imag(), heightAndX[z].real(), zAndSlopeX[z].real(), 0.0f);
+                    m_normals[i] = glm::vec4(glm::normalize(glm::vec3(-zAndSlopeX[z].imag(), 1.0f, -slopeZ[z].real())), 0.0f);
+                }
+            }
+        }
+    });
+}
+
+void RS_OceanSpectrum::sample(float x, float z, glm::vec3& displacement, glm::vec3& normal) const
+{
+    const int n = m_resolution;
+    const float samplesPerUnit = static_cast<float>(n) / m_settings.patchSize;
+    const glm::vec2 position = glm::vec2(x, z) * samplesPerUnit;
+    const glm::vec2 cell = glm::floor(position);
+    const glm::vec2 weight = position - cell;
+
+    const int x0 = static_cast<int>(cell.x) & (n - 1);
+    const int z0 = static_cast<int>(cell.y) & (n - 1);
+    const int x1 = (x0 + 1) & (n - 1);
+    const int z1 = (z0 + 1) & (n - 1);
+    const auto index = [n](int xi, int zi) { return static_cast<size_t>(zi) * static_cast<size_t>(n) + static_cast<size_t>(xi); };
+
+    const auto bilinear = [&](const std::vector<glm::vec4>& samples) {
+        const glm::vec4 near = glm::mix(samples[index(x0, z0)], samples[index(x1, z0)], weight.x);
+        const glm::vec4 far = glm::mix(samples[index(x0, z1)], samples[index(x1, z1)], weight.x);
+        return glm::vec3(glm::mix(near, far, weight.y));
+    };
+    displacement = bilinear(m_displacements);
+    normal = glm::normalize(bilinear(m_normals));
+}
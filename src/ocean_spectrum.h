@@ -0,0 +1,65 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <complex>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Tessendorf ocean: random wave amplitudes drawn from a Phillips spectrum, animated with deep water dispersion and
+// turned into one periodic patch of heights, horizontal (choppy) displacements and normals by inverse FFTs. The
+// patch tiles seamlessly, so any water extent samples it with wrapping instead of needing a larger transform.
+class RS_OceanSpectrum {
+public:
+    struct Settings {
+        float patchSize { 64.0f }; // World units covered by one period of the patch
+        float windSpeed { 9.0f }; // Meters per second
+        float windDirection { 0.0f }; // Radians from +x towards +z
+        float rmsHeight { 0.1f }; // Root mean square of the heights
+        float choppiness { 1.0f }; // Scale of the horizontal displacement
+    };
+
+    // resolution is the number of samples along each side of the patch, a power of two
+    explicit RS_OceanSpectrum(int resolution = 256, uint32_t seed = 0);
+
+    // Draws new wave amplitudes only when the patch size or the wind changed
+    void setSettings(const Settings& settings);
+    const Settings& getSettings() const { return m_settings; }
+
+    // Evaluate the spectrum at the given time in seconds and transform it, on the shared thread pool
+    void simulate(float time);
+
+    int getResolution() const { return m_resolution; }
+    // Samples of the last simulate(), x first: the displacement (x, height, z) and the unit normal; w is unused
+    std::span<const glm::vec4> getDisplacements() const { return m_displacements; }
+    std::span<const glm::vec4> getNormals() const { return m_normals; }
+
+    // Bilinear displacement and normal at world (x, z), repeating with the patch
+    void sample(float x, float z, glm::vec3& displacement, glm::vec3& normal) const;
+
+private:
+    void generateAmplitudes();
+
+    int m_resolution;
+    uint32_t m_seed;
+    Settings m_settings;
+
+    // Amplitude of every wave vector and the conjugate amplitude of its opposite, with unit total variance
+    std::vector<std::complex<float>> m_amplitudes;
+    std::vector<std::complex<float>> m_oppositeAmplitudes;
+    // Angular frequency of every wave vector
+    std::vector<float> m_dispersion;
+    std::vector<std::complex<float>> m_twiddles;
+    std::vector<int> m_bitReverse;
+
+    // Five real fields packed into three complex transforms: height + i * x displacement, z displacement +
+    // i * x slope, and z slope
+    std::vector<std::complex<float>> m_fields[3];
+
+    std::vector<glm::vec4> m_displacements;
+    std::vector<glm::vec4> m_normals;
+};
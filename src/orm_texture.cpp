@@ -0,0 +1,89 @@
+#include "orm_texture.h"
+#include "asset_cache.h"
+#include "thread_pool.h"
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <stb/stb_image_write.h>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t ORM_CACHE_VERSION = 1;
+
+uint8_t sampleRed(const Image* image, int x, int y, int width, int height, uint8_t fallback)
+{
+    if (!image)
+        return fallback;
+    // Nearest neighbour if the two maps differ in size
+    const int sourceX = x * image->width / width;
+    const int sourceY = y * image->height / height;
+    return static_cast<uint8_t>(std::clamp(image->view().getComponent(sourceX, sourceY, 0), 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+} // namespace
+
+std::filesystem::path getPackedORMPath(const std::filesystem::path& metallicFile, const std::filesystem::path& roughnessFile, int sizeLimit)
+{
+    if (metallicFile.empty() && roughnessFile.empty())
+        return {};
+
+    uint64_t hash = ORM_CACHE_VERSION | (uint64_t(sizeLimit) << 32);
+    for (const std::filesystem::path& sourceFile : { metallicFile, roughnessFile }) {
+        if (sourceFile.empty()) {
+            // Keeps "metallic only" and "roughness only" apart
+            hash = hashBytes({}, hash + 1);
+            continue;
+        }
+        const std::optional<uint64_t> stamp = hashFileStamp(sourceFile, hash);
+        if (!stamp)
+            return {};
+        hash = *stamp;
+    }
+
+    return getCacheEntryPath(metallicFile.empty() ? roughnessFile : metallicFile, hash, "_orm.tga");
+}
+
+Image packORMTexture(const Image* metallic, const Image* roughness, const std::filesystem::path& packedFile)
+{
+    const int width = std::max(metallic ? metallic->width : 0, roughness ? roughness->width : 0);
+    const int height = std::max(metallic ? metallic->height : 0, roughness ? roughness->height : 0);
+
+    Image packed(width, height, 3);
+    packed.filePath = packedFile;
+    uint8_t* pixels = packed.get_data();
+    RS_ThreadPool::instance().parallelFor(0, height, [&](int begin, int end, int) {
+        for (int y = begin; y < end; ++y) {
+            for (int x = 0; x < width; ++x) {
+                uint8_t* pixel = pixels + (size_t(y) * size_t(width) + size_t(x)) * 3;
+                pixel[0] = 255;
+                pixel[1] = sampleRed(roughness, x, y, width, height, 128);
+                pixel[2] = sampleRed(metallic, x, y, width, height, 0);
+            }
+        }
+    });
+
+    // Run-length encoded TGA: quick to write and read, and compact for the smooth data of these maps
+    std::vector<std::byte> encoded;
+    stbi_write_tga_to_func(
+        [](void* context, void* data, int size) {
+            auto* output = static_cast<std::vector<std::byte>*>(context);
+            output->insert(std::end(*output), static_cast<const std::byte*>(data), static_cast<const std::byte*>(data) + size);
+        },
+        &encoded, width, height, 3, pixels);
+
+    const std::array<std::span<const std::byte>, 1> chunks { encoded };
+    if (encoded.empty() || !writeFileAtomically(packedFile, chunks))
+        std::cerr << "Failed to write packed ORM texture " << packedFile << std::endl;
+    else
+        std::cout << "Packed ORM texture " << packedFile << " (" << width << "x" << height << ")" << std::endl;
+
+    return packed;
+}
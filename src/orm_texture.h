@@ -0,0 +1,17 @@
+#pragma once
+#include <framework/image.h>
+
+#include <filesystem>
+
+// Occlusion (R), roughness (G) and metallic (B) packed into one texture, following the glTF convention. The packed
+// image is written to the asset cache as a TGA file, so packing happens once per pair of source maps and the result
+// is then compressed and shared like any other texture file.
+
+// Cache entry for the packed texture of the given maps (either may be empty, not both), imported with the given
+// resolution cap (0 = full resolution). Empty if a source is missing.
+std::filesystem::path getPackedORMPath(const std::filesystem::path& metallicFile, const std::filesystem::path& roughnessFile, int sizeLimit = 0);
+
+// Pack the red channels of the source maps (either may be null) at the larger of their resolutions and write the
+// result to packedFile. Occlusion is 1 since materials have no occlusion maps; a missing metallic map packs as 0
+// and a missing roughness map as 0.5, matching the material defaults.
+Image packORMTexture(const Image* metallic, const Image* roughness, const std::filesystem::path& packedFile);
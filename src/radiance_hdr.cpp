@@ -0,0 +1,324 @@
+#include "radiance_hdr.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_RADIANCE_HDR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// RGBE stores value = mantissa * 2^(e - 136) and RGB9_E5 value = mantissa * 2^(E - 24); doubling the 8-bit
+// mantissas into 9 bits gives E = e - 113
+constexpr int RGBE_TO_SHARED_EXPONENT_BIAS = 113;
+constexpr int MAX_SHARED_EXPONENT = 31;
+constexpr uint32_t MAX_MANTISSA = 511;
+constexpr float MAX_SHARED_EXPONENT_VALUE = 65408.0f;
+
+// New-style run-length encoding is only used for scanlines of this width
+constexpr int MIN_RLE_WIDTH = 8;
+constexpr int MAX_RLE_WIDTH = 0x7FFF;
+
+uint32_t packRGBE(uint32_t r, uint32_t g, uint32_t b, uint32_t e)
+{
+    if (e == 0)
+        return 0;
+
+    int exponent = static_cast<int>(e) - RGBE_TO_SHARED_EXPONENT_BIAS;
+    uint32_t mantissas[3] { r << 1, g << 1, b << 1 };
+    if (exponent < 0) {
+        // Below the smallest exponent: shift the mantissas down instead, flushing to zero eventually
+        const int shift = std::min(-exponent, 31);
+        for (uint32_t& mantissa : mantissas)
+            mantissa >>= shift;
+        exponent = 0;
+    } else if (exponent > MAX_SHARED_EXPONENT) {
+        // Above the range: saturate, which only affects extremely bright spots such as the sun
+        const int shift = std::min(exponent - MAX_SHARED_EXPONENT, 16);
+        for (uint32_t& mantissa : mantissas)
+            mantissa = std::min(mantissa << shift, MAX_MANTISSA);
+        exponent = MAX_SHARED_EXPONENT;
+    }
+    return mantissas[0] | (mantissas[1] << 9) | (mantissas[2] << 18) | (static_cast<uint32_t>(exponent) << 27);
+}
+
+#ifdef RS_RADIANCE_HDR_SSE2
+// Pack four texels whose channels are held in 32-bit lanes
+__m128i packRGBE4(__m128i r, __m128i g, __m128i b, __m128i e, uint32_t* texels)
+{
+    const __m128i exponent = _mm_sub_epi32(e, _mm_set1_epi32(RGBE_TO_SHARED_EXPONENT_BIAS));
+    const __m128i isZero = _mm_cmpeq_epi32(e, _mm_setzero_si128());
+    const __m128i isOutOfRange = _mm_andnot_si128(isZero,
+        _mm_or_si128(_mm_cmplt_epi32(exponent, _mm_setzero_si128()), _mm_cmpgt_epi32(exponent, _mm_set1_epi32(MAX_SHARED_EXPONENT))));
+
+    __m128i packed = _mm_slli_epi32(r, 1);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(g, 10));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(b, 19));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(exponent, 27));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(texels), _mm_andnot_si128(isZero, packed));
+    return isOutOfRange;
+}
+#endif
+
+// Convert one scanline held as separate R, G, B and E planes
+void packScanline(const uint8_t* planes, int width, uint32_t* texels)
+{
+    const uint8_t* r = planes;
+    const uint8_t* g = planes + width;
+    const uint8_t* b = planes + 2 * width;
+    const uint8_t* e = planes + 3 * width;
+
+    int x = 0;
+#ifdef RS_RADIANCE_HDR_SSE2
+    // Sixteen texels per iteration: each plane is widened from bytes to 32-bit lanes in four groups. Lanes outside
+    // the exponent range are rare (very dark or very bright texels) and are redone with the scalar code.
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        const __m128i bytes[4] {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(e + x))
+        };
+        __m128i words[4][2];
+        for (int channel = 0; channel < 4; ++channel) {
+            words[channel][0] = _mm_unpacklo_epi8(bytes[channel], zero);
+            words[channel][1] = _mm_unpackhi_epi8(bytes[channel], zero);
+        }
+
+        __m128i isOutOfRange = zero;
+        for (int group = 0; group < 4; ++group) {
+            __m128i lanes[4];
+            for (int channel = 0; channel < 4; ++channel) {
+                const __m128i half = words[channel][group / 2];
+                lanes[channel] = group % 2 == 0 ? _mm_unpacklo_epi16(half, zero) : _mm_unpackhi_epi16(half, zero);
+            }
+            isOutOfRange = _mm_or_si128(isOutOfRange, packRGBE4(lanes[0], lanes[1], lanes[2], lanes[3], texels + x + 4 * group));
+        }
+
+        if (_mm_movemask_epi8(isOutOfRange) != 0) {
+            for (int i = x; i < x + 16; ++i)
+                texels[i] = packRGBE(r[i], g[i], b[i], e[i]);
+        }
+    }
+#endif
+    for (; x < width; ++x)
+        texels[x] = packRGBE(r[x], g[x], b[x], e[x]);
+}
+
+class ScanlineReader {
+public:
+    ScanlineReader(std::span<const std::byte> data, int width)
+        : m_data(reinterpret_cast<const uint8_t*>(data.data()))
+        , m_end(m_data + data.size())
+        , m_width(width)
+    {
+    }
+
+    // Decode the next scanline into R, G, B and E planes of width bytes each
+    bool read(uint8_t* planes)
+    {
+        if (m_end - m_data < 4)
+            return false;
+        const bool isRunLengthEncoded = m_width >= MIN_RLE_WIDTH && m_width <= MAX_RLE_WIDTH
+            && m_data[0] == 2 && m_data[1] == 2 && (m_data[2] & 0x80) == 0;
+        if (!isRunLengthEncoded)
+            return readFlat(planes);
+
+        if (((m_data[2] << 8) | m_data[3]) != m_width)
+            return false;
+        m_data += 4;
+
+        // Every channel is encoded separately as runs of one repeated byte or literal spans
+        for (int channel = 0; channel < 4; ++channel) {
+            uint8_t* plane = planes + channel * m_width;
+            for (int x = 0; x < m_width;) {
+                if (m_data == m_end)
+                    return false;
+                int count = *m_data++;
+                if (count > 128) {
+                    count -= 128;
+                    if (count > m_width - x || m_data == m_end)
+                        return false;
+                    std::memset(plane + x, *m_data++, static_cast<size_t>(count));
+                } else {
+                    if (count == 0 || count > m_width - x || m_end - m_data < count)
+                        return false;
+                    std::memcpy(plane + x, m_data, static_cast<size_t>(count));
+                    m_data += count;
+                }
+                x += count;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Uncompressed texels, possibly with old-style runs: a (1, 1, 1, n) texel repeats the previous one, with the
+    // count of consecutive runs shifted by eight bits each
+    bool readFlat(uint8_t* planes)
+    {
+        int shift = 0;
+        for (int x = 0; x < m_width;) {
+            if (m_end - m_data < 4)
+                return false;
+            const uint8_t* texel = m_data;
+            m_data += 4;
+
+            if (texel[0] == 1 && texel[1] == 1 && texel[2] == 1) {
+                const int count = texel[3] << shift;
+                if (x == 0 || shift > 16 || count > m_width - x)
+                    return false;
+                for (int channel = 0; channel < 4; ++channel) {
+                    uint8_t* plane = planes + channel * m_width;
+                    std::memset(plane + x, plane[x - 1], static_cast<size_t>(count));
+                }
+                x += count;
+                shift += 8;
+                continue;
+            }
+
+            for (int channel = 0; channel < 4; ++channel)
+                planes[channel * m_width + x] = texel[channel];
+            ++x;
+            shift = 0;
+        }
+        return true;
+    }
+
+    const uint8_t* m_data;
+    const uint8_t* m_end;
+    int m_width;
+};
+
+// Read one header line, without its terminating newline
+std::optional<std::string_view> readLine(std::string_view text, size_t& offset)
+{
+    const size_t end = text.find('\n', offset);
+    if (end == std::string_view::npos)
+        return std::nullopt;
+    const std::string_view line = text.substr(offset, end - offset);
+    offset = end + 1;
+    return line;
+}
+
+uint32_t packFloat(float r, float g, float b)
+{
+    // Following the reference encoding of EXT_texture_shared_exponent: the largest channel picks the exponent
+    r = std::clamp(r, 0.0f, MAX_SHARED_EXPONENT_VALUE);
+    g = std::clamp(g, 0.0f, MAX_SHARED_EXPONENT_VALUE);
+    b = std::clamp(b, 0.0f, MAX_SHARED_EXPONENT_VALUE);
+    const float maxChannel = std::max({ r, g, b });
+    if (!(maxChannel > 0.0f))
+        return 0;
+
+    int exponent = std::max(-16, std::ilogb(maxChannel)) + 16;
+    float scale = std::ldexp(1.0f, 24 - exponent);
+    if (static_cast<uint32_t>(maxChannel * scale + 0.5f) > MAX_MANTISSA) {
+        ++exponent;
+        scale *= 0.5f;
+    }
+    exponent = std::min(exponent, MAX_SHARED_EXPONENT);
+
+    const uint32_t red = std::min(static_cast<uint32_t>(r * scale + 0.5f), MAX_MANTISSA);
+    const uint32_t green = std::min(static_cast<uint32_t>(g * scale + 0.5f), MAX_MANTISSA);
+    const uint32_t blue = std::min(static_cast<uint32_t>(b * scale + 0.5f), MAX_MANTISSA);
+    return red | (green << 9) | (blue << 18) | (static_cast<uint32_t>(exponent) << 27);
+}
+
+} // namespace
+
+void RS_SharedExponentImage::unpackRow(int y, float* rgb) const
+{
+    const uint32_t* row = &texels[static_cast<size_t>(y) * static_cast<size_t>(width)];
+    for (int x = 0; x < width; ++x, rgb += 3) {
+        const uint32_t texel = row[x];
+        const float scale = std::ldexp(1.0f, static_cast<int>(texel >> 27) - 24);
+        rgb[0] = static_cast<float>(texel & 0x1FF) * scale;
+        rgb[1] = static_cast<float>((texel >> 9) & 0x1FF) * scale;
+        rgb[2] = static_cast<float>((texel >> 18) & 0x1FF) * scale;
+    }
+}
+
+bool isRadianceHDR(std::span<const std::byte> encoded)
+{
+    const std::string_view text(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    return text.starts_with("#?RADIANCE\n") || text.starts_with("#?RGBE\n");
+}
+
+std::optional<RS_SharedExponentImage> decodeRadianceHDR(std::span<const std::byte> encoded, const std::filesystem::path& filePath)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    if (!isRadianceHDR(encoded)) {
+        std::cerr << "Not a Radiance HDR file: " << filePath << std::endl;
+        return std::nullopt;
+    }
+
+    // Header lines up to an empty line, then the resolution line
+    const std::string_view text(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    size_t offset = 0;
+    std::optional<std::string_view> line;
+    while ((line = readLine(text, offset)) && !line->empty()) {
+        if (line->starts_with("FORMAT=") && *line != "FORMAT=32-bit_rle_rgbe") {
+            std::cerr << "Unsupported Radiance HDR pixel format \"" << line->substr(7) << "\" in " << filePath << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    RS_SharedExponentImage image;
+    image.filePath = filePath;
+    char resolution[64] {};
+    if (line)
+        line = readLine(text, offset);
+    if (line)
+        line->copy(resolution, std::min(line->size(), sizeof(resolution) - 1));
+    if (!line || std::sscanf(resolution, "-Y %d +X %d", &image.height, &image.width) != 2 || image.width <= 0 || image.height <= 0) {
+        std::cerr << "Unsupported Radiance HDR orientation or malformed header in " << filePath << std::endl;
+        return std::nullopt;
+    }
+
+    image.texels.resize(static_cast<size_t>(image.width) * static_cast<size_t>(image.height));
+    std::vector<uint8_t> planes(4 * static_cast<size_t>(image.width));
+    ScanlineReader reader(encoded.subspan(offset), image.width);
+    for (int y = 0; y < image.height; ++y) {
+        if (!reader.read(planes.data())) {
+            std::cerr << "Corrupt or truncated scanline " << y << " in " << filePath << std::endl;
+            return std::nullopt;
+        }
+        packScanline(planes.data(), image.width, &image.texels[static_cast<size_t>(y) * static_cast<size_t>(image.width)]);
+    }
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    const float milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+    std::cout << "Decoded Radiance HDR " << filePath << " (" << image.width << "x" << image.height << ") in " << milliseconds << " ms, "
+              << static_cast<float>(image.texels.size()) / (1000.0f * std::max(milliseconds, 1e-3f)) << " Mtexels/s" << std::endl;
+    return image;
+}
+
+RS_SharedExponentImage packSharedExponent(const ImageView& pixels)
+{
+    RS_SharedExponentImage image;
+    image.width = pixels.width;
+    image.height = pixels.height;
+    image.texels.resize(static_cast<size_t>(pixels.width) * static_cast<size_t>(pixels.height));
+    assert(pixels.channels >= 1);
+
+    // Grey images are replicated into all three channels
+    const int greenChannel = std::min(1, pixels.channels - 1);
+    const int blueChannel = std::min(2, pixels.channels - 1);
+    for (int y = 0; y < pixels.height; ++y) {
+        uint32_t* texels = &image.texels[static_cast<size_t>(y) * static_cast<size_t>(pixels.width)];
+        for (int x = 0; x < pixels.width; ++x)
+            texels[x] = packFloat(pixels.getComponent(x, y, 0), pixels.getComponent(x, y, greenChannel), pixels.getComponent(x, y, blueChannel));
+    }
+    return image;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <framework/image.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// HDR pixels in the shared-exponent layout of GL_RGB9_E5 / GL_UNSIGNED_INT_5_9_9_9_REV: 9-bit red, green and blue
+// mantissas from the low bits up, then a 5-bit exponent. Four bytes per texel instead of twelve for float RGB.
+struct RS_SharedExponentImage {
+    int width { 0 };
+    int height { 0 };
+    std::vector<uint32_t> texels;
+    std::filesystem::path filePath;
+
+    // Expand row y to width float RGB triplets
+    void unpackRow(int y, float* rgb) const;
+    size_t getByteSize() const { return texels.size() * sizeof(uint32_t); }
+};
+
+// Whether the data starts with a Radiance (.hdr) signature
+bool isRadianceHDR(std::span<const std::byte> encoded);
+
+// Decode a Radiance RGBE image, with flat or run-length encoded scanlines, straight to shared-exponent texels. RGBE
+// maps onto RGB9_E5 without loss except for values outside its range (about 6e-8 to 65408), which are clamped.
+// Returns an empty optional if the file is malformed or not stored top to bottom, left to right.
+std::optional<RS_SharedExponentImage> decodeRadianceHDR(std::span<const std::byte> encoded, const std::filesystem::path& filePath = {});
+
+// Pack pixels of any format; grey images are replicated into RGB and alpha is dropped
+RS_SharedExponentImage packSharedExponent(const ImageView& pixels);
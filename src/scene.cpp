@@ -3,7 +3,14 @@
 //
 
 #include "scene.h"
+#include "asset_cache.h"
+#include "constants.h"
+#include "environment_cache.h"
+#include "mesh_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <string>
 #include <cmath>
 #include <framework/disable_all_warnings.h>
@@ -12,10 +19,94 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 DISABLE_WARNINGS_POP()
+#include <iostream>
 
 namespace {
 constexpr GLint SHADOW_MAP_TEXTURE_UNIT = 5;
 constexpr GLint SHADOW_CUBEMAP_TEXTURE_UNIT = 6;
+
+void setTextureToggles(const Shader& shader, const RS_RenderSettings& settings)
+{
+    glUniform1i(shader.getUniformLocation("enableColorTextures"), settings.enableColorTextures ? 1 : 0);
+    glUniform1i(shader.getUniformLocation("enableNormalTextures"), settings.enableNormalTextures ? 1 : 0);
+    glUniform1i(shader.getUniformLocation("enableMetallicTextures"), settings.enableMetallicTextures ? 1 : 0);
+    glUniform1i(shader.getUniformLocation("enableGammaCorrection"), settings.enableGammaCorrection ? 1 : 0);
+    glUniform1i(shader.getUniformLocation("enableToneMapping"), settings.enableToneMapping ? 1 : 0);
+}
+
+// Uniforms of the lighting pass that are shared by all lights
+void setLightingUniforms(const Shader& shader, const Trackball& camera, const RS_RenderSettings& settings)
+{
+    setTextureToggles(shader, settings);
+
+    glUniform3fv(shader.getUniformLocation("cameraPosition"), 1, glm::value_ptr(camera.position()));
+    glUniform1i(shader.getUniformLocation("enableShadows"), settings.enableShadows ? 1 : 0);
+    glUniform1i(shader.getUniformLocation("enableShadowPCF"), settings.enableShadowPCF ? 1 : 0);
+    glUniform2f(shader.getUniformLocation("shadowMapTexelSize"), 1.0f / RS_SHADOW_MAP_SIZE, 1.0f / RS_SHADOW_MAP_SIZE);
+}
+
+void setLightUniforms(const Shader& shader, const RS_Light& light, const RS_RenderSettings& settings)
+{
+    glUniform3fv(shader.getUniformLocation("lightPosition"), 1, glm::value_ptr(light.m_position));
+    glUniform3fv(shader.getUniformLocation("lightColor"), 1, glm::value_ptr(light.m_color));
+    glUniform1f(shader.getUniformLocation("lightIntensity"), light.m_intensity);
+    glUniform1i(shader.getUniformLocation("lightType"), static_cast<int>(light.m_type));
+
+    const glm::vec3 lightDir = light.getDirection();
+
+    glUniform3fv(shader.getUniformLocation("lightDirection"), 1, glm::value_ptr(lightDir));
+    glUniform1f(shader.getUniformLocation("spotlightCosCutoff"), glm::cos(light.m_spotFov * 0.5f));
+    glUniform1f(shader.getUniformLocation("shadowFarPlane"), light.getShadowFarPlane());
+
+    if (settings.enableShadows) {
+        if (light.m_type == RS_LIGHT_TYPE_SPOT && light.m_shadowMapTexture) {
+            glUniformMatrix4fv(
+                shader.getUniformLocation("lightSpaceMatrix"),
+                1,
+                GL_FALSE,
+                glm::value_ptr(light.getLightSpaceMatrix()));
+
+            light.bindShadowMap(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+            glUniform1i(shader.getUniformLocation("shadowMap"), SHADOW_MAP_TEXTURE_UNIT);
+        } else if (light.m_type == RS_LIGHT_TYPE_POINT && light.m_cubeMapTexture) {
+            light.bindCubeMap(GL_TEXTURE0 + SHADOW_CUBEMAP_TEXTURE_UNIT);
+            glUniform1i(shader.getUniformLocation("shadowCubemap"), SHADOW_CUBEMAP_TEXTURE_UNIT);
+        }
+    }
+}
+
+void setCubemapShadowUniforms(const Shader& shader, const RS_Light& light)
+{
+    const std::array<glm::mat4, 6>& shadowTransforms = light.getShadowTransforms();
+    for (int i = 0; i < 6; ++i) {
+        const std::string uniformName = "shadowMatrices[" + std::to_string(i) + "]";
+        glUniformMatrix4fv(
+            shader.getUniformLocation(uniformName.c_str()),
+            1,
+            GL_FALSE,
+            glm::value_ptr(shadowTransforms[i]));
+    }
+
+    glUniform3fv(shader.getUniformLocation("lightPosition"), 1, glm::value_ptr(light.m_position));
+    glUniform1f(shader.getUniformLocation("farPlane"), light.getShadowFarPlane());
+}
+
+// Draw the water with the pass shader, or with the program of its tessellated path after giving that the same
+// pass uniforms; the pass shader is bound again afterwards
+template <typename SetPassUniforms, typename Draw>
+void drawWaterPass(const WaterSurface& water, RS_WaterPass pass, const Shader& passShader, SetPassUniforms&& setPassUniforms, Draw&& draw)
+{
+    const Shader* waterShader = water.getPassShader(pass);
+    if (!waterShader) {
+        draw(passShader);
+        return;
+    }
+
+    waterShader->bind();
+    setPassUniforms(*waterShader);
+    draw(*waterShader);
+    passShader.bind();
+}
 }
 
 RS_Scene::RS_Scene()
@@ -38,17 +129,8 @@ void RS_Scene::draw(const Shader& drawShader, RS_RenderSettings settings)
     const glm::mat4 projectionMatrix = camera.projectionMatrix();
     const glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
 
-    // Set global texture toggles
-    glUniform1i(drawShader.getUniformLocation("enableColorTextures"), settings.enableColorTextures ? 1 : 0);
-    glUniform1i(drawShader.getUniformLocation("enableNormalTextures"), settings.enableNormalTextures ? 1 : 0);
-    glUniform1i(drawShader.getUniformLocation("enableMetallicTextures"), settings.enableMetallicTextures ? 1 : 0);
-    glUniform1i(drawShader.getUniformLocation("enableGammaCorrection"), settings.enableGammaCorrection ? 1 : 0);
-    glUniform1i(drawShader.getUniformLocation("enableToneMapping"), settings.enableToneMapping ? 1 : 0);
-
-    glUniform3fv(drawShader.getUniformLocation("cameraPosition"), 1, glm::value_ptr(camera.position()));
-    glUniform1i(drawShader.getUniformLocation("enableShadows"), settings.enableShadows ? 1 : 0);
-    glUniform1i(drawShader.getUniformLocation("enableShadowPCF"), settings.enableShadowPCF ? 1 : 0);
-    glUniform2f(drawShader.getUniformLocation("shadowMapTexelSize"), 1.0f / RS_SHADOW_MAP_SIZE, 1.0f / RS_SHADOW_MAP_SIZE);
+    // Set global texture toggles and camera
+    setLightingUniforms(drawShader, camera, settings);
 
     if (!m_lights.empty()) {
         glEnable(GL_BLEND);
@@ -59,41 +141,22 @@ void RS_Scene::draw(const Shader& drawShader, RS_RenderSettings settings)
 
     // Multi-pass lighting: render scene once for each light with additive blending
     for (size_t lightIndex = 0; lightIndex < m_lights.size(); lightIndex++) {
-        RS_Light& light = m_lights[lightIndex];
-
-        glUniform3fv(drawShader.getUniformLocation("lightPosition"), 1, glm::value_ptr(light.m_position));
-        glUniform3fv(drawShader.getUniformLocation("lightColor"), 1, glm::value_ptr(light.m_color));
-        glUniform1f(drawShader.getUniformLocation("lightIntensity"), light.m_intensity);
-        glUniform1i(drawShader.getUniformLocation("lightType"), static_cast<int>(light.m_type));
-
-        const glm::vec3 lightDir = light.getDirection();
-
-        glUniform3fv(drawShader.getUniformLocation("lightDirection"), 1, glm::value_ptr(lightDir));
-        glUniform1f(drawShader.getUniformLocation("spotlightCosCutoff"), glm::cos(light.m_spotFov * 0.5f));
-        glUniform1f(drawShader.getUniformLocation("shadowFarPlane"), light.getShadowFarPlane());
-
-        if (settings.enableShadows) {
-            if (light.m_type == RS_LIGHT_TYPE_SPOT && light.m_shadowMapTexture) {
-                glUniformMatrix4fv(
-                    drawShader.getUniformLocation("lightSpaceMatrix"),
-                    1,
-                    GL_FALSE,
-                    glm::value_ptr(light.getLightSpaceMatrix()));
-
-                light.bindShadowMap(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
-                glUniform1i(drawShader.getUniformLocation("shadowMap"), SHADOW_MAP_TEXTURE_UNIT);
-            } else if (light.m_type == RS_LIGHT_TYPE_POINT && light.m_cubeMapTexture) {
-                light.bindCubeMap(GL_TEXTURE0 + SHADOW_CUBEMAP_TEXTURE_UNIT);
-                glUniform1i(drawShader.getUniformLocation("shadowCubemap"), SHADOW_CUBEMAP_TEXTURE_UNIT);
-            }
-        }
+        const RS_Light& light = m_lights[lightIndex];
+        setLightUniforms(drawShader, light, settings);
 
         for (RS_Model& model : m_models) {
             model.draw(drawShader, viewProjectionMatrix);
         }
 
-        if (m_water)
-            m_water->draw(drawShader, viewProjectionMatrix);
+        if (m_water) {
+            drawWaterPass(
+                *m_water, RS_WaterPass::Lighting, drawShader,
+                [&](const Shader& shader) {
+                    setLightingUniforms(shader, camera, settings);
+                    setLightUniforms(shader, light, settings);
+                },
+                [&](const Shader& shader) { m_water->draw(shader, viewProjectionMatrix); });
+        }
     }
 
     if (!m_lights.empty()) {
@@ -117,12 +180,25 @@ void RS_Scene::drawEnvironment(const Shader& envShader, RS_RenderSettings settin
     const glm::mat4 projectionMatrix = camera.projectionMatrix();
     const glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
 
-    // Set global texture toggles
-    glUniform1i(envShader.getUniformLocation("enableColorTextures"), settings.enableColorTextures ? 1 : 0);
-    glUniform1i(envShader.getUniformLocation("enableNormalTextures"), settings.enableNormalTextures ? 1 : 0);
-    glUniform1i(envShader.getUniformLocation("enableMetallicTextures"), settings.enableMetallicTextures ? 1 : 0);
-    glUniform1i(envShader.getUniformLocation("enableGammaCorrection"), settings.enableGammaCorrection ? 1 : 0);
-    glUniform1i(envShader.getUniformLocation("enableToneMapping"), settings.enableToneMapping ? 1 : 0);
+    // Set global texture toggles, camera and environment lighting
+    setEnvironmentUniforms(envShader, camera, settings);
+
+    // Draw all models with environment shader (writes depth)
+    for (RS_Model& model : m_models) {
+        model.draw(envShader, viewProjectionMatrix);
+    }
+
+    if (m_water) {
+        drawWaterPass(
+            *m_water, RS_WaterPass::Environment, envShader,
+            [&](const Shader& shader) { setEnvironmentUniforms(shader, camera, settings); },
+            [&](const Shader& shader) { m_water->drawEnvironment(shader, viewProjectionMatrix); });
+    }
+}
+
+void RS_Scene::setEnvironmentUniforms(const Shader& envShader, const Trackball& camera, const RS_RenderSettings& settings) const
+{
+    setTextureToggles(envShader, settings);
 
     glActiveTexture(GL_TEXTURE0);
     m_environmentCubemap->bind(GL_TEXTURE0);
@@ -130,13 +206,163 @@ void RS_Scene::drawEnvironment(const Shader& envShader, RS_RenderSettings settin
     glUniform3fv(envShader.getUniformLocation("cameraPosition"), 1, glm::value_ptr(camera.position()));
     glUniform1f(envShader.getUniformLocation("envBrightness"), m_envBrightness);
 
-    // Draw all models with environment shader (writes depth)
-    for (RS_Model& model : m_models) {
-        model.draw(envShader, viewProjectionMatrix);
+    const bool useSHDiffuse = settings.enableSHDiffuse && m_hasEnvironmentSH;
+    glUniform1i(envShader.getUniformLocation("useSHDiffuse"), useSHDiffuse ? 1 : 0);
+    if (useSHDiffuse) {
+        glUniform3fv(envShader.getUniformLocation("shCoefficients"), 9, glm::value_ptr(m_environmentSH.coefficients[0]));
     }
+}
+
+void RS_Scene::setEnvironmentMap(std::filesystem::path filePath, bool isHDR, int cubemapResolution)
+{
+    applyEnvironmentMap(prepareEnvironmentMap(std::move(filePath), isHDR, cubemapResolution));
+}
 
-    if (m_water)
-        m_water->drawEnvironment(envShader, viewProjectionMatrix);
+RS_LoadTask RS_Scene::setEnvironmentMapAsync(RS_AsyncLoader& loader, std::filesystem::path filePath, bool isHDR, int cubemapResolution)
+{
+    const auto scope = loader.trackTask();
+
+    co_await loader.resumeOnWorker();
+    RS_EnvironmentSource source = prepareEnvironmentMap(std::move(filePath), isHDR, cubemapResolution);
+
+    co_await loader.resumeOnMainThread();
+    applyEnvironmentMap(std::move(source));
+}
+
+RS_EnvironmentSource RS_Scene::prepareEnvironmentMap(std::filesystem::path filePath, bool isHDR, int cubemapResolution)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    RS_EnvironmentSource source;
+    source.isHDR = isHDR;
+    source.cubemapResolution = cubemapResolution;
+
+    // Baked cubemaps are keyed on the source contents, so the source is read exactly once either way
+    const std::optional<std::vector<std::byte>> fileBytes = readFileBytes(filePath);
+    if (fileBytes) {
+        source.cachePath = getEnvironmentCachePath(filePath, hashBytes(*fileBytes), cubemapResolution);
+
+        source.bake = readEnvironmentCache(source.cachePath);
+        if (source.bake && source.bake->resolution != cubemapResolution)
+            source.bake.reset();
+    }
+
+    if (!source.bake && isHDR && fileBytes) {
+        // Decode once on the CPU so the same pixels feed both the SH projection and the GPU upload. Radiance files
+        // are decoded straight to shared-exponent texels, anything else (such as half-float OpenEXR) is packed.
+        if (isRadianceHDR(*fileBytes))
+            source.hdrImage = decodeRadianceHDR(*fileBytes, filePath);
+        if (!source.hdrImage) {
+            try {
+                const Image image = Image::fromMemory(*fileBytes, {}, filePath);
+                source.hdrImage = packSharedExponent(image.view());
+                source.hdrImage->filePath = filePath;
+            } catch (const std::exception&) {
+                // Already reported by the decoder; the main thread falls back to loading the file directly
+            }
+        }
+        if (source.hdrImage)
+            source.diffuseSH = projectEquirectToSH(*source.hdrImage).toDiffuseRadiance();
+    }
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Prepared environment map " << filePath << (source.bake ? " from cache" : "") << " in "
+              << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+
+    source.filePath = std::move(filePath);
+    return source;
+}
+
+void RS_Scene::applyEnvironmentMap(RS_EnvironmentSource source)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    if (source.bake) {
+        const RS_EnvironmentBake& bake = *source.bake;
+        m_environmentCubemap = std::make_unique<RS_Cubemap>(bake.resolution, bake.mipCount, bake.faceData.data());
+        m_environmentSH = bake.diffuseSH;
+        m_hasEnvironmentSH = bake.hasDiffuseSH;
+    } else {
+        // Load the equirectangular texture
+        std::unique_ptr<RS_Texture> equirectTexture;
+        if (source.hdrImage)
+            equirectTexture = std::make_unique<RS_Texture>(*source.hdrImage, GL_R11F_G11F_B10F);
+        else
+            equirectTexture = std::make_unique<RS_Texture>(source.filePath, source.isHDR);
+        equirectTexture->setEnvironmentMapWrapping();
+
+        // Convert to cubemap
+        m_environmentCubemap = std::make_unique<RS_Cubemap>(*equirectTexture, source.cubemapResolution);
+        m_hasEnvironmentSH = source.diffuseSH.has_value();
+        if (source.diffuseSH)
+            m_environmentSH = *source.diffuseSH;
+
+        if (!source.cachePath.empty()) {
+            // Bake the result so later runs skip decoding and conversion; the file is written in the background
+            RS_EnvironmentBake bake;
+            bake.resolution = m_environmentCubemap->getResolution();
+            bake.mipCount = m_environmentCubemap->getMipCount();
+            bake.faceData = m_environmentCubemap->readSharedExponentFaces();
+            bake.hasDiffuseSH = m_hasEnvironmentSH;
+            bake.diffuseSH = m_environmentSH;
+
+            RS_ThreadPool::instance().submit([cachePath = source.cachePath, bake = std::move(bake)]() {
+                if (writeEnvironmentCache(cachePath, bake))
+                    std::cout << "Wrote environment cache " << cachePath << std::endl;
+            });
+        }
+    }
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Uploaded environment map " << source.filePath << " in "
+              << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+}
+
+RS_LoadTask RS_Scene::loadModelAsync(RS_AsyncLoader& loader, size_t modelIndex, std::filesystem::path filePath, bool normalize)
+{
+    const auto scope = loader.trackTask();
+
+    // OBJ parsing (or mapping the mesh cache), texture decoding, downscaling, ORM packing and block compression
+    co_await loader.resumeOnWorker();
+    const RS_MaterialImportSettings importSettings {
+        RS_COMPRESS_MATERIAL_TEXTURES, RS_PACK_ORM_TEXTURES, getTextureSizeLimit(RS_TEXTURE_QUALITY), RS_TEXTURE_IMPORT_BUDGET
+    };
+    const RS_MeshData meshData = RS_MeshData::load(filePath, normalize, importSettings);
+
+    bool placeholderRemoved = false;
+    for (const RS_MeshData::SubMesh& subMesh : meshData.getSubMeshes()) {
+        // Upload one sub-mesh (geometry and its textures) per main-thread slice to keep frames short
+        co_await loader.resumeOnMainThread();
+
+        GPUMesh gpuMesh(subMesh.vertices, subMesh.triangles, subMesh.material);
+        RS_Material material = RS_Material::createFromMesh(gpuMesh, subMesh.importedTextures, RS_STREAM_MATERIAL_TEXTURES);
+        material.footprint = RS_TextureFootprint {
+            (subMesh.boundsMin + subMesh.boundsMax) * 0.5f, glm::length(subMesh.boundsMax - subMesh.boundsMin) * 0.5f, subMesh.uvDensity
+        };
+
+        RS_Model& model = m_models[modelIndex];
+        if (!placeholderRemoved) {
+            model.clearMeshes();
+            placeholderRemoved = true;
+        }
+        model.addMesh(std::move(gpuMesh));
+        model.addMaterial(std::move(material));
+    }
+
+    std::cout << "Finished loading " << filePath << " (" << meshData.getSubMeshes().size() << " meshes)" << std::endl;
+}
+
+void RS_Scene::requestStreamedTextures(float viewportHeight) const
+{
+    if (m_cameras.empty()) {
+        return;
+    }
+
+    const Trackball& camera = getActiveCamera();
+    const glm::mat4 viewProjectionMatrix = camera.projectionMatrix() * camera.viewMatrix();
+    for (const RS_Model& model : m_models) {
+        model.requestStreamedTextures(viewProjectionMatrix, viewportHeight);
+    }
 }
 
 void RS_Scene::drawSkybox(const Shader& skyboxShader, GLuint skyboxVAO)
@@ -216,8 +442,12 @@ void RS_Scene::renderShadowMaps(const Shader& shadowShader,
                 model.drawDepth(shadowShader, lightSpaceMatrix);
             }
 
-            if (m_water)
-                m_water->drawDepth(shadowShader, lightSpaceMatrix);
+            if (m_water) {
+                drawWaterPass(
+                    *m_water, RS_WaterPass::Depth, shadowShader,
+                    [](const Shader&) {},
+                    [&](const Shader& shader) { m_water->drawDepth(shader, lightSpaceMatrix); });
+            }
         } else if (light.m_type == RS_LIGHT_TYPE_POINT && light.m_cubeMapTexture) {
             const int resolution = light.m_cubeMapTexture->getResolution();
             glViewport(0, 0, resolution, resolution);
@@ -245,25 +475,18 @@ void RS_Scene::renderShadowMaps(const Shader& shadowShader,
                 shadowProj * glm::lookAt(light.m_position, light.m_position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
             };
             light.setShadowTransforms(shadowTransforms);
-
-            for (int i = 0; i < 6; ++i) {
-                const std::string uniformName = "shadowMatrices[" + std::to_string(i) + "]";
-                glUniformMatrix4fv(
-                    shadowCubemapShader.getUniformLocation(uniformName.c_str()),
-                    1,
-                    GL_FALSE,
-                    glm::value_ptr(shadowTransforms[i]));
-            }
-
-            glUniform3fv(shadowCubemapShader.getUniformLocation("lightPosition"), 1, glm::value_ptr(light.m_position));
-            glUniform1f(shadowCubemapShader.getUniformLocation("farPlane"), farPlane);
+            setCubemapShadowUniforms(shadowCubemapShader, light);
 
             for (RS_Model& model : m_models) {
                 model.drawDepthCubemap(shadowCubemapShader);
             }
 
-            if (m_water)
-                m_water->drawDepthCubemap(shadowCubemapShader);
+            if (m_water) {
+                drawWaterPass(
+                    *m_water, RS_WaterPass::DepthCubemap, shadowCubemapShader,
+                    [&](const Shader& shader) { setCubemapShadowUniforms(shader, light); },
+                    [&](const Shader& shader) { m_water->drawDepthCubemap(shader); });
+            }
         }
     }
 
@@ -273,10 +496,100 @@ void RS_Scene::renderShadowMaps(const Shader& shadowShader,
     glDepthMask(GL_TRUE);
 }
 
-void RS_Scene::updateWaterSurface(const glm::vec3& focusPosition, float deltaTime)
+void RS_Scene::updateWaterSurface(const glm::vec3& focusPosition, float deltaTime, float viewportHeight)
+{
+    if (!m_water)
+        return;
+
+    if (!m_cameras.empty()) {
+        const Trackball& camera = getActiveCamera();
+        m_water->setViewer(camera.position(), 0.5f * viewportHeight * camera.projectionMatrix()[1][1]);
+    }
+    m_water->update(focusPosition, deltaTime);
+    floatModels(deltaTime);
+}
+
+void RS_Scene::floatModels(float deltaTime)
 {
-    if (m_water)
-        m_water->update(focusPosition, deltaTime);
+    m_hullPositions.clear();
+    for (const RS_Model& model : m_models) {
+        const glm::mat4 pathMatrix = model.getPathMatrix();
+        for (const glm::vec3& point : model.getBuoyancy().hullPoints) {
+            const glm::vec3 world(pathMatrix * glm::vec4(point, 1.0f));
+            m_hullPositions.emplace_back(world.x, world.z);
+        }
+    }
+    if (m_hullPositions.empty())
+        return;
+
+    m_hullHeights.resize(m_hullPositions.size());
+    if (m_water->isEnabled())
+        m_water->sampleSurface(m_hullPositions, m_hullHeights);
+    else
+        std::fill(m_hullHeights.begin(), m_hullHeights.end(), m_water->getHeightOffset());
+
+    // Fit a plane through the rise of the water above its calm level at the hull points, in the horizontal
+    // directions along and across each model: its height at the origin is the heave, its slopes give pitch and roll
+    size_t next = 0;
+    for (RS_Model& model : m_models) {
+        RS_Buoyancy& buoyancy = model.getBuoyancy();
+        if (buoyancy.hullPoints.empty())
+            continue;
+
+        const glm::mat4 pathMatrix = model.getPathMatrix();
+        const glm::vec3 origin(pathMatrix[3]);
+        glm::vec2 forward(pathMatrix[2].x, pathMatrix[2].z);
+        forward = glm::length(forward) > 1e-6f ? glm::normalize(forward) : glm::vec2(0.0f, 1.0f);
+        const glm::vec2 right(forward.y, -forward.x); // The model's +x, as the animation orients it
+
+        // The hull moving along its path stirs up the wake; the hull points span its footprint
+        const glm::vec2 position(origin.x, origin.z);
+        if (buoyancy.lastPosition && deltaTime > 0.0f) {
+            glm::vec2 halfSize(0.0f);
+            for (const glm::vec3& point : buoyancy.hullPoints)
+                halfSize = glm::max(halfSize, glm::abs(glm::vec2(point.z, point.x)));
+            halfSize *= glm::vec2(glm::length(glm::vec3(pathMatrix[2])), glm::length(glm::vec3(pathMatrix[0])));
+            m_water->addWakeSource(position, forward, halfSize, (position - *buoyancy.lastPosition) / deltaTime, buoyancy.draft);
+        }
+        buoyancy.lastPosition = position;
+
+        const size_t count = buoyancy.hullPoints.size();
+        glm::vec3 mean(0.0f); // Along, across and rise
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec2 offset = m_hullPositions[next + i] - glm::vec2(origin.x, origin.z);
+            mean += glm::vec3(glm::dot(offset, forward), glm::dot(offset, right), m_hullHeights[next + i] - m_water->getHeightOffset());
+        }
+        mean /= static_cast<float>(count);
+
+        float alongAlong = 0.0f, acrossAcross = 0.0f, alongAcross = 0.0f, alongRise = 0.0f, acrossRise = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec2 offset = m_hullPositions[next + i] - glm::vec2(origin.x, origin.z);
+            const float along = glm::dot(offset, forward) - mean.x;
+            const float across = glm::dot(offset, right) - mean.y;
+            const float rise = m_hullHeights[next + i] - m_water->getHeightOffset() - mean.z;
+            alongAlong += along * along;
+            acrossAcross += across * across;
+            alongAcross += along * across;
+            alongRise += along * rise;
+            acrossRise += across * rise;
+        }
+        next += count;
+
+        // Hull points on a single line only determine the slope along it
+        float slopeAlong = alongAlong > 1e-6f ? alongRise / alongAlong : 0.0f;
+        float slopeAcross = acrossAcross > 1e-6f ? acrossRise / acrossAcross : 0.0f;
+        const float determinant = alongAlong * acrossAcross - alongAcross * alongAcross;
+        if (determinant > 1e-6f * alongAlong * acrossAcross) {
+            slopeAlong = (alongRise * acrossAcross - acrossRise * alongAcross) / determinant;
+            slopeAcross = (acrossRise * alongAlong - alongRise * alongAcross) / determinant;
+        }
+
+        const float heave = mean.z - slopeAlong * mean.x - slopeAcross * mean.y;
+        const float follow = 1.0f - std::exp(-deltaTime * buoyancy.response);
+        buoyancy.heave += (heave - buoyancy.heave) * follow;
+        buoyancy.pitch += (std::atan(slopeAlong) - buoyancy.pitch) * follow;
+        buoyancy.roll += (std::atan(slopeAcross) - buoyancy.roll) * follow;
+    }
 }
 
 glm::vec3 RS_Scene::getProceduralFocusPoint() const
@@ -5,6 +5,7 @@
 #ifndef COMPUTERGRAPHICS_RSSCENE_H
 #define COMPUTERGRAPHICS_RSSCENE_H
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 #include <glm/vec2.hpp>
@@ -12,7 +13,11 @@
 #include "light.h"
 #include "model.h"
 #include "texture.h"
+#include "async_loader.h"
 #include "cubemap.h"
+#include "environment_cache.h"
+#include "radiance_hdr.h"
+#include "spherical_harmonics.h"
 #include "water_surface.h"
 #include "framework/trackball.h"
 #include "framework/shader.h"
@@ -26,6 +31,22 @@ struct RS_RenderSettings
     bool enableGammaCorrection = true;
     bool enableShadows = true;
     bool enableShadowPCF = true;
+    bool enableSHDiffuse = true;
+};
+
+// CPU-side half of loading an environment map: either a cache hit or the decoded source pixels.
+// Produced by RS_Scene::prepareEnvironmentMap without touching OpenGL, so it can be built on a worker thread.
+struct RS_EnvironmentSource
+{
+    std::filesystem::path filePath;
+    std::filesystem::path cachePath; // Empty if the source could not be read
+    bool isHDR { true };
+    int cubemapResolution { 512 };
+
+    std::optional<RS_EnvironmentBake> bake;
+
+    std::optional<RS_SharedExponentImage> hdrImage; // Decoded only on a cache miss
+    std::optional<RS_SHCoefficients> diffuseSH;
 };
 
 class RS_Scene
@@ -39,6 +60,9 @@ public:
     // Draw environment map contribution
     void drawEnvironment(const Shader& envShader, RS_RenderSettings settings);
 
+    // Ask streamed textures for the mips the models need from the active camera
+    void requestStreamedTextures(float viewportHeight) const;
+
     // Draw skybox background
     void drawSkybox(const Shader& skyboxShader, GLuint skyboxVAO);
 
@@ -74,23 +98,32 @@ public:
     void addModel(RS_Model&& model) { m_models.push_back(std::move(model)); }
     size_t getModelCount() const { return m_models.size(); }
 
+    // Parse the model file and decode its textures on a worker thread, then replace the (placeholder) meshes of
+    // the model at modelIndex one sub-mesh per main-thread slice. The scene must stay at the same address until done.
+    RS_LoadTask loadModelAsync(RS_AsyncLoader& loader, size_t modelIndex, std::filesystem::path filePath, bool normalize);
+
     WaterSurface& getWater() { return *m_water; }
     const WaterSurface& getWater() const { return *m_water; }
 
-    void updateWaterSurface(const glm::vec3& focusPosition, float deltaTime);
+    // Animate the water around the focus point and choose its tessellation for the active camera, then float the
+    // models that have hull points on it
+    void updateWaterSurface(const glm::vec3& focusPosition, float deltaTime, float viewportHeight);
     glm::vec3 getProceduralFocusPoint() const;
 
     // Environment map management
     RS_Cubemap* getEnvironmentCubemap() { return m_environmentCubemap.get(); }
     const RS_Cubemap* getEnvironmentCubemap() const { return m_environmentCubemap.get(); }
-    void setEnvironmentMap(std::filesystem::path filePath, bool isHDR = true, int cubemapResolution = 512) {
-        // Load the equirectangular texture
-        auto equirectTexture = std::make_unique<RS_Texture>(std::move(filePath), isHDR);
-        equirectTexture->setEnvironmentMapWrapping();
+    void setEnvironmentMap(std::filesystem::path filePath, bool isHDR = true, int cubemapResolution = 512);
+    // Same as setEnvironmentMap, but decoding (or reading the cache) happens on a worker thread
+    RS_LoadTask setEnvironmentMapAsync(RS_AsyncLoader& loader, std::filesystem::path filePath, bool isHDR = true, int cubemapResolution = 512);
 
-        // Convert to cubemap
-        m_environmentCubemap = std::make_unique<RS_Cubemap>(*equirectTexture, cubemapResolution);
-    }
+    // The two halves of setEnvironmentMap: prepare is thread-safe and GL-free, apply uploads on the GL thread
+    static RS_EnvironmentSource prepareEnvironmentMap(std::filesystem::path filePath, bool isHDR, int cubemapResolution);
+    void applyEnvironmentMap(RS_EnvironmentSource source);
+
+    // Diffuse environment lighting projected onto spherical harmonics (only available for HDR environment maps)
+    bool hasEnvironmentSH() const { return m_hasEnvironmentSH; }
+    const RS_SHCoefficients& getEnvironmentSH() const { return m_environmentSH; }
 
     // Environment brightness control
     float& getEnvironmentBrightness() { return m_envBrightness; }
@@ -98,6 +131,9 @@ public:
     void setEnvironmentBrightness(float brightness) { m_envBrightness = brightness; }
 
 private:
+    void setEnvironmentUniforms(const Shader& envShader, const Trackball& camera, const RS_RenderSettings& settings) const;
+    void floatModels(float deltaTime);
+
     // Models (meshes + materials + transforms)
     std::vector<RS_Model> m_models;
 
@@ -106,10 +142,15 @@ private:
 
     // Procedural content
     std::unique_ptr<WaterSurface> m_water;
+    // Hull points of all floating models, queried on the water in one batch every frame
+    std::vector<glm::vec2> m_hullPositions;
+    std::vector<float> m_hullHeights;
 
     //Environment map
     std::unique_ptr<RS_Cubemap> m_environmentCubemap { nullptr };
     float m_envBrightness { 0.5f }; // Default brightness
+    RS_SHCoefficients m_environmentSH {};
+    bool m_hasEnvironmentSH { false };
 
     // Cameras
     std::vector<std::unique_ptr<Trackball>> m_cameras;
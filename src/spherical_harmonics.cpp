@@ -0,0 +1,224 @@
+#include "spherical_harmonics.h"
+#include "radiance_hdr.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RS_SH_USE_SSE 1
+#endif
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+// Real SH basis normalization constants
+constexpr float SH_C0 = 0.282095f;
+constexpr float SH_C1 = 0.488603f;
+constexpr float SH_C2 = 1.092548f;
+constexpr float SH_C3 = 0.315392f;
+constexpr float SH_C4 = 0.546274f;
+
+// Per-column factors of the basis functions; within a row only the azimuth changes
+struct ColumnTables {
+    std::vector<float> cosPhi;
+    std::vector<float> sinPhi;
+    std::vector<float> cosSinPhi;
+    std::vector<float> cosSqPhi;
+};
+
+ColumnTables buildColumnTables(int width)
+{
+    ColumnTables tables;
+    tables.cosPhi.resize(static_cast<size_t>(width));
+    tables.sinPhi.resize(static_cast<size_t>(width));
+    tables.cosSinPhi.resize(static_cast<size_t>(width));
+    tables.cosSqPhi.resize(static_cast<size_t>(width));
+
+    for (int x = 0; x < width; ++x) {
+        // Inverse of uv.x = 1 - (atan(z, x) / 2PI + 0.5) in equirect_to_cube_frag.glsl
+        const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+        const float phi = PI - 2.0f * PI * u;
+        const size_t i = static_cast<size_t>(x);
+        tables.cosPhi[i] = std::cos(phi);
+        tables.sinPhi[i] = std::sin(phi);
+        tables.cosSinPhi[i] = tables.cosPhi[i] * tables.sinPhi[i];
+        tables.cosSqPhi[i] = tables.cosPhi[i] * tables.cosPhi[i];
+    }
+    return tables;
+}
+
+// Sums of one channel of a row multiplied by 1, cos, sin, cos*sin and cos^2 of the azimuth
+struct RowMoments {
+    float sum { 0.0f };
+    float cosSum { 0.0f };
+    float sinSum { 0.0f };
+    float cosSinSum { 0.0f };
+    float cosSqSum { 0.0f };
+};
+
+RowMoments computeRowMoments(const float* row, int width, int channels, const ColumnTables& tables)
+{
+    RowMoments moments;
+    int x = 0;
+
+#ifdef RS_SH_USE_SSE
+    __m128 sum = _mm_setzero_ps();
+    __m128 cosSum = _mm_setzero_ps();
+    __m128 sinSum = _mm_setzero_ps();
+    __m128 cosSinSum = _mm_setzero_ps();
+    __m128 cosSqSum = _mm_setzero_ps();
+
+    for (; x + 4 <= width; x += 4) {
+        const float* pixel = row + static_cast<size_t>(x) * static_cast<size_t>(channels);
+        const __m128 value = _mm_setr_ps(pixel[0], pixel[channels], pixel[2 * channels], pixel[3 * channels]);
+        const size_t i = static_cast<size_t>(x);
+
+        sum = _mm_add_ps(sum, value);
+        cosSum = _mm_add_ps(cosSum, _mm_mul_ps(value, _mm_loadu_ps(&tables.cosPhi[i])));
+        sinSum = _mm_add_ps(sinSum, _mm_mul_ps(value, _mm_loadu_ps(&tables.sinPhi[i])));
+        cosSinSum = _mm_add_ps(cosSinSum, _mm_mul_ps(value, _mm_loadu_ps(&tables.cosSinPhi[i])));
+        cosSqSum = _mm_add_ps(cosSqSum, _mm_mul_ps(value, _mm_loadu_ps(&tables.cosSqPhi[i])));
+    }
+
+    const auto horizontalSum = [](__m128 v) {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    };
+    moments.sum = horizontalSum(sum);
+    moments.cosSum = horizontalSum(cosSum);
+    moments.sinSum = horizontalSum(sinSum);
+    moments.cosSinSum = horizontalSum(cosSinSum);
+    moments.cosSqSum = horizontalSum(cosSqSum);
+#endif
+
+    for (; x < width; ++x) {
+        const float value = row[static_cast<size_t>(x) * static_cast<size_t>(channels)];
+        const size_t i = static_cast<size_t>(x);
+        moments.sum += value;
+        moments.cosSum += value * tables.cosPhi[i];
+        moments.sinSum += value * tables.sinPhi[i];
+        moments.cosSinSum += value * tables.cosSinPhi[i];
+        moments.cosSqSum += value * tables.cosSqPhi[i];
+    }
+
+    return moments;
+}
+
+using SHAccumulator = std::array<std::array<double, 3>, 9>;
+
+} // namespace
+
+glm::vec3 RS_SHCoefficients::evaluate(const glm::vec3& d) const
+{
+    return coefficients[0] * SH_C0
+        + coefficients[1] * (SH_C1 * d.y)
+        + coefficients[2] * (SH_C1 * d.z)
+        + coefficients[3] * (SH_C1 * d.x)
+        + coefficients[4] * (SH_C2 * d.x * d.y)
+        + coefficients[5] * (SH_C2 * d.y * d.z)
+        + coefficients[6] * (SH_C3 * (3.0f * d.z * d.z - 1.0f))
+        + coefficients[7] * (SH_C2 * d.x * d.z)
+        + coefficients[8] * (SH_C4 * (d.x * d.x - d.y * d.y));
+}
+
+RS_SHCoefficients RS_SHCoefficients::toDiffuseRadiance() const
+{
+    // Cosine lobe band factors (PI, 2PI/3, PI/4) divided by PI
+    constexpr std::array<float, 9> bandFactors { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    RS_SHCoefficients result;
+    for (size_t i = 0; i < 9; ++i)
+        result.coefficients[i] = coefficients[i] * bandFactors[i];
+    return result;
+}
+
+namespace {
+
+// Shared by both entry points: getRow(y, scratch) returns row y, either in place or unpacked into the scratch row
+template <typename GetRow>
+RS_SHCoefficients projectRows(int width, int height, int channels, GetRow&& getRow)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    const ColumnTables tables = buildColumnTables(width);
+    const int colorChannels = std::min(channels, 3);
+    const float pixelArea = (2.0f * PI / static_cast<float>(width)) * (PI / static_cast<float>(height));
+
+    RS_ThreadPool& pool = RS_ThreadPool::instance();
+    const int rangeCount = std::min(pool.getDefaultRangeCount(), height);
+    std::vector<SHAccumulator> partialSums(static_cast<size_t>(rangeCount), SHAccumulator {});
+
+    pool.parallelFor(0, height, [&](int rowBegin, int rowEnd, int rangeIndex) {
+        SHAccumulator& acc = partialSums[static_cast<size_t>(rangeIndex)];
+        std::vector<float> scratch;
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            // Row 0 is the top of the image (+Y), matching uv.y = 1 - (asin(y) / PI + 0.5)
+            const float theta = PI * (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+            const float dirY = std::cos(theta);
+            const float sinTheta = std::sin(theta);
+            const float solidAngle = pixelArea * sinTheta;
+            const float* row = getRow(y, scratch);
+
+            for (int c = 0; c < 3; ++c) {
+                const RowMoments m = computeRowMoments(row + std::min(c, colorChannels - 1), width, channels, tables);
+                const float sinSqSum = m.sum - m.cosSqSum;
+                const size_t ci = static_cast<size_t>(c);
+
+                // A row is summed in float; the rows add up in double
+                const std::array<float, 9> rowTerms {
+                    solidAngle * SH_C0 * m.sum,
+                    solidAngle * SH_C1 * dirY * m.sum,
+                    solidAngle * SH_C1 * sinTheta * m.sinSum,
+                    solidAngle * SH_C1 * sinTheta * m.cosSum,
+                    solidAngle * SH_C2 * sinTheta * dirY * m.cosSum,
+                    solidAngle * SH_C2 * sinTheta * dirY * m.sinSum,
+                    solidAngle * SH_C3 * (3.0f * sinTheta * sinTheta * sinSqSum - m.sum),
+                    solidAngle * SH_C2 * sinTheta * sinTheta * m.cosSinSum,
+                    solidAngle * SH_C4 * (sinTheta * sinTheta * m.cosSqSum - dirY * dirY * m.sum)
+                };
+                for (size_t i = 0; i < rowTerms.size(); ++i)
+                    acc[i][ci] += static_cast<double>(rowTerms[i]);
+            }
+        }
+    }, rangeCount);
+
+    RS_SHCoefficients result;
+    for (size_t i = 0; i < 9; ++i) {
+        glm::dvec3 total(0.0);
+        for (const SHAccumulator& partial : partialSums)
+            total += glm::dvec3(partial[i][0], partial[i][1], partial[i][2]);
+        result.coefficients[i] = glm::vec3(total);
+    }
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Projected " << width << "x" << height << " environment map onto SH in "
+              << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+
+    return result;
+}
+
+} // namespace
+
+RS_SHCoefficients projectEquirectToSH(const float* pixels, int width, int height, int channels)
+{
+    return projectRows(width, height, channels, [&](int y, std::vector<float>&) {
+        return pixels + static_cast<size_t>(y) * static_cast<size_t>(width) * static_cast<size_t>(channels);
+    });
+}
+
+RS_SHCoefficients projectEquirectToSH(const RS_SharedExponentImage& image)
+{
+    return projectRows(image.width, image.height, 3, [&](int y, std::vector<float>& scratch) {
+        scratch.resize(3 * static_cast<size_t>(image.width));
+        image.unpackRow(y, scratch.data());
+        return static_cast<const float*>(scratch.data());
+    });
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <array>
+
+struct RS_SharedExponentImage;
+
+// Order-2 spherical harmonics (9 RGB coefficients), ordered as
+// Y(0,0), Y(1,-1), Y(1,0), Y(1,1), Y(2,-2), Y(2,-1), Y(2,0), Y(2,1), Y(2,2).
+// The basis is evaluated on world-space directions exactly like evaluateSH() in env_frag.glsl.
+struct RS_SHCoefficients {
+    std::array<glm::vec3, 9> coefficients {};
+
+    // Evaluate the projected function in the given (normalized) direction
+    glm::vec3 evaluate(const glm::vec3& direction) const;
+
+    // Convolve radiance coefficients with the clamped cosine lobe and divide by PI, such that
+    // evaluating the result yields the average diffuse radiance (irradiance / PI) around a normal.
+    RS_SHCoefficients toDiffuseRadiance() const;
+};
+
+// Project an equirectangular RGB(A) float image onto order-2 spherical harmonics.
+// Rows are stored top (+Y) to bottom and columns follow the mapping used by equirect_to_cube_frag.glsl.
+// Every pixel is weighted by the solid angle it covers; rows are split across the shared thread pool
+// and pixels within a row are processed 4 at a time with SSE where available.
+RS_SHCoefficients projectEquirectToSH(const float* pixels, int width, int height, int channels);
+
+// Same for shared-exponent pixels, which are unpacked to floats one row at a time
+RS_SHCoefficients projectEquirectToSH(const RS_SharedExponentImage& image);
@@ -1,15 +1,20 @@
 #include "texture.h"
-#include <framework/disable_all_warnings.h>
-DISABLE_WARNINGS_PUSH()
-#include <stb/stb_image.h>
-DISABLE_WARNINGS_POP()
+#include "image_resample.h"
+#include "radiance_hdr.h"
+#include "texture_compression.h"
 #include <framework/image.h>
+#include <cassert>
 #include <iostream>
+#include <optional>
 #include <string>
-#include <algorithm>
 
-RS_Texture::RS_Texture(std::filesystem::path filePath, bool isHDR)
-    : m_isHDR(isHDR)
+static bool isHDRFormat(ImageFormat format)
+{
+    return format == ImageFormat::Float16 || format == ImageFormat::Float32;
+}
+
+// Decode a texture file, reporting failures as ImageLoadingException
+static Image loadImage(const std::filesystem::path& filePath, bool isHDR, int sizeLimit)
 {
     // Check if file exists
     if (!std::filesystem::exists(filePath)) {
@@ -17,139 +22,113 @@ RS_Texture::RS_Texture(std::filesystem::path filePath, bool isHDR)
         throw ImageLoadingException("Texture file does not exist");
     }
 
-    const std::string filePathStr = filePath.string();
+    // HDR files are detected from their contents; isHDR additionally promotes LDR files. Half floats are what the
+    // GPU stores either way, so HDR pixels are requested as such; OpenEXR files decode to them directly.
+    ImageLoadSettings settings;
+    if (isHDR)
+        settings.format = ImageFormat::Float16;
 
-    // Auto-detect HDR format
-    if (!isHDR) {
-        std::string ext = filePath.extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        m_isHDR = (ext == ".hdr" || ext == ".exr");
+    std::optional<Image> image;
+    try {
+        image.emplace(filePath, settings);
+    } catch (const std::exception&) {
+        throw ImageLoadingException("Failed to load texture");
     }
 
-    // Load image data
-    void* data = nullptr;
+    const glm::ivec2 size = getDownscaledSize(image->width, image->height, sizeLimit);
+    if (size == glm::ivec2(image->width, image->height))
+        return std::move(*image);
 
-    if (m_isHDR) {
-        // Load as floating-point HDR data
-        float* hdrData = stbi_loadf(filePathStr.c_str(), &m_width, &m_height, &m_channels, 0);
+    // A box filter cannot ring, which would show around bright spots in HDR images
+    Image downscaled = resampleImage(image->view(), size.x, size.y, isHDRFormat(image->format) ? RS_ResampleFilter::Box : RS_ResampleFilter::Lanczos3);
+    downscaled.filePath = filePath;
+    return downscaled;
+}
 
-        if (!hdrData) {
-            std::cerr << "Failed to read HDR texture \"" << filePath << "\" using stb_image.h" << std::endl;
-            std::cerr << "STB Error: " << stbi_failure_reason() << std::endl;
-            throw ImageLoadingException("Failed to load HDR texture");
-        }
+RS_Texture::RS_Texture(std::filesystem::path filePath, bool isHDR, int sizeLimit)
+    : RS_Texture(loadImage(filePath, isHDR, sizeLimit))
+{
+}
 
-        data = hdrData;
-    } else {
-        // Load
-        unsigned char* ldrData = stbi_load(filePathStr.c_str(), &m_width, &m_height, &m_channels, 0);
+RS_Texture::RS_Texture(const Image& image)
+    : RS_Texture(image.view())
+{
+    std::cout << "Loaded " << (m_isHDR ? "HDR" : "LDR") << " texture: " << image.filePath
+              << " (" << m_width << "x" << m_height << ", " << m_channels << " channels)" << std::endl;
+}
 
-        if (!ldrData) {
-            std::cerr << "Failed to read LDR texture \"" << filePath << "\" using stb_image.h" << std::endl;
-            std::cerr << "STB Error: " << stbi_failure_reason() << std::endl;
-            throw ImageLoadingException("Failed to load LDR texture");
-        }
+RS_Texture::RS_Texture(const ImageView& pixels)
+    : m_width(pixels.width)
+    , m_height(pixels.height)
+    , m_channels(pixels.channels)
+    , m_isHDR(isHDRFormat(pixels.format))
+{
+    upload(pixels);
+}
 
-        data = ldrData;
+RS_Texture::RS_Texture(const RS_CompressedTexture& texture, int firstLevel)
+    : m_width(texture.getLevels().front().width)
+    , m_height(texture.getLevels().front().height)
+    , m_isHDR(false)
+{
+    switch (texture.getFormat()) {
+    case RS_BlockFormat::BC4:
+        m_channels = 1;
+        break;
+    case RS_BlockFormat::BC5:
+        m_channels = 2;
+        break;
+    case RS_BlockFormat::BC1:
+        m_channels = 3;
+        break;
+    case RS_BlockFormat::BC7:
+        m_channels = 4;
+        break;
     }
 
-    // Create OpenGL texture
     glGenTextures(1, &m_texture);
     glBindTexture(GL_TEXTURE_2D, m_texture);
 
-    // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Upload texture data based on format and channels
-    if (m_isHDR) {
-        switch (m_channels) {
-            case 1:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, m_width, m_height, 0, GL_RED, GL_FLOAT, data);
-                break;
-            case 3:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, m_width, m_height, 0, GL_RGB, GL_FLOAT, data);
-                break;
-            case 4:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_width, m_height, 0, GL_RGBA, GL_FLOAT, data);
-                break;
-            default:
-                stbi_image_free(data);
-                std::cerr << "Unsupported number of channels: " << m_channels << std::endl;
-                throw ImageLoadingException("Unsupported number of channels");
-        }
-    } else {
-        switch (m_channels) {
-            case 1:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, data);
-                break;
-            case 3:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                break;
-            case 4:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-                break;
-            default:
-                stbi_image_free(data);
-                std::cerr << "Unsupported number of channels: " << m_channels << std::endl;
-                throw ImageLoadingException("Unsupported number of channels");
-        }
+    // The mip chain was built on the CPU, so there is nothing left to generate
+    const std::vector<RS_CompressedTexture::Level>& levels = texture.getLevels();
+    const GLenum format = getBlockFormatGLEnum(texture.getFormat());
+    for (size_t level = static_cast<size_t>(firstLevel); level < levels.size(); ++level) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), format, levels[level].width, levels[level].height, 0,
+            static_cast<GLsizei>(levels[level].blocks.size()), levels[level].blocks.data());
     }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
 
-    // Generate mipmaps
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Free image data
-    stbi_image_free(data);
-
-    std::cout << "Loaded " << (m_isHDR ? "HDR" : "LDR") << " texture: " << filePath
-              << " (" << m_width << "x" << m_height << ", " << m_channels << " channels)" << std::endl;
+    std::cout << "Loaded " << getBlockFormatName(texture.getFormat()) << " texture: " << texture.getSourcePath()
+              << " (" << m_width << "x" << m_height << ", " << levels.size() - static_cast<size_t>(firstLevel) << " of " << levels.size() << " mips)" << std::endl;
 }
 
-RS_Texture::RS_Texture(const Image& image)
+RS_Texture::RS_Texture(const RS_SharedExponentImage& image, GLenum internalFormat)
     : m_width(image.width)
     , m_height(image.height)
-    , m_channels(image.channels)
-    , m_isHDR(false)
+    , m_channels(3)
+    , m_isHDR(true)
 {
-    // Create OpenGL texture
+    assert(internalFormat == GL_RGB9_E5 || internalFormat == GL_R11F_G11F_B10F);
     glGenTextures(1, &m_texture);
     glBindTexture(GL_TEXTURE_2D, m_texture);
 
-    // Set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Get raw pixel data from Image
-    unsigned char* data = const_cast<unsigned char*>(
-        reinterpret_cast<const unsigned char*>(const_cast<Image&>(image).get_data())
-    );
-
-    // Upload texture data based on channels
-    switch (m_channels) {
-        case 1:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, data);
-            break;
-        case 3:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            break;
-        case 4:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            break;
-        default:
-            std::cerr << "Unsupported number of channels: " << m_channels << std::endl;
-            throw ImageLoadingException("Unsupported number of channels");
-    }
-
-    // Generate mipmaps
+    // The packed texels are uploaded as they are; for GL_R11F_G11F_B10F the driver converts them
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat), m_width, m_height, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, image.texels.data());
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    std::cout << "Loaded texture from Image: "
-              << " (" << m_width << "x" << m_height << ", " << m_channels << " channels)" << std::endl;
+    std::cout << "Loaded " << (internalFormat == GL_RGB9_E5 ? "RGB9_E5" : "R11F_G11F_B10F") << " texture: " << image.filePath
+              << " (" << m_width << "x" << m_height << ")" << std::endl;
 }
 
 // Private constructor for creating empty textures
@@ -223,6 +202,61 @@ void RS_Texture::bind(GLint textureSlot) const
     glBindTexture(GL_TEXTURE_2D, m_texture);
 }
 
+// Create the OpenGL texture (half float if HDR, normalized integer otherwise) and build its mipmaps
+void RS_Texture::upload(const ImageView& pixels)
+{
+    if (m_channels < 1 || m_channels > 4) {
+        std::cerr << "Unsupported number of channels: " << m_channels << std::endl;
+        throw ImageLoadingException("Unsupported number of channels");
+    }
+
+    // Indexed by channel count
+    static constexpr GLenum pixelFormats[] { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static constexpr GLint ldrFormats[] { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static constexpr GLint wideFormats[] { GL_R16, GL_RG16, GL_RGB16, GL_RGBA16 };
+    static constexpr GLint hdrFormats[] { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+
+    GLint internalFormat = ldrFormats[m_channels - 1];
+    GLenum componentType = GL_UNSIGNED_BYTE;
+    switch (pixels.format) {
+    case ImageFormat::UInt8:
+        break;
+    case ImageFormat::UInt16:
+        internalFormat = wideFormats[m_channels - 1];
+        componentType = GL_UNSIGNED_SHORT;
+        break;
+    case ImageFormat::Float16:
+        internalFormat = hdrFormats[m_channels - 1];
+        componentType = GL_HALF_FLOAT;
+        break;
+    case ImageFormat::Float32:
+        internalFormat = hdrFormats[m_channels - 1];
+        componentType = GL_FLOAT;
+        break;
+    }
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    // Set texture parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Rows are read straight from the view: RGB rows need not be 4-byte aligned and may be padded
+    const size_t pixelSize = pixels.getPixelSize();
+    assert(pixels.rowStride % pixelSize == 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pixels.isContiguous() ? 0 : static_cast<GLint>(pixels.rowStride / pixelSize));
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, pixelFormats[m_channels - 1], componentType, pixels.data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Generate mipmaps
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
 void RS_Texture::setEnvironmentMapWrapping()
 {
     glBindTexture(GL_TEXTURE_2D, m_texture);
@@ -10,14 +10,26 @@ DISABLE_WARNINGS_POP()
 #include <framework/opengl_includes.h>
 
 
+class RS_CompressedTexture;
+struct RS_SharedExponentImage;
+
 struct ImageLoadingException : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
 class RS_Texture {
 public:
-    RS_Texture(std::filesystem::path filePath, bool isHDR = false);
+    // Images larger than sizeLimit (width or height; 0 = unlimited) are scaled down before upload
+    RS_Texture(std::filesystem::path filePath, bool isHDR = false, int sizeLimit = 0);
     RS_Texture(const Image& image); // Create texture from framework
+    // Create texture from 8-bit, 16-bit, half or float pixels; half and float pixels produce an HDR texture
+    RS_Texture(const ImageView& pixels);
+    // Upload a block-compressed texture together with its precomputed mips. Levels finer than firstLevel are left
+    // out; they can be added later, each one becoming the new base level.
+    RS_Texture(const RS_CompressedTexture& texture, int firstLevel = 0);
+    // Upload shared-exponent HDR pixels as they are (GL_RGB9_E5) or converted to GL_R11F_G11F_B10F, which is just as
+    // small but color-renderable, so drivers can generate its mipmaps on the GPU
+    RS_Texture(const RS_SharedExponentImage& image, GLenum internalFormat = GL_RGB9_E5);
     // Create empty depth texture for shadow mapping
     static RS_Texture createDepthTexture(int width, int height);
 
@@ -42,6 +54,7 @@ public:
 private:
     // Private constructor for creating empty textures
     RS_Texture(int width, int height, bool isDepth);
+    void upload(const ImageView& pixels);
 
     static constexpr GLuint INVALID = 0xFFFFFFFF;
     GLuint m_texture { INVALID };
@@ -0,0 +1,82 @@
+#include "texture_cache.h"
+
+#include <functional>
+#include <system_error>
+#include <utility>
+
+size_t RS_TextureImportOptions::hash() const
+{
+    return std::hash<bool>()(isHDR) ^ (std::hash<std::optional<RS_BlockFormat>>()(blockFormat) << 1) ^ (std::hash<int>()(sizeLimit) << 2);
+}
+
+RS_TextureCache& RS_TextureCache::instance()
+{
+    // Intentionally leaked: textures may still be released by static objects during shutdown
+    static RS_TextureCache* cache = new RS_TextureCache();
+    return *cache;
+}
+
+size_t RS_TextureCache::KeyHash::operator()(const Key& key) const
+{
+    return std::hash<std::string>()(key.canonicalPath) ^ (key.options.hash() * 0x9E3779B97F4A7C15ull);
+}
+
+RS_TextureCache::Key RS_TextureCache::makeKey(const std::filesystem::path& filePath, const RS_TextureImportOptions& options)
+{
+    // The same file can be reached through different relative paths
+    std::error_code error;
+    std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(filePath, error);
+    if (error)
+        canonicalPath = filePath.lexically_normal();
+    return Key { canonicalPath.generic_string(), options };
+}
+
+template <typename Texture, typename... Args>
+std::shared_ptr<Texture> RS_TextureCache::getOrInsert(TextureMap<Texture>& textures, Key key, Args&&... args)
+{
+    if (const auto iter = textures.find(key); iter != std::end(textures)) {
+        if (std::shared_ptr<Texture> texture = iter->second.lock())
+            return texture;
+    }
+
+    // The deleter evicts the entry together with the GPU texture
+    std::shared_ptr<Texture> texture(new Texture(std::forward<Args>(args)...), [&textures, key](Texture* cachedTexture) {
+        if (const auto iter = textures.find(key); iter != std::end(textures) && iter->second.expired())
+            textures.erase(iter);
+        delete cachedTexture;
+    });
+    textures.insert_or_assign(std::move(key), texture);
+    return texture;
+}
+
+std::shared_ptr<RS_Texture> RS_TextureCache::getOrCreate(const Image& image, const RS_TextureImportOptions& options)
+{
+    // Images that were not loaded from a file cannot be shared
+    if (image.filePath.empty())
+        return std::make_shared<RS_Texture>(image);
+
+    return getOrInsert(m_textures, makeKey(image.filePath, options), image);
+}
+
+std::shared_ptr<RS_Texture> RS_TextureCache::getOrCreate(const RS_CompressedTexture& texture)
+{
+    if (texture.getSourcePath().empty())
+        return std::make_shared<RS_Texture>(texture);
+
+    const RS_TextureImportOptions options { .blockFormat = texture.getFormat() };
+    return getOrInsert(m_textures, makeKey(texture.getSourcePath(), options), texture);
+}
+
+std::shared_ptr<RS_StreamingTexture> RS_TextureCache::getOrCreateStreaming(const std::shared_ptr<const RS_CompressedTexture>& texture)
+{
+    if (texture->getSourcePath().empty())
+        return std::make_shared<RS_StreamingTexture>(texture);
+
+    const RS_TextureImportOptions options { .blockFormat = texture->getFormat() };
+    return getOrInsert(m_streamingTextures, makeKey(texture->getSourcePath(), options), texture);
+}
+
+std::shared_ptr<RS_Texture> RS_TextureCache::getOrLoad(const std::filesystem::path& filePath, const RS_TextureImportOptions& options)
+{
+    return getOrInsert(m_textures, makeKey(filePath, options), filePath, options.isHDR, options.sizeLimit);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "texture.h"
+#include "texture_compression.h"
+#include "texture_streaming.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Settings that change the GPU texture produced from a source file; part of the texture cache key
+struct RS_TextureImportOptions {
+    bool isHDR { false };
+    std::optional<RS_BlockFormat> blockFormat; // Uncompressed if empty
+    int sizeLimit { 0 }; // Largest width or height; larger images are scaled down before upload (0 = unlimited)
+
+    bool operator==(const RS_TextureImportOptions&) const = default;
+    size_t hash() const;
+};
+
+// Shares GPU textures between all materials and models that import the same file with the same options.
+// Handles are reference counted: a texture is uploaded on first use and deleted (and forgotten by the cache)
+// as soon as the last handle goes away. Must only be used on the thread that owns the OpenGL context.
+class RS_TextureCache {
+public:
+    static RS_TextureCache& instance();
+
+    // Texture for a decoded framework image, keyed on the file the image was loaded from
+    std::shared_ptr<RS_Texture> getOrCreate(const Image& image, const RS_TextureImportOptions& options = {});
+    // Texture for a block-compressed image, keyed on its source file and format
+    std::shared_ptr<RS_Texture> getOrCreate(const RS_CompressedTexture& texture);
+    // Streaming texture for a block-compressed image; only its coarsest mips are uploaded right away
+    std::shared_ptr<RS_StreamingTexture> getOrCreateStreaming(const std::shared_ptr<const RS_CompressedTexture>& texture);
+    // Texture for an image file, decoded only if no live texture exists for it yet
+    std::shared_ptr<RS_Texture> getOrLoad(const std::filesystem::path& filePath, const RS_TextureImportOptions& options = {});
+
+    size_t getLiveTextureCount() const { return m_textures.size() + m_streamingTextures.size(); }
+
+private:
+    RS_TextureCache() = default;
+
+    struct Key {
+        std::string canonicalPath;
+        RS_TextureImportOptions options;
+
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    template <typename Texture>
+    using TextureMap = std::unordered_map<Key, std::weak_ptr<Texture>, KeyHash>;
+
+    static Key makeKey(const std::filesystem::path& filePath, const RS_TextureImportOptions& options);
+    template <typename Texture, typename... Args>
+    std::shared_ptr<Texture> getOrInsert(TextureMap<Texture>& textures, Key key, Args&&... args);
+
+    TextureMap<RS_Texture> m_textures;
+    TextureMap<RS_StreamingTexture> m_streamingTextures;
+};
@@ -0,0 +1,652 @@
+#include "texture_compression.h"
+#include "asset_cache.h"
+#include "thread_pool.h"
+
+#include <cstring> // stb_dxt.h uses memcpy without including it
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_TEXTURE_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Not part of core OpenGL, so not declared by glad
+constexpr GLenum GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+
+constexpr std::array<char, 4> COMPRESSED_CACHE_MAGIC { 'R', 'S', 'B', 'C' };
+constexpr uint32_t COMPRESSED_CACHE_VERSION = 1;
+constexpr uint64_t COMPRESSED_CACHE_ALIGNMENT = 64;
+
+// File layout: header, one record per mip level, then the blocks of all levels
+struct CompressedCacheHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t usage;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t padding;
+};
+
+struct CompressedCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Written once by initBlockCompressionSupport, read by the import workers
+std::atomic<bool> s_hasBC1BC4BC5 { false };
+std::atomic<bool> s_hasBC7 { false };
+
+uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + COMPRESSED_CACHE_ALIGNMENT - 1) / COMPRESSED_CACHE_ALIGNMENT * COMPRESSED_CACHE_ALIGNMENT;
+}
+
+size_t getBlockSize(RS_BlockFormat format)
+{
+    return format == RS_BlockFormat::BC1 || format == RS_BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t getLevelSize(RS_BlockFormat format, int width, int height)
+{
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * getBlockSize(format);
+}
+
+std::filesystem::path getCompressedCachePath(const std::filesystem::path& sourceFile, uint64_t fileStamp, RS_BlockFormat format)
+{
+    return getCacheEntryPath(sourceFile, fileStamp, std::string("_") + getBlockFormatName(format) + ".rsbc");
+}
+
+std::optional<uint64_t> getCompressedCacheStamp(const std::filesystem::path& sourceFile, RS_TextureUsage usage, RS_BlockFormat format, int sizeLimit)
+{
+    const uint64_t seed = (uint64_t(COMPRESSED_CACHE_VERSION) << 48) | (uint64_t(sizeLimit) << 16) | (uint64_t(format) << 8) | uint64_t(usage);
+    return hashFileStamp(sourceFile, seed);
+}
+
+// Uncompressed RGBA8 mip level
+struct PixelLevel {
+    int width;
+    int height;
+    std::vector<uint8_t> rgba;
+};
+
+uint8_t toUnorm8(const std::byte* component, ImageFormat format)
+{
+    switch (format) {
+    case ImageFormat::UInt8:
+        return static_cast<uint8_t>(*component);
+    case ImageFormat::UInt16: {
+        uint16_t value;
+        std::memcpy(&value, component, sizeof(value));
+        return static_cast<uint8_t>((value * 255u + 32767u) / 65535u);
+    }
+    case ImageFormat::Float16: {
+        uint16_t value;
+        std::memcpy(&value, component, sizeof(value));
+        return static_cast<uint8_t>(std::clamp(glm::unpackHalf1x16(value), 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    case ImageFormat::Float32: {
+        float value;
+        std::memcpy(&value, component, sizeof(value));
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    }
+    return 0;
+}
+
+// Expand any image to RGBA8: grey images are replicated, two-channel images fill red and green
+PixelLevel convertToRGBA8(const ImageView& image)
+{
+    PixelLevel level { image.width, image.height, std::vector<uint8_t>(size_t(image.width) * size_t(image.height) * 4) };
+    const size_t componentSize = getComponentSize(image.format);
+
+    RS_ThreadPool::instance().parallelFor(0, image.height, [&](int begin, int end, int) {
+        for (int y = begin; y < end; ++y) {
+            const std::byte* source = image.getRow(y);
+            uint8_t* target = &level.rgba[size_t(y) * size_t(image.width) * 4];
+            for (int x = 0; x < image.width; ++x, source += image.getPixelSize(), target += 4) {
+                uint8_t components[4] { 0, 0, 0, 255 };
+                for (int channel = 0; channel < std::min(image.channels, 4); ++channel)
+                    components[channel] = toUnorm8(source + size_t(channel) * componentSize, image.format);
+                if (image.channels == 1)
+                    components[1] = components[2] = components[0];
+                std::memcpy(target, components, 4);
+            }
+        }
+    });
+    return level;
+}
+
+// 2x2 box filter; odd edges repeat their last row or column
+void downsampleRows(const PixelLevel& source, PixelLevel& target, int rowBegin, int rowEnd)
+{
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uint8_t* row0 = &source.rgba[size_t(std::min(2 * y, source.height - 1)) * size_t(source.width) * 4];
+        const uint8_t* row1 = &source.rgba[size_t(std::min(2 * y + 1, source.height - 1)) * size_t(source.width) * 4];
+        uint8_t* output = &target.rgba[size_t(y) * size_t(target.width) * 4];
+
+        int x = 0;
+#ifdef RS_TEXTURE_COMPRESSION_SSE2
+        // Two output pixels per iteration, summed in 16 bits
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        for (; x + 2 <= target.width && 2 * x + 4 <= source.width; x += 2) {
+            const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+            const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+            const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 4 * x), _mm_packus_epi16(sum, zero));
+        }
+#endif
+        for (; x < target.width; ++x) {
+            const int x0 = std::min(2 * x, source.width - 1) * 4;
+            const int x1 = std::min(2 * x + 1, source.width - 1) * 4;
+            for (int channel = 0; channel < 4; ++channel)
+                output[4 * x + channel] = static_cast<uint8_t>((row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel] + 2) / 4);
+        }
+    }
+}
+
+// Averaging shortens normals; restore unit length so distant surfaces keep their shading
+void renormalizeRows(PixelLevel& level, int rowBegin, int rowEnd)
+{
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        uint8_t* pixel = &level.rgba[size_t(y) * size_t(level.width) * 4];
+        for (int x = 0; x < level.width; ++x, pixel += 4) {
+            const glm::vec3 normal = glm::vec3(pixel[0], pixel[1], pixel[2]) / 127.5f - 1.0f;
+            const float length = glm::length(normal);
+            if (length < 1e-4f)
+                continue;
+            const glm::vec3 encoded = (normal / length + 1.0f) * 127.5f + 0.5f;
+            for (int channel = 0; channel < 3; ++channel)
+                pixel[channel] = static_cast<uint8_t>(std::clamp(encoded[channel], 0.0f, 255.0f));
+        }
+    }
+}
+
+std::vector<PixelLevel> generateMipChain(PixelLevel base, RS_TextureUsage usage)
+{
+    std::vector<PixelLevel> levels;
+    levels.push_back(std::move(base));
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const PixelLevel& source = levels.back();
+        PixelLevel target { std::max(1, source.width / 2), std::max(1, source.height / 2), {} };
+        target.rgba.resize(size_t(target.width) * size_t(target.height) * 4);
+        RS_ThreadPool::instance().parallelFor(0, target.height, [&](int begin, int end, int) {
+            downsampleRows(source, target, begin, end);
+            if (usage == RS_TextureUsage::Normal)
+                renormalizeRows(target, begin, end);
+        });
+        levels.push_back(std::move(target));
+    }
+    return levels;
+}
+
+// 4x4 block of RGBA8 pixels; blocks on the right and bottom edges repeat the last column or row
+void loadBlock(const PixelLevel& level, int blockX, int blockY, uint8_t rgba[64])
+{
+    for (int y = 0; y < 4; ++y) {
+        const int sourceY = std::min(blockY * 4 + y, level.height - 1);
+        for (int x = 0; x < 4; ++x) {
+            const int sourceX = std::min(blockX * 4 + x, level.width - 1);
+            std::memcpy(rgba + 4 * (4 * y + x), &level.rgba[(size_t(sourceY) * size_t(level.width) + size_t(sourceX)) * 4], 4);
+        }
+    }
+}
+
+// BC7 mode 6: a single subset with RGBA endpoints of 7 bits plus one p-bit each and 4-bit indices
+namespace bc7 {
+
+    constexpr int WEIGHTS[16] { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Endpoint {
+        int value[4]; // 7-bit components
+        int pBit;
+    };
+
+    int expand(const Endpoint& endpoint, int channel)
+    {
+        return (endpoint.value[channel] << 1) | endpoint.pBit;
+    }
+
+    // Closest representable endpoint; the p-bit is shared by all four channels, so both choices are tried
+    Endpoint quantize(const glm::vec4& color)
+    {
+        Endpoint best {};
+        float bestError = std::numeric_limits<float>::max();
+        for (int pBit = 0; pBit < 2; ++pBit) {
+            Endpoint candidate {};
+            candidate.pBit = pBit;
+            float error = 0.0f;
+            for (int channel = 0; channel < 4; ++channel) {
+                const float target = std::clamp(color[channel], 0.0f, 255.0f);
+                candidate.value[channel] = std::clamp(static_cast<int>(std::lround((target - float(pBit)) * 0.5f)), 0, 127);
+                const float difference = float(expand(candidate, channel)) - target;
+                error += difference * difference;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    // Choose the closest palette entry for every pixel; returns the summed squared error
+    int findIndices(const uint8_t rgba[64], const Endpoint& endpoint0, const Endpoint& endpoint1, int indices[16])
+    {
+        int16_t palette[16][4];
+        for (int entry = 0; entry < 16; ++entry) {
+            for (int channel = 0; channel < 4; ++channel)
+                palette[entry][channel] = static_cast<int16_t>(((64 - WEIGHTS[entry]) * expand(endpoint0, channel) + WEIGHTS[entry] * expand(endpoint1, channel) + 32) >> 6);
+        }
+
+        int totalError = 0;
+#ifdef RS_TEXTURE_COMPRESSION_SSE2
+        // Four pixels at a time: red/green and blue/alpha pairs are squared and summed with one multiply-add each
+        for (int group = 0; group < 4; ++group) {
+            const uint8_t* pixels = rgba + 16 * group;
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+            const __m128i wide0 = _mm_unpacklo_epi8(packed, _mm_setzero_si128()); // r0 g0 b0 a0 r1 g1 b1 a1
+            const __m128i wide1 = _mm_unpackhi_epi8(packed, _mm_setzero_si128()); // r2 g2 b2 a2 r3 g3 b3 a3
+            const __m128i pairs02 = _mm_unpacklo_epi32(wide0, wide1); // rg0 rg2 ba0 ba2
+            const __m128i pairs13 = _mm_unpackhi_epi32(wide0, wide1); // rg1 rg3 ba1 ba3
+            const __m128i redGreen = _mm_unpacklo_epi32(pairs02, pairs13); // rg0 rg1 rg2 rg3
+            const __m128i blueAlpha = _mm_unpackhi_epi32(pairs02, pairs13); // ba0 ba1 ba2 ba3
+
+            __m128i bestError = _mm_set1_epi32(std::numeric_limits<int>::max());
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int entry = 0; entry < 16; ++entry) {
+                const __m128i paletteRedGreen = _mm_set1_epi32((uint16_t(palette[entry][1]) << 16) | uint16_t(palette[entry][0]));
+                const __m128i paletteBlueAlpha = _mm_set1_epi32((uint16_t(palette[entry][3]) << 16) | uint16_t(palette[entry][2]));
+                const __m128i differenceRedGreen = _mm_sub_epi16(redGreen, paletteRedGreen);
+                const __m128i differenceBlueAlpha = _mm_sub_epi16(blueAlpha, paletteBlueAlpha);
+                const __m128i error = _mm_add_epi32(_mm_madd_epi16(differenceRedGreen, differenceRedGreen), _mm_madd_epi16(differenceBlueAlpha, differenceBlueAlpha));
+                const __m128i better = _mm_cmplt_epi32(error, bestError);
+                bestError = _mm_or_si128(_mm_and_si128(better, error), _mm_andnot_si128(better, bestError));
+                bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(entry)), _mm_andnot_si128(better, bestIndex));
+            }
+
+            alignas(16) int errors[4];
+            alignas(16) int groupIndices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(errors), bestError);
+            _mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+            for (int i = 0; i < 4; ++i) {
+                indices[4 * group + i] = groupIndices[i];
+                totalError += errors[i];
+            }
+        }
+#else
+        for (int pixel = 0; pixel < 16; ++pixel) {
+            int bestError = std::numeric_limits<int>::max();
+            for (int entry = 0; entry < 16; ++entry) {
+                int error = 0;
+                for (int channel = 0; channel < 4; ++channel) {
+                    const int difference = rgba[4 * pixel + channel] - palette[entry][channel];
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    indices[pixel] = entry;
+                }
+            }
+            totalError += bestError;
+        }
+#endif
+        return totalError;
+    }
+
+    // Least-squares endpoints for fixed indices; false if the indices do not constrain both endpoints
+    bool refitEndpoints(const uint8_t rgba[64], const int indices[16], glm::vec4& color0, glm::vec4& color1)
+    {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        glm::vec4 right0(0.0f), right1(0.0f);
+        for (int pixel = 0; pixel < 16; ++pixel) {
+            const float weight = float(WEIGHTS[indices[pixel]]) / 64.0f;
+            const glm::vec4 color(rgba[4 * pixel], rgba[4 * pixel + 1], rgba[4 * pixel + 2], rgba[4 * pixel + 3]);
+            a += (1.0f - weight) * (1.0f - weight);
+            b += (1.0f - weight) * weight;
+            c += weight * weight;
+            right0 += (1.0f - weight) * color;
+            right1 += weight * color;
+        }
+
+        const float determinant = a * c - b * b;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+        color0 = (c * right0 - b * right1) / determinant;
+        color1 = (a * right1 - b * right0) / determinant;
+        return true;
+    }
+
+    void encodeBlock(const uint8_t rgba[64], uint8_t* output)
+    {
+        // Endpoints span the pixels along their principal axis
+        glm::vec4 mean(0.0f);
+        for (int pixel = 0; pixel < 16; ++pixel)
+            mean += glm::vec4(rgba[4 * pixel], rgba[4 * pixel + 1], rgba[4 * pixel + 2], rgba[4 * pixel + 3]);
+        mean /= 16.0f;
+
+        glm::mat4 covariance(0.0f);
+        for (int pixel = 0; pixel < 16; ++pixel) {
+            const glm::vec4 offset = glm::vec4(rgba[4 * pixel], rgba[4 * pixel + 1], rgba[4 * pixel + 2], rgba[4 * pixel + 3]) - mean;
+            covariance += glm::outerProduct(offset, offset);
+        }
+
+        glm::vec4 axis(1.0f, 1.0f, 1.0f, 0.0f);
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            axis = covariance * axis;
+            const float largest = std::max(std::max(std::abs(axis.x), std::abs(axis.y)), std::max(std::abs(axis.z), std::abs(axis.w)));
+            if (largest < 1e-6f)
+                break;
+            axis /= largest;
+        }
+
+        glm::vec4 color0 = mean, color1 = mean;
+        if (const float axisLength = glm::length(axis); axisLength > 1e-6f) {
+            axis /= axisLength;
+            float minimum = std::numeric_limits<float>::max(), maximum = std::numeric_limits<float>::lowest();
+            for (int pixel = 0; pixel < 16; ++pixel) {
+                const float projection = glm::dot(glm::vec4(rgba[4 * pixel], rgba[4 * pixel + 1], rgba[4 * pixel + 2], rgba[4 * pixel + 3]) - mean, axis);
+                minimum = std::min(minimum, projection);
+                maximum = std::max(maximum, projection);
+            }
+            color0 = mean + minimum * axis;
+            color1 = mean + maximum * axis;
+        }
+
+        Endpoint endpoint0 = quantize(color0), endpoint1 = quantize(color1);
+        int indices[16];
+        int error = findIndices(rgba, endpoint0, endpoint1, indices);
+
+        // One refinement pass usually recovers most of the error left by the principal-axis estimate
+        if (error > 0 && refitEndpoints(rgba, indices, color0, color1)) {
+            const Endpoint refit0 = quantize(color0), refit1 = quantize(color1);
+            int refitIndices[16];
+            if (const int refitError = findIndices(rgba, refit0, refit1, refitIndices); refitError < error) {
+                endpoint0 = refit0;
+                endpoint1 = refit1;
+                std::copy(std::begin(refitIndices), std::end(refitIndices), std::begin(indices));
+            }
+        }
+
+        // The first index is stored without its most significant bit, so it must be below 8
+        if (indices[0] >= 8) {
+            std::swap(endpoint0, endpoint1);
+            for (int& index : indices)
+                index = 15 - index;
+        }
+
+        std::memset(output, 0, 16);
+        int bitPosition = 0;
+        const auto writeBits = [&](uint32_t value, int bitCount) {
+            for (int bit = 0; bit < bitCount; ++bit, ++bitPosition) {
+                if ((value >> bit) & 1u)
+                    output[bitPosition >> 3] |= static_cast<uint8_t>(1u << (bitPosition & 7));
+            }
+        };
+
+        writeBits(1u << 6, 7); // Mode 6
+        for (int channel = 0; channel < 4; ++channel) {
+            writeBits(uint32_t(endpoint0.value[channel]), 7);
+            writeBits(uint32_t(endpoint1.value[channel]), 7);
+        }
+        writeBits(uint32_t(endpoint0.pBit), 1);
+        writeBits(uint32_t(endpoint1.pBit), 1);
+        for (int pixel = 0; pixel < 16; ++pixel)
+            writeBits(uint32_t(indices[pixel]), pixel == 0 ? 3 : 4);
+    }
+
+} // namespace bc7
+
+void encodeBlock(const uint8_t rgba[64], RS_BlockFormat format, uint8_t* output)
+{
+    switch (format) {
+    case RS_BlockFormat::BC1:
+        stb_compress_dxt_block(output, rgba, 0, STB_DXT_HIGHQUAL);
+        break;
+    case RS_BlockFormat::BC4: {
+        uint8_t red[16];
+        for (int pixel = 0; pixel < 16; ++pixel)
+            red[pixel] = rgba[4 * pixel];
+        stb_compress_bc4_block(output, red);
+        break;
+    }
+    case RS_BlockFormat::BC5: {
+        uint8_t redGreen[32];
+        for (int pixel = 0; pixel < 16; ++pixel) {
+            redGreen[2 * pixel] = rgba[4 * pixel];
+            redGreen[2 * pixel + 1] = rgba[4 * pixel + 1];
+        }
+        stb_compress_bc5_block(output, redGreen);
+        break;
+    }
+    case RS_BlockFormat::BC7:
+        bc7::encodeBlock(rgba, output);
+        break;
+    }
+}
+
+bool hasExtension(std::string_view name)
+{
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i) {
+        if (name == reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i))))
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+void initBlockCompressionSupport()
+{
+    // RGTC is core since OpenGL 3.0; S3TC is an extension that every desktop driver exposes.
+    // BPTC is core since 4.2, so macOS (capped at 4.1) falls back to BC1 for colour maps.
+    s_hasBC1BC4BC5 = hasExtension("GL_EXT_texture_compression_s3tc");
+    s_hasBC7 = s_hasBC1BC4BC5 && ((GLVersion.major == 4 && GLVersion.minor >= 2) || GLVersion.major > 4 || hasExtension("GL_ARB_texture_compression_bptc"));
+
+    std::cout << "Texture compression: " << (s_hasBC1BC4BC5 ? "BC1/BC4/BC5" : "unavailable") << (s_hasBC7 ? ", BC7" : "") << std::endl;
+}
+
+std::optional<RS_BlockFormat> getBlockFormatForUsage(RS_TextureUsage usage)
+{
+    if (!s_hasBC1BC4BC5)
+        return std::nullopt;
+
+    switch (usage) {
+    case RS_TextureUsage::Color:
+        return s_hasBC7 ? RS_BlockFormat::BC7 : RS_BlockFormat::BC1;
+    case RS_TextureUsage::Normal:
+        return RS_BlockFormat::BC5;
+    case RS_TextureUsage::Mask:
+        return RS_BlockFormat::BC4;
+    case RS_TextureUsage::Packed:
+        // BC1 shares its endpoints between channels, which smears independent values into each other
+        return s_hasBC7 ? std::optional(RS_BlockFormat::BC7) : std::nullopt;
+    }
+    return std::nullopt;
+}
+
+GLenum getBlockFormatGLEnum(RS_BlockFormat format)
+{
+    switch (format) {
+    case RS_BlockFormat::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1;
+    case RS_BlockFormat::BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case RS_BlockFormat::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case RS_BlockFormat::BC7:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_NONE;
+}
+
+const char* getBlockFormatName(RS_BlockFormat format)
+{
+    switch (format) {
+    case RS_BlockFormat::BC1:
+        return "BC1";
+    case RS_BlockFormat::BC4:
+        return "BC4";
+    case RS_BlockFormat::BC5:
+        return "BC5";
+    case RS_BlockFormat::BC7:
+        return "BC7";
+    }
+    return "unknown";
+}
+
+std::optional<RS_CompressedTexture> RS_CompressedTexture::loadFromCache(const std::filesystem::path& sourceFile, RS_TextureUsage usage, RS_BlockFormat format, int sizeLimit)
+{
+    const std::optional<uint64_t> fileStamp = getCompressedCacheStamp(sourceFile, usage, format, sizeLimit);
+    if (!fileStamp)
+        return std::nullopt;
+    const std::filesystem::path cacheFile = getCompressedCachePath(sourceFile, *fileStamp, format);
+
+    std::error_code error;
+    if (!std::filesystem::exists(cacheFile, error))
+        return std::nullopt;
+
+    RS_CompressedTexture texture;
+    texture.m_format = format;
+    texture.m_sourcePath = sourceFile;
+    try {
+        texture.m_mappedFile.emplace(cacheFile);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+
+    const std::span<const std::byte> bytes = texture.m_mappedFile->bytes();
+    const auto rejectEntry = [&]() {
+        std::cerr << "Ignoring invalid compressed texture cache entry " << cacheFile << std::endl;
+        return std::nullopt;
+    };
+
+    CompressedCacheHeader header;
+    if (bytes.size() < sizeof(header))
+        return rejectEntry();
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != COMPRESSED_CACHE_MAGIC || header.version != COMPRESSED_CACHE_VERSION || header.format != uint32_t(format)
+        || header.usage != uint32_t(usage) || header.levelCount == 0 || sizeof(header) + header.levelCount * sizeof(CompressedCacheLevel) > bytes.size())
+        return rejectEntry();
+
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        CompressedCacheLevel level;
+        std::memcpy(&level, bytes.data() + sizeof(header) + i * sizeof(level), sizeof(level));
+        if (level.width == 0 || level.height == 0 || level.size != getLevelSize(format, int(level.width), int(level.height)) || level.offset + level.size > bytes.size())
+            return rejectEntry();
+        texture.m_levels.push_back({ int(level.width), int(level.height), bytes.subspan(level.offset, level.size) });
+    }
+    return texture;
+}
+
+RS_CompressedTexture RS_CompressedTexture::encode(const Image& image, RS_TextureUsage usage, RS_BlockFormat format, int sizeLimit)
+{
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    const std::vector<PixelLevel> pixelLevels = generateMipChain(convertToRGBA8(image.view()), usage);
+
+    RS_CompressedTexture texture;
+    texture.m_format = format;
+    texture.m_sourcePath = image.filePath;
+
+    // Levels are packed back to back; each block row is an independent job
+    struct BlockRow {
+        size_t level;
+        int blockY;
+        size_t offset;
+    };
+    std::vector<BlockRow> blockRows;
+    std::vector<size_t> levelOffsets;
+    size_t totalSize = 0;
+    for (size_t level = 0; level < pixelLevels.size(); ++level) {
+        const PixelLevel& pixels = pixelLevels[level];
+        const size_t rowSize = size_t((pixels.width + 3) / 4) * getBlockSize(format);
+        levelOffsets.push_back(totalSize);
+        for (int blockY = 0; blockY < (pixels.height + 3) / 4; ++blockY) {
+            blockRows.push_back({ level, blockY, totalSize });
+            totalSize += rowSize;
+        }
+    }
+    texture.m_blocks.resize(totalSize);
+
+    RS_ThreadPool::instance().parallelFor(0, static_cast<int>(blockRows.size()), [&](int begin, int end, int) {
+        uint8_t rgba[64];
+        for (int i = begin; i < end; ++i) {
+            const BlockRow& row = blockRows[size_t(i)];
+            const PixelLevel& pixels = pixelLevels[row.level];
+            uint8_t* output = reinterpret_cast<uint8_t*>(texture.m_blocks.data() + row.offset);
+            for (int blockX = 0; blockX < (pixels.width + 3) / 4; ++blockX, output += getBlockSize(format)) {
+                loadBlock(pixels, blockX, row.blockY, rgba);
+                encodeBlock(rgba, format, output);
+            }
+        }
+    });
+
+    for (size_t level = 0; level < pixelLevels.size(); ++level) {
+        const PixelLevel& pixels = pixelLevels[level];
+        texture.m_levels.push_back({ pixels.width, pixels.height,
+            std::span<const std::byte>(texture.m_blocks).subspan(levelOffsets[level], getLevelSize(format, pixels.width, pixels.height)) });
+    }
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Encoded " << image.filePath << " as " << getBlockFormatName(format) << " (" << image.width << "x" << image.height << ", "
+              << texture.m_levels.size() << " mips) in " << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+
+    const std::optional<uint64_t> fileStamp = image.filePath.empty() ? std::nullopt : getCompressedCacheStamp(image.filePath, usage, format, sizeLimit);
+    if (!fileStamp)
+        return texture;
+
+    CompressedCacheHeader header {};
+    header.magic = COMPRESSED_CACHE_MAGIC;
+    header.version = COMPRESSED_CACHE_VERSION;
+    header.format = uint32_t(format);
+    header.usage = uint32_t(usage);
+    header.width = uint32_t(image.width);
+    header.height = uint32_t(image.height);
+    header.levelCount = uint32_t(texture.m_levels.size());
+
+    const uint64_t dataOffset = alignOffset(sizeof(header) + texture.m_levels.size() * sizeof(CompressedCacheLevel));
+    std::vector<CompressedCacheLevel> records;
+    for (size_t level = 0; level < texture.m_levels.size(); ++level) {
+        const Level& source = texture.m_levels[level];
+        records.push_back({ uint32_t(source.width), uint32_t(source.height), dataOffset + levelOffsets[level], source.blocks.size() });
+    }
+
+    static constexpr std::array<std::byte, COMPRESSED_CACHE_ALIGNMENT> padding {};
+    const std::span<const std::byte> headerBytes = std::as_bytes(std::span(&header, 1));
+    const std::span<const std::byte> recordBytes = std::as_bytes(std::span(records));
+    const std::array<std::span<const std::byte>, 4> chunks {
+        headerBytes, recordBytes, std::span(padding).first(dataOffset - headerBytes.size() - recordBytes.size()), std::span<const std::byte>(texture.m_blocks)
+    };
+    const std::filesystem::path cacheFile = getCompressedCachePath(image.filePath, *fileStamp, format);
+    if (!writeFileAtomically(cacheFile, chunks))
+        std::cerr << "Failed to write compressed texture cache " << cacheFile << std::endl;
+
+    return texture;
+}
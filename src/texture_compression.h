@@ -0,0 +1,73 @@
+#pragma once
+#include <framework/image.h>
+#include <framework/mapped_file.h>
+#include <framework/opengl_includes.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Block-compressed GPU formats produced when importing material textures
+enum class RS_BlockFormat : uint32_t {
+    BC1, // RGB, 4 bits per pixel (S3TC)
+    BC4, // One channel, 4 bits per pixel (RGTC1)
+    BC5, // Two channels, 8 bits per pixel (RGTC2)
+    BC7 // RGBA, 8 bits per pixel (BPTC)
+};
+
+// What a material texture is sampled for; decides its block format and how its mips are filtered
+enum class RS_TextureUsage : uint32_t {
+    Color,
+    Normal, // Tangent-space normal map; only X and Y are kept, shaders reconstruct Z
+    Mask, // Scalar data such as metallic or roughness, read from the red channel
+    Packed // Unrelated values in each channel (e.g. occlusion/roughness/metallic); only compressed if BC7 is available
+};
+
+// Query the compressed formats the OpenGL context can sample. Must be called on the thread that owns the context
+// before textures are imported; until then every texture is uploaded uncompressed.
+void initBlockCompressionSupport();
+// Format that textures of the given usage are compressed to, or empty if they are uploaded as-is. Thread-safe.
+std::optional<RS_BlockFormat> getBlockFormatForUsage(RS_TextureUsage usage);
+
+GLenum getBlockFormatGLEnum(RS_BlockFormat format);
+const char* getBlockFormatName(RS_BlockFormat format);
+
+// Texture with its complete mip chain in a block-compressed format, ready for glCompressedTexImage2D.
+// Encoding happens once per source file: the result is cached next to the source and memory-mapped on later runs.
+// Does not touch OpenGL, so it can be produced on a worker thread.
+class RS_CompressedTexture {
+public:
+    struct Level {
+        int width;
+        int height;
+        std::span<const std::byte> blocks;
+    };
+
+    // Empty optional if there is no up-to-date cache entry for the source file. sizeLimit is the resolution cap the
+    // source was imported with (0 = full resolution); every cap has its own cache entry.
+    static std::optional<RS_CompressedTexture> loadFromCache(const std::filesystem::path& sourceFile, RS_TextureUsage usage, RS_BlockFormat format, int sizeLimit = 0);
+    // Generate mips and encode them on the thread pool; writes a cache entry if the image was loaded from a file.
+    // The image must already be scaled down to sizeLimit, which only keys the cache entry.
+    static RS_CompressedTexture encode(const Image& image, RS_TextureUsage usage, RS_BlockFormat format, int sizeLimit = 0);
+
+    RS_BlockFormat getFormat() const { return m_format; }
+    const std::filesystem::path& getSourcePath() const { return m_sourcePath; }
+    const std::vector<Level>& getLevels() const { return m_levels; }
+    bool isFromCache() const { return m_mappedFile.has_value(); }
+
+private:
+    RS_BlockFormat m_format { RS_BlockFormat::BC1 };
+    std::filesystem::path m_sourcePath;
+    std::optional<MappedFile> m_mappedFile; // Cache hit: the levels point into the mapping
+    std::vector<std::byte> m_blocks; // Freshly encoded: the levels point into this buffer
+    std::vector<Level> m_levels;
+};
+
+// Compressed versions of a material's textures: diffuse, normal, metallic, roughness and packed ORM (empty if not compressed)
+using RS_CompressedMaterialTextures = std::array<std::shared_ptr<const RS_CompressedTexture>, 5>;
+constexpr size_t RS_ORM_TEXTURE_SLOT = 4;
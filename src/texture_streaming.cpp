@@ -0,0 +1,218 @@
+#include "texture_streaming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Levels up to this size are uploaded with the texture; together they cost a few kilobytes
+constexpr int RESIDENT_TAIL_SIZE = 64;
+// Textures that were not drawn for this many frames only need their tail
+constexpr uint64_t IDLE_FRAMES = 120;
+// Main-thread time spent on finishing uploads whose data has been copied
+constexpr std::chrono::milliseconds UPLOAD_COMPLETION_BUDGET { 2 };
+
+int findTailLevel(const RS_CompressedTexture& texture)
+{
+    const std::vector<RS_CompressedTexture::Level>& levels = texture.getLevels();
+    for (size_t level = 0; level < levels.size(); ++level) {
+        if (std::max(levels[level].width, levels[level].height) <= RESIDENT_TAIL_SIZE)
+            return static_cast<int>(level);
+    }
+    return static_cast<int>(levels.size()) - 1;
+}
+
+} // namespace
+
+RS_StreamingTexture::RS_StreamingTexture(std::shared_ptr<const RS_CompressedTexture> source)
+    : m_source(std::move(source))
+    , m_tailLevel(findTailLevel(*m_source))
+    , m_residentLevel(m_tailLevel)
+    , m_requestedLevel(m_tailLevel)
+    , m_texture(*m_source, m_tailLevel)
+{
+    const std::vector<RS_CompressedTexture::Level>& levels = m_source->getLevels();
+    m_bytesFromLevel.resize(levels.size() + 1, 0);
+    for (size_t level = levels.size(); level-- > 0;)
+        m_bytesFromLevel[level] = m_bytesFromLevel[level + 1] + levels[level].blocks.size();
+
+    RS_TextureStreamer::instance().m_textures.push_back(this);
+}
+
+RS_StreamingTexture::~RS_StreamingTexture()
+{
+    std::erase(RS_TextureStreamer::instance().m_textures, this);
+}
+
+void RS_StreamingTexture::request(float pixelsPerUV)
+{
+    if (!(pixelsPerUV > 0.0f))
+        return;
+
+    // One texel per pixel: every level halves the texels per UV unit
+    const RS_CompressedTexture::Level& baseLevel = m_source->getLevels().front();
+    const float texelsPerPixel = float(std::max(baseLevel.width, baseLevel.height)) / pixelsPerUV;
+    const int level = texelsPerPixel <= 1.0f ? 0 : std::min(static_cast<int>(std::log2(texelsPerPixel)), m_tailLevel);
+
+    const uint64_t frame = RS_TextureStreamer::instance().m_frame;
+    if (m_lastRequestFrame != frame) {
+        m_lastRequestFrame = frame;
+        m_requestedLevel = level;
+    } else {
+        m_requestedLevel = std::min(m_requestedLevel, level);
+    }
+}
+
+void RS_StreamingTexture::rebuild(int firstLevel)
+{
+    // OpenGL cannot free single levels of a texture, but the coarse levels are cheap to upload again
+    m_texture = RS_Texture(*m_source, firstLevel);
+    m_residentLevel = firstLevel;
+}
+
+RS_TextureStreamer& RS_TextureStreamer::instance()
+{
+    // Intentionally leaked, like the texture cache that owns the streaming textures
+    static RS_TextureStreamer* streamer = new RS_TextureStreamer();
+    return *streamer;
+}
+
+size_t RS_TextureStreamer::getResidentBytes() const
+{
+    size_t residentBytes = 0;
+    for (const RS_StreamingTexture* texture : m_textures)
+        residentBytes += texture->getResidentBytes();
+    return residentBytes;
+}
+
+void RS_TextureStreamer::update(size_t uploadBudget, size_t memoryBudget)
+{
+    // Finish the uploads whose data was copied since the last frame
+    m_loader.processMainThreadQueue(UPLOAD_COMPLETION_BUDGET);
+
+    std::vector<int> targetLevels(m_textures.size());
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        const RS_StreamingTexture& texture = *m_textures[i];
+        targetLevels[i] = m_frame - texture.m_lastRequestFrame <= IDLE_FRAMES ? texture.m_requestedLevel : texture.m_tailLevel;
+    }
+
+    // Coarsen every texture by the same number of levels until the targets fit in the memory budget
+    const auto getTargetBytes = [&](int bias) {
+        size_t targetBytes = 0;
+        for (size_t i = 0; i < m_textures.size(); ++i)
+            targetBytes += m_textures[i]->m_bytesFromLevel[static_cast<size_t>(std::min(targetLevels[i] + bias, m_textures[i]->m_tailLevel))];
+        return targetBytes;
+    };
+    int bias = 0;
+    while (bias < 16 && getTargetBytes(bias) > memoryBudget)
+        ++bias;
+    for (size_t i = 0; i < m_textures.size(); ++i)
+        targetLevels[i] = std::min(targetLevels[i] + bias, m_textures[i]->m_tailLevel);
+
+    // Under memory pressure, drop the levels that are no longer needed; least recently used textures go first
+    size_t residentBytes = getResidentBytes() + m_uploadingBytes;
+    if (residentBytes > memoryBudget) {
+        std::vector<size_t> evictable;
+        for (size_t i = 0; i < m_textures.size(); ++i) {
+            if (m_textures[i]->m_residentLevel < targetLevels[i] && !m_textures[i]->m_isUploading)
+                evictable.push_back(i);
+        }
+        std::sort(std::begin(evictable), std::end(evictable), [&](size_t lhs, size_t rhs) {
+            return m_textures[lhs]->m_lastRequestFrame < m_textures[rhs]->m_lastRequestFrame;
+        });
+        for (size_t i : evictable) {
+            if (residentBytes <= memoryBudget)
+                break;
+            RS_StreamingTexture& texture = *m_textures[i];
+            residentBytes -= texture.getResidentBytes() - texture.m_bytesFromLevel[static_cast<size_t>(targetLevels[i])];
+            texture.rebuild(targetLevels[i]);
+        }
+    }
+
+    // Stream in one level per texture at a time, starting with the textures that are furthest from their target
+    std::vector<size_t> wanting;
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        if (m_textures[i]->m_residentLevel > targetLevels[i] && !m_textures[i]->m_isUploading)
+            wanting.push_back(i);
+    }
+    std::sort(std::begin(wanting), std::end(wanting), [&](size_t lhs, size_t rhs) {
+        const int lhsMissing = m_textures[lhs]->m_residentLevel - targetLevels[lhs];
+        const int rhsMissing = m_textures[rhs]->m_residentLevel - targetLevels[rhs];
+        if (lhsMissing != rhsMissing)
+            return lhsMissing > rhsMissing;
+        return m_textures[lhs]->m_lastRequestFrame > m_textures[rhs]->m_lastRequestFrame;
+    });
+
+    size_t uploadedBytes = 0;
+    for (size_t i : wanting) {
+        RS_StreamingTexture& texture = *m_textures[i];
+        const int level = texture.m_residentLevel - 1;
+        const size_t levelBytes = texture.m_source->getLevels()[static_cast<size_t>(level)].blocks.size();
+        // At least one upload per frame, so a level larger than the budget still arrives
+        if (uploadedBytes > 0 && uploadedBytes + levelBytes > uploadBudget)
+            break;
+        if (residentBytes + levelBytes > memoryBudget)
+            continue;
+
+        uploadedBytes += levelBytes;
+        residentBytes += levelBytes;
+        uploadLevel(texture.shared_from_this(), level);
+    }
+
+    ++m_frame;
+}
+
+GLuint RS_TextureStreamer::acquirePixelBuffer()
+{
+    if (m_freePixelBuffers.empty()) {
+        GLuint pixelBuffer;
+        glGenBuffers(1, &pixelBuffer);
+        return pixelBuffer;
+    }
+    const GLuint pixelBuffer = m_freePixelBuffers.back();
+    m_freePixelBuffers.pop_back();
+    return pixelBuffer;
+}
+
+RS_LoadTask RS_TextureStreamer::uploadLevel(std::shared_ptr<RS_StreamingTexture> texture, int level)
+{
+    const auto scope = m_loader.trackTask();
+    const RS_CompressedTexture::Level& source = texture->m_source->getLevels()[static_cast<size_t>(level)];
+    const GLsizeiptr size = static_cast<GLsizeiptr>(source.blocks.size());
+    texture->m_isUploading = true;
+    m_uploadingBytes += source.blocks.size();
+
+    // Invalidating the whole buffer lets the driver hand out fresh storage instead of waiting for an earlier upload
+    const GLuint pixelBuffer = acquirePixelBuffer();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (staging) {
+        co_await m_loader.resumeOnWorker();
+        std::memcpy(staging, source.blocks.data(), source.blocks.size());
+        co_await m_loader.resumeOnMainThread();
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    // Unmapping fails if the buffer contents were lost in the meantime; the level is then requested again later
+    if (staging && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE) {
+        // Sourced from the bound pixel buffer, so the data pointer is an offset into it
+        glBindTexture(GL_TEXTURE_2D, texture->m_texture.getTextureID());
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, getBlockFormatGLEnum(texture->m_source->getFormat()), source.width, source.height, 0,
+            static_cast<GLsizei>(size), nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        texture->m_residentLevel = level;
+    } else {
+        std::cerr << "Failed to stream mip " << level << " of " << texture->m_source->getSourcePath() << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m_freePixelBuffers.push_back(pixelBuffer);
+    m_uploadingBytes -= source.blocks.size();
+    texture->m_isUploading = false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "async_loader.h"
+#include "texture.h"
+#include "texture_compression.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Block-compressed texture whose finer mips are uploaded only once they are needed on screen. The coarse tail of
+// the mip chain is uploaded immediately, so the texture can be drawn right away; RS_TextureStreamer adds and drops
+// the finer levels. Must only be used on the thread that owns the OpenGL context.
+class RS_StreamingTexture : public std::enable_shared_from_this<RS_StreamingTexture> {
+public:
+    explicit RS_StreamingTexture(std::shared_ptr<const RS_CompressedTexture> source);
+    ~RS_StreamingTexture();
+
+    RS_StreamingTexture(const RS_StreamingTexture&) = delete;
+    RS_StreamingTexture& operator=(const RS_StreamingTexture&) = delete;
+
+    // Ask for the mips needed to draw one UV unit across the given number of pixels. Requests are collected
+    // per frame; the finest one wins.
+    void request(float pixelsPerUV);
+
+    // Stays the same object while levels are added and dropped, so it can be bound like any other texture
+    RS_Texture& getTexture() { return m_texture; }
+    const RS_Texture& getTexture() const { return m_texture; }
+    int getResidentLevel() const { return m_residentLevel; }
+    size_t getResidentBytes() const { return m_bytesFromLevel[static_cast<size_t>(m_residentLevel)]; }
+
+private:
+    friend class RS_TextureStreamer;
+
+    // Replace the GL texture by one that holds only the levels from firstLevel on, freeing the finer ones
+    void rebuild(int firstLevel);
+
+    std::shared_ptr<const RS_CompressedTexture> m_source;
+    int m_tailLevel; // Finest level that is always resident
+    int m_residentLevel; // Finest level uploaded so far
+    int m_requestedLevel; // Finest level requested in the frame of the last request
+    uint64_t m_lastRequestFrame { 0 };
+    bool m_isUploading { false };
+    std::vector<size_t> m_bytesFromLevel; // Size of the levels from the index on to the end of the chain
+    RS_Texture m_texture;
+};
+
+// Decides which mips of the streaming textures are resident. Runs once per frame, after the meshes requested their
+// textures: finer levels are uploaded through pixel buffer objects within a byte budget per frame, and when the
+// textures would exceed the memory budget every texture is coarsened alike and unneeded levels are dropped, least
+// recently used first. Must only be used on the thread that owns the OpenGL context.
+class RS_TextureStreamer {
+public:
+    static RS_TextureStreamer& instance();
+
+    void update(size_t uploadBudget, size_t memoryBudget);
+
+    size_t getTextureCount() const { return m_textures.size(); }
+    size_t getResidentBytes() const;
+
+private:
+    friend class RS_StreamingTexture;
+    RS_TextureStreamer() = default;
+
+    // Copies the level into a pixel buffer on a worker thread (paging it in from the cache file) and uploads it from
+    // there on the main thread, so neither the disk read nor the copy stalls the frame
+    RS_LoadTask uploadLevel(std::shared_ptr<RS_StreamingTexture> texture, int level);
+    GLuint acquirePixelBuffer();
+
+    std::vector<RS_StreamingTexture*> m_textures; // Registered by their constructor
+    std::vector<GLuint> m_freePixelBuffers;
+    // Separate from the asset loader: streaming in the background does not count as loading
+    RS_AsyncLoader m_loader;
+    uint64_t m_frame { 1 };
+    size_t m_uploadingBytes { 0 };
+};
@@ -0,0 +1,108 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+RS_ThreadPool::RS_ThreadPool(unsigned threadCount)
+{
+    threadCount = std::max(1u, threadCount);
+    m_workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_workers.emplace_back([this]() { workerLoop(); });
+}
+
+RS_ThreadPool::~RS_ThreadPool()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+RS_ThreadPool& RS_ThreadPool::instance()
+{
+    // Leave one hardware thread for the render loop
+    static RS_ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1u);
+    return pool;
+}
+
+void RS_ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void RS_ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int, int)>& body, int maxRanges)
+{
+    if (end <= begin)
+        return;
+
+    const int count = end - begin;
+    const int rangeCount = std::clamp(maxRanges > 0 ? maxRanges : getDefaultRangeCount(), 1, count);
+    if (rangeCount == 1) {
+        body(begin, end, 0);
+        return;
+    }
+
+    // Shared with the queued helper jobs, which may only get to run after this call has returned
+    struct State {
+        std::atomic<int> nextRange { 0 };
+        int remaining { 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    state->remaining = rangeCount;
+
+    const auto runRanges = [state, &body, begin, count, rangeCount]() {
+        int processed = 0;
+        for (int range = state->nextRange++; range < rangeCount; range = state->nextRange++) {
+            const int rangeBegin = begin + static_cast<int>(static_cast<long long>(count) * range / rangeCount);
+            const int rangeEnd = begin + static_cast<int>(static_cast<long long>(count) * (range + 1) / rangeCount);
+            body(rangeBegin, rangeEnd, range);
+            ++processed;
+        }
+
+        if (processed > 0) {
+            std::lock_guard lock(state->mutex);
+            state->remaining -= processed;
+            if (state->remaining == 0)
+                state->done.notify_all();
+        }
+    };
+
+    const int helperCount = std::min(rangeCount - 1, static_cast<int>(m_workers.size()));
+    // Helpers only touch body while ranges are left, which cannot outlive this call
+    for (int i = 0; i < helperCount; ++i)
+        submit(runRanges);
+
+    runRanges();
+
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->remaining == 0; });
+}
+
+void RS_ThreadPool::workerLoop()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping && m_jobs.empty())
+                return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
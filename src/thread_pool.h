@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads shared by the CPU-side preprocessing code (environment
+// projection, asset decoding, water simulation, ...).
+class RS_ThreadPool {
+public:
+    explicit RS_ThreadPool(unsigned threadCount);
+    ~RS_ThreadPool();
+
+    RS_ThreadPool(const RS_ThreadPool&) = delete;
+    RS_ThreadPool& operator=(const RS_ThreadPool&) = delete;
+
+    // Process-wide pool sized to the number of hardware threads (minus the calling thread)
+    static RS_ThreadPool& instance();
+
+    unsigned getThreadCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+    // Queue a job; it runs on one of the worker threads at some point in the future
+    void submit(std::function<void()> job);
+
+    // Split [begin, end) into at most maxRanges contiguous ranges and call body(rangeBegin, rangeEnd, rangeIndex)
+    // for each of them. The calling thread helps out and the call returns once every range has been processed.
+    // maxRanges <= 0 uses one range per worker plus one for the caller.
+    void parallelFor(int begin, int end, const std::function<void(int, int, int)>& body, int maxRanges = 0);
+
+    // Number of ranges parallelFor splits into when maxRanges <= 0
+    int getDefaultRangeCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping { false };
+};
@@ -0,0 +1,516 @@
+#include "water_noise.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+// Defining RS_WATER_NOISE_SCALAR builds only the scalar path, so that it can be tested and benchmarked on its own
+#if !defined(RS_WATER_NOISE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RS_WATER_NOISE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// ----- PerlinNoise --------------------------------------------------------------------------------
+
+PerlinNoise::PerlinNoise(uint32_t seed)
+{
+    std::array<int, 256> base{};
+    for (int i = 0; i < 256; ++i)
+        base[static_cast<size_t>(i)] = i;
+
+    std::mt19937 rng(seed);
+    std::shuffle(base.begin(), base.end(), rng);
+
+    for (int i = 0; i < 256; ++i) {
+        const size_t idx = static_cast<size_t>(i);
+        m_permutation[idx] = m_permutation[256 + idx] = base[idx];
+    }
+}
+
+namespace {
+
+template <typename T>
+T fade(T t)
+{
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+template <typename T>
+T fadeDerivative(T t)
+{
+    return 30 * t * t * (t * (t - 2) + 1);
+}
+
+template <typename T>
+T lerp(T t, T a, T b)
+{
+    return a + t * (b - a);
+}
+
+template <typename T>
+T grad(int hash, T x, T y, T z)
+{
+    const int h = hash & 15;
+    const T u = h < 8 ? x : y;
+    const T v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+// Hashes of the eight lattice corners of cell (x0, y0, z0), whose far corners are (x1, y1, z1); corner (dx, dy, dz)
+// at index dx + 2 * dy + 4 * dz. The table holds the permutation twice, so the sums never need wrapping.
+void cornerHashes(const int* permutation, int x0, int x1, int y0, int y1, int z0, int z1, int* hashes)
+{
+    const int a0 = permutation[x0] + y0;
+    const int a1 = permutation[x0] + y1;
+    const int b0 = permutation[x1] + y0;
+    const int b1 = permutation[x1] + y1;
+    const int aa = permutation[a0];
+    const int ab = permutation[a1];
+    const int ba = permutation[b0];
+    const int bb = permutation[b1];
+    hashes[0] = permutation[aa + z0];
+    hashes[1] = permutation[ba + z0];
+    hashes[2] = permutation[ab + z0];
+    hashes[3] = permutation[bb + z0];
+    hashes[4] = permutation[aa + z1];
+    hashes[5] = permutation[ba + z1];
+    hashes[6] = permutation[ab + z1];
+    hashes[7] = permutation[bb + z1];
+}
+
+// Lattice cell and fade weights along y and z, which are shared by a whole row. The lattice repeats every
+// periodMask + 1 cells along each axis; 255 everywhere is the plain noise, which repeats with the permutation.
+struct NoiseRow {
+    int maskX;
+    int yi, yi1, zi, zi1;
+    float yf, zf;
+    float v, w, dw;
+
+    NoiseRow(float y, float z, const glm::ivec3& periodMask)
+        : maskX(periodMask.x)
+    {
+        const float cellY = std::floor(y);
+        const float cellZ = std::floor(z);
+        yi = static_cast<int>(cellY) & periodMask.y;
+        zi = static_cast<int>(cellZ) & periodMask.z;
+        yi1 = (yi + 1) & periodMask.y;
+        zi1 = (zi + 1) & periodMask.z;
+        yf = y - cellY;
+        zf = z - cellZ;
+        v = fade(yf);
+        w = fade(zf);
+        dw = fadeDerivative(zf);
+    }
+};
+
+struct NoiseSample {
+    float value, derivativeX, derivativeZ;
+};
+
+NoiseSample noisePoint(const int* permutation, const NoiseRow& row, float x, bool withDerivatives)
+{
+    const float cellX = std::floor(x);
+    const float xf = x - cellX;
+    const float u = fade(xf);
+
+    const int xi = static_cast<int>(cellX) & row.maskX;
+    int hashes[8];
+    cornerHashes(permutation, xi, (xi + 1) & row.maskX, row.yi, row.yi1, row.zi, row.zi1, hashes);
+
+    float corners[8];
+    for (int c = 0; c < 8; ++c)
+        corners[c] = grad(hashes[c], xf - static_cast<float>(c & 1), row.yf - static_cast<float>((c >> 1) & 1), row.zf - static_cast<float>(c >> 2));
+
+    float edges[4];
+    for (int e = 0; e < 4; ++e)
+        edges[e] = lerp(u, corners[2 * e], corners[2 * e + 1]);
+
+    const float y1 = lerp(row.v, edges[0], edges[1]);
+    const float y2 = lerp(row.v, edges[2], edges[3]);
+    NoiseSample sample { lerp(row.w, y1, y2), 0.0f, 0.0f };
+    if (!withDerivatives)
+        return sample;
+
+    const float du = fadeDerivative(xf);
+    float edgesX[4], edgesZ[4];
+    for (int e = 0; e < 4; ++e) {
+        const int c = 2 * e;
+        edgesX[e] = du * (corners[c + 1] - corners[c]) + lerp(u, grad(hashes[c], 1.0f, 0.0f, 0.0f), grad(hashes[c + 1], 1.0f, 0.0f, 0.0f));
+        edgesZ[e] = lerp(u, grad(hashes[c], 0.0f, 0.0f, 1.0f), grad(hashes[c + 1], 0.0f, 0.0f, 1.0f));
+    }
+    sample.derivativeX = lerp(row.w, lerp(row.v, edgesX[0], edgesX[1]), lerp(row.v, edgesX[2], edgesX[3]));
+    sample.derivativeZ = row.dw * (y2 - y1) + lerp(row.w, lerp(row.v, edgesZ[0], edgesZ[1]), lerp(row.v, edgesZ[2], edgesZ[3]));
+    return sample;
+}
+
+#ifdef RS_WATER_NOISE_SSE2
+__m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128 lerp4(__m128 t, __m128 a, __m128 b)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+__m128 fade4(__m128 t)
+{
+    const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+__m128 fadeDerivative4(__m128 t)
+{
+    const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(t, _mm_set1_ps(2.0f))), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(30.0f), t), t), inner);
+}
+
+// grad() for four hashes: the low two bits become the signs of u and v
+__m128 grad4(__m128i hash, __m128 x, __m128 y, __m128 z)
+{
+    const __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    const __m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    const __m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    const __m128 is12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+    const __m128 u = select4(below8, x, y);
+    const __m128 v = select4(below4, y, select4(is12or14, x, z));
+    const __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+    const __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+    return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(v, signV));
+}
+
+// floor() by truncation, corrected for negative values
+__m128i floor4(__m128 x)
+{
+    const __m128i cell = _mm_cvttps_epi32(x);
+    return _mm_add_epi32(cell, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(cell), x)));
+}
+
+// NoiseRow for four samples that share y but may each have their own z
+struct NoiseLanes {
+    int maskX;
+    int yi, yi1;
+    alignas(16) int zi[4];
+    alignas(16) int zi1[4];
+    __m128 yf, v, zf, w, dw;
+
+    explicit NoiseLanes(const NoiseRow& row)
+        : maskX(row.maskX), yi(row.yi), yi1(row.yi1)
+        , yf(_mm_set1_ps(row.yf)), v(_mm_set1_ps(row.v)), zf(_mm_set1_ps(row.zf)), w(_mm_set1_ps(row.w)), dw(_mm_set1_ps(row.dw))
+    {
+        std::fill(std::begin(zi), std::end(zi), row.zi);
+        std::fill(std::begin(zi1), std::end(zi1), row.zi1);
+    }
+
+    // The y of row and a z for every lane, on the lattice of periodMask
+    NoiseLanes(const NoiseRow& row, __m128 z, int maskZ)
+        : maskX(row.maskX), yi(row.yi), yi1(row.yi1), yf(_mm_set1_ps(row.yf)), v(_mm_set1_ps(row.v))
+    {
+        const __m128i cell = floor4(z);
+        const __m128i mask = _mm_set1_epi32(maskZ);
+        const __m128i cellMasked = _mm_and_si128(cell, mask);
+        _mm_store_si128(reinterpret_cast<__m128i*>(zi), cellMasked);
+        _mm_store_si128(reinterpret_cast<__m128i*>(zi1), _mm_and_si128(_mm_add_epi32(cellMasked, _mm_set1_epi32(1)), mask));
+        zf = _mm_sub_ps(z, _mm_cvtepi32_ps(cell));
+        w = fade4(zf);
+        dw = fadeDerivative4(zf);
+    }
+};
+
+// noisePoint() for four x; the permutation lookups stay scalar since SSE2 has no gather
+void noisePoint4(const int* permutation, const NoiseLanes& lanes, __m128 x, float* values, float* derivativesX, float* derivativesZ)
+{
+    const __m128i cell = floor4(x);
+    const __m128 xf = _mm_sub_ps(x, _mm_cvtepi32_ps(cell));
+    const __m128 u = fade4(xf);
+
+    alignas(16) int cells[4];
+    alignas(16) int hashes[8][4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(cells), _mm_and_si128(cell, _mm_set1_epi32(lanes.maskX)));
+    for (int lane = 0; lane < 4; ++lane) {
+        int laneHashes[8];
+        cornerHashes(permutation, cells[lane], (cells[lane] + 1) & lanes.maskX, lanes.yi, lanes.yi1, lanes.zi[lane], lanes.zi1[lane], laneHashes);
+        for (int c = 0; c < 8; ++c)
+            hashes[c][lane] = laneHashes[c];
+    }
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 xs[2] { xf, _mm_sub_ps(xf, one) };
+    const __m128 ys[2] { lanes.yf, _mm_sub_ps(lanes.yf, one) };
+    const __m128 zs[2] { lanes.zf, _mm_sub_ps(lanes.zf, one) };
+    const bool withDerivatives = derivativesX != nullptr;
+
+    __m128 corners[8], cornersX[8], cornersZ[8];
+    for (int c = 0; c < 8; ++c) {
+        const __m128i hash = _mm_load_si128(reinterpret_cast<const __m128i*>(hashes[c]));
+        corners[c] = grad4(hash, xs[c & 1], ys[(c >> 1) & 1], zs[c >> 2]);
+        if (withDerivatives) {
+            cornersX[c] = grad4(hash, one, zero, zero);
+            cornersZ[c] = grad4(hash, zero, zero, one);
+        }
+    }
+
+    __m128 edges[4];
+    for (int e = 0; e < 4; ++e)
+        edges[e] = lerp4(u, corners[2 * e], corners[2 * e + 1]);
+
+    const __m128 v = lanes.v;
+    const __m128 w = lanes.w;
+    const __m128 y1 = lerp4(v, edges[0], edges[1]);
+    const __m128 y2 = lerp4(v, edges[2], edges[3]);
+    _mm_storeu_ps(values, lerp4(w, y1, y2));
+    if (!withDerivatives)
+        return;
+
+    const __m128 du = fadeDerivative4(xf);
+    __m128 edgesX[4], edgesZ[4];
+    for (int e = 0; e < 4; ++e) {
+        const int c = 2 * e;
+        edgesX[e] = _mm_add_ps(_mm_mul_ps(du, _mm_sub_ps(corners[c + 1], corners[c])), lerp4(u, cornersX[c], cornersX[c + 1]));
+        edgesZ[e] = lerp4(u, cornersZ[c], cornersZ[c + 1]);
+    }
+    _mm_storeu_ps(derivativesX, lerp4(w, lerp4(v, edgesX[0], edgesX[1]), lerp4(v, edgesX[2], edgesX[3])));
+    _mm_storeu_ps(derivativesZ, _mm_add_ps(_mm_mul_ps(lanes.dw, _mm_sub_ps(y2, y1)),
+        lerp4(w, lerp4(v, edgesZ[0], edgesZ[1]), lerp4(v, edgesZ[2], edgesZ[3]))));
+}
+#endif
+
+void evaluateNoiseRow(const int* permutation, const glm::ivec3& periodMask, float x0, float step, float y, float z,
+    std::span<float> values, std::span<float> derivativesX, std::span<float> derivativesZ)
+{
+    const bool withDerivatives = !derivativesX.empty();
+    assert(derivativesX.size() == derivativesZ.size());
+    assert(!withDerivatives || derivativesX.size() == values.size());
+
+    const NoiseRow row(y, z, periodMask);
+    const size_t count = values.size();
+    size_t i = 0;
+#ifdef RS_WATER_NOISE_SSE2
+    const NoiseLanes lanes(row);
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    for (; i + 4 <= count; i += 4) {
+        // Same rounding as the scalar tail: x0 + float(i) * step
+        const __m128 index = _mm_add_ps(_mm_set1_ps(static_cast<float>(i)), laneOffsets);
+        const __m128 x = _mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(index, _mm_set1_ps(step)));
+        noisePoint4(permutation, lanes, x, &values[i],
+            withDerivatives ? &derivativesX[i] : nullptr, withDerivatives ? &derivativesZ[i] : nullptr);
+    }
+#endif
+    for (; i < count; ++i) {
+        const NoiseSample sample = noisePoint(permutation, row, x0 + static_cast<float>(i) * step, withDerivatives);
+        values[i] = sample.value;
+        if (withDerivatives) {
+            derivativesX[i] = sample.derivativeX;
+            derivativesZ[i] = sample.derivativeZ;
+        }
+    }
+}
+
+void evaluateNoisePoints(const int* permutation, const glm::ivec3& periodMask, std::span<const float> x, float y,
+    std::span<const float> z, std::span<float> values, std::span<float> derivativesX, std::span<float> derivativesZ)
+{
+    const bool withDerivatives = !derivativesX.empty();
+    assert(x.size() == values.size() && z.size() == values.size());
+    assert(derivativesX.size() == derivativesZ.size());
+    assert(!withDerivatives || derivativesX.size() == values.size());
+
+    const size_t count = values.size();
+    size_t i = 0;
+#ifdef RS_WATER_NOISE_SSE2
+    const NoiseRow shared(y, 0.0f, periodMask);
+    for (; i + 4 <= count; i += 4) {
+        const NoiseLanes lanes(shared, _mm_loadu_ps(&z[i]), periodMask.z);
+        noisePoint4(permutation, lanes, _mm_loadu_ps(&x[i]), &values[i],
+            withDerivatives ? &derivativesX[i] : nullptr, withDerivatives ? &derivativesZ[i] : nullptr);
+    }
+#endif
+    for (; i < count; ++i) {
+        const NoiseSample sample = noisePoint(permutation, NoiseRow(y, z[i], periodMask), x[i], withDerivatives);
+        values[i] = sample.value;
+        if (withDerivatives) {
+            derivativesX[i] = sample.derivativeX;
+            derivativesZ[i] = sample.derivativeZ;
+        }
+    }
+}
+
+} // namespace
+
+double PerlinNoise::noise(double x, double y, double z) const
+{
+    const int xi = static_cast<int>(std::floor(x)) & 255;
+    const int yi = static_cast<int>(std::floor(y)) & 255;
+    const int zi = static_cast<int>(std::floor(z)) & 255;
+
+    const double xf = x - std::floor(x);
+    const double yf = y - std::floor(y);
+    const double zf = z - std::floor(z);
+
+    const double u = fade(xf);
+    const double v = fade(yf);
+    const double w = fade(zf);
+
+    const auto perm = [this](int value) -> int {
+        return m_permutation[static_cast<size_t>(value & 255)];
+    };
+
+    const int aaa = perm(perm(perm(xi) + yi) + zi);
+    const int aba = perm(perm(perm(xi) + yi + 1) + zi);
+    const int aab = perm(perm(perm(xi) + yi) + zi + 1);
+    const int abb = perm(perm(perm(xi) + yi + 1) + zi + 1);
+    const int baa = perm(perm(perm(xi + 1) + yi) + zi);
+    const int bba = perm(perm(perm(xi + 1) + yi + 1) + zi);
+    const int bab = perm(perm(perm(xi + 1) + yi) + zi + 1);
+    const int bbb = perm(perm(perm(xi + 1) + yi + 1) + zi + 1);
+
+    const double x1 = lerp(u, grad(aaa, xf, yf, zf), grad(baa, xf - 1, yf, zf));
+    const double x2 = lerp(u, grad(aba, xf, yf - 1, zf), grad(bba, xf - 1, yf - 1, zf));
+    const double y1 = lerp(v, x1, x2);
+
+    const double x3 = lerp(u, grad(aab, xf, yf, zf - 1), grad(bab, xf - 1, yf, zf - 1));
+    const double x4 = lerp(u, grad(abb, xf, yf - 1, zf - 1), grad(bbb, xf - 1, yf - 1, zf - 1));
+    const double y2 = lerp(v, x3, x4);
+
+    return lerp(w, y1, y2);
+}
+
+void PerlinNoise::noiseRow(float x0, float step, float y, float z, std::span<float> values,
+    std::span<float> derivativesX, std::span<float> derivativesZ) const
+{
+    evaluateNoiseRow(m_permutation.data(), glm::ivec3(255), x0, step, y, z, values, derivativesX, derivativesZ);
+}
+
+void PerlinNoise::periodicNoiseRow(const glm::ivec3& period, float x0, float step, float y, float z, std::span<float> values,
+    std::span<float> derivativesX, std::span<float> derivativesZ) const
+{
+    assert(glm::all(glm::greaterThan(period, glm::ivec3(0))) && glm::all(glm::lessThanEqual(period, glm::ivec3(256))));
+    assert((period.x & (period.x - 1)) == 0 && (period.y & (period.y - 1)) == 0 && (period.z & (period.z - 1)) == 0);
+    evaluateNoiseRow(m_permutation.data(), period - 1, x0, step, y, z, values, derivativesX, derivativesZ);
+}
+
+void PerlinNoise::noisePoints(std::span<const float> x, float y, std::span<const float> z, std::span<float> values,
+    std::span<float> derivativesX, std::span<float> derivativesZ) const
+{
+    evaluateNoisePoints(m_permutation.data(), glm::ivec3(255), x, y, z, values, derivativesX, derivativesZ);
+}
+
+// ----- NoiseVolume --------------------------------------------------------------------------------
+
+namespace {
+
+struct VolumeAxis {
+    int texel0, texel1;
+    float weight;
+};
+
+// Texels on either side of a noise coordinate along an axis of texelsPerCell texels per cell and texels in total
+VolumeAxis volumeAxis(float coordinate, int texelsPerCell, int texels)
+{
+    const float texel = coordinate * static_cast<float>(texelsPerCell);
+    const float cell = std::floor(texel);
+    const int texel0 = static_cast<int>(cell) & (texels - 1);
+    return { texel0, (texel0 + 1) & (texels - 1), texel - cell };
+}
+
+} // namespace
+
+void NoiseVolume::bake(const PerlinNoise& noise)
+{
+    constexpr glm::ivec3 size = getSize();
+    m_texels.resize(static_cast<size_t>(size.x) * static_cast<size_t>(size.y) * static_cast<size_t>(size.z));
+
+    // The noise takes time as its y coordinate
+    const glm::ivec3 noisePeriod(PERIOD.x, PERIOD.z, PERIOD.y);
+    const glm::vec3 texelSize = 1.0f / glm::vec3(TEXELS_PER_CELL);
+
+    // One x row of texels per noise row, for every z and time
+    RS_ThreadPool::instance().parallelFor(0, size.y * size.z, [&](int begin, int end, int) {
+        std::vector<float> scratch(3 * static_cast<size_t>(size.x));
+        const std::span<float> values(scratch.data(), static_cast<size_t>(size.x));
+        const std::span<float> derivativesX(scratch.data() + size.x, static_cast<size_t>(size.x));
+        const std::span<float> derivativesZ(scratch.data() + 2 * size.x, static_cast<size_t>(size.x));
+
+        for (int row = begin; row < end; ++row) {
+            const int z = row % size.y;
+            const int t = row / size.y;
+            noise.periodicNoiseRow(noisePeriod, 0.0f, texelSize.x, static_cast<float>(t) * texelSize.z,
+                static_cast<float>(z) * texelSize.y, values, derivativesX, derivativesZ);
+
+            glm::vec4* texels = &m_texels[static_cast<size_t>(row) * static_cast<size_t>(size.x)];
+            for (size_t x = 0; x < values.size(); ++x)
+                texels[x] = glm::vec4(values[x], derivativesX[x], derivativesZ[x], 0.0f);
+        }
+    });
+}
+
+void NoiseVolume::sampleRow(float x0, float step, float y, float z, std::span<float> values,
+    std::span<float> derivativesX, std::span<float> derivativesZ) const
+{
+    assert(isBaked());
+    const bool withDerivatives = !derivativesX.empty();
+    assert(derivativesX.size() == derivativesZ.size());
+    assert(!withDerivatives || derivativesX.size() == values.size());
+
+    // Every sample of the row lies between the same two z and time texels, so those four x rows are blended once
+    // and the samples only interpolate along x
+    constexpr glm::ivec3 size = getSize();
+    const VolumeAxis axisZ = volumeAxis(z, TEXELS_PER_CELL.y, size.y);
+    const VolumeAxis axisT = volumeAxis(y, TEXELS_PER_CELL.z, size.z);
+    const auto texelRow = [this, size](int zi, int ti) {
+        return &m_texels[(static_cast<size_t>(ti) * static_cast<size_t>(size.y) + static_cast<size_t>(zi)) * static_cast<size_t>(size.x)];
+    };
+    const glm::vec4* rows[4] = { texelRow(axisZ.texel0, axisT.texel0), texelRow(axisZ.texel1, axisT.texel0),
+        texelRow(axisZ.texel0, axisT.texel1), texelRow(axisZ.texel1, axisT.texel1) };
+    const float weights[4] = { (1.0f - axisZ.weight) * (1.0f - axisT.weight), axisZ.weight * (1.0f - axisT.weight),
+        (1.0f - axisZ.weight) * axisT.weight, axisZ.weight * axisT.weight };
+
+    std::array<glm::vec4, static_cast<size_t>(size.x)> blended;
+    for (size_t x = 0; x < blended.size(); ++x)
+        blended[x] = weights[0] * rows[0][x] + weights[1] * rows[1][x] + weights[2] * rows[2][x] + weights[3] * rows[3][x];
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        const VolumeAxis axisX = volumeAxis(x0 + static_cast<float>(i) * step, TEXELS_PER_CELL.x, size.x);
+        const glm::vec4 sample = glm::mix(blended[static_cast<size_t>(axisX.texel0)], blended[static_cast<size_t>(axisX.texel1)], axisX.weight);
+        values[i] = sample.x;
+        if (withDerivatives) {
+            derivativesX[i] = sample.y;
+            derivativesZ[i] = sample.z;
+        }
+    }
+}
+
+void NoiseVolume::samplePoints(std::span<const float> x, float y, std::span<const float> z, std::span<float> values,
+    std::span<float> derivativesX, std::span<float> derivativesZ) const
+{
+    assert(isBaked());
+    const bool withDerivatives = !derivativesX.empty();
+    assert(x.size() == values.size() && z.size() == values.size());
+    assert(derivativesX.size() == derivativesZ.size());
+    assert(!withDerivatives || derivativesX.size() == values.size());
+
+    constexpr glm::ivec3 size = getSize();
+    const VolumeAxis axisT = volumeAxis(y, TEXELS_PER_CELL.z, size.z);
+    const auto texel = [this, size](int xi, int zi, int ti) {
+        return m_texels[(static_cast<size_t>(ti) * static_cast<size_t>(size.y) + static_cast<size_t>(zi)) * static_cast<size_t>(size.x) + static_cast<size_t>(xi)];
+    };
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        const VolumeAxis axisX = volumeAxis(x[i], TEXELS_PER_CELL.x, size.x);
+        const VolumeAxis axisZ = volumeAxis(z[i], TEXELS_PER_CELL.y, size.y);
+        const auto blendX = [&](int zi, int ti) {
+            return glm::mix(texel(axisX.texel0, zi, ti), texel(axisX.texel1, zi, ti), axisX.weight);
+        };
+        const glm::vec4 near = glm::mix(blendX(axisZ.texel0, axisT.texel0), blendX(axisZ.texel1, axisT.texel0), axisZ.weight);
+        const glm::vec4 far = glm::mix(blendX(axisZ.texel0, axisT.texel1), blendX(axisZ.texel1, axisT.texel1), axisZ.weight);
+        const glm::vec4 sample = glm::mix(near, far, axisT.weight);
+        values[i] = sample.x;
+        if (withDerivatives) {
+            derivativesX[i] = sample.y;
+            derivativesZ[i] = sample.z;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class PerlinNoise
+{
+public:
+    explicit PerlinNoise(uint32_t seed = 0);
+
+    double noise(double x, double y, double z) const;
+
+    // Single-precision noise at (x0 + i * step, y, z) for every element i of values, evaluated four points at a time
+    // where SSE2 is available. The derivatives along x and z are written too when their spans are not empty.
+    void noiseRow(float x0, float step, float y, float z, std::span<float> values,
+        std::span<float> derivativesX = {}, std::span<float> derivativesZ = {}) const;
+    // noiseRow() on a lattice that repeats every period cells along x, y and z; powers of two up to 256
+    void periodicNoiseRow(const glm::ivec3& period, float x0, float step, float y, float z, std::span<float> values,
+        std::span<float> derivativesX = {}, std::span<float> derivativesZ = {}) const;
+
+    // noiseRow() at scattered points (x[i], y, z[i]) that only share y
+    void noisePoints(std::span<const float> x, float y, std::span<const float> z, std::span<float> values,
+        std::span<float> derivativesX = {}, std::span<float> derivativesZ = {}) const;
+
+    const std::array<int, 512>& getPermutation() const { return m_permutation; }
+
+private:
+    std::array<int, 512> m_permutation{};
+};
+
+// Periodic PerlinNoise baked together with its x and z derivatives into a volume over x, z and time, so that a
+// sample costs one trilinear lookup instead of a noise evaluation. Coordinates are in noise units, as for
+// noiseRow(), so the wave amplitude and frequency only scale the lookups and never require a new bake.
+class NoiseVolume
+{
+public:
+    // Lattice cells after which the volume repeats along x, z and time, and the texels per cell along each
+    static constexpr glm::ivec3 PERIOD { 16, 16, 8 };
+    static constexpr glm::ivec3 TEXELS_PER_CELL { 8, 8, 8 };
+
+    // Evaluates the noise for every texel on the thread pool
+    void bake(const PerlinNoise& noise);
+    bool isBaked() const { return !m_texels.empty(); }
+
+    // Trilinear counterpart of PerlinNoise::noiseRow(), with the same arguments and outputs
+    void sampleRow(float x0, float step, float y, float z, std::span<float> values,
+        std::span<float> derivativesX = {}, std::span<float> derivativesZ = {}) const;
+
+    // Trilinear counterpart of PerlinNoise::noisePoints()
+    void samplePoints(std::span<const float> x, float y, std::span<const float> z, std::span<float> values,
+        std::span<float> derivativesX = {}, std::span<float> derivativesZ = {}) const;
+
+    // Texels along x, z and time, x first; each holds the value and the x and z derivatives, then padding
+    static constexpr glm::ivec3 getSize() { return PERIOD * TEXELS_PER_CELL; }
+    std::span<const glm::vec4> getTexels() const { return m_texels; }
+
+private:
+    std::vector<glm::vec4> m_texels;
+};
+
+// Square grid of (resolution + 1)^2 vertices displaced by the noise, in world units
+struct WaterGridParameters {
+    glm::vec2 center;
+    float extent;
+    int resolution;
+    float waveFrequency;
+    float waveAmplitude;
+    float heightOffset;
+    // Noise coordinate along y, which animates the waves
+    float noiseTime;
+};
+
+// CPU update of the grid rows [begin, end): every row is one noise row with derivatives, sampled from noiseVolume
+// when it is not null, turned into the height and normal of the vertex that getVertex(x, z) returns. The
+// derivatives give the exact normal of every sample, so bands of rows can run on separate threads; scratch holds
+// the current row of the band and is resized as needed.
+template <typename GetVertex>
+void updateWaterGridRows(const PerlinNoise& noise, const NoiseVolume* noiseVolume, const WaterGridParameters& grid,
+    int begin, int end, std::vector<float>& scratch, GetVertex&& getVertex)
+{
+    const float step = grid.extent / static_cast<float>(grid.resolution);
+    const size_t rowLength = static_cast<size_t>(grid.resolution + 1);
+    const float noiseX0 = (grid.center.x - 0.5f * grid.extent) * grid.waveFrequency;
+    const float noiseStep = step * grid.waveFrequency;
+    // Chain rule from the noise derivatives to the slopes of the surface
+    const float slopeScale = grid.waveFrequency * grid.waveAmplitude;
+
+    scratch.resize(3 * rowLength);
+    const std::span<float> values(scratch.data(), rowLength);
+    const std::span<float> derivativesX(scratch.data() + rowLength, rowLength);
+    const std::span<float> derivativesZ(scratch.data() + 2 * rowLength, rowLength);
+
+    for (int z = begin; z < end; ++z) {
+        const float localZ = -0.5f * grid.extent + step * static_cast<float>(z);
+        const float noiseZ = (grid.center.y + localZ) * grid.waveFrequency;
+        if (noiseVolume)
+            noiseVolume->sampleRow(noiseX0, noiseStep, grid.noiseTime, noiseZ, values, derivativesX, derivativesZ);
+        else
+            noise.noiseRow(noiseX0, noiseStep, grid.noiseTime, noiseZ, values, derivativesX, derivativesZ);
+
+        for (int x = 0; x <= grid.resolution; ++x) {
+            const size_t i = static_cast<size_t>(x);
+            auto& vertex = getVertex(x, z);
+            vertex.position.y = values[i] * grid.waveAmplitude + grid.heightOffset;
+            vertex.normal = glm::normalize(glm::vec3(-derivativesX[i] * slopeScale, 1.0f, -derivativesZ[i] * slopeScale));
+        }
+    }
+}
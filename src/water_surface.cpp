@@ -1,4 +1,5 @@
 #include "water_surface.h"
+#include "thread_pool.h"
 
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -7,13 +8,179 @@ DISABLE_WARNINGS_POP()
 
 #include <algorithm>
 #include <array>
+#include <cassert>
 #include <cmath>
-#include <random>
+#include <iostream>
+#include <map>
+#include <utility>
 
 namespace {
 
 constexpr int MATERIAL_BINDING_POINT = 0;
 
+// The GPU path displaces a static grid, so its resolution is not bounded by the per-frame rebuild and upload. Both
+// only need to follow the waves; the ripples finer than that are shaded with the detail maps.
+constexpr int CPU_GRID_RESOLUTION = 96;
+constexpr int GPU_GRID_RESOLUTION = 128;
+// Extents the scrolling CPU grid may drift from the origin of its stored positions before it is placed again
+constexpr float MAX_GRID_DRIFT = 8.0f;
+
+// Tessellated path: patches per side, the triangles they may turn into, and the smallest edge on screen worth it
+constexpr int PATCH_GRID_RESOLUTION = 32;
+constexpr float TESSELLATION_TRIANGLE_BUDGET = 131072.0f;
+constexpr float MIN_TESSELLATED_EDGE_PIXELS = 4.0f;
+constexpr float MAX_TESSELLATION_LEVEL = 64.0f;
+
+// Ocean mode: samples per side of the spectrum, and how the wave speed and frequency controls map onto the wind
+// speed in meters per second and the size of the repeating patch (the defaults give 9 m/s over 64 units)
+constexpr int OCEAN_RESOLUTION = 256;
+constexpr float OCEAN_WIND_PER_SPEED = 15.0f;
+constexpr float OCEAN_PATCH_SIZE_PER_FREQUENCY = 22.4f;
+
+// Detail slope maps: texels along each side, layers (WATER_DETAIL_LAYERS in shaders/water_detail.glsl) and the noise
+// octaves summed into each, the coarsest repeating every DETAIL_MAP_BASE_PERIOD lattice cells
+constexpr int DETAIL_MAP_RESOLUTION = 256;
+constexpr int DETAIL_MAP_LAYERS = 3;
+constexpr int DETAIL_MAP_OCTAVES = 3;
+constexpr int DETAIL_MAP_BASE_PERIOD = 4;
+
+// Surface queries: points per batched noise evaluation, and the fewest points worth a range of the thread pool
+constexpr size_t QUERY_BATCH_SIZE = 64;
+constexpr int QUERY_POINTS_PER_RANGE = 1024;
+
+// Programs of the tessellated water, one per pass, sharing the fragment (and geometry) stages of the regular pass
+// shaders. Built on first use and intentionally never freed, like the cubemap conversion resources.
+struct TessellationResources {
+    Shader lighting;
+    Shader environment;
+    Shader depth;
+    Shader depthCubemap;
+    bool available { false };
+};
+
+Shader buildTessellatedShader(std::initializer_list<std::pair<GLuint, const char*>> passStages)
+{
+    ShaderBuilder builder;
+    builder.addStage(GL_VERTEX_SHADER, RESOURCE_ROOT "shaders/water_tess_vert.glsl");
+    builder.addStage(GL_TESS_CONTROL_SHADER, RESOURCE_ROOT "shaders/water_tess_ctrl.glsl");
+    builder.addStage(GL_TESS_EVALUATION_SHADER, RESOURCE_ROOT "shaders/water_tess_eval.glsl");
+    builder.addStage(GL_TESS_EVALUATION_SHADER, RESOURCE_ROOT "shaders/water_noise.glsl");
+    for (const auto& [stage, file] : passStages)
+        builder.addStage(stage, file);
+    return builder.build();
+}
+
+const TessellationResources& getTessellationResources()
+{
+    static TessellationResources* resources = []() {
+        auto* result = new TessellationResources();
+        try {
+            result->lighting = buildTessellatedShader({ { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shader_frag.glsl" },
+                { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/water_detail.glsl" } });
+            result->environment = buildTessellatedShader({ { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/env_frag.glsl" },
+                { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/water_detail.glsl" } });
+            result->depth = buildTessellatedShader({ { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shadow_frag.glsl" } });
+            result->depthCubemap = buildTessellatedShader({ { GL_GEOMETRY_SHADER, RESOURCE_ROOT "shaders/shadow_cubemap_geom.glsl" },
+                { GL_FRAGMENT_SHADER, RESOURCE_ROOT "shaders/shadow_cubemap_frag.glsl" } });
+            result->available = true;
+        } catch (const ShaderLoadingException& e) {
+            std::cerr << "Tessellated water unavailable: " << e.what() << std::endl;
+        }
+        return result;
+    }();
+    return *resources;
+}
+
+// Index buffers of the grid topologies, which only depend on the resolution. Built once for each and shared by
+// every WaterSurface of every scene; like the tessellation programs they are never freed.
+enum class GridTopology {
+    Static, // Rows of triangle strips separated by primitive restarts, drawn at once
+    Ring, // Wrapping strips for the scrolling CPU grid, drawn one row at a time
+    Patches // Quad patches of the tessellated path
+};
+
+struct GridIndices {
+    GLuint buffer { 0 };
+    GLsizei count { 0 };
+};
+
+constexpr GLushort PRIMITIVE_RESTART_INDEX = 0xFFFF;
+
+std::vector<GLushort> buildGridIndices(GridTopology topology, int resolution)
+{
+    const int rowLength = resolution + 1;
+    // 16-bit indices, with the largest value kept free for primitive restart
+    assert(rowLength * rowLength <= PRIMITIVE_RESTART_INDEX);
+    const auto vertex = [rowLength](int x, int z) { return static_cast<GLushort>(z * rowLength + x); };
+
+    std::vector<GLushort> indices;
+    switch (topology) {
+    case GridTopology::Static:
+        // Strips zig-zag between the rows, with the winding of the (x, z), (x, z + 1), (x + 1, z) triangles
+        indices.reserve(static_cast<size_t>(resolution) * static_cast<size_t>(2 * rowLength + 1));
+        for (int z = 0; z < resolution; ++z) {
+            if (z > 0)
+                indices.push_back(PRIMITIVE_RESTART_INDEX);
+            for (int x = 0; x <= resolution; ++x) {
+                indices.push_back(vertex(x, z));
+                indices.push_back(vertex(x, z + 1));
+            }
+        }
+        break;
+    case GridTopology::Ring:
+        // Every row of slots gets the strip to the next row (the last to the first), stored twice around, so the
+        // quads of any ring offset are one contiguous range per row
+        indices.reserve(static_cast<size_t>(rowLength) * static_cast<size_t>(2 * (2 * resolution + 1)));
+        for (int z = 0; z < rowLength; ++z) {
+            for (int x = 0; x <= 2 * resolution; ++x) {
+                indices.push_back(vertex(x % rowLength, z));
+                indices.push_back(vertex(x % rowLength, (z + 1) % rowLength));
+            }
+        }
+        break;
+    case GridTopology::Patches:
+        // Corners in the order (x, z), (x + 1, z), (x + 1, z + 1), (x, z + 1)
+        indices.reserve(static_cast<size_t>(resolution) * static_cast<size_t>(resolution) * 4);
+        for (int z = 0; z < resolution; ++z) {
+            for (int x = 0; x < resolution; ++x) {
+                indices.push_back(vertex(x, z));
+                indices.push_back(vertex(x + 1, z));
+                indices.push_back(vertex(x + 1, z + 1));
+                indices.push_back(vertex(x, z + 1));
+            }
+        }
+        break;
+    }
+    return indices;
+}
+
+const GridIndices& getGridIndices(GridTopology topology, int resolution)
+{
+    static std::map<std::pair<GridTopology, int>, GridIndices> cache;
+    auto [entry, inserted] = cache.try_emplace({ topology, resolution });
+    if (!inserted)
+        return entry->second;
+
+    const std::vector<GLushort> indices = buildGridIndices(topology, resolution);
+    entry->second.count = static_cast<GLsizei>(indices.size());
+    // Uploaded through the copy target, so that no vertex array object picks up the buffer by accident
+    glGenBuffers(1, &entry->second.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, entry->second.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLushort)), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return entry->second;
+}
+
+void setVertexLayout()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texCoord)));
+}
+
 RS_GPUMaterial makeWaterMaterial()
 {
     RS_GPUMaterial material{};
@@ -28,104 +195,312 @@ RS_GPUMaterial makeWaterMaterial()
 
 } // namespace
 
-// ----- PerlinNoise --------------------------------------------------------------------------------
+// ----- WaterSurface ------------------------------------------------------------------------------
 
-PerlinNoise::PerlinNoise(uint32_t seed)
+WaterSurface::WaterSurface()
+    : m_material(makeWaterMaterial())
 {
-    std::array<int, 256> base{};
-    for (int i = 0; i < 256; ++i)
-        base[static_cast<size_t>(i)] = i;
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_materialUbo);
+    glGenVertexArrays(1, &m_patchVao);
+    glGenBuffers(1, &m_patchVbo);
+
+    std::array<uint8_t, 256> permutation{};
+    for (size_t i = 0; i < permutation.size(); ++i)
+        permutation[i] = static_cast<uint8_t>(m_noise.getPermutation()[i]);
+
+    glGenTextures(1, &m_permutationTexture);
+    glBindTexture(GL_TEXTURE_2D, m_permutationTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 256, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, permutation.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    bakeDetailMaps();
+}
 
-    std::mt19937 rng(seed);
-    std::shuffle(base.begin(), base.end(), rng);
+WaterSurface::~WaterSurface()
+{
+    if (m_vao)
+        glDeleteVertexArrays(1, &m_vao);
+    if (m_vbo)
+        glDeleteBuffers(1, &m_vbo);
+    if (m_materialUbo)
+        glDeleteBuffers(1, &m_materialUbo);
+    if (m_permutationTexture)
+        glDeleteTextures(1, &m_permutationTexture);
+    if (m_patchVao)
+        glDeleteVertexArrays(1, &m_patchVao);
+    if (m_patchVbo)
+        glDeleteBuffers(1, &m_patchVbo);
+    if (m_noiseVolumeTexture)
+        glDeleteTextures(1, &m_noiseVolumeTexture);
+    if (m_oceanDisplacementTexture)
+        glDeleteTextures(1, &m_oceanDisplacementTexture);
+    if (m_oceanNormalTexture)
+        glDeleteTextures(1, &m_oceanNormalTexture);
+    if (m_wakeTexture)
+        glDeleteTextures(1, &m_wakeTexture);
+    if (m_detailTexture)
+        glDeleteTextures(1, &m_detailTexture);
+}
 
-    for (int i = 0; i < 256; ++i) {
-        const size_t idx = static_cast<size_t>(i);
-        m_permutation[idx] = m_permutation[256 + idx] = base[idx];
-    }
+void WaterSurface::setGPUDisplacement(bool enabled)
+{
+    if (enabled == m_gpuDisplacement)
+        return;
+    m_gpuDisplacement = enabled;
+    m_needsRebuild = true;
 }
 
-namespace {
+void WaterSurface::setTessellated(bool enabled)
+{
+    if (enabled == m_tessellated)
+        return;
+    m_tessellated = enabled;
+    m_needsRebuild = true;
+}
 
-double fade(double t)
+// The ocean displaces the grid horizontally, so switching replaces the samples of the CPU grid
+void WaterSurface::setOcean(bool enabled)
 {
-    return t * t * t * (t * (t * 6 - 15) + 10);
+    if (enabled == m_oceanMode)
+        return;
+    m_oceanMode = enabled;
+    m_needsRebuild = true;
 }
 
-double lerp(double t, double a, double b)
+bool WaterSurface::setWindDirection(float radians)
 {
-    return a + t * (b - a);
+    if (std::abs(radians - m_windDirection) < 1e-4f)
+        return false;
+    m_windDirection = radians;
+    return true;
 }
 
-double grad(int hash, double x, double y, double z)
+void WaterSurface::setWake(bool enabled)
 {
-    const int h = hash & 15;
-    const double u = h < 8 ? x : y;
-    const double v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
-    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+    if (enabled == m_wakeEnabled)
+        return;
+    m_wakeEnabled = enabled;
+    m_wake.clear();
 }
 
-} // namespace
+void WaterSurface::addWakeSource(const glm::vec2& position, const glm::vec2& forward, const glm::vec2& halfSize, const glm::vec2& velocity, float draft)
+{
+    if (m_enabled && m_wakeEnabled)
+        m_wake.addSource(position, forward, halfSize, velocity, draft);
+}
 
-double PerlinNoise::noise(double x, double y, double z) const
+// Step the ripples around the focus point; the GPU paths sample their heights as a texture
+void WaterSurface::updateWake(const glm::vec3& focusPosition, float deltaTime)
 {
-    const int xi = static_cast<int>(std::floor(x)) & 255;
-    const int yi = static_cast<int>(std::floor(y)) & 255;
-    const int zi = static_cast<int>(std::floor(z)) & 255;
+    m_wake.recenter(glm::vec2(focusPosition.x, focusPosition.z));
+    m_wake.step(deltaTime);
+    if (!isDisplacedOnGPU())
+        return;
 
-    const double xf = x - std::floor(x);
-    const double yf = y - std::floor(y);
-    const double zf = z - std::floor(z);
+    const int size = m_wake.getResolution();
+    if (!m_wakeTexture) {
+        glGenTextures(1, &m_wakeTexture);
+        glBindTexture(GL_TEXTURE_2D, m_wakeTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, size, size, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // The border cells are always flat, so clamping fades the ripples out at the edges of the grid
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, m_wakeTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, GL_FLOAT, m_wake.getHeights().data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    const double u = fade(xf);
-    const double v = fade(yf);
-    const double w = fade(zf);
+// Add the wake onto logical grid rows [begin, end) of the CPU path, as displaceWater in water_noise.glsl does on the GPU
+void WaterSurface::addWakeRows(int begin, int end)
+{
+    for (int z = begin; z < end; ++z) {
+        for (int x = 0; x <= m_resolution; ++x) {
+            Vertex& vertex = m_vertices[gridSlot(x, z)];
+            const glm::vec3 wake = m_wake.sample(m_gridOrigin.x + vertex.position.x, m_gridOrigin.y + vertex.position.z);
+            if (wake == glm::vec3(0.0f))
+                continue;
+            vertex.position.y += wake.x;
+            vertex.normal = glm::normalize(vertex.normal / vertex.normal.y - glm::vec3(wake.y, 0.0f, wake.z));
+        }
+    }
+}
+
+RS_OceanSpectrum::Settings WaterSurface::getOceanSettings() const
+{
+    RS_OceanSpectrum::Settings settings;
+    settings.patchSize = OCEAN_PATCH_SIZE_PER_FREQUENCY / m_waveFrequency;
+    settings.windSpeed = std::max(OCEAN_WIND_PER_SPEED * std::abs(m_waveSpeed), 0.1f);
+    settings.windDirection = m_windDirection;
+    settings.rmsHeight = m_waveAmplitude;
+    return settings;
+}
+
+// Transform the spectrum at the current time; the GPU paths sample the results as two repeating textures
+void WaterSurface::simulateOcean()
+{
+    if (!m_ocean)
+        m_ocean.emplace(OCEAN_RESOLUTION);
+    m_ocean->setSettings(getOceanSettings());
+    m_ocean->simulate(m_time);
+    if (!isDisplacedOnGPU())
+        return;
 
-    const auto perm = [this](int value) -> int {
-        return m_permutation[static_cast<size_t>(value & 255)];
+    const auto upload = [size = m_ocean->getResolution()](GLuint& texture, std::span<const glm::vec4> samples) {
+        if (!texture) {
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size, size, 0, GL_RGBA, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, samples.data());
     };
+    upload(m_oceanDisplacementTexture, m_ocean->getDisplacements());
+    upload(m_oceanNormalTexture, m_ocean->getNormals());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Ocean samples of logical grid rows [begin, end) on the CPU path, displaced from their flat positions
+void WaterSurface::updateOceanRows(int begin, int end)
+{
+    const float step = m_extent / static_cast<float>(m_resolution);
+    for (int z = begin; z < end; ++z) {
+        for (int x = 0; x <= m_resolution; ++x) {
+            const glm::vec2 local = m_center - m_gridOrigin + step * (glm::vec2(x, z) - 0.5f * static_cast<float>(m_resolution));
+            const glm::vec2 world = m_gridOrigin + local;
+            glm::vec3 displacement;
+            glm::vec3 normal;
+            m_ocean->sample(world.x, world.y, displacement, normal);
+
+            Vertex& vertex = m_vertices[gridSlot(x, z)];
+            vertex.position = glm::vec3(local.x + displacement.x, displacement.y + m_heightOffset, local.y + displacement.z);
+            vertex.normal = normal;
+        }
+    }
+}
 
-    const int aaa = perm(perm(perm(xi) + yi) + zi);
-    const int aba = perm(perm(perm(xi) + yi + 1) + zi);
-    const int aab = perm(perm(perm(xi) + yi) + zi + 1);
-    const int abb = perm(perm(perm(xi) + yi + 1) + zi + 1);
-    const int baa = perm(perm(perm(xi + 1) + yi) + zi);
-    const int bba = perm(perm(perm(xi + 1) + yi + 1) + zi);
-    const int bab = perm(perm(perm(xi + 1) + yi) + zi + 1);
-    const int bbb = perm(perm(perm(xi + 1) + yi + 1) + zi + 1);
+// Tileable slope maps for shaders/water_detail.glsl: periodic fractal noise over each tile, every layer from its
+// own slice along the noise's y axis, with the slopes (per tile) scaled to unit RMS
+void WaterSurface::bakeDetailMaps()
+{
+    constexpr size_t size = static_cast<size_t>(DETAIL_MAP_RESOLUTION);
+    constexpr size_t layerTexels = size * size;
+    std::vector<glm::vec2> slopes(layerTexels * DETAIL_MAP_LAYERS, glm::vec2(0.0f));
+
+    RS_ThreadPool::instance().parallelFor(0, DETAIL_MAP_RESOLUTION * DETAIL_MAP_LAYERS, [&](int begin, int end, int) {
+        std::vector<float> scratch(3 * size);
+        const std::span<float> values(scratch.data(), size);
+        const std::span<float> derivativesX(scratch.data() + size, size);
+        const std::span<float> derivativesZ(scratch.data() + 2 * size, size);
+
+        for (int row = begin; row < end; ++row) {
+            const int layer = row / DETAIL_MAP_RESOLUTION;
+            const float v = static_cast<float>(row % DETAIL_MAP_RESOLUTION) / static_cast<float>(DETAIL_MAP_RESOLUTION);
+            glm::vec2* rowSlopes = &slopes[static_cast<size_t>(row) * size];
+            for (int octave = 0; octave < DETAIL_MAP_OCTAVES; ++octave) {
+                const int period = DETAIL_MAP_BASE_PERIOD << octave;
+                const float cells = static_cast<float>(period);
+                const float amplitude = std::ldexp(1.0f, -octave);
+                m_noise.periodicNoiseRow(glm::ivec3(period, 256, period), 0.0f, cells / static_cast<float>(DETAIL_MAP_RESOLUTION),
+                    0.5f + 19.0f * static_cast<float>(layer), v * cells, values, derivativesX, derivativesZ);
+                for (size_t x = 0; x < size; ++x)
+                    rowSlopes[x] += amplitude * cells * glm::vec2(derivativesX[x], derivativesZ[x]);
+            }
+        }
+    });
+
+    for (size_t layer = 0; layer < DETAIL_MAP_LAYERS; ++layer) {
+        const std::span<glm::vec2> layerSlopes(slopes.data() + layer * layerTexels, layerTexels);
+        double squares = 0.0;
+        for (const glm::vec2& slope : layerSlopes)
+            squares += static_cast<double>(glm::dot(slope, slope));
+        const float scale = static_cast<float>(1.0 / std::sqrt(std::max(squares / static_cast<double>(layerTexels), 1e-12)));
+        for (glm::vec2& slope : layerSlopes)
+            slope *= scale;
+    }
 
-    const double x1 = lerp(u, grad(aaa, xf, yf, zf), grad(baa, xf - 1, yf, zf));
-    const double x2 = lerp(u, grad(aba, xf, yf - 1, zf), grad(bba, xf - 1, yf - 1, zf));
-    const double y1 = lerp(v, x1, x2);
+    glGenTextures(1, &m_detailTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_detailTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG16F, DETAIL_MAP_RESOLUTION, DETAIL_MAP_RESOLUTION, DETAIL_MAP_LAYERS, 0, GL_RG, GL_FLOAT, slopes.data());
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // Averaged slopes flatten the ripples with distance, as they should
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
 
-    const double x3 = lerp(u, grad(aab, xf, yf, zf - 1), grad(bab, xf - 1, yf, zf - 1));
-    const double x4 = lerp(u, grad(abb, xf, yf - 1, zf - 1), grad(bbb, xf - 1, yf - 1, zf - 1));
-    const double y2 = lerp(v, x3, x4);
+// The volume is in noise units, so it is baked once and stays valid for every amplitude and frequency
+void WaterSurface::bakeNoiseVolume()
+{
+    m_noiseVolume.bake(m_noise);
+
+    constexpr glm::ivec3 size = NoiseVolume::getSize();
+    if (!m_noiseVolumeTexture)
+        glGenTextures(1, &m_noiseVolumeTexture);
+    glBindTexture(GL_TEXTURE_3D, m_noiseVolumeTexture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, size.x, size.y, size.z, 0, GL_RGBA, GL_FLOAT, m_noiseVolume.getTexels().data());
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
 
-    return lerp(w, y1, y2);
+// Noise time of the waves; wrapped to the period of the volume when it is sampled, which keeps it precise
+float WaterSurface::getNoiseTime() const
+{
+    const float time = m_time * m_waveSpeed;
+    if (!m_useNoiseVolume)
+        return time;
+    const float period = static_cast<float>(NoiseVolume::PERIOD.z);
+    return time - period * std::floor(time / period);
 }
 
-// ----- WaterSurface ------------------------------------------------------------------------------
+void WaterSurface::setViewer(const glm::vec3& cameraPosition, float pixelsPerUnit)
+{
+    m_viewerPosition = cameraPosition;
+    m_viewerPixelsPerUnit = pixelsPerUnit;
+}
 
-WaterSurface::WaterSurface()
-    : m_material(makeWaterMaterial())
+bool WaterSurface::usesTessellation() const
 {
-    glGenVertexArrays(1, &m_vao);
-    glGenBuffers(1, &m_vbo);
-    glGenBuffers(1, &m_ibo);
-    glGenBuffers(1, &m_materialUbo);
+    return m_tessellated && getTessellationResources().available;
 }
 
-WaterSurface::~WaterSurface()
+const Shader* WaterSurface::getPassShader(RS_WaterPass pass) const
 {
-    if (m_vao)
-        glDeleteVertexArrays(1, &m_vao);
-    if (m_vbo)
-        glDeleteBuffers(1, &m_vbo);
-    if (m_ibo)
-        glDeleteBuffers(1, &m_ibo);
-    if (m_materialUbo)
-        glDeleteBuffers(1, &m_materialUbo);
+    if (!usesTessellation())
+        return nullptr;
+
+    const TessellationResources& resources = getTessellationResources();
+    switch (pass) {
+    case RS_WaterPass::Lighting:
+        return &resources.lighting;
+    case RS_WaterPass::Environment:
+        return &resources.environment;
+    case RS_WaterPass::Depth:
+        return &resources.depth;
+    case RS_WaterPass::DepthCubemap:
+        return &resources.depthCubemap;
+    }
+    return nullptr;
 }
 
 bool WaterSurface::setAmplitude(float value)
@@ -164,6 +539,15 @@ bool WaterSurface::setTileSize(float value)
     return true;
 }
 
+bool WaterSurface::setDetailStrength(float value)
+{
+    value = std::max(0.0f, value);
+    if (std::abs(value - m_detailStrength) < 1e-4f)
+        return false;
+    m_detailStrength = value;
+    return true;
+}
+
 bool WaterSurface::setHeightOffset(float value)
 {
     if (std::abs(value - m_heightOffset) < 1e-4f)
@@ -174,63 +558,45 @@ bool WaterSurface::setHeightOffset(float value)
 
 void WaterSurface::rebuild()
 {
-    const size_t vertexCount = static_cast<size_t>(m_resolution + 1) * static_cast<size_t>(m_resolution + 1);
-    m_vertices.resize(vertexCount);
-    m_indices.clear();
-    m_indices.reserve(static_cast<size_t>(m_resolution) * static_cast<size_t>(m_resolution) * 6);
-
-    const float step = m_extent / static_cast<float>(m_resolution);
-
-    for (int z = 0; z <= m_resolution; ++z) {
-        for (int x = 0; x <= m_resolution; ++x) {
-            const size_t idx = static_cast<size_t>(z) * static_cast<size_t>(m_resolution + 1) + static_cast<size_t>(x);
-
-            float localX = -0.5f * m_extent + step * static_cast<float>(x);
-            float localZ = -0.5f * m_extent + step * static_cast<float>(z);
-
-            float worldX = m_center.x + localX;
-            float worldZ = m_center.y + localZ;
-            float height = sampleHeight(worldX, worldZ);
-
-            m_vertices[idx].position = glm::vec3(localX, height + m_heightOffset, localZ);
-            m_vertices[idx].texCoord = glm::vec2(static_cast<float>(x) / m_resolution, static_cast<float>(z) / m_resolution);
-            m_vertices[idx].normal = glm::vec3(0.0f, 1.0f, 0.0f);
-        }
-    }
+    m_resolution = isDisplacedOnGPU() ? GPU_GRID_RESOLUTION : CPU_GRID_RESOLUTION;
+    const int rowLength = m_resolution + 1;
+    m_vertices.resize(static_cast<size_t>(rowLength) * static_cast<size_t>(rowLength));
+    resetGrid();
 
-    for (int z = 0; z < m_resolution; ++z) {
-        for (int x = 0; x < m_resolution; ++x) {
-            uint32_t topLeft = static_cast<uint32_t>(z * (m_resolution + 1) + x);
-            uint32_t topRight = topLeft + 1;
-            uint32_t bottomLeft = topLeft + static_cast<uint32_t>(m_resolution + 1);
-            uint32_t bottomRight = bottomLeft + 1;
-
-            m_indices.push_back(topLeft);
-            m_indices.push_back(bottomLeft);
-            m_indices.push_back(topRight);
-
-            m_indices.push_back(topRight);
-            m_indices.push_back(bottomLeft);
-            m_indices.push_back(bottomRight);
-        }
-    }
-
-    m_indexCount = static_cast<GLsizei>(m_indices.size());
+    // The topology only depends on the resolution, so the shared index buffer is only built the first time
+    const GridIndices& indices = getGridIndices(isDisplacedOnGPU() ? GridTopology::Static : GridTopology::Ring, m_resolution);
+    m_indexCount = indices.count;
 
     glBindVertexArray(m_vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex)), m_vertices.data(), GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_indices.size() * sizeof(uint32_t)), m_indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex)), m_vertices.data(), isDisplacedOnGPU() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+
+    setVertexLayout();
+
+    // Flat quad patches for the tessellated path
+    std::vector<Vertex> patchVertices;
+    patchVertices.reserve(static_cast<size_t>(PATCH_GRID_RESOLUTION + 1) * static_cast<size_t>(PATCH_GRID_RESOLUTION + 1));
+
+    const float patchSize = m_extent / static_cast<float>(PATCH_GRID_RESOLUTION);
+    for (int z = 0; z <= PATCH_GRID_RESOLUTION; ++z) {
+        for (int x = 0; x <= PATCH_GRID_RESOLUTION; ++x) {
+            Vertex vertex{};
+            vertex.position = glm::vec3(-0.5f * m_extent + patchSize * static_cast<float>(x), 0.0f, -0.5f * m_extent + patchSize * static_cast<float>(z));
+            vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            vertex.texCoord = glm::vec2(static_cast<float>(x), static_cast<float>(z)) / static_cast<float>(PATCH_GRID_RESOLUTION);
+            patchVertices.push_back(vertex);
+        }
+    }
+    const GridIndices& patchIndices = getGridIndices(GridTopology::Patches, PATCH_GRID_RESOLUTION);
+    m_patchIndexCount = patchIndices.count;
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texCoord)));
+    glBindVertexArray(m_patchVao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_patchVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(patchVertices.size() * sizeof(Vertex)), patchVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchIndices.buffer);
+    setVertexLayout();
 
     glBindVertexArray(0);
 
@@ -243,30 +609,92 @@ void WaterSurface::updateBuffers()
     glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex)), m_vertices.data());
 }
 
-float WaterSurface::sampleHeight(float worldX, float worldZ) const
+size_t WaterSurface::gridSlot(int x, int z) const
 {
-    const double nx = static_cast<double>(worldX) * static_cast<double>(m_waveFrequency);
-    const double ny = static_cast<double>(m_time) * static_cast<double>(m_waveSpeed);
-    const double nz = static_cast<double>(worldZ) * static_cast<double>(m_waveFrequency);
-    const double height = m_noise.noise(nx, ny, nz);
-    return static_cast<float>(height) * m_waveAmplitude;
+    const int rowLength = m_resolution + 1;
+    const int slotX = (m_ringOffset.x + x) % rowLength;
+    const int slotZ = (m_ringOffset.y + z) % rowLength;
+    return static_cast<size_t>(slotZ) * static_cast<size_t>(rowLength) + static_cast<size_t>(slotX);
 }
 
-glm::vec3 WaterSurface::computeNormal(int x, int z, float step, const std::vector<float>& heights) const
+// Flat sample relative to the grid origin; the CPU path writes the heights and normals every frame
+void WaterSurface::setGridSample(int x, int z)
 {
-    const auto idx = [this](int xi, int zi) {
-        xi = std::clamp(xi, 0, m_resolution);
-        zi = std::clamp(zi, 0, m_resolution);
-        return static_cast<size_t>(zi) * static_cast<size_t>(m_resolution + 1) + static_cast<size_t>(xi);
+    const float step = m_extent / static_cast<float>(m_resolution);
+    const glm::vec2 local = m_center - m_gridOrigin + step * (glm::vec2(x, z) - 0.5f * static_cast<float>(m_resolution));
+
+    Vertex& vertex = m_vertices[gridSlot(x, z)];
+    vertex.position = glm::vec3(local.x, 0.0f, local.y);
+    vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    vertex.texCoord = local / m_extent + 0.5f;
+}
+
+// Place every sample around the center, with the ring offset back at zero. The CPU grid snaps to whole cells so
+// that scrolling keeps sampling the same points.
+void WaterSurface::resetGrid()
+{
+    if (!isDisplacedOnGPU()) {
+        const float step = m_extent / static_cast<float>(m_resolution);
+        m_centerCell = glm::ivec2(glm::round(m_center / step));
+        m_center = glm::vec2(m_centerCell) * step;
+    }
+    m_gridOrigin = m_center;
+    m_ringOffset = glm::ivec2(0);
+
+    for (int z = 0; z <= m_resolution; ++z) {
+        for (int x = 0; x <= m_resolution; ++x)
+            setGridSample(x, z);
+    }
+    updateDrawRanges();
+}
+
+// Move the CPU grid by whole cells. Samples that stay in view keep their slot and only the rows and columns coming
+// into view are placed, so the cost follows the distance moved rather than the grid size.
+void WaterSurface::scrollGrid(const glm::ivec2& cells)
+{
+    const int rowLength = m_resolution + 1;
+    const float step = m_extent / static_cast<float>(m_resolution);
+    m_centerCell += cells;
+    m_center = glm::vec2(m_centerCell) * step;
+
+    if (std::abs(cells.x) >= rowLength || std::abs(cells.y) >= rowLength || glm::distance(m_center, m_gridOrigin) > MAX_GRID_DRIFT * m_extent) {
+        resetGrid();
+        return;
+    }
+
+    m_ringOffset = (m_ringOffset + cells % rowLength + rowLength) % rowLength;
+
+    // Logical rows or columns [first, end) that are new after a shift
+    const auto exposed = [rowLength](int shift) {
+        return shift > 0 ? std::pair(rowLength - shift, rowLength) : std::pair(0, -shift);
     };
+    const auto [firstColumn, endColumn] = exposed(cells.x);
+    const auto [firstRow, endRow] = exposed(cells.y);
+    for (int z = 0; z < rowLength; ++z) {
+        const bool rowExposed = z >= firstRow && z < endRow;
+        for (int x = rowExposed ? 0 : firstColumn; x < (rowExposed ? rowLength : endColumn); ++x)
+            setGridSample(x, z);
+    }
+    updateDrawRanges();
+}
 
-    float hL = heights[idx(x - 1, z)];
-    float hR = heights[idx(x + 1, z)];
-    float hD = heights[idx(x, z - 1)];
-    float hU = heights[idx(x, z + 1)];
+// Strips of the quad rows behind the ring offset of the CPU grid; the static GPU grid is drawn in one range
+void WaterSurface::updateDrawRanges()
+{
+    m_drawCounts.clear();
+    m_drawOffsets.clear();
+    if (isDisplacedOnGPU())
+        return;
 
-    glm::vec3 normal(-(hR - hL), 2.0f * step, -(hU - hD));
-    return glm::normalize(normal);
+    const int rowLength = m_resolution + 1;
+    // Two indices per stored column; a strip starting at an even index keeps the winding of the triangles
+    const size_t stripLength = 2 * (2 * static_cast<size_t>(m_resolution) + 1);
+    for (int z = 0; z < m_resolution; ++z) {
+        const size_t slotRow = static_cast<size_t>((m_ringOffset.y + z) % rowLength);
+        const size_t firstIndex = slotRow * stripLength + 2 * static_cast<size_t>(m_ringOffset.x);
+        m_drawCounts.push_back(2 * rowLength);
+        m_drawOffsets.push_back(reinterpret_cast<const void*>(firstIndex * sizeof(GLushort)));
+    }
 }
 
 void WaterSurface::uploadMaterial()
@@ -275,51 +703,237 @@ void WaterSurface::uploadMaterial()
     glBufferData(GL_UNIFORM_BUFFER, sizeof(RS_GPUMaterial), &m_material, GL_DYNAMIC_DRAW);
 }
 
+void WaterSurface::bindDisplacement(const Shader& shader) const
+{
+    glActiveTexture(GL_TEXTURE0 + WATER_PERMUTATION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_permutationTexture);
+    glUniform1i(shader.getUniformLocation("waterPermutation"), WATER_PERMUTATION_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + WATER_NOISE_VOLUME_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, m_noiseVolumeTexture);
+    glUniform1i(shader.getUniformLocation("waterNoiseVolume"), WATER_NOISE_VOLUME_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + WATER_OCEAN_DISPLACEMENT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_oceanDisplacementTexture);
+    glUniform1i(shader.getUniformLocation("waterOceanDisplacement"), WATER_OCEAN_DISPLACEMENT_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + WATER_OCEAN_NORMAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_oceanNormalTexture);
+    glUniform1i(shader.getUniformLocation("waterOceanNormal"), WATER_OCEAN_NORMAL_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + WATER_WAKE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_wakeTexture);
+    glUniform1i(shader.getUniformLocation("waterWakeHeights"), WATER_WAKE_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + WATER_DETAIL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_detailTexture);
+    glUniform1i(shader.getUniformLocation("waterDetailMaps"), WATER_DETAIL_TEXTURE_UNIT);
+    glUniform1i(shader.getUniformLocation("waterDetail"), m_detailEnabled ? 1 : 0);
+    glUniform1f(shader.getUniformLocation("waterDetailTime"), m_time);
+    glUniform1f(shader.getUniformLocation("waterDetailStrength"), m_detailStrength);
+    glUniform1i(shader.getUniformLocation("waterDisplacement"), isDisplacedOnGPU() ? 1 : 0);
+    if (!isDisplacedOnGPU())
+        return;
+
+    glUniform2fv(shader.getUniformLocation("waterOrigin"), 1, &m_gridOrigin[0]);
+    glUniform1f(shader.getUniformLocation("waterFrequency"), m_waveFrequency);
+    glUniform1f(shader.getUniformLocation("waterTime"), getNoiseTime());
+    glUniform1f(shader.getUniformLocation("waterAmplitude"), m_waveAmplitude);
+    glUniform1f(shader.getUniformLocation("waterHeightOffset"), m_heightOffset);
+    glUniform1i(shader.getUniformLocation("waterUseNoiseVolume"), m_useNoiseVolume ? 1 : 0);
+    // The ocean is simulated on the next update after it is switched on
+    const bool ocean = m_oceanMode && m_ocean.has_value();
+    glUniform1i(shader.getUniformLocation("waterUseOcean"), ocean ? 1 : 0);
+    if (ocean)
+        glUniform1f(shader.getUniformLocation("waterOceanPatchSize"), m_ocean->getSettings().patchSize);
+    const bool wake = m_wakeEnabled && m_wakeTexture;
+    glUniform1i(shader.getUniformLocation("waterWake"), wake ? 1 : 0);
+    if (wake) {
+        const glm::vec2 corner = m_wake.getCorner();
+        glUniform2fv(shader.getUniformLocation("waterWakeCorner"), 1, &corner[0]);
+        glUniform1f(shader.getUniformLocation("waterWakeExtent"), m_wake.getExtent());
+    }
+    if (m_useNoiseVolume) {
+        const glm::vec3 period(NoiseVolume::PERIOD);
+        glUniform3fv(shader.getUniformLocation("waterNoiseVolumePeriod"), 1, &period[0]);
+    }
+    if (usesTessellation()) {
+        glUniform3fv(shader.getUniformLocation("waterLodCamera"), 1, &m_viewerPosition[0]);
+        glUniform1f(shader.getUniformLocation("waterLodScale"), m_lodScale);
+    }
+}
+
+// The displacement uniforms are shared with every other mesh drawn by the same program
+void WaterSurface::unbindDisplacement(const Shader& shader) const
+{
+    glUniform1i(shader.getUniformLocation("waterDisplacement"), 0);
+    glUniform1i(shader.getUniformLocation("waterDetail"), 0);
+}
+
+// Triangles the control shader produces at the given LOD scale; the same edge levels, ignoring the rounding of
+// fractional_even_spacing
+float WaterSurface::estimateTessellatedTriangles(float lodScale) const
+{
+    const float patchSize = m_extent / static_cast<float>(PATCH_GRID_RESOLUTION);
+    const auto edgeLevel = [&](float localX, float localZ) {
+        const glm::vec3 center(m_center.x + localX, m_heightOffset, m_center.y + localZ);
+        const float distance = std::max(glm::distance(center, m_viewerPosition), 0.01f);
+        return std::clamp(patchSize * lodScale / distance, 1.0f, MAX_TESSELLATION_LEVEL);
+    };
+
+    float triangles = 0.0f;
+    for (int z = 0; z < PATCH_GRID_RESOLUTION; ++z) {
+        const float z0 = -0.5f * m_extent + patchSize * static_cast<float>(z);
+        for (int x = 0; x < PATCH_GRID_RESOLUTION; ++x) {
+            const float x0 = -0.5f * m_extent + patchSize * static_cast<float>(x);
+            const float innerU = std::max(edgeLevel(x0 + 0.5f * patchSize, z0), edgeLevel(x0 + 0.5f * patchSize, z0 + patchSize));
+            const float innerV = std::max(edgeLevel(x0, z0 + 0.5f * patchSize), edgeLevel(x0 + patchSize, z0 + 0.5f * patchSize));
+            triangles += 2.0f * innerU * innerV;
+        }
+    }
+    return triangles;
+}
+
+// Scale the tessellation levels towards the triangle budget, but never below the smallest useful edge on screen
+void WaterSurface::updateTessellationLOD()
+{
+    const float maxScale = m_viewerPixelsPerUnit / MIN_TESSELLATED_EDGE_PIXELS;
+    for (int iteration = 0; iteration < 2; ++iteration) {
+        const float triangles = std::max(estimateTessellatedTriangles(m_lodScale), 1.0f);
+        m_lodScale = std::clamp(m_lodScale * std::sqrt(TESSELLATION_TRIANGLE_BUDGET / triangles), 1e-3f, maxScale);
+    }
+}
+
 void WaterSurface::update(const glm::vec3& focusPosition, float deltaTime)
 {
     if (!m_enabled)
         return;
 
     m_time += deltaTime;
-    glm::vec2 newCenter(focusPosition.x, focusPosition.z);
-    if (glm::distance(newCenter, m_center) > 5.0f) {
-        m_center = newCenter;
-        m_needsRebuild = true;
-    }
+    if (m_useNoiseVolume && !m_noiseVolume.isBaked())
+        bakeNoiseVolume();
+    if (m_oceanMode)
+        simulateOcean();
+    if (m_wakeEnabled)
+        updateWake(focusPosition, deltaTime);
+
+    const glm::vec2 newCenter(focusPosition.x, focusPosition.z);
+    const bool recenter = glm::distance(newCenter, m_center) > 5.0f;
 
     if (m_needsRebuild) {
+        if (recenter)
+            m_center = newCenter;
         rebuild();
+    } else if (recenter && isDisplacedOnGPU()) {
+        // The vertex shaders move the static grid with its origin
+        m_center = newCenter;
+        m_gridOrigin = m_center;
+    } else if (recenter) {
+        const float step = m_extent / static_cast<float>(m_resolution);
+        scrollGrid(glm::ivec2(glm::round(newCenter / step)) - m_centerCell);
     }
 
-    const float step = m_extent / static_cast<float>(m_resolution);
-    const size_t vertexCount = static_cast<size_t>(m_resolution + 1) * static_cast<size_t>(m_resolution + 1);
-    std::vector<float> heights(vertexCount);
+    if (usesTessellation())
+        updateTessellationLOD();
 
-    for (int z = 0; z <= m_resolution; ++z) {
-        for (int x = 0; x <= m_resolution; ++x) {
-            const size_t idx = static_cast<size_t>(z) * static_cast<size_t>(m_resolution + 1) + static_cast<size_t>(x);
+    // The vertex shaders move the static grid to the new center and time
+    if (isDisplacedOnGPU())
+        return;
+
+    const WaterGridParameters grid { m_center, m_extent, m_resolution, m_waveFrequency, m_waveAmplitude, m_heightOffset, getNoiseTime() };
+    const NoiseVolume* noiseVolume = m_useNoiseVolume ? &m_noiseVolume : nullptr;
+
+    // Bands of rows are updated on the worker threads, each with scratch space for the row it is on
+    RS_ThreadPool& pool = RS_ThreadPool::instance();
+    const int bandCount = std::min(pool.getDefaultRangeCount(), m_resolution + 1);
+    if (m_bandRows.size() < static_cast<size_t>(bandCount))
+        m_bandRows.resize(static_cast<size_t>(bandCount));
+
+    pool.parallelFor(0, m_resolution + 1, [&](int begin, int end, int band) {
+        if (m_oceanMode) {
+            updateOceanRows(begin, end);
+        } else {
+            updateWaterGridRows(m_noise, noiseVolume, grid, begin, end, m_bandRows[static_cast<size_t>(band)],
+                [&](int x, int z) -> Vertex& { return m_vertices[gridSlot(x, z)]; });
+        }
+        if (m_wakeEnabled)
+            addWakeRows(begin, end);
+    }, bandCount);
+
+    updateBuffers();
+}
 
-            float localX = -0.5f * m_extent + step * static_cast<float>(x);
-            float localZ = -0.5f * m_extent + step * static_cast<float>(z);
-            float worldX = m_center.x + localX;
-            float worldZ = m_center.y + localZ;
+void WaterSurface::sampleSurface(std::span<const glm::vec2> positions, std::span<float> heights, std::span<glm::vec3> normals) const
+{
+    assert(heights.size() == positions.size());
+    assert(normals.empty() || normals.size() == positions.size());
+
+    // Large batches are split over the thread pool; every range is an independent query
+    RS_ThreadPool& pool = RS_ThreadPool::instance();
+    const int count = static_cast<int>(positions.size());
+    const int rangeCount = std::min(pool.getDefaultRangeCount(), count / QUERY_POINTS_PER_RANGE);
+    if (rangeCount <= 1) {
+        sampleSurfaceRange(positions, heights, normals);
+        return;
+    }
 
-            float height = sampleHeight(worldX, worldZ);
-            heights[idx] = height;
+    pool.parallelFor(0, count, [&](int begin, int end, int) {
+        const size_t offset = static_cast<size_t>(begin);
+        const size_t length = static_cast<size_t>(end - begin);
+        sampleSurfaceRange(positions.subspan(offset, length), heights.subspan(offset, length),
+            normals.empty() ? normals : normals.subspan(offset, length));
+    }, rangeCount);
+}
 
-            m_vertices[idx].position = glm::vec3(localX, height + m_heightOffset, localZ);
-            m_vertices[idx].texCoord = glm::vec2(static_cast<float>(x) / m_resolution, static_cast<float>(z) / m_resolution);
+void WaterSurface::sampleSurfaceRange(std::span<const glm::vec2> positions, std::span<float> heights, std::span<glm::vec3> normals) const
+{
+    const bool withNormals = !normals.empty();
+
+    if (m_oceanMode) {
+        for (size_t i = 0; i < positions.size(); ++i) {
+            if (!m_ocean) {
+                heights[i] = m_heightOffset;
+                if (withNormals)
+                    normals[i] = glm::vec3(0.0f, 1.0f, 0.0f);
+                continue;
+            }
+
+            // The choppy displacement moves the water sideways, so the water above a point comes from roughly one
+            // displacement upstream of it
+            glm::vec3 displacement;
+            glm::vec3 normal;
+            m_ocean->sample(positions[i].x, positions[i].y, displacement, normal);
+            m_ocean->sample(positions[i].x - displacement.x, positions[i].y - displacement.z, displacement, normal);
+            heights[i] = displacement.y + m_heightOffset;
+            if (withNormals)
+                normals[i] = normal;
         }
+        return;
     }
 
-    for (int z = 0; z <= m_resolution; ++z) {
-        for (int x = 0; x <= m_resolution; ++x) {
-            const size_t idx = static_cast<size_t>(z) * static_cast<size_t>(m_resolution + 1) + static_cast<size_t>(x);
-            m_vertices[idx].normal = computeNormal(x, z, step, heights);
+    // Same noise coordinates and chain rule as the grid update in update()
+    const float noiseY = getNoiseTime();
+    const float slopeScale = m_waveFrequency * m_waveAmplitude;
+
+    std::array<float, QUERY_BATCH_SIZE> noiseX, noiseZ, values, derivativesX, derivativesZ;
+    for (size_t first = 0; first < positions.size(); first += QUERY_BATCH_SIZE) {
+        const size_t count = std::min(QUERY_BATCH_SIZE, positions.size() - first);
+        for (size_t i = 0; i < count; ++i) {
+            noiseX[i] = positions[first + i].x * m_waveFrequency;
+            noiseZ[i] = positions[first + i].y * m_waveFrequency;
         }
-    }
 
-    updateBuffers();
+        const std::span<const float> x(noiseX.data(), count);
+        const std::span<const float> z(noiseZ.data(), count);
+        const std::span<float> batchValues(values.data(), count);
+        const std::span<float> batchDerivativesX = withNormals ? std::span<float>(derivativesX.data(), count) : std::span<float>();
+        const std::span<float> batchDerivativesZ = withNormals ? std::span<float>(derivativesZ.data(), count) : std::span<float>();
+        if (m_useNoiseVolume && m_noiseVolume.isBaked())
+            m_noiseVolume.samplePoints(x, noiseY, z, batchValues, batchDerivativesX, batchDerivativesZ);
+        else
+            m_noise.noisePoints(x, noiseY, z, batchValues, batchDerivativesX, batchDerivativesZ);
+
+        for (size_t i = 0; i < count; ++i) {
+            heights[first + i] = values[i] * m_waveAmplitude + m_heightOffset;
+            if (withNormals)
+                normals[first + i] = glm::normalize(glm::vec3(-derivativesX[i] * slopeScale, 1.0f, -derivativesZ[i] * slopeScale));
+        }
+    }
 }
 
 void WaterSurface::draw(const Shader& shader, const glm::mat4& viewProjectionMatrix)
@@ -330,7 +944,7 @@ void WaterSurface::draw(const Shader& shader, const glm::mat4& viewProjectionMat
     uploadMaterial();
     shader.bindUniformBlock("Material", MATERIAL_BINDING_POINT, m_materialUbo);
 
-    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_center.x, 0.0f, m_center.y));
+    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_gridOrigin.x, 0.0f, m_gridOrigin.y));
     const glm::mat4 mvpMatrix = viewProjectionMatrix * modelMatrix;
     const glm::mat3 normalMatrix = glm::mat3(1.0f);
 
@@ -346,9 +960,7 @@ void WaterSurface::draw(const Shader& shader, const glm::mat4& viewProjectionMat
     glUniform1i(hasTexCoordsLoc, 1);
     glUniform1i(useMaterialLoc, 1);
 
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    drawGeometry(shader);
 }
 
 void WaterSurface::drawEnvironment(const Shader& shader, const glm::mat4& viewProjectionMatrix)
@@ -361,14 +973,12 @@ void WaterSurface::drawDepth(const Shader& shader, const glm::mat4& viewProjecti
     if (!m_enabled)
         return;
 
-    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_center.x, 0.0f, m_center.y));
+    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_gridOrigin.x, 0.0f, m_gridOrigin.y));
     const glm::mat4 mvpMatrix = viewProjectionMatrix * modelMatrix;
     const GLint mvpLoc = shader.getUniformLocation("mvpMatrix");
     glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, &mvpMatrix[0][0]);
 
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    drawGeometry(shader);
 }
 
 void WaterSurface::drawDepthCubemap(const Shader& shader)
@@ -376,11 +986,31 @@ void WaterSurface::drawDepthCubemap(const Shader& shader)
     if (!m_enabled)
         return;
 
-    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_center.x, 0.0f, m_center.y));
+    const glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(m_gridOrigin.x, 0.0f, m_gridOrigin.y));
     const GLint modelLoc = shader.getUniformLocation("modelMatrix");
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix[0][0]);
 
-    glBindVertexArray(m_vao);
-    glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr);
+    drawGeometry(shader);
+}
+
+void WaterSurface::drawGeometry(const Shader& shader) const
+{
+    bindDisplacement(shader);
+    if (usesTessellation()) {
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+        glBindVertexArray(m_patchVao);
+        glDrawElements(GL_PATCHES, m_patchIndexCount, GL_UNSIGNED_SHORT, nullptr);
+    } else {
+        glBindVertexArray(m_vao);
+        if (m_drawCounts.empty()) {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+            glDrawElements(GL_TRIANGLE_STRIP, m_indexCount, GL_UNSIGNED_SHORT, nullptr);
+            glDisable(GL_PRIMITIVE_RESTART);
+        } else {
+            glMultiDrawElements(GL_TRIANGLE_STRIP, m_drawCounts.data(), GL_UNSIGNED_SHORT, m_drawOffsets.data(), static_cast<GLsizei>(m_drawCounts.size()));
+        }
+    }
     glBindVertexArray(0);
+    unbindDisplacement(shader);
 }
@@ -2,6 +2,9 @@
 
 #include "mesh.h"
 #include "model.h"
+#include "ocean_spectrum.h"
+#include "water_noise.h"
+#include "water_wake.h"
 
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -11,19 +14,28 @@ DISABLE_WARNINGS_POP()
 
 #include <array>
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <vector>
 
 #include <framework/shader.h>
 
-class PerlinNoise
-{
-public:
-    explicit PerlinNoise(uint32_t seed = 0);
-
-    double noise(double x, double y, double z) const;
-
-private:
-    std::array<int, 512> m_permutation{};
+// Texture units of the noise permutation table, the baked noise volume, the ocean displacement and normal maps and
+// the wake heights sampled by shaders/water_noise.glsl
+constexpr GLint WATER_PERMUTATION_TEXTURE_UNIT = 7;
+constexpr GLint WATER_NOISE_VOLUME_TEXTURE_UNIT = 8;
+constexpr GLint WATER_OCEAN_DISPLACEMENT_TEXTURE_UNIT = 9;
+constexpr GLint WATER_OCEAN_NORMAL_TEXTURE_UNIT = 10;
+constexpr GLint WATER_WAKE_TEXTURE_UNIT = 11;
+// Detail slope maps sampled by shaders/water_detail.glsl in the fragment stage
+constexpr GLint WATER_DETAIL_TEXTURE_UNIT = 12;
+
+// Render passes that draw the water; the tessellated surface has its own program for each of them
+enum class RS_WaterPass {
+    Lighting,
+    Environment,
+    Depth,
+    DepthCubemap
 };
 
 class WaterSurface
@@ -36,6 +48,11 @@ public:
     WaterSurface& operator=(const WaterSurface&) = delete;
 
     void update(const glm::vec3& focusPosition, float deltaTime);
+    // Height of the water and its unit normal at world (x, z) of every position, as update() last animated it. Batched
+    // for the many hull points of floating models; large batches run on the thread pool. The wake is left out, so hulls
+    // do not ride their own ripples. Only reads the surface, so queries may run concurrently with each other, but not
+    // with update(). normals may be empty.
+    void sampleSurface(std::span<const glm::vec2> positions, std::span<float> heights, std::span<glm::vec3> normals = {}) const;
     void draw(const Shader& shader, const glm::mat4& viewProjectionMatrix);
     void drawEnvironment(const Shader& shader, const glm::mat4& viewProjectionMatrix);
     void drawDepth(const Shader& shader, const glm::mat4& viewProjectionMatrix);
@@ -44,30 +61,99 @@ public:
     bool isEnabled() const { return m_enabled; }
     void setEnabled(bool enabled) { m_enabled = enabled; }
 
+    // Displace a static flat grid in the vertex shaders (shaders/water_noise.glsl) instead of rebuilding and
+    // uploading the vertices on the CPU every frame
+    bool isGPUDisplacement() const { return m_gpuDisplacement; }
+    void setGPUDisplacement(bool enabled);
+
+    // Draw a coarse patch grid that the GPU tessellates finer towards the viewer, within a fixed triangle budget.
+    // Always displaced on the GPU.
+    bool isTessellated() const { return m_tessellated; }
+    void setTessellated(bool enabled);
+    // Main camera the tessellation is chosen for (in every pass, so shadows match); pixelsPerUnit is the projected
+    // size in pixels of a unit length at unit distance
+    void setViewer(const glm::vec3& cameraPosition, float pixelsPerUnit);
+    // Sample a baked NoiseVolume instead of evaluating the noise, on the CPU and GPU paths alike. The waves then
+    // repeat after NoiseVolume::PERIOD cells in space and time.
+    bool isNoiseVolume() const { return m_useNoiseVolume; }
+    void setNoiseVolume(bool enabled) { m_useNoiseVolume = enabled; }
+    // Replace the noise by an FFT ocean (RS_OceanSpectrum) that repeats across the water. The amplitude then sets
+    // the RMS wave height, the speed the wind speed and the frequency the size of the repeating patch; the wind
+    // direction is in radians from +x towards +z.
+    bool isOcean() const { return m_oceanMode; }
+    void setOcean(bool enabled);
+    bool setWindDirection(float radians);
+    float getWindDirection() const { return m_windDirection; }
+    // Ripples of moving hulls around the focus point (RS_WaterWake), added onto the waves on every path
+    bool isWake() const { return m_wakeEnabled; }
+    void setWake(bool enabled);
+    // Hull moving over the water until the next update(); see RS_WaterWake::addSource()
+    void addWakeSource(const glm::vec2& position, const glm::vec2& forward, const glm::vec2& halfSize, const glm::vec2& velocity, float draft);
+    // Shade ripples finer than the grid with scrolling detail maps (shaders/water_detail.glsl), baked at construction;
+    // the strength is the RMS slope each of their layers adds
+    bool isDetailNormals() const { return m_detailEnabled; }
+    void setDetailNormals(bool enabled) { m_detailEnabled = enabled; }
+    // Program to draw the water with in the given pass, after giving it the uniforms of that pass, or nullptr when
+    // the pass shader itself draws the water
+    const Shader* getPassShader(RS_WaterPass pass) const;
+
     bool setAmplitude(float value);
     bool setFrequency(float value);
     bool setSpeed(float value);
     bool setTileSize(float value);
     bool setHeightOffset(float value);
+    bool setDetailStrength(float value);
 
     float getAmplitude() const { return m_waveAmplitude; }
     float getFrequency() const { return m_waveFrequency; }
     float getSpeed() const { return m_waveSpeed; }
     float getTileSize() const { return m_extent; }
     float getHeightOffset() const { return m_heightOffset; }
+    float getDetailStrength() const { return m_detailStrength; }
 
 private:
     void rebuild();
     void updateBuffers();
-    float sampleHeight(float worldX, float worldZ) const;
-    glm::vec3 computeNormal(int x, int z, float step, const std::vector<float>& heights) const;
+    // Grid slot of logical sample (x, z); the CPU grid is a torus that scrolls by moving its ring offset
+    size_t gridSlot(int x, int z) const;
+    void setGridSample(int x, int z);
+    void resetGrid();
+    void scrollGrid(const glm::ivec2& cells);
+    void updateDrawRanges();
     void uploadMaterial();
+    void bindDisplacement(const Shader& shader) const;
+    void unbindDisplacement(const Shader& shader) const;
+    void drawGeometry(const Shader& shader) const;
+    bool isDisplacedOnGPU() const { return m_gpuDisplacement || m_tessellated; }
+    bool usesTessellation() const;
+    float estimateTessellatedTriangles(float lodScale) const;
+    void updateTessellationLOD();
+    void bakeNoiseVolume();
+    void bakeDetailMaps();
+    float getNoiseTime() const;
+    void sampleSurfaceRange(std::span<const glm::vec2> positions, std::span<float> heights, std::span<glm::vec3> normals) const;
+    RS_OceanSpectrum::Settings getOceanSettings() const;
+    void simulateOcean();
+    void updateOceanRows(int begin, int end);
+    void updateWake(const glm::vec3& focusPosition, float deltaTime);
+    void addWakeRows(int begin, int end);
 
 private:
     bool m_enabled{ true };
     bool m_needsRebuild{ true };
+    bool m_gpuDisplacement{ true };
+    bool m_tessellated{ false };
+    bool m_useNoiseVolume{ false };
+    bool m_oceanMode{ false };
+    bool m_wakeEnabled{ true };
+    bool m_detailEnabled{ true };
 
     glm::vec2 m_center{ 0.0f };
+    // World translation of the stored vertex positions
+    glm::vec2 m_gridOrigin{ 0.0f };
+    // Grid cell of the center on the CPU path, which snaps to whole cells, and the slot of logical sample (0, 0)
+    glm::ivec2 m_centerCell{ 0 };
+    glm::ivec2 m_ringOffset{ 0 };
     float m_extent{ 120.0f };
     int m_resolution{ 96 };
 
@@ -75,18 +161,42 @@ private:
     float m_waveFrequency{ 0.35f };
     float m_waveSpeed{ 0.6f };
     float m_heightOffset{ -1.5f };
+    float m_windDirection{ 0.0f };
+    float m_detailStrength{ 0.08f };
     float m_time{ 0.0f };
 
     GLuint m_vao{ 0 };
     GLuint m_vbo{ 0 };
-    GLuint m_ibo{ 0 };
     GLsizei m_indexCount{ 0 };
+    GLuint m_permutationTexture{ 0 };
+
+    GLuint m_patchVao{ 0 };
+    GLuint m_patchVbo{ 0 };
+    GLsizei m_patchIndexCount{ 0 };
+    glm::vec3 m_viewerPosition{ 0.0f };
+    float m_viewerPixelsPerUnit{ 512.0f };
+    float m_lodScale{ 64.0f };
 
     std::vector<Vertex> m_vertices;
-    std::vector<uint32_t> m_indices;
+    // One strip per row of quads behind the ring offset; drawn with a single glMultiDrawElements
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const void*> m_drawOffsets;
+    // Noise values and derivatives of one grid row, for each row band of the CPU update
+    std::vector<std::vector<float>> m_bandRows;
 
     GLuint m_materialUbo{ 0 };
     RS_GPUMaterial m_material{};
 
     PerlinNoise m_noise;
+    NoiseVolume m_noiseVolume;
+    GLuint m_noiseVolumeTexture{ 0 };
+
+    // Created on first use of the ocean mode
+    std::optional<RS_OceanSpectrum> m_ocean;
+    GLuint m_oceanDisplacementTexture{ 0 };
+    GLuint m_oceanNormalTexture{ 0 };
+
+    RS_WaterWake m_wake;
+    GLuint m_wakeTexture{ 0 };
+    GLuint m_detailTexture{ 0 };
 };
@@ -0,0 +1,222 @@
+#include "water_wake.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_WATER_WAKE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Speed of the ripples in world units per second and the rate at which their motion dies out
+constexpr float WAVE_SPEED = 2.5f;
+constexpr float WAVE_DAMPING = 0.6f;
+
+// The solver always steps by the same time; a slow frame runs a few steps and drops the rest of its time
+constexpr float TIME_STEP = 1.0f / 60.0f;
+constexpr int MAX_STEPS_PER_CALL = 2;
+
+// Hulls are clamped to this speed, so that a model jumping to a new place does not flood the grid
+constexpr float MAX_SOURCE_SPEED = 10.0f;
+
+// Fewest grid rows worth a range of the thread pool
+constexpr int ROWS_PER_RANGE = 32;
+
+} // namespace
+
+RS_WaterWake::RS_WaterWake(int resolution, float extent)
+    : m_resolution(resolution)
+    , m_extent(extent)
+    , m_cellSize(extent / static_cast<float>(resolution))
+{
+    assert(resolution >= 3);
+    // The explicit scheme is only stable while a ripple crosses less than a cell per step along both axes
+    assert(WAVE_SPEED * TIME_STEP / m_cellSize < 0.7f);
+
+    const size_t cellCount = static_cast<size_t>(resolution) * static_cast<size_t>(resolution);
+    m_heights.assign(cellCount, 0.0f);
+    m_previousHeights.assign(cellCount, 0.0f);
+}
+
+glm::vec2 RS_WaterWake::getCorner() const
+{
+    return (glm::vec2(m_centerCell) - 0.5f * static_cast<float>(m_resolution)) * m_cellSize;
+}
+
+float RS_WaterWake::height(int x, int z) const
+{
+    return m_heights[static_cast<size_t>(z) * static_cast<size_t>(m_resolution) + static_cast<size_t>(x)];
+}
+
+void RS_WaterWake::clear()
+{
+    std::fill(m_heights.begin(), m_heights.end(), 0.0f);
+    std::fill(m_previousHeights.begin(), m_previousHeights.end(), 0.0f);
+    m_sources.clear();
+}
+
+void RS_WaterWake::recenter(const glm::vec2& center)
+{
+    const glm::ivec2 centerCell(glm::round(center / m_cellSize));
+    const glm::ivec2 shift = centerCell - m_centerCell;
+    if (shift == glm::ivec2(0))
+        return;
+
+    m_centerCell = centerCell;
+    const int n = m_resolution;
+    if (std::abs(shift.x) >= n - 1 || std::abs(shift.y) >= n - 1) {
+        clear();
+        return;
+    }
+
+    // Cell (x, z) takes over cell (x + shift) of the old grid; the cells coming into view and the border start flat
+    const auto move = [n, shift](std::vector<float>& heights) {
+        const int firstX = std::max(1, 1 - shift.x);
+        const int endX = std::min(n - 1, n - 1 - shift.x);
+        const auto row = [&heights, n](int z) { return heights.begin() + static_cast<ptrdiff_t>(z) * n; };
+
+        if (shift.y > 0 || (shift.y == 0 && shift.x > 0)) {
+            for (int z = 1; z < n - 1; ++z) {
+                const int source = z + shift.y;
+                if (source >= 1 && source < n - 1)
+                    std::copy(row(source) + firstX + shift.x, row(source) + endX + shift.x, row(z) + firstX);
+                else
+                    std::fill(row(z), row(z) + n, 0.0f);
+            }
+        } else {
+            for (int z = n - 2; z >= 1; --z) {
+                const int source = z + shift.y;
+                if (source >= 1 && source < n - 1)
+                    std::copy_backward(row(source) + firstX + shift.x, row(source) + endX + shift.x, row(z) + endX);
+                else
+                    std::fill(row(z), row(z) + n, 0.0f);
+            }
+        }
+        for (int z = 1; z < n - 1; ++z) {
+            std::fill(row(z), row(z) + firstX, 0.0f);
+            std::fill(row(z) + endX, row(z) + n, 0.0f);
+        }
+    };
+    move(m_heights);
+    move(m_previousHeights);
+}
+
+void RS_WaterWake::addSource(const glm::vec2& position, const glm::vec2& forward, const glm::vec2& halfSize, const glm::vec2& velocity, float draft)
+{
+    if (halfSize.x <= 0.0f || halfSize.y <= 0.0f || glm::length(forward) < 1e-6f)
+        return;
+
+    const float speed = glm::length(velocity);
+    const glm::vec2 clampedVelocity = speed > MAX_SOURCE_SPEED ? velocity * (MAX_SOURCE_SPEED / speed) : velocity;
+    m_sources.push_back({ position, glm::normalize(forward), halfSize, clampedVelocity, draft });
+}
+
+// A hull displaces the water by draft * (1 - q)^2 inside its ellipse, where q is the squared elliptical distance
+// from its center. Moving it lowers the water ahead and releases the water behind; both buffers are shifted, so
+// this moves the surface without adding momentum and a hull at rest leaves no trace.
+void RS_WaterWake::applySources(float timeStep)
+{
+    const int n = m_resolution;
+    const glm::vec2 corner = getCorner();
+    for (const Source& source : m_sources) {
+        const glm::vec2 right(source.forward.y, -source.forward.x);
+        const float radius = std::max(source.halfSize.x, source.halfSize.y);
+        const glm::ivec2 first = glm::max(glm::ivec2(glm::floor((source.position - radius - corner) / m_cellSize)), glm::ivec2(1));
+        const glm::ivec2 last = glm::min(glm::ivec2(glm::ceil((source.position + radius - corner) / m_cellSize)), glm::ivec2(n - 2));
+
+        for (int z = first.y; z <= last.y; ++z) {
+            for (int x = first.x; x <= last.x; ++x) {
+                const glm::vec2 offset = corner + (glm::vec2(x, z) + 0.5f) * m_cellSize - source.position;
+                const float along = glm::dot(offset, source.forward) / source.halfSize.x;
+                const float across = glm::dot(offset, right) / source.halfSize.y;
+                const float q = along * along + across * across;
+                if (q >= 1.0f)
+                    continue;
+
+                // -d/dt of the displacement under a hull moving with velocity: velocity . gradient
+                const glm::vec2 gradientQ = 2.0f * (along / source.halfSize.x * source.forward + across / source.halfSize.y * right);
+                const glm::vec2 gradient = -2.0f * source.draft * (1.0f - q) * gradientQ;
+                const float change = timeStep * glm::dot(source.velocity, gradient);
+
+                const size_t i = static_cast<size_t>(z) * static_cast<size_t>(n) + static_cast<size_t>(x);
+                m_heights[i] += change;
+                m_previousHeights[i] += change;
+            }
+        }
+    }
+}
+
+// Leapfrog step of the damped wave equation for rows [begin, end), written over the previous heights
+void RS_WaterWake::integrateRows(int begin, int end, float courant, float keep)
+{
+    const size_t n = static_cast<size_t>(m_resolution);
+    for (int z = begin; z < end; ++z) {
+        const float* up = &m_heights[(static_cast<size_t>(z) - 1) * n];
+        const float* row = &m_heights[static_cast<size_t>(z) * n];
+        const float* down = &m_heights[(static_cast<size_t>(z) + 1) * n];
+        float* out = &m_previousHeights[static_cast<size_t>(z) * n];
+
+        size_t x = 1;
+#ifdef RS_WATER_WAKE_SSE2
+        const __m128 courant4 = _mm_set1_ps(courant);
+        const __m128 keep4 = _mm_set1_ps(keep);
+        const __m128 four = _mm_set1_ps(4.0f);
+        for (; x + 4 <= n - 1; x += 4) {
+            const __m128 center = _mm_loadu_ps(row + x);
+            const __m128 neighbours = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1)),
+                _mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+            const __m128 laplacian = _mm_sub_ps(neighbours, _mm_mul_ps(four, center));
+            const __m128 velocity = _mm_mul_ps(_mm_sub_ps(center, _mm_loadu_ps(out + x)), keep4);
+            _mm_storeu_ps(out + x, _mm_add_ps(_mm_add_ps(center, velocity), _mm_mul_ps(courant4, laplacian)));
+        }
+#endif
+        for (; x < n - 1; ++x) {
+            const float laplacian = row[x - 1] + row[x + 1] + up[x] + down[x] - 4.0f * row[x];
+            out[x] = row[x] + (row[x] - out[x]) * keep + courant * laplacian;
+        }
+    }
+}
+
+void RS_WaterWake::step(float deltaTime)
+{
+    m_pendingTime = std::min(m_pendingTime + std::max(deltaTime, 0.0f), MAX_STEPS_PER_CALL * TIME_STEP);
+
+    const float courant = (WAVE_SPEED * TIME_STEP / m_cellSize) * (WAVE_SPEED * TIME_STEP / m_cellSize);
+    const float keep = 1.0f - WAVE_DAMPING * TIME_STEP;
+    RS_ThreadPool& pool = RS_ThreadPool::instance();
+    const int rangeCount = std::clamp((m_resolution - 2) / ROWS_PER_RANGE, 1, pool.getDefaultRangeCount());
+
+    for (; m_pendingTime >= TIME_STEP; m_pendingTime -= TIME_STEP) {
+        applySources(TIME_STEP);
+        pool.parallelFor(1, m_resolution - 1, [&](int begin, int end, int) {
+            integrateRows(begin, end, courant, keep);
+        }, rangeCount);
+        std::swap(m_heights, m_previousHeights);
+    }
+    m_sources.clear();
+}
+
+glm::vec3 RS_WaterWake::sample(float x, float z) const
+{
+    const glm::vec2 cell = (glm::vec2(x, z) - getCorner()) / m_cellSize - 0.5f;
+    const glm::vec2 base = glm::floor(cell);
+    const int x0 = static_cast<int>(base.x);
+    const int z0 = static_cast<int>(base.y);
+    if (x0 < 0 || z0 < 0 || x0 >= m_resolution - 1 || z0 >= m_resolution - 1)
+        return glm::vec3(0.0f);
+
+    const glm::vec2 weight = cell - base;
+    const float h00 = height(x0, z0);
+    const float h10 = height(x0 + 1, z0);
+    const float h01 = height(x0, z0 + 1);
+    const float h11 = height(x0 + 1, z0 + 1);
+
+    const float value = glm::mix(glm::mix(h00, h10, weight.x), glm::mix(h01, h11, weight.x), weight.y);
+    const float slopeX = glm::mix(h10 - h00, h11 - h01, weight.y) / m_cellSize;
+    const float slopeZ = glm::mix(h01 - h00, h11 - h10, weight.x) / m_cellSize;
+    return glm::vec3(value, slopeX, slopeZ);
+}
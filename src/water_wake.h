@@ -0,0 +1,61 @@
+#pragma once
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <span>
+#include <vector>
+
+// Damped 2D wave equation on a square heightfield that follows the focus point, stirred up by the hulls of moving
+// models. The heights are offsets added onto the water and settle back to zero once the hulls stop.
+class RS_WaterWake {
+public:
+    // resolution cells along each side of a square of extent world units
+    explicit RS_WaterWake(int resolution = 128, float extent = 32.0f);
+
+    // Keep the grid centered on center by moving it whole cells; ripples keep their place in the world
+    void recenter(const glm::vec2& center);
+    // Hull that moves with velocity during the next step(): an ellipse with semi-axes halfSize along and across
+    // forward, which pushes the water down by up to draft
+    void addSource(const glm::vec2& position, const glm::vec2& forward, const glm::vec2& halfSize, const glm::vec2& velocity, float draft);
+    // Advance by deltaTime in fixed time steps, at most a few per call so that the cost of a frame is bounded, on
+    // the shared thread pool. Consumes the sources.
+    void step(float deltaTime);
+    void clear();
+
+    // Height and its x and z slopes at world (x, z), bilinear; zero outside the grid
+    glm::vec3 sample(float x, float z) const;
+
+    int getResolution() const { return m_resolution; }
+    float getExtent() const { return m_extent; }
+    // World xz of the grid's corner; cell (x, z) is centered at corner + (x + 0.5, z + 0.5) * extent / resolution
+    glm::vec2 getCorner() const;
+    // Heights of the cells, x first
+    std::span<const float> getHeights() const { return m_heights; }
+
+private:
+    struct Source {
+        glm::vec2 position;
+        glm::vec2 forward;
+        glm::vec2 halfSize;
+        glm::vec2 velocity;
+        float draft;
+    };
+
+    void applySources(float timeStep);
+    void integrateRows(int begin, int end, float courant, float keep);
+    float height(int x, int z) const;
+
+    int m_resolution;
+    float m_extent;
+    float m_cellSize;
+    glm::ivec2 m_centerCell { 0 };
+    float m_pendingTime { 0.0f };
+
+    // Heights of the current and the previous step; the border cells stay zero
+    std::vector<float> m_heights;
+    std::vector<float> m_previousHeights;
+    std::vector<Source> m_sources;
+};
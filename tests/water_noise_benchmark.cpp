@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+#include "water_noise.h"
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cost of the noise the CPU water grid evaluates every frame. This target is built twice, the second time with
+// RS_WATER_NOISE_SCALAR defined, so running both compares the SSE2 path with the scalar fallback on one machine.
+// The per-sample PerlinNoise::noise() loop is the double-precision reference both are tested against. Run with
+// "[scaling]" for the time of a whole grid update against the number of threads.
+namespace {
+
+// One row of the CPU water grid
+constexpr size_t ROW_LENGTH = 97;
+// Default extent, wave frequency and amplitude of WaterSurface
+constexpr float GRID_EXTENT = 120.0f;
+constexpr float WAVE_FREQUENCY = 0.35f;
+constexpr float WAVE_AMPLITUDE = 0.1f;
+
+} // namespace
+
+TEST_CASE("Water noise throughput", "[water_noise][benchmark]")
+{
+    const PerlinNoise noise(7);
+    std::vector<float> values(ROW_LENGTH), derivativesX(ROW_LENGTH), derivativesZ(ROW_LENGTH);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::vector<float> x(ROW_LENGTH), z(ROW_LENGTH);
+    for (size_t i = 0; i < ROW_LENGTH; ++i) {
+        x[i] = coordinate(rng);
+        z[i] = coordinate(rng);
+    }
+
+    BENCHMARK("noise() per sample, 97 samples")
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < ROW_LENGTH; ++i)
+            sum += noise.noise(static_cast<double>(x[i]), 0.5, static_cast<double>(z[i]));
+        return sum;
+    };
+
+    BENCHMARK("noiseRow, 97 values")
+    {
+        noise.noiseRow(-12.3f, 0.37f, 0.5f, 4.2f, values);
+        return values[0];
+    };
+
+    BENCHMARK("noiseRow, 97 values and derivatives")
+    {
+        noise.noiseRow(-12.3f, 0.37f, 0.5f, 4.2f, values, derivativesX, derivativesZ);
+        return values[0] + derivativesX[0] + derivativesZ[0];
+    };
+
+    BENCHMARK("noisePoints, 97 values and derivatives")
+    {
+        noise.noisePoints(x, 0.5f, z, values, derivativesX, derivativesZ);
+        return values[0] + derivativesX[0] + derivativesZ[0];
+    };
+}
+
+TEST_CASE("Water grid update scaling", "[water_noise][benchmark][scaling]")
+{
+    // The CPU path of WaterSurface::update() without the vertex upload, in one band of rows per thread
+    struct GridVertex {
+        glm::vec3 position, normal;
+    };
+    std::vector<GridVertex> vertices(ROW_LENGTH * ROW_LENGTH);
+    const PerlinNoise noise(7);
+    const WaterGridParameters grid { glm::vec2(0.0f), GRID_EXTENT, static_cast<int>(ROW_LENGTH - 1), WAVE_FREQUENCY, WAVE_AMPLITUDE, 0.0f, 0.5f };
+
+    std::vector<unsigned> threadCounts { 1, 2, 4, std::max(1u, std::thread::hardware_concurrency()) };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (const unsigned threadCount : threadCounts) {
+        // The calling thread takes a band too, as the render thread does
+        RS_ThreadPool pool(threadCount - 1);
+        const int bandCount = static_cast<int>(threadCount);
+        std::vector<std::vector<float>> bandRows(threadCount);
+
+        BENCHMARK("Grid update, " + std::to_string(threadCount) + " thread(s)")
+        {
+            pool.parallelFor(0, static_cast<int>(ROW_LENGTH), [&](int begin, int end, int band) {
+                updateWaterGridRows(noise, nullptr, grid, begin, end, bandRows[static_cast<size_t>(band)], [&](int x, int z) -> GridVertex& {
+                    return vertices[static_cast<size_t>(z) * ROW_LENGTH + static_cast<size_t>(x)];
+                });
+            }, bandCount);
+            return vertices[0].position.y;
+        };
+    }
+}
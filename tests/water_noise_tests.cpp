@@ -0,0 +1,144 @@
+#include "water_noise.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_range.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// The single-precision paths are compared with PerlinNoise::noise(), which evaluates the same lattice in double.
+// Values stay within [-1, 1] and the derivatives within a few units, so these bounds leave room for float rounding
+// only; a wrong hash, corner or fade shows up as an error of order one.
+namespace {
+
+constexpr double VALUE_TOLERANCE = 1e-5;
+constexpr double DERIVATIVE_TOLERANCE = 1e-4;
+
+// Step of the central differences that stand in for the derivatives of the double-precision reference
+constexpr double DIFFERENCE_STEP = 1e-4;
+
+// Row lengths around the four lanes of the SIMD path, so that every length of the scalar tail is covered
+const std::vector<size_t> ROW_LENGTHS { 0, 1, 2, 3, 4, 5, 7, 8, 9, 13, 16, 31, 97 };
+
+struct Reference {
+    double value, derivativeX, derivativeZ;
+};
+
+Reference reference(const PerlinNoise& noise, float x, float y, float z)
+{
+    const double px = x, py = y, pz = z;
+    return {
+        noise.noise(px, py, pz),
+        (noise.noise(px + DIFFERENCE_STEP, py, pz) - noise.noise(px - DIFFERENCE_STEP, py, pz)) / (2.0 * DIFFERENCE_STEP),
+        (noise.noise(px, py, pz + DIFFERENCE_STEP) - noise.noise(px, py, pz - DIFFERENCE_STEP)) / (2.0 * DIFFERENCE_STEP)
+    };
+}
+
+void requireMatches(const Reference& expected, float value, float derivativeX, float derivativeZ)
+{
+    using Catch::Matchers::WithinAbs;
+    REQUIRE_THAT(static_cast<double>(value), WithinAbs(expected.value, VALUE_TOLERANCE));
+    REQUIRE_THAT(static_cast<double>(derivativeX), WithinAbs(expected.derivativeX, DERIVATIVE_TOLERANCE));
+    REQUIRE_THAT(static_cast<double>(derivativeZ), WithinAbs(expected.derivativeZ, DERIVATIVE_TOLERANCE));
+}
+
+} // namespace
+
+TEST_CASE("noiseRow matches the double-precision noise", "[water_noise]")
+{
+    const PerlinNoise noise(7);
+    std::mt19937 rng(1234);
+    // Negative coordinates and coordinates past the 256 cells of the permutation exercise the lattice wrapping
+    std::uniform_real_distribution<float> coordinate(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> stepSize(0.01f, 0.9f);
+
+    const size_t length = GENERATE(from_range(ROW_LENGTHS));
+    CAPTURE(length);
+    for (int trial = 0; trial < 20; ++trial) {
+        const float x0 = coordinate(rng), step = stepSize(rng), y = coordinate(rng), z = coordinate(rng);
+        std::vector<float> values(length), derivativesX(length), derivativesZ(length), valuesOnly(length);
+        noise.noiseRow(x0, step, y, z, values, derivativesX, derivativesZ);
+        noise.noiseRow(x0, step, y, z, valuesOnly);
+
+        for (size_t i = 0; i < length; ++i) {
+            CAPTURE(trial, i);
+            requireMatches(reference(noise, x0 + static_cast<float>(i) * step, y, z), values[i], derivativesX[i], derivativesZ[i]);
+            // Skipping the derivatives must not change the values
+            REQUIRE(valuesOnly[i] == values[i]);
+        }
+    }
+}
+
+TEST_CASE("noisePoints matches the double-precision noise", "[water_noise]")
+{
+    const PerlinNoise noise(7);
+    std::mt19937 rng(5678);
+    std::uniform_real_distribution<float> coordinate(-300.0f, 300.0f);
+
+    const size_t length = GENERATE(from_range(ROW_LENGTHS));
+    CAPTURE(length);
+    for (int trial = 0; trial < 20; ++trial) {
+        const float y = coordinate(rng);
+        std::vector<float> x(length), z(length);
+        for (size_t i = 0; i < length; ++i) {
+            x[i] = coordinate(rng);
+            z[i] = coordinate(rng);
+        }
+        std::vector<float> values(length), derivativesX(length), derivativesZ(length), valuesOnly(length);
+        noise.noisePoints(x, y, z, values, derivativesX, derivativesZ);
+        noise.noisePoints(x, y, z, valuesOnly);
+
+        for (size_t i = 0; i < length; ++i) {
+            CAPTURE(trial, i);
+            requireMatches(reference(noise, x[i], y, z[i]), values[i], derivativesX[i], derivativesZ[i]);
+            REQUIRE(valuesOnly[i] == values[i]);
+        }
+    }
+}
+
+TEST_CASE("noisePoints along a row is bit-identical to noiseRow", "[water_noise]")
+{
+    // The water surface mixes both: the grid is evaluated by rows, the floating models by points
+    const PerlinNoise noise(3);
+    const size_t length = GENERATE(from_range(ROW_LENGTHS));
+    CAPTURE(length);
+
+    const float x0 = -12.3f, step = 0.37f, y = 4.56f, z = -78.9f;
+    std::vector<float> rowValues(length), rowDerivativesX(length), rowDerivativesZ(length);
+    noise.noiseRow(x0, step, y, z, rowValues, rowDerivativesX, rowDerivativesZ);
+
+    std::vector<float> x(length), zs(length, z);
+    for (size_t i = 0; i < length; ++i)
+        x[i] = x0 + static_cast<float>(i) * step;
+    std::vector<float> values(length), derivativesX(length), derivativesZ(length);
+    noise.noisePoints(x, y, zs, values, derivativesX, derivativesZ);
+
+    for (size_t i = 0; i < length; ++i) {
+        CAPTURE(i);
+        REQUIRE(values[i] == rowValues[i]);
+        REQUIRE(derivativesX[i] == rowDerivativesX[i]);
+        REQUIRE(derivativesZ[i] == rowDerivativesZ[i]);
+    }
+}
+
+TEST_CASE("periodicNoiseRow repeats with its period", "[water_noise]")
+{
+    const PerlinNoise noise(11);
+    const glm::ivec3 period(16, 8, 32);
+    const size_t length = GENERATE(from_range(ROW_LENGTHS));
+    CAPTURE(length);
+
+    // Whole periods are exact in float, so the shifted rows sample the same fractions of the same cells
+    const float x0 = 0.3f, step = 0.25f, y = 1.7f, z = 2.9f;
+    std::vector<float> values(length), shiftedValues(length);
+    noise.periodicNoiseRow(period, x0, step, y, z, values);
+    noise.periodicNoiseRow(period, x0 + static_cast<float>(period.x), step, y + static_cast<float>(period.y), z - static_cast<float>(period.z), shiftedValues);
+
+    for (size_t i = 0; i < length; ++i) {
+        CAPTURE(i);
+        REQUIRE_THAT(static_cast<double>(shiftedValues[i]), Catch::Matchers::WithinAbs(static_cast<double>(values[i]), VALUE_TOLERANCE));
+    }
+}